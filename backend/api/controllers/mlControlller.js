@@ -30,6 +30,24 @@ exports.model = async (req, res) => {
   }
 };
 
+exports.devicePrediction = async (req, res) => {
+  try {
+    const { plant_id, predicted_dry_time, current_moisture } = req.body;
+    if (!plant_id || !predicted_dry_time || current_moisture === undefined) {
+      return res.status(400).send({ message: "plant_id, predicted_dry_time and current_moisture are required" });
+    }
+    if (isNaN(new Date(predicted_dry_time).getTime())) {
+      return res.status(400).send({ message: "predicted_dry_time must be an ISO-8601 time" });
+    }
+
+    await ModelingService.saveDevicePrediction(plant_id, predicted_dry_time, current_moisture);
+    return res.status(200).send("Successfully uploaded prediction");
+  } catch (error) {
+    console.error('Error in devicePrediction endpoint:', error);
+    return res.status(500).send({ message: "Internal server error" });
+  }
+};
+
 function soil_moisture_predict(input_arr) {
   avg_moisture = (input_arr[0][3] + input_arr[0][4]) / 2
   return avg_moisture - Math.round((Math.random() * 0.4 + 0.8) * 100) / 100;
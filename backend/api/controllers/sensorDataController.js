@@ -1,11 +1,35 @@
 const SensorData = require("../models/sensorModel");
 const PlantMonitoringService = require('../services/plantMonitoringService');
 const WateringDetectionService = require('../services/wateringDetectionService');
+const SequencedIngestService = require('../services/sequencedIngestService');
+const DeviceTelemetry = require("../models/deviceTelemetryModel");
+const DeviceOta = require("../models/deviceOtaModel");
+const DeviceIntervals = require("../models/deviceIntervalsModel");
+const SensorRollup = require("../models/sensorRollupModel");
+
+// Sequenced upload from current firmware:
+//   { device_id, base, records: [{ plant_id, seq, ...readings, time_stamp }, ...] }
+// Stored by SequencedIngestService, which also takes the same batches over MQTT; the response
+// is { ack }, the highest sequence up to which the device's records are all stored, with the
+// device's intervals if any are set. The device drops its buffered records up to the ack and
+// resends the rest.
+const sequencedUpload = async (req, res) => {
+  const { device_id, base, records } = req.body;
+  if (!SequencedIngestService.isValid(req.body)) {
+    return res.status(400).send({ message: "Sequenced upload needs device_id and a seq per record" });
+  }
+
+  const ack = await SequencedIngestService.store(device_id, base, records);
+  return res.status(200).send(await SequencedIngestService.reply(device_id, ack));
+};
 
 exports.sensorUpload = async (req, res) => {
-  console.log(`Processing sensor upload: ${req.body.length ? 'batch' : 'single'} request`);
+  console.log(`Processing sensor upload: ${req.body.length ? 'batch' : req.body.records ? 'sequenced' : 'single'} request`);
   
   try {
+    if (Array.isArray(req.body.records)) {
+      return await sequencedUpload(req, res);
+    }
     if (req.body.length) {
       for (const data of req.body) {
         const sensorData = new SensorData(data);
@@ -27,6 +51,83 @@ exports.sensorUpload = async (req, res) => {
   }
 };
 
+// Rollups of records a device's full buffer let go of, oldest first:
+//   { device_id, rollups: [{ plant_id, first_seq, last_seq, span, records, time_stamp,
+//                            <channel>: { min, max, mean, count }, ... }, ...] }
+exports.sensorRollups = async (req, res) => {
+  const { device_id, rollups } = req.body;
+  if (typeof device_id !== "string" || !Array.isArray(rollups) || !rollups.every(SensorRollup.isValid)) {
+    return res.status(400).send({ message: "device_id and rollups with plant_id, first_seq, last_seq, span, records and time_stamp are required" });
+  }
+
+  try {
+    for (const rollup of rollups) {
+      await SensorRollup.save(device_id, rollup);
+    }
+    return res.status(200).send("Successfully uploaded sensor rollups");
+  } catch (err) {
+    console.error("Error uploading sensor rollups:", err);
+    return res.status(500).send({ message: "Internal server error" });
+  }
+};
+
+// Upload profile from the firmware's UploadProfiler:
+//   { device_id, uploads, failures, bytes_sent, bytes_received, sent_p50, ..., phases: { dns: { n, p50, ... } } }
+exports.deviceTelemetry = async (req, res) => {
+  const { device_id, uploads, phases } = req.body;
+  if (typeof device_id !== "string" || !Number.isInteger(uploads) || typeof phases !== "object" || phases === null) {
+    return res.status(400).send({ message: "device_id, uploads and phases are required" });
+  }
+
+  try {
+    await DeviceTelemetry.save(device_id, req.body);
+    return res.status(200).send("Successfully uploaded telemetry");
+  } catch (err) {
+    console.error("Error uploading device telemetry:", err);
+    return res.status(500).send({ message: "Internal server error" });
+  }
+};
+
+// Firmware update attempt from the firmware's OtaUpdater:
+//   { device_id, from_version, to_version, method: "delta"|"full"|"rollback", bytes, image_bytes, duration_ms, ok, error }
+exports.deviceOta = async (req, res) => {
+  const { device_id, to_version, method, bytes } = req.body;
+  if (typeof device_id !== "string" || typeof to_version !== "string" ||
+      !["delta", "full", "rollback"].includes(method) || !Number.isInteger(bytes)) {
+    return res.status(400).send({ message: "device_id, to_version, method and bytes are required" });
+  }
+
+  try {
+    await DeviceOta.save(device_id, req.body);
+    return res.status(200).send("Successfully uploaded OTA report");
+  } catch (err) {
+    console.error("Error uploading OTA report:", err);
+    return res.status(500).send({ message: "Internal server error" });
+  }
+};
+
+// Sets a device's task intervals (ms), delivered in its next upload response:
+//   { device_id, intervals: { sample?, record?, upload?, bt? } }, or intervals: null to clear them
+exports.deviceIntervals = async (req, res) => {
+  const { device_id, intervals } = req.body;
+  if (typeof device_id !== "string" ||
+      (intervals !== null && (typeof intervals !== "object" || !DeviceIntervals.isValid(intervals)))) {
+    return res.status(400).send({ message: "device_id and intervals within bounds are required" });
+  }
+
+  try {
+    if (intervals === null) {
+      await DeviceIntervals.clear(device_id);
+    } else {
+      await DeviceIntervals.set(device_id, intervals);
+    }
+    return res.status(200).send("Successfully set device intervals");
+  } catch (err) {
+    console.error("Error setting device intervals:", err);
+    return res.status(500).send({ message: "Internal server error" });
+  }
+};
+
 exports.testSensorUpload = async (req, res) => {
   try {
     if (req.body.length) {
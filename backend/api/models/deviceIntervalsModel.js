@@ -0,0 +1,57 @@
+const connection = require("../../db/connection");
+
+// Task intervals (ms) set for a device from the backend. They go back in every sequenced upload
+// response until cleared, so a device applies them on its next upload and a value changed
+// over BLE is brought back in line. Columns left NULL keep the device's own setting.
+const BOUNDS = {
+  sample: [0, 60000],
+  record: [1000, 3600000],
+  upload: [5000, 86400000],
+  bt: [500, 60000],
+};
+
+class DeviceIntervals {
+  // Same bounds as the firmware's INTERVAL_*_MIN/MAX; the device refuses anything else anyway
+  static isValid(intervals) {
+    const names = Object.keys(intervals);
+    if (names.length === 0 || !names.every((name) => name in BOUNDS)) return false;
+    if (!names.every((name) => Number.isInteger(intervals[name]) &&
+        intervals[name] >= BOUNDS[name][0] && intervals[name] <= BOUNDS[name][1])) return false;
+    return intervals.sample === undefined || intervals.record === undefined || intervals.sample <= intervals.record;
+  }
+
+  static set(device_id, intervals) {
+    return connection.query(
+      `INSERT INTO DeviceIntervals (device_id, sample_ms, record_ms, upload_ms, bt_ms) VALUES (?, ?, ?, ?, ?)
+       ON DUPLICATE KEY UPDATE sample_ms = VALUES(sample_ms), record_ms = VALUES(record_ms),
+         upload_ms = VALUES(upload_ms), bt_ms = VALUES(bt_ms)`,
+      [
+        device_id,
+        intervals.sample ?? null,
+        intervals.record ?? null,
+        intervals.upload ?? null,
+        intervals.bt ?? null,
+      ]
+    );
+  }
+
+  static clear(device_id) {
+    return connection.query("DELETE FROM DeviceIntervals WHERE device_id = ?", [device_id]);
+  }
+
+  // { record: 60000, ... } with only the intervals that are set, or null
+  static async get(device_id) {
+    const [[row]] = await connection.query(
+      "SELECT sample_ms, record_ms, upload_ms, bt_ms FROM DeviceIntervals WHERE device_id = ?",
+      [device_id]
+    );
+    if (!row) return null;
+    const intervals = {};
+    for (const name of Object.keys(BOUNDS)) {
+      if (row[`${name}_ms`] !== null) intervals[name] = Number(row[`${name}_ms`]);
+    }
+    return Object.keys(intervals).length > 0 ? intervals : null;
+  }
+}
+
+module.exports = DeviceIntervals;
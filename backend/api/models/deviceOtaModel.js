@@ -0,0 +1,24 @@
+const connection = require("../../db/connection");
+
+// One firmware update attempt as the device reports it: how the new image came (delta, full, or
+// a rollback the previous image noticed after restarting), the bytes downloaded and the time taken.
+class DeviceOta {
+  static save(device_id, report) {
+    return connection.query(
+      "INSERT INTO DeviceOtaReports (device_id, from_version, to_version, method, bytes, image_bytes, duration_ms, ok, error) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+      [
+        device_id,
+        report.from_version,
+        report.to_version,
+        report.method,
+        report.bytes,
+        report.image_bytes,
+        report.duration_ms,
+        report.ok === true,
+        report.error || null,
+      ]
+    );
+  }
+}
+
+module.exports = DeviceOta;
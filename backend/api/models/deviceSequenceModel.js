@@ -0,0 +1,46 @@
+const connection = require("../../db/connection");
+
+// Per-device acknowledgement of sequenced sensor uploads. acked_seq is the highest sequence
+// number up to which every record of the device has been stored.
+class DeviceSequence {
+  // Moves the device's acknowledgement as far as its stored records are contiguous and
+  // returns it. base is the oldest sequence the device still holds; anything before it was
+  // lost on the device (buffer overwrite) and is no longer waited for.
+  static async acknowledge(device_id, base) {
+    await connection.query(
+      "INSERT INTO DeviceSequence (device_id, acked_seq) VALUES (?, 0) ON DUPLICATE KEY UPDATE device_id = device_id",
+      [device_id]
+    );
+    if (base > 0) {
+      await connection.query(
+        "UPDATE DeviceSequence SET acked_seq = GREATEST(acked_seq, ?) WHERE device_id = ?",
+        [base - 1, device_id]
+      );
+    }
+
+    const [[row]] = await connection.query(
+      "SELECT acked_seq FROM DeviceSequence WHERE device_id = ?",
+      [device_id]
+    );
+    let acked = Number(row.acked_seq);
+
+    // Only records the device still holds can be past the acknowledgement, so this stays small
+    const [rows] = await connection.query(
+      "SELECT DISTINCT seq FROM SensorData WHERE device_id = ? AND seq > ? ORDER BY seq",
+      [device_id, acked]
+    );
+    for (const { seq } of rows) {
+      if (Number(seq) !== acked + 1) break;
+      acked++;
+    }
+
+    // GREATEST keeps concurrent requests from the same device from moving it backwards
+    await connection.query(
+      "UPDATE DeviceSequence SET acked_seq = GREATEST(acked_seq, ?) WHERE device_id = ?",
+      [acked, device_id]
+    );
+    return acked;
+  }
+}
+
+module.exports = DeviceSequence;
@@ -0,0 +1,26 @@
+const connection = require("../../db/connection");
+
+// Upload profile a device reports every hour or so: its upload counters and the rolling
+// percentiles of each upload phase (ms), kept as sent so new phases need no migration.
+class DeviceTelemetry {
+  static save(device_id, report) {
+    return connection.query(
+      "INSERT INTO DeviceTelemetry (device_id, uploads, failures, bytes_sent, bytes_received, phases) VALUES (?, ?, ?, ?, ?, ?)",
+      [
+        device_id,
+        report.uploads,
+        report.failures,
+        report.bytes_sent,
+        report.bytes_received,
+        JSON.stringify({
+          ...report.phases,
+          sent_bytes: { p50: report.sent_p50, p90: report.sent_p90 },
+          received_bytes: { p50: report.received_p50, p90: report.received_p90 },
+          tls_sessions: { handshakes: report.tls_handshakes, resumed: report.tls_resumed },
+        }),
+      ]
+    );
+  }
+}
+
+module.exports = DeviceTelemetry;
@@ -11,6 +11,8 @@ class SensorData {
     soil_moisture_1,
     soil_moisture_2,
     time_stamp,
+    device_id,
+    seq,
   }) {
     this.plant_id = plant_id;
     this.ext_temp = ext_temp;
@@ -20,11 +22,15 @@ class SensorData {
     this.soil_moisture_1 = soil_moisture_1;
     this.soil_moisture_2 = soil_moisture_2;
     this.time_stamp = time_stamp;
+    this.device_id = device_id ?? null;
+    this.seq = seq ?? null;
   }
 
+  // A record already stored under the same (device_id, seq, plant_id) is left as it was, so
+  // retried uploads are harmless; the result's affectedRows is 0 for such a duplicate.
   uploadData() {
     const cmd =
-      "INSERT INTO SensorData (plant_id, ext_temp, light, humidity, soil_temp, soil_moisture_1, soil_moisture_2, time_stamp) VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+      "INSERT INTO SensorData (plant_id, ext_temp, light, humidity, soil_temp, soil_moisture_1, soil_moisture_2, time_stamp, device_id, seq) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?) ON DUPLICATE KEY UPDATE sensor_id = sensor_id";
 
     return connection.query(cmd, [
       this.plant_id,
@@ -35,6 +41,8 @@ class SensorData {
       this.soil_moisture_1,
       this.soil_moisture_2,
       this.time_stamp,
+      this.device_id,
+      this.seq,
     ]);
   }
   static readData(plant_id) {
@@ -0,0 +1,39 @@
+const connection = require("../../db/connection");
+
+// Summary of raw records a device let go of during an outage longer than its buffer: min, max,
+// mean and count per channel over span seconds (900, or 3600 once the device merged them). The
+// channels are kept as sent. A device may resend a rollup, or send it again merged into a longer
+// one, under the same first_seq; the newer one replaces it.
+class SensorRollup {
+  static isValid(rollup) {
+    return !!rollup && Number.isInteger(rollup.plant_id) && Number.isInteger(rollup.first_seq) &&
+      Number.isInteger(rollup.last_seq) && rollup.last_seq >= rollup.first_seq &&
+      Number.isInteger(rollup.span) && rollup.span > 0 && Number.isInteger(rollup.records) &&
+      typeof rollup.time_stamp === "string";
+  }
+
+  static save(device_id, rollup) {
+    const channels = {};
+    for (const [key, value] of Object.entries(rollup)) {
+      if (value !== null && typeof value === "object") channels[key] = value;
+    }
+    return connection.query(
+      `INSERT INTO SensorRollups (device_id, plant_id, first_seq, last_seq, span_s, records, time_stamp, channels)
+       VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+       ON DUPLICATE KEY UPDATE last_seq = VALUES(last_seq), span_s = VALUES(span_s), records = VALUES(records),
+         time_stamp = VALUES(time_stamp), channels = VALUES(channels)`,
+      [
+        device_id,
+        rollup.plant_id,
+        rollup.first_seq,
+        rollup.last_seq,
+        rollup.span,
+        rollup.records,
+        rollup.time_stamp,
+        JSON.stringify(channels),
+      ]
+    );
+  }
+}
+
+module.exports = SensorRollup;
@@ -1,8 +1,11 @@
 let express = require("express");
-let { model } = require("../controllers/mlControlller");
+let { model, devicePrediction } = require("../controllers/mlControlller");
 let router = express.Router();
 
 // Needs plant_id passed as query parameter
 router.get("/model", model);
 
+// Dry time predicted on the device from the exported decision tree
+router.post("/devicePrediction", devicePrediction);
+
 module.exports = router;
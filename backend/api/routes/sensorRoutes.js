@@ -3,6 +3,10 @@ let express = require("express");
 let router = express.Router();
 let {
   sensorUpload,
+  sensorRollups,
+  deviceTelemetry,
+  deviceOta,
+  deviceIntervals,
   sensorRead,
   sensorReadSeries,
   testSensorUpload,
@@ -18,6 +22,18 @@ const { body, query } = require("express-validator");
 
 router.post("/sensorUpload", sensorUpload);
 
+// Lower-resolution summaries of records a device dropped during a long outage
+router.post("/sensorRollups", sensorRollups);
+
+// Upload phase timings and byte counts the device reports periodically
+router.post("/deviceTelemetry", deviceTelemetry);
+
+// Firmware update attempts: delta or full download, bytes and time, or a rollback
+router.post("/deviceOta", deviceOta);
+
+// Sampling, recording, upload and BLE intervals for a device, sent back with its uploads
+router.put("/deviceIntervals", deviceIntervals);
+
 router.post("/testSensorUpload", plantTokenVerify, testSensorUpload);
 
 router.get("/sensorRead", sensorRead);
@@ -0,0 +1,219 @@
+const dgram = require("dgram");
+const SequencedIngestService = require("./sequencedIngestService");
+require("dotenv").config();
+
+// Takes the batches devices POST as confirmable CoAP requests (RFC 7252) to api/sensorUpload,
+// in Block1 blocks (RFC 7959), and stores them like HTTP sequenced uploads. Each block is
+// answered with 2.31 Continue, the last with 2.04 Changed and { ack }. Only what the firmware's
+// CoapUploader sends is understood. Started when COAP_PORT is set.
+const CON = 0;
+const ACK = 2;
+const CODE = (c, dd) => (c << 5) | dd;
+const POST = CODE(0, 2);
+const CHANGED = CODE(2, 4);
+const CONTINUE = CODE(2, 31);
+const BAD_REQUEST = CODE(4, 0);
+const NOT_FOUND = CODE(4, 4);
+const INCOMPLETE = CODE(4, 8);
+const TOO_LARGE = CODE(4, 13);
+const OPTION_URI_PATH = 11;
+const OPTION_CONTENT_FORMAT = 12;
+const OPTION_BLOCK1 = 27;
+const CONTENT_JSON = 50;
+
+class CoapIngestService {
+    constructor() {
+        this.PATH = "api/sensorUpload";
+        this.MAX_BODY = 64 * 1024;
+        this.TRANSFER_TIMEOUT_MS = 60 * 1000;
+        this.REPLIES_PER_PEER = 16;
+        this.socket = null;
+        this.transfers = new Map(); // peer + token -> { chunks, size, lastMs }
+        this.replies = new Map(); // peer -> [[messageId, reply]], to answer retransmissions
+        this.sweepTimer = null;
+    }
+
+    start() {
+        if (!process.env.COAP_PORT) {
+            return;
+        }
+        this.socket = dgram.createSocket("udp4");
+        this.socket.on("message", (msg, rinfo) => {
+            this.handleMessage(msg, rinfo).catch((err) => console.error("Error handling CoAP message:", err));
+        });
+        this.socket.on("error", (err) => console.error("CoAP ingest error:", err.message));
+        this.socket.bind(Number(process.env.COAP_PORT), () => {
+            console.log(`CoAP ingest listening on udp ${process.env.COAP_PORT}`);
+        });
+        this.sweepTimer = setInterval(() => this.sweep(), this.TRANSFER_TIMEOUT_MS);
+    }
+
+    stop() {
+        if (this.sweepTimer) {
+            clearInterval(this.sweepTimer);
+            this.sweepTimer = null;
+        }
+        if (this.socket) {
+            this.socket.close();
+            this.socket = null;
+        }
+        console.log('CoAP ingest service stopped');
+    }
+
+    parse(msg) {
+        if (msg.length < 4 || msg[0] >> 6 !== 1) return null;
+        const tokenLength = msg[0] & 0x0f;
+        if (tokenLength > 8 || msg.length < 4 + tokenLength) return null;
+        const message = {
+            type: (msg[0] >> 4) & 0x03,
+            code: msg[1],
+            messageId: msg.readUInt16BE(2),
+            token: msg.subarray(4, 4 + tokenLength),
+            path: [],
+            block1: null,
+            payload: Buffer.alloc(0),
+        };
+        let i = 4 + tokenLength;
+        let number = 0;
+        const extended = (nibble) => {
+            if (nibble < 13) return nibble;
+            if (nibble === 13) return msg[i++] + 13;
+            if (nibble === 14) {
+                const value = msg.readUInt16BE(i) + 269;
+                i += 2;
+                return value;
+            }
+            throw new Error("Reserved option nibble");
+        };
+        try {
+            while (i < msg.length) {
+                if (msg[i] === 0xff) {
+                    message.payload = msg.subarray(i + 1);
+                    break;
+                }
+                const header = msg[i++];
+                number += extended(header >> 4);
+                const length = extended(header & 0x0f);
+                const value = msg.subarray(i, i + length);
+                i += length;
+                if (number === OPTION_URI_PATH) {
+                    message.path.push(value.toString());
+                } else if (number === OPTION_BLOCK1) {
+                    const raw = value.reduce((acc, byte) => acc * 256 + byte, 0);
+                    message.block1 = { num: Math.floor(raw / 16), more: (raw & 0x08) !== 0, szx: raw & 0x07 };
+                }
+            }
+        } catch (err) {
+            return null;
+        }
+        return message;
+    }
+
+    encodeOption(delta, value) {
+        const nibble = (n) => (n < 13 ? [n, []] : n < 269 ? [13, [n - 13]] : [14, [(n - 269) >> 8, (n - 269) & 0xff]]);
+        const [d, dExt] = nibble(delta);
+        const [l, lExt] = nibble(value.length);
+        return Buffer.concat([Buffer.from([(d << 4) | l, ...dExt, ...lExt]), value]);
+    }
+
+    encodeUint(value) {
+        const bytes = [];
+        while (value > 0) {
+            bytes.unshift(value & 0xff);
+            value = Math.floor(value / 256);
+        }
+        return Buffer.from(bytes);
+    }
+
+    // A piggybacked response in the ACK for request
+    response(request, code, block1, payload) {
+        const parts = [Buffer.from([0x40 | (ACK << 4) | request.token.length, code, request.messageId >> 8,
+            request.messageId & 0xff]), request.token];
+        let last = 0;
+        if (payload) {
+            parts.push(this.encodeOption(OPTION_CONTENT_FORMAT - last, this.encodeUint(CONTENT_JSON)));
+            last = OPTION_CONTENT_FORMAT;
+        }
+        if (block1) {
+            const raw = block1.num * 16 + (block1.more ? 0x08 : 0) + block1.szx;
+            parts.push(this.encodeOption(OPTION_BLOCK1 - last, this.encodeUint(raw)));
+        }
+        if (payload) {
+            parts.push(Buffer.from([0xff]), Buffer.from(payload));
+        }
+        return Buffer.concat(parts);
+    }
+
+    reply(peer, rinfo, request, code, block1, payload) {
+        const message = this.response(request, code, block1, payload);
+        const recent = this.replies.get(peer) || [];
+        recent.push([request.messageId, message]);
+        if (recent.length > this.REPLIES_PER_PEER) recent.shift();
+        this.replies.set(peer, recent);
+        this.socket.send(message, rinfo.port, rinfo.address);
+    }
+
+    async handleMessage(msg, rinfo) {
+        const request = this.parse(msg);
+        if (!request || request.type !== CON) {
+            return;
+        }
+        const peer = `${rinfo.address}:${rinfo.port}`;
+        // A retransmission gets the reply it had, without being stored twice
+        const previous = (this.replies.get(peer) || []).find(([id]) => id === request.messageId);
+        if (previous) {
+            this.socket.send(previous[1], rinfo.port, rinfo.address);
+            return;
+        }
+        if (request.code !== POST || request.path.join("/") !== this.PATH) {
+            return this.reply(peer, rinfo, request, NOT_FOUND);
+        }
+
+        const block = request.block1 || { num: 0, more: false, szx: 6 };
+        const blockSize = 16 << block.szx;
+        const key = peer + request.token.toString("hex");
+        if (block.num === 0) {
+            this.transfers.set(key, { chunks: [], size: 0, lastMs: Date.now() });
+        }
+        const transfer = this.transfers.get(key);
+        if (!transfer || transfer.size !== block.num * blockSize ||
+            (block.more && request.payload.length !== blockSize)) {
+            this.transfers.delete(key);
+            return this.reply(peer, rinfo, request, INCOMPLETE);
+        }
+        if (transfer.size + request.payload.length > this.MAX_BODY) {
+            this.transfers.delete(key);
+            return this.reply(peer, rinfo, request, TOO_LARGE);
+        }
+        transfer.chunks.push(request.payload);
+        transfer.size += request.payload.length;
+        transfer.lastMs = Date.now();
+        if (block.more) {
+            return this.reply(peer, rinfo, request, CONTINUE, block);
+        }
+        this.transfers.delete(key);
+
+        let body;
+        try {
+            body = JSON.parse(Buffer.concat(transfer.chunks).toString());
+        } catch (err) {
+            return this.reply(peer, rinfo, request, BAD_REQUEST, block);
+        }
+        if (!SequencedIngestService.isValid(body)) {
+            return this.reply(peer, rinfo, request, BAD_REQUEST, block);
+        }
+        const ack = await SequencedIngestService.store(body.device_id, body.base, body.records);
+        const response = await SequencedIngestService.reply(body.device_id, ack);
+        this.reply(peer, rinfo, request, CHANGED, block, JSON.stringify(response));
+    }
+
+    // Drops transfers whose device gave up partway
+    sweep() {
+        const now = Date.now();
+        for (const [key, transfer] of this.transfers) {
+            if (now - transfer.lastMs > this.TRANSFER_TIMEOUT_MS) this.transfers.delete(key);
+        }
+    }
+}
+
+module.exports = new CoapIngestService();
@@ -0,0 +1,68 @@
+const fs = require("fs");
+const https = require("https");
+require("dotenv").config();
+
+// Serves the app over TLS for devices built with USE_TLS_UPLOAD. They keep one connection open
+// between uploads and resume their TLS session when it has to be reopened, so the server keeps
+// idle connections longer than Node's 5 s default and accepts TLS 1.2 session tickets. Tickets
+// are encrypted with TLS_TICKET_KEYS (48 bytes, hex) when set, so they survive restarts;
+// otherwise every restart costs each device one full handshake. Started when TLS_CERT_FILE
+// and TLS_KEY_FILE are set.
+class HttpsServerService {
+    constructor() {
+        this.PORT = Number(process.env.HTTPS_PORT || 3443);
+        this.KEEP_ALIVE_MS = 120 * 1000; // Longer than the devices' 20 s upload interval
+        this.SESSION_TIMEOUT_S = 24 * 60 * 60;
+        this.server = null;
+        this.statsTimer = null;
+    }
+
+    start(app) {
+        if (!process.env.TLS_CERT_FILE || !process.env.TLS_KEY_FILE) {
+            return;
+        }
+        const options = {
+            cert: fs.readFileSync(process.env.TLS_CERT_FILE),
+            key: fs.readFileSync(process.env.TLS_KEY_FILE),
+            sessionTimeout: this.SESSION_TIMEOUT_S,
+        };
+        if (process.env.TLS_TICKET_KEYS) {
+            options.ticketKeys = Buffer.from(process.env.TLS_TICKET_KEYS, "hex");
+        }
+        this.server = https.createServer(options, app);
+        this.server.keepAliveTimeout = this.KEEP_ALIVE_MS;
+        this.server.headersTimeout = this.KEEP_ALIVE_MS + 5000;
+
+        let handshakes = 0;
+        let resumed = 0;
+        this.server.on("secureConnection", (socket) => {
+            handshakes++;
+            if (socket.isSessionReused()) resumed++;
+        });
+        this.statsTimer = setInterval(() => {
+            if (handshakes > 0) {
+                console.log(`TLS handshakes: ${handshakes}, ${resumed} resumed`);
+                handshakes = 0;
+                resumed = 0;
+            }
+        }, 60 * 60 * 1000);
+
+        this.server.listen(this.PORT, () => {
+            console.log(`Listening for TLS on port ${this.server.address().port}`);
+        });
+    }
+
+    stop() {
+        if (this.statsTimer) {
+            clearInterval(this.statsTimer);
+            this.statsTimer = null;
+        }
+        if (this.server) {
+            this.server.close();
+            this.server = null;
+        }
+        console.log('HTTPS server stopped');
+    }
+}
+
+module.exports = new HttpsServerService();
@@ -88,6 +88,16 @@ class ModelingService {
         }
     }
 
+    // Devices running the exported tree upload their dry time only when it changes
+    async saveDevicePrediction(plant_id, predicted_dry_time, current_moisture) {
+        return connection.query(
+            `INSERT INTO MoisturePredictions 
+             (plant_id, predicted_dry_time, current_moisture)
+             VALUES (?, ?, ?)`,
+            [plant_id, predicted_dry_time, current_moisture]
+        );
+    }
+
     async getHourlyPredictions(plant_id) {
         try {
             const [predictions] = await connection.query(
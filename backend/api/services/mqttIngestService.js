@@ -0,0 +1,67 @@
+const SequencedIngestService = require("./sequencedIngestService");
+require("dotenv").config();
+
+// Subscribes to the batches devices publish to plantguru/<device_id>/records at QoS 1 and
+// stores them like HTTP sequenced uploads. The session is persistent (clean: false), so the
+// broker queues publishes while the backend is down. Only started when MQTT_URL is set, and
+// the mqtt package is only needed then (npm install mqtt).
+class MqttIngestService {
+    constructor() {
+        this.TOPIC = "plantguru/+/records";
+        this.client = null;
+        this.queue = Promise.resolve(); // Batches of a device must be stored in order
+    }
+
+    start() {
+        if (!process.env.MQTT_URL) {
+            return;
+        }
+        const mqtt = require("mqtt");
+        this.client = mqtt.connect(process.env.MQTT_URL, {
+            clientId: process.env.MQTT_CLIENT_ID || "plantguru-backend",
+            clean: false,
+            username: process.env.MQTT_USERNAME,
+            password: process.env.MQTT_PASSWORD,
+        });
+
+        this.client.on("connect", () => {
+            console.log(`MQTT ingest connected to ${process.env.MQTT_URL}`);
+            this.client.subscribe(this.TOPIC, { qos: 1 }, (err) => {
+                if (err) console.error("MQTT ingest subscribe failed:", err);
+            });
+        });
+        this.client.on("message", (topic, payload) => {
+            this.queue = this.queue.then(() => this.handleMessage(topic, payload));
+        });
+        this.client.on("error", (err) => {
+            console.error("MQTT ingest error:", err.message);
+        });
+
+        console.log('MQTT ingest service started');
+    }
+
+    async handleMessage(topic, payload) {
+        try {
+            const body = JSON.parse(payload.toString());
+            const device_id = topic.split("/")[1];
+            // The device ID in the topic is the one the broker saw; the body must agree
+            if (!SequencedIngestService.isValid(body) || body.device_id !== device_id) {
+                console.error(`Dropping malformed MQTT batch on ${topic}`);
+                return;
+            }
+            await SequencedIngestService.store(device_id, body.base, body.records);
+        } catch (err) {
+            console.error(`Error storing MQTT batch on ${topic}:`, err);
+        }
+    }
+
+    stop() {
+        if (this.client) {
+            this.client.end();
+            this.client = null;
+        }
+        console.log('MQTT ingest service stopped');
+    }
+}
+
+module.exports = new MqttIngestService();
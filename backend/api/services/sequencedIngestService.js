@@ -0,0 +1,36 @@
+const SensorData = require("../models/sensorModel");
+const DeviceSequence = require("../models/deviceSequenceModel");
+const DeviceIntervals = require("../models/deviceIntervalsModel");
+const WateringDetectionService = require("./wateringDetectionService");
+
+// Stores sequenced batches from the firmware, whichever transport they came in on:
+//   { device_id, base, records: [{ plant_id, seq, ...readings, time_stamp }, ...] }
+// Records are stored idempotently by (device_id, seq, plant_id), so a batch delivered twice
+// (an HTTP retry, an MQTT redelivery) only stores and runs watering detection once.
+class SequencedIngestService {
+    isValid(body) {
+        return !!body && typeof body.device_id === "string" && body.device_id.length > 0 &&
+            Array.isArray(body.records) && body.records.every((data) => Number.isInteger(data.seq));
+    }
+
+    // Returns the device's new acknowledgement
+    async store(device_id, base, records) {
+        for (const data of records) {
+            const sensorData = new SensorData({ ...data, device_id });
+            const [result] = await sensorData.uploadData();
+            // A retried record was already seen by watering detection
+            if (result.affectedRows > 0) {
+                await WateringDetectionService.detectWateringEvent(data.plant_id, data);
+            }
+        }
+        return DeviceSequence.acknowledge(device_id, Number(base) || 0);
+    }
+
+    // Response body for a stored batch: { ack }, plus { intervals } when the device has some set
+    async reply(device_id, ack) {
+        const intervals = await DeviceIntervals.get(device_id);
+        return intervals ? { ack, intervals } : { ack };
+    }
+}
+
+module.exports = new SequencedIngestService();
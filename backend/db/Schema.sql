@@ -42,7 +42,74 @@ CREATE TABLE SensorData (
     soil_moisture_1 FLOAT,
     soil_moisture_2 FLOAT,
     time_stamp timestamp NOT NULL,
-    FOREIGN KEY (plant_id) REFERENCES Plants(plant_id) ON DELETE CASCADE
+    device_id VARCHAR(36),
+    seq INT UNSIGNED,
+    FOREIGN KEY (plant_id) REFERENCES Plants(plant_id) ON DELETE CASCADE,
+    -- Retried uploads hit this key and are ignored; rows without a sequence are never duplicates
+    UNIQUE KEY unique_device_record (device_id, seq, plant_id)
+);
+
+-- Highest sequence per device up to which every record is stored; returned to the device as its ack
+CREATE TABLE DeviceSequence (
+    device_id VARCHAR(36) PRIMARY KEY,
+    acked_seq INT UNSIGNED NOT NULL DEFAULT 0,
+    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP
+);
+
+-- Rollups of records a device dropped from its full buffer; channels holds { min, max, mean, count } per channel
+CREATE TABLE SensorRollups (
+    rollup_id INT AUTO_INCREMENT PRIMARY KEY,
+    device_id VARCHAR(36) NOT NULL,
+    plant_id INT,
+    first_seq INT UNSIGNED NOT NULL,
+    last_seq INT UNSIGNED NOT NULL,
+    span_s INT UNSIGNED NOT NULL,
+    records INT UNSIGNED,
+    time_stamp timestamp NOT NULL,
+    channels JSON,
+    FOREIGN KEY (plant_id) REFERENCES Plants(plant_id) ON DELETE CASCADE,
+    -- A resent or merged rollup replaces the one it starts with
+    UNIQUE KEY unique_device_rollup (device_id, first_seq, plant_id),
+    INDEX idx_rollup_plant_time (plant_id, time_stamp)
+);
+
+-- Task intervals (ms) set for a device, returned in its upload responses; NULL keeps the device's own
+CREATE TABLE DeviceIntervals (
+    device_id VARCHAR(36) PRIMARY KEY,
+    sample_ms INT UNSIGNED,
+    record_ms INT UNSIGNED,
+    upload_ms INT UNSIGNED,
+    bt_ms INT UNSIGNED,
+    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP
+);
+
+-- Upload profile reports: counters since boot plus per-phase percentiles (ms) over recent uploads
+CREATE TABLE DeviceTelemetry (
+    telemetry_id INT AUTO_INCREMENT PRIMARY KEY,
+    device_id VARCHAR(36) NOT NULL,
+    uploads INT UNSIGNED,
+    failures INT UNSIGNED,
+    bytes_sent BIGINT UNSIGNED,
+    bytes_received BIGINT UNSIGNED,
+    phases JSON,
+    received_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_telemetry_device_time (device_id, received_at)
+);
+
+-- Firmware update attempts: method is delta, full or rollback; bytes is what was downloaded
+CREATE TABLE DeviceOtaReports (
+    ota_id INT AUTO_INCREMENT PRIMARY KEY,
+    device_id VARCHAR(36) NOT NULL,
+    from_version VARCHAR(32),
+    to_version VARCHAR(32) NOT NULL,
+    method VARCHAR(16) NOT NULL,
+    bytes INT UNSIGNED,
+    image_bytes INT UNSIGNED,
+    duration_ms INT UNSIGNED,
+    ok BOOLEAN,
+    error VARCHAR(64),
+    received_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_ota_device_time (device_id, received_at)
 );
 
 -- Primary time-series index for fast time-based lookups
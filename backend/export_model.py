@@ -0,0 +1,133 @@
+import pickle
+import sys
+import numpy as np
+
+# Exports the DecisionTreeRegressor trained by train_model.py as a C++ header for the firmware.
+# The device evaluates the same tree on its own 30min feature bucket and predicts locally.
+#
+#   python export_model.py [decision_tree] [../embedded/full_prov/WateringModel.h]
+
+# Must match augment_data() in train_model.py
+FEATURES = ["ext_temp", "humidity", "light", "soil_moisture_1"]
+RESAMPLE_MINUTES = 30
+FUTURE_STEPS = 8
+
+LEAF = -1
+
+
+def float32_at_most(value):
+    # sklearn compares float32 features against float64 thresholds. The largest float32
+    # not above the threshold gives the same split when compared in float32 on the device.
+    f = np.float32(value)
+    if float(f) > value:
+        f = np.nextafter(f, np.float32(-np.inf))
+    return f
+
+
+def format_float(value):
+    text = repr(float(value))
+    if "e" not in text and "." not in text:
+        text += ".0"
+    return text + "f"
+
+
+def export_tree(model, model_path):
+    tree = model.tree_
+    if tree.n_features != len(FEATURES):
+        raise ValueError(f"model has {tree.n_features} features, expected {len(FEATURES)}")
+    if tree.node_count > 32767:
+        raise ValueError(f"model has {tree.node_count} nodes, too many for int16 child indices")
+
+    rows = []
+    for node in range(tree.node_count):
+        left = int(tree.children_left[node])
+        right = int(tree.children_right[node])
+        if left == right:  # leaf
+            rows.append(f"  {{{LEAF}, {LEAF}, {LEAF}, 0.0f, {format_float(np.float32(tree.value[node][0][0]))}}},")
+        else:
+            threshold = float32_at_most(tree.threshold[node])
+            rows.append(f"  {{{left}, {right}, {int(tree.feature[node])}, {format_float(threshold)}, 0.0f}},")
+
+    feature_enum = "\n".join(f"  WATERING_FEATURE_{name.upper()} = {i}," for i, name in enumerate(FEATURES))
+
+    return f"""// Generated by backend/export_model.py from backend/{model_path}. Do not edit.
+// DecisionTreeRegressor: {tree.node_count} nodes, depth {tree.max_depth}. Inputs are the means of the
+// current {RESAMPLE_MINUTES}min bucket; the output is soil_moisture_1 {FUTURE_STEPS} buckets later.
+#ifndef WATERINGMODEL_H
+#define WATERINGMODEL_H
+
+#include <stdint.h>
+
+#define WATERING_MODEL_FEATURES {len(FEATURES)}
+#define WATERING_MODEL_RESAMPLE_MINUTES {RESAMPLE_MINUTES}
+#define WATERING_MODEL_FUTURE_STEPS {FUTURE_STEPS}
+
+enum WateringFeature {{
+{feature_enum}
+}};
+
+struct WateringTreeNode {{
+  int16_t left;     // Child for feature <= threshold, {LEAF} at a leaf
+  int16_t right;    // Child for feature > threshold, {LEAF} at a leaf
+  int8_t feature;   // WateringFeature, {LEAF} at a leaf
+  float threshold;
+  float value;      // Predicted soil_moisture_1 at a leaf
+}};
+
+constexpr WateringTreeNode WATERING_TREE[] = {{
+{chr(10).join(rows)}
+}};
+
+constexpr int WATERING_TREE_NODES = sizeof(WATERING_TREE) / sizeof(WATERING_TREE[0]);
+
+// Walks the tree from the root; at most depth {tree.max_depth} comparisons
+constexpr float predictWateringMoisture(const float (&features)[WATERING_MODEL_FEATURES]) {{
+  int node = 0;
+  while (WATERING_TREE[node].feature != {LEAF}) {{
+    node = features[WATERING_TREE[node].feature] <= WATERING_TREE[node].threshold
+               ? WATERING_TREE[node].left
+               : WATERING_TREE[node].right;
+  }}
+  return WATERING_TREE[node].value;
+}}
+
+#endif // WATERINGMODEL_H
+"""
+
+
+def check_export(model):
+    # Re-evaluate the exported float32 tree in Python against sklearn on random inputs
+    tree = model.tree_
+    rng = np.random.default_rng(42)
+    X = np.column_stack([
+        rng.uniform(10, 35, 5000),   # ext_temp
+        rng.uniform(20, 80, 5000),   # humidity
+        rng.uniform(0, 100, 5000),   # light
+        rng.uniform(30, 90, 5000),   # soil_moisture_1
+    ]).astype(np.float32)
+    expected = model.predict(X)
+    for x, want in zip(X, expected):
+        node = 0
+        while tree.children_left[node] != tree.children_right[node]:
+            if x[tree.feature[node]] <= float32_at_most(tree.threshold[node]):
+                node = tree.children_left[node]
+            else:
+                node = tree.children_right[node]
+        got = np.float32(tree.value[node][0][0])
+        if abs(float(got) - want) > 1e-4:
+            raise AssertionError(f"exported tree disagrees with sklearn at {x}: {got} != {want}")
+
+
+if __name__ == "__main__":
+    model_path = sys.argv[1] if len(sys.argv) > 1 else "decision_tree"
+    out_path = sys.argv[2] if len(sys.argv) > 2 else "../embedded/full_prov/WateringModel.h"
+
+    with open(model_path, 'rb') as file:
+        model = pickle.load(file)
+
+    header = export_tree(model, model_path)
+    check_export(model)
+
+    with open(out_path, 'w') as file:
+        file.write(header)
+    print(f"Wrote {model.tree_.node_count} nodes to {out_path}")
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Makes the upload CA and a server certificate from it for httpsServerService. Devices built with
+# USE_TLS_UPLOAD trust only the CA (embedded/full_prov/Certificate.h, upload_ca_cert) and check
+# the server certificate for PLANTGURU_TLS_HOST (embedded/full_prov/Config.h).
+#
+#   scripts/make_tls_certs.sh OUTDIR [HOST]         new CA, then a server certificate for HOST
+#   scripts/make_tls_certs.sh OUTDIR HOST --reuse   server certificate from the CA already in OUTDIR
+#
+# Keep OUTDIR/upload_ca.key offline; it is only needed to issue the next server certificate. Start
+# the backend with TLS_CERT_FILE=OUTDIR/server.pem TLS_KEY_FILE=OUTDIR/server.key, and check the
+# result with scripts/tls_handshake_check.js.
+set -e
+OUT=${1:?usage: $0 OUTDIR [HOST] [--reuse]}
+HOST=${2:-api.plantguru.internal}
+mkdir -p "$OUT"
+
+if [ "$3" != "--reuse" ]; then
+  openssl ecparam -name prime256v1 -genkey -noout -out "$OUT/upload_ca.key"
+  openssl req -x509 -new -key "$OUT/upload_ca.key" -sha256 -days 7300 -subj "/O=PlantGuru/CN=PlantGuru Upload CA" \
+    -addext "basicConstraints=critical,CA:TRUE,pathlen:0" -addext "keyUsage=critical,keyCertSign,cRLSign" \
+    -out "$OUT/upload_ca.pem"
+fi
+
+openssl ecparam -name prime256v1 -genkey -noout -out "$OUT/server.key"
+openssl req -new -key "$OUT/server.key" -subj "/O=PlantGuru/CN=$HOST" -out "$OUT/server.csr"
+printf 'basicConstraints=critical,CA:FALSE\nkeyUsage=critical,digitalSignature\nextendedKeyUsage=serverAuth\nsubjectAltName=DNS:%s\n' \
+  "$HOST" > "$OUT/server.ext"
+openssl x509 -req -in "$OUT/server.csr" -CA "$OUT/upload_ca.pem" -CAkey "$OUT/upload_ca.key" -CAcreateserial \
+  -days 825 -sha256 -extfile "$OUT/server.ext" -out "$OUT/server.pem"
+rm -f "$OUT/server.csr" "$OUT/server.ext"
+openssl verify -CAfile "$OUT/upload_ca.pem" "$OUT/server.pem"
+echo "Server certificate for $HOST: TLS_CERT_FILE=$OUT/server.pem TLS_KEY_FILE=$OUT/server.key"
+echo "Devices must carry $OUT/upload_ca.pem as upload_ca_cert in embedded/full_prov/Certificate.h"
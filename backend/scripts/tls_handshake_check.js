@@ -0,0 +1,86 @@
+// Checks the HTTPS service the way a device built with USE_TLS_UPLOAD sees it: TLS 1.2, trusting
+// only the CA in embedded/full_prov/UploadCaCert.h and expecting PLANTGURU_TLS_HOST on the
+// certificate. Runs httpsServerService on a free port with the given certificate, then makes a
+// full handshake and a request, resumes the session, and makes sure the bare IP address is refused.
+//
+//   node scripts/tls_handshake_check.js SERVER_CERT SERVER_KEY [HOST]
+//
+// HOST defaults to the production PLANTGURU_TLS_HOST in Config.h. Exits non-zero on any failure.
+const fs = require("fs");
+const path = require("path");
+const tls = require("tls");
+const { X509Certificate } = require("crypto");
+
+const FIRMWARE = path.join(__dirname, "..", "..", "embedded", "full_prov");
+
+function deviceCa() {
+    const header = fs.readFileSync(path.join(FIRMWARE, "UploadCaCert.h"), "utf8");
+    const array = header.slice(header.indexOf("upload_ca_cert[]"), header.indexOf("};"));
+    const der = Buffer.from(array.match(/0x[0-9a-f]{2}/gi).map((byte) => parseInt(byte, 16)));
+    return new X509Certificate(der).toString();
+}
+
+function deviceHost() {
+    const config = fs.readFileSync(path.join(FIRMWARE, "Config.h"), "utf8");
+    return config.match(/#define PLANTGURU_TLS_HOST "([^"]+)"/)[1];
+}
+
+// One GET over a fresh connection; resolves with the socket's state once the reply is in
+function request(port, options) {
+    return new Promise((resolve, reject) => {
+        const socket = tls.connect({ host: "127.0.0.1", port, minVersion: "TLSv1.2", maxVersion: "TLSv1.2", ...options });
+        let session = null;
+        let reply = "";
+        socket.on("session", (ticket) => { session = ticket; });
+        socket.on("secureConnect", () => {
+            socket.write(`GET /api/ping HTTP/1.1\r\nHost: ${options.servername || "127.0.0.1"}\r\nConnection: close\r\n\r\n`);
+        });
+        socket.on("data", (chunk) => { reply += chunk; });
+        socket.on("end", () => resolve({ reply, session, resumed: socket.isSessionReused(), cipher: socket.getCipher().name }));
+        socket.on("error", reject);
+    });
+}
+
+async function main() {
+    const [certFile, keyFile, hostArg] = process.argv.slice(2);
+    if (!certFile || !keyFile) {
+        console.error("usage: node scripts/tls_handshake_check.js SERVER_CERT SERVER_KEY [HOST]");
+        process.exit(2);
+    }
+    process.env.TLS_CERT_FILE = certFile;
+    process.env.TLS_KEY_FILE = keyFile;
+    process.env.HTTPS_PORT = "0";
+    const httpsServerService = require("../api/services/httpsServerService");
+    httpsServerService.start((req, res) => res.end("ok"));
+    await new Promise((resolve) => httpsServerService.server.on("listening", resolve));
+    const port = httpsServerService.server.address().port;
+
+    const ca = deviceCa();
+    const host = deviceHost();
+    const servername = hostArg || host;
+    let failed = false;
+    const check = (ok, message) => {
+        console.log(`${ok ? "ok  " : "FAIL"} ${message}`);
+        failed = failed || !ok;
+    };
+
+    try {
+        const full = await request(port, { ca, servername });
+        check(full.reply.startsWith("HTTP/1.1 200"), `full handshake to ${servername} (${full.cipher}), request answered`);
+        const resumed = await request(port, { ca, servername, session: full.session });
+        check(resumed.resumed && resumed.reply.startsWith("HTTP/1.1 200"), "session resumed from the ticket");
+    } catch (err) {
+        check(false, `handshake to ${servername}: ${err.code || err.message}`);
+    }
+    try {
+        await request(port, { ca });
+        check(false, "certificate accepted for the bare IP address");
+    } catch (err) {
+        check(err.code === "ERR_TLS_CERT_ALTNAME_INVALID", `bare IP address refused (${err.code || err.message})`);
+    }
+
+    httpsServerService.stop();
+    process.exit(failed ? 1 : 0);
+}
+
+main();
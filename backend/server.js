@@ -1,5 +1,6 @@
 //Require all dependencies
 const express = require("express");
+const path = require("path");
 const app = express();
 const bodyParser = require("body-parser");
 const cookieParser = require("cookie-parser");
@@ -7,6 +8,9 @@ const cors = require("cors");
 const healthCheckScheduler = require("./api/services/healthCheckSchedulerService");
 const modelingService = require("./api/services/modelingService");
 const initializationService = require("./api/services/initializationService");
+const mqttIngestService = require("./api/services/mqttIngestService");
+const coapIngestService = require("./api/services/coapIngestService");
+const httpsServerService = require("./api/services/httpsServerService");
 
 app.use(bodyParser.urlencoded({ extended: false }));
 app.use(bodyParser.json());
@@ -36,6 +40,9 @@ app.use("/api", ALL_ROUTES.insights);
 app.use("/api", ALL_ROUTES.projections);
 app.use("/api", ALL_ROUTES.notificationSettings);
 
+// OTA release directory from embedded/host/ota_delta: manifest.json, images and delta patches
+app.use("/firmware", express.static(process.env.FIRMWARE_DIR || path.join(__dirname, "firmware")));
+
 app.get("/test", (req, res) => {
   res.send("Should change automatically now");
 });
@@ -59,13 +66,28 @@ const server = app.listen(3000, async () => {
   
   // Start modeling service scheduler
   modelingService.start();
+
+  // Take sensor batches over MQTT and CoAP as well (MQTT_URL / COAP_PORT unset leaves them off)
+  mqttIngestService.start();
+  coapIngestService.start();
+
+  // Serve the same app over TLS too (TLS_CERT_FILE / TLS_KEY_FILE unset leaves it off)
+  httpsServerService.start(app);
 });
 
+// Devices keep their upload connection open between uploads (HttpTransport.h), so hold idle
+// connections as long as the TLS server does instead of Node's 5 s default
+server.keepAliveTimeout = httpsServerService.KEEP_ALIVE_MS;
+server.headersTimeout = httpsServerService.KEEP_ALIVE_MS + 5000;
+
 // handle graceful shutdown
 process.on('SIGTERM', () => {
   console.log('SIGTERM signal received: closing HTTP server');
   healthCheckScheduler.stop();
   modelingService.stop();
+  mqttIngestService.stop();
+  coapIngestService.stop();
+  httpsServerService.stop();
   server.close(() => {
     console.log('HTTP server closed');
     process.exit(0);
@@ -76,6 +98,9 @@ process.on('SIGINT', () => {
   console.log('SIGINT signal received: closing HTTP server');
   healthCheckScheduler.stop();
   modelingService.stop();
+  mqttIngestService.stop();
+  coapIngestService.stop();
+  httpsServerService.stop();
   server.close(() => {
     console.log('HTTP server closed');
     process.exit(0);
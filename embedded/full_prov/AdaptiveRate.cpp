@@ -0,0 +1,88 @@
+#include "AdaptiveRate.h"
+#include <math.h>
+
+AdaptiveRate::AdaptiveRate()
+  : step(ADAPTIVE_FAST_SHIFT), jumped(false), hasRecord(false), lastRecordMs(0), changes(0) {
+  for (Track& track : tracks) {
+    track.lastRecorded = NAN;
+    track.samples = 0;
+    track.mean = 0;
+    track.m2 = 0;
+    track.away = 0;
+  }
+}
+
+float AdaptiveRate::rateThreshold(int track) {
+  return track == LIGHT_TRACK ? ADAPTIVE_LIGHT_RATE : ADAPTIVE_SOIL_RATE;
+}
+
+float AdaptiveRate::stddevThreshold(int track) {
+  return track == LIGHT_TRACK ? ADAPTIVE_LIGHT_STDDEV : ADAPTIVE_SOIL_STDDEV;
+}
+
+float AdaptiveRate::jumpThreshold(int track) {
+  return track == LIGHT_TRACK ? ADAPTIVE_LIGHT_JUMP : ADAPTIVE_SOIL_JUMP;
+}
+
+void AdaptiveRate::addSample(int track, float value) {
+  if (track < 0 || track >= TRACK_COUNT || isnan(value)) {
+    return;
+  }
+  Track& t = tracks[track];
+  t.samples++;
+  float delta = value - t.mean;
+  t.mean += delta / t.samples;
+  t.m2 += delta * (value - t.mean);
+  // Samples rather than the mean, which a long window would drag out
+  if (!isnan(t.lastRecorded) && fabsf(value - t.lastRecorded) >= jumpThreshold(track)) {
+    if (++t.away >= ADAPTIVE_MIN_SAMPLES) {
+      jumped = true;
+    }
+  } else {
+    t.away = 0;
+  }
+}
+
+uint32_t AdaptiveRate::recorded(uint32_t nowMs, uint32_t recordMs) {
+  float minutes = hasRecord ? (nowMs - lastRecordMs) / 60000.0f : 0;
+  bool change = jumped;
+  for (int i = 0; i < TRACK_COUNT; i++) {
+    Track& t = tracks[i];
+    if (t.samples == 0) {
+      continue;
+    }
+    if (t.samples > 1 && sqrtf(t.m2 / (t.samples - 1)) > stddevThreshold(i)) {
+      change = true;
+    }
+    if (!isnan(t.lastRecorded) && minutes > 0 && fabsf(t.mean - t.lastRecorded) / minutes > rateThreshold(i)) {
+      change = true;
+    }
+    t.lastRecorded = t.mean;
+    t.samples = 0;
+    t.mean = 0;
+    t.m2 = 0;
+    t.away = 0;
+  }
+
+  if (change) {
+    step = 0;
+    changes++;
+  } else if (step < ADAPTIVE_FAST_SHIFT + ADAPTIVE_SLOW_SHIFT) {
+    step++;
+  }
+  jumped = false;
+  hasRecord = true;
+  lastRecordMs = nowMs;
+  return interval(recordMs);
+}
+
+uint32_t AdaptiveRate::interval(uint32_t recordMs) const {
+  uint64_t ms = (uint64_t)(recordMs >> ADAPTIVE_FAST_SHIFT) << step;
+  if (ms < INTERVAL_RECORD_MIN) {
+    ms = INTERVAL_RECORD_MIN;
+  }
+  if (ms > INTERVAL_RECORD_MAX) {
+    ms = INTERVAL_RECORD_MAX;
+  }
+  return (uint32_t)ms;
+}
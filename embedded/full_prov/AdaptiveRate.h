@@ -0,0 +1,62 @@
+#ifndef ADAPTIVERATE_H
+#define ADAPTIVERATE_H
+
+#include <stdint.h>
+#include "Config.h"
+
+// Record rate that follows the signal. Soil moisture sits flat for hours and then jumps when the
+// plant is watered, so a fixed rate either wastes records or misses the event. Each soil probe
+// and the light channel are tracked over the current record window: the mean and variance of
+// its samples, and how far the mean has moved since the last record. A window counts as
+// changing when a tracked channel moved faster than its ADAPTIVE_*_RATE per minute or its samples
+// spread wider than ADAPTIVE_*_STDDEV. The next record then comes after the record interval
+// divided by 2^ADAPTIVE_FAST_SHIFT. Each stable window after that doubles the interval, up to
+// the record interval times 2^ADAPTIVE_SLOW_SHIFT. ADAPTIVE_MIN_SAMPLES samples in a row that are
+// ADAPTIVE_*_JUMP away from the last record ask for a record at once (recordDue()).
+//
+// Records stay averages over their whole window, so the long steady-state windows still cover
+// every sample. The record interval itself comes from Intervals, so the bounds follow it.
+class AdaptiveRate {
+public:
+  static const int TRACK_COUNT = SOIL_PROBE_COUNT + 1;  // Soil probes, then light
+  static const int LIGHT_TRACK = SOIL_PROBE_COUNT;
+
+  AdaptiveRate();
+
+  // A sample of a tracked channel that went into the running average
+  void addSample(int track, float value);
+
+  // A tracked channel jumped mid-window and the interval isn't already the fastest
+  bool recordDue() const { return jumped && step > 0; }
+
+  // The window closed into a record at nowMs; returns the interval until the next one
+  uint32_t recorded(uint32_t nowMs, uint32_t recordMs);
+
+  // Current interval for a record interval of recordMs
+  uint32_t interval(uint32_t recordMs) const;
+
+  bool changing() const { return step == 0; }
+  uint32_t changingWindows() const { return changes; }
+
+private:
+  struct Track {
+    float lastRecorded;  // NAN before the first record
+    uint32_t samples;
+    float mean;
+    float m2;            // Sum of squared deviations from mean (Welford)
+    uint32_t away;       // Consecutive samples at least the jump threshold from lastRecorded
+  };
+
+  Track tracks[TRACK_COUNT];
+  int step;              // Interval is (recordMs >> ADAPTIVE_FAST_SHIFT) << step
+  bool jumped;
+  bool hasRecord;
+  uint32_t lastRecordMs;
+  uint32_t changes;
+
+  static float rateThreshold(int track);
+  static float stddevThreshold(int track);
+  static float jumpThreshold(int track);
+};
+
+#endif // ADAPTIVERATE_H
@@ -0,0 +1,203 @@
+#include "AdcCalibration.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#if __has_include(<esp_adc/adc_cali_scheme.h>)
+#include <esp_adc/adc_cali_scheme.h>
+#endif
+
+AdcCalibration adcCalibration;
+
+// Used by begin() in setup and then only by the BLE task, which sets calibrations
+static Preferences calibrationPreferences;
+
+AdcCalibration::AdcCalibration() : efuse(false) {
+  // Nominal until begin() reads the eFuse, so conversions are sane from the start
+  for (int i = 0; i < ADC_LUT_POINTS; i++) {
+    uint32_t raw = i << ADC_LUT_SHIFT;
+    mvTable[i] = (raw > 4095 ? 4095 : raw) * ADC_NOMINAL_MV / 4095;
+  }
+  for (int p = 0; p < SOIL_PROBE_COUNT; p++) {
+    probes[p] = fullRange();
+    lastMv[p] = 0;
+    buildProbeTable(p);
+  }
+}
+
+int32_t AdcCalibration::interpolate(const uint16_t* table, uint16_t raw) {
+  if (raw > 4095) {
+    raw = 4095;
+  }
+  int i = raw >> ADC_LUT_SHIFT;
+  int32_t low = table[i];
+  return low + (((int32_t)table[i + 1] - low) * (raw & ((1 << ADC_LUT_SHIFT) - 1)) >> ADC_LUT_SHIFT);
+}
+
+int32_t AdcCalibration::interpolate(const int16_t* table, uint16_t raw) {
+  if (raw > 4095) {
+    raw = 4095;
+  }
+  int i = raw >> ADC_LUT_SHIFT;
+  int32_t low = table[i];
+  return low + (((int32_t)table[i + 1] - low) * (raw & ((1 << ADC_LUT_SHIFT) - 1)) >> ADC_LUT_SHIFT);
+}
+
+// The last entry stands for 4096, past the top reading, and takes 4095's value
+bool AdcCalibration::buildMillivoltTable() {
+#if defined(ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED) || defined(ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED)
+  adc_cali_handle_t handle = nullptr;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+  adc_cali_curve_fitting_config_t config = {};
+  config.unit_id = ADC_UNIT_1;
+  config.atten = ADC_ATTEN_DB_12;
+  config.bitwidth = ADC_BITWIDTH_12;
+  bool created = adc_cali_create_scheme_curve_fitting(&config, &handle) == ESP_OK;
+#else
+  adc_cali_line_fitting_config_t config = {};
+  config.unit_id = ADC_UNIT_1;
+  config.atten = ADC_ATTEN_DB_12;
+  config.bitwidth = ADC_BITWIDTH_12;
+  bool created = adc_cali_create_scheme_line_fitting(&config, &handle) == ESP_OK;
+#endif
+  if (created) {
+    for (int i = 0; i < ADC_LUT_POINTS; i++) {
+      int raw = i << ADC_LUT_SHIFT;
+      int mv = 0;
+      adc_cali_raw_to_voltage(handle, raw > 4095 ? 4095 : raw, &mv);
+      mvTable[i] = mv < 0 ? 0 : mv;
+    }
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_delete_scheme_curve_fitting(handle);
+#else
+    adc_cali_delete_scheme_line_fitting(handle);
+#endif
+    return true;
+  }
+#endif
+  return false;
+}
+
+SoilCalibration AdcCalibration::fullRange() const {
+  return {millivolts(4095), millivolts(0)};
+}
+
+void AdcCalibration::buildProbeTable(int probe) {
+  int32_t dry = probes[probe].dryMv;
+  int32_t span = dry - (int32_t)probes[probe].wetMv;
+  int16_t table[ADC_LUT_POINTS];
+  for (int i = 0; i < ADC_LUT_POINTS; i++) {
+    int32_t centi = span == 0 ? 0 : (dry - (int32_t)mvTable[i]) * 10000 / span;
+    table[i] = centi < 0 ? 0 : centi > 10000 ? 10000 : centi;
+  }
+  std::lock_guard<std::mutex> guard(tableLock);
+  memcpy(probeTables[probe], table, sizeof(table));
+}
+
+void AdcCalibration::begin() {
+  efuse = buildMillivoltTable();
+  Serial.printf("ADC calibration: %s, %u-%u mV\n", efuse ? "eFuse" : "nominal (no eFuse data)",
+                (unsigned)mvTable[0], (unsigned)mvTable[ADC_LUT_POINTS - 1]);
+  for (int p = 0; p < SOIL_PROBE_COUNT; p++) {
+    probes[p] = fullRange();
+  }
+  load();
+  for (int p = 0; p < SOIL_PROBE_COUNT; p++) {
+    buildProbeTable(p);
+  }
+  Serial.printf("Soil calibration: %s\n", toString().c_str());
+}
+
+int16_t AdcCalibration::soilCentiPercent(int probe, uint16_t raw) {
+  lastMv[probe] = millivolts(raw);
+  std::lock_guard<std::mutex> guard(tableLock);
+  return interpolate(probeTables[probe], raw);
+}
+
+bool AdcCalibration::valid(const SoilCalibration& c) {
+  return c.dryMv <= SOIL_CAL_MAX_MV && c.wetMv <= SOIL_CAL_MAX_MV &&
+         abs((int)c.dryMv - (int)c.wetMv) >= SOIL_CAL_MIN_SPAN_MV;
+}
+
+bool AdcCalibration::set(int probe, uint16_t dryMv, uint16_t wetMv) {
+  if (probe < 0 || probe >= SOIL_PROBE_COUNT || !valid({dryMv, wetMv})) {
+    return false;
+  }
+  probes[probe] = {dryMv, wetMv};
+  buildProbeTable(probe);
+  save();
+  return true;
+}
+
+bool AdcCalibration::assign(const String& text) {
+  int first = text.indexOf(',');
+  if (first < 0) {
+    return false;
+  }
+  String probeField = text.substring(0, first);
+  probeField.trim();
+  int probe = probeField.toInt() - 1;
+  if (probe < 0 || probe >= SOIL_PROBE_COUNT) {
+    return false;
+  }
+  int second = text.indexOf(',', first + 1);
+  String a = second < 0 ? text.substring(first + 1) : text.substring(first + 1, second);
+  a.trim();
+  if (second < 0) {
+    // Capture the probe's last reading as one point, keeping the other
+    uint16_t mv = lastMv[probe].load();
+    if (mv == 0) {
+      return false;
+    }
+    SoilCalibration c = probes[probe];
+    if (a == "dry") {
+      c.dryMv = mv;
+    } else if (a == "wet") {
+      c.wetMv = mv;
+    } else {
+      return false;
+    }
+    return set(probe, c.dryMv, c.wetMv);
+  }
+  String b = text.substring(second + 1);
+  b.trim();
+  if (a.isEmpty() || b.isEmpty() || !isdigit((unsigned char)a[0]) || !isdigit((unsigned char)b[0])) {
+    return false;
+  }
+  return set(probe, a.toInt(), b.toInt());
+}
+
+String AdcCalibration::toString() const {
+  String out;
+  for (int p = 0; p < SOIL_PROBE_COUNT; p++) {
+    if (p > 0) {
+      out += ",";
+    }
+    out += String((unsigned)probes[p].dryMv);
+    out += ":";
+    out += String((unsigned)probes[p].wetMv);
+  }
+  return out;
+}
+
+void AdcCalibration::load() {
+  SoilCalibration stored[SOIL_PROBE_COUNT];
+  calibrationPreferences.begin("device_prefs", true);
+  size_t n = calibrationPreferences.getBytes("soil_cal", stored, sizeof(stored));
+  calibrationPreferences.end();
+  if (n != sizeof(stored)) {
+    return;
+  }
+  for (int p = 0; p < SOIL_PROBE_COUNT; p++) {
+    if (valid(stored[p])) {
+      probes[p] = stored[p];
+    } else {
+      probes[p] = fullRange();
+    }
+  }
+}
+
+void AdcCalibration::save() const {
+  calibrationPreferences.begin("device_prefs", false);
+  calibrationPreferences.putBytes("soil_cal", probes, sizeof(probes));
+  calibrationPreferences.end();
+}
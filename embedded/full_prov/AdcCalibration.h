@@ -0,0 +1,78 @@
+#ifndef ADCCALIBRATION_H
+#define ADCCALIBRATION_H
+
+#include <atomic>
+#include <mutex>
+#include "Config.h"
+
+// Integer conversion of analog readings through precomputed tables. The millivolt table maps
+// raw readings to millivolts with the chip's eFuse calibration (ADC1 at 12 dB, as analogRead()
+// reads), taken once at boot instead of assuming 0-4095 spans 0-3.3 V linearly. Each soil probe
+// then has its own table from raw reading to moisture in hundredths of a percent, folding the
+// millivolt table into the probe's two-point calibration: its reading dry (0%) and in water
+// (100%). Tables hold every 2^ADC_LUT_SHIFT-th reading; conversion interpolates between two
+// entries with integer arithmetic.
+//
+// Probe calibrations are stored as "soil_cal" in device_prefs and can be set over BLE, either as
+// millivolts or by capturing the probe's current reading as its dry or wet point. Without one,
+// a probe spans the whole ADC range, which is the old (1 - raw / ANALOG_MAX) * 100.
+//
+// The sampling task converts readings while the BLE task sets calibrations: a new probe table is
+// built aside and copied in under a lock the conversion also takes.
+#define ADC_LUT_SHIFT 4
+#define ADC_LUT_POINTS ((4096 >> ADC_LUT_SHIFT) + 1)
+
+struct SoilCalibration {
+  uint16_t dryMv;  // Reading at 0%
+  uint16_t wetMv;  // Reading at 100%; capacitive probes read lower when wetter
+};
+
+class AdcCalibration {
+public:
+  AdcCalibration();
+
+  // Builds the millivolt table, then loads and builds the probe calibrations
+  void begin();
+
+  uint16_t millivolts(uint16_t raw) const { return interpolate(mvTable, raw); }
+
+  // Moisture in hundredths of a percent, 0-10000, of probe (0-based)
+  int16_t soilCentiPercent(int probe, uint16_t raw);
+
+  // Sets probe's (0-based) two points. False, changing nothing, if they are above SOIL_CAL_MAX_MV
+  // or closer than SOIL_CAL_MIN_SPAN_MV.
+  bool set(int probe, uint16_t dryMv, uint16_t wetMv);
+
+  // "probe,dry_mv,wet_mv", or "probe,dry" / "probe,wet" to take the probe's last reading as that
+  // point; probes are numbered from 1 as in the upload JSON
+  bool assign(const String& text);
+
+  // "dry:wet,dry:wet,..." in millivolts, one per probe
+  String toString() const;
+
+  const SoilCalibration& calibration(int probe) const { return probes[probe]; }
+  bool usesEfuse() const { return efuse; }
+
+  // Stored calibrations that set() would refuse keep the full range
+  void load();
+  void save() const;
+
+private:
+  uint16_t mvTable[ADC_LUT_POINTS];  // Written only by begin(), before the tasks start
+  int16_t probeTables[SOIL_PROBE_COUNT][ADC_LUT_POINTS];
+  std::mutex tableLock;  // Over probeTables
+  SoilCalibration probes[SOIL_PROBE_COUNT];  // BLE task only once running
+  std::atomic<uint16_t> lastMv[SOIL_PROBE_COUNT];  // For capturing a point; 0 before the first reading
+  bool efuse;
+
+  static bool valid(const SoilCalibration& c);
+  static int32_t interpolate(const uint16_t* table, uint16_t raw);
+  static int32_t interpolate(const int16_t* table, uint16_t raw);
+  bool buildMillivoltTable();
+  void buildProbeTable(int probe);
+  SoilCalibration fullRange() const;
+};
+
+extern AdcCalibration adcCalibration;
+
+#endif // ADCCALIBRATION_H
@@ -1,7 +1,16 @@
 #ifndef BLESERVICE_H
 #define BLESERVICE_H
 
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLEUtils.h>
+#include <BLE2902.h>
+#include <atomic>
+#include "AdcCalibration.h"
 #include "Config.h"
+#include "Intervals.h"
+#include "PlantMap.h"
+#include "UploadProfiler.h"
 
 class BluetoothService {
 public:
@@ -11,17 +20,16 @@ public:
 
 private:
     BLEServer* pServer;
-    BLECharacteristic* pTemperature1Characteristic;
-    BLECharacteristic* pTemperature2Characteristic;
-    BLECharacteristic* pLightCharacteristic;
-    BLECharacteristic* pSoilMoisture1Characteristic;
-    BLECharacteristic* pSoilMoisture2Characteristic;
-    BLECharacteristic* pHumidityCharacteristic;
+    BLECharacteristic* pChannelCharacteristics[CHANNEL_COUNT];  // Indexed by ChannelId, from CHANNELS
     BLECharacteristic* pResetCharacteristic;
     BLECharacteristic* pEndpointCharacteristic;
     BLECharacteristic* pUpdatePeriodBtCharacteristic;
     BLECharacteristic* pUpdatePeriodWifiCharacteristic;
-    static bool deviceConnected;
+    BLECharacteristic* pProbeMapCharacteristic;
+    BLECharacteristic* pIntervalsCharacteristic;
+    BLECharacteristic* pSoilCalibrationCharacteristic;
+    BLECharacteristic* pUploadProfileCharacteristic;
+    static std::atomic<bool> deviceConnected;  // Set on the BLE task, read by updateData()
     static bool oldDeviceConnected;
 
     class ServerCallbacks : public BLEServerCallbacks {
@@ -42,15 +50,103 @@ private:
             Serial.println("Reset callback triggered");
         }
     };
+    // "id,id,..." with one plant ID per soil probe, -1 for an unused probe
+    class ProbeMapCallbacks : public BLECharacteristicCallbacks {
+        void onWrite(BLECharacteristic* pCharacteristic) override {
+            String value = pCharacteristic->getValue();
+            PlantMap map;
+            if (map.assign(value)) {
+                plantMap.publish(map, true);  // The sampling task saves it
+                Serial.printf("Probe map set to %s\n", map.toString().c_str());
+            } else {
+                Serial.printf("Rejected probe map '%s'\n", value.c_str());
+            }
+            pCharacteristic->setValue(plantMap.get().toString().c_str());
+        }
+    };
+
+    // One interval in ms as a decimal number: the BLE notification period or the upload period
+    class UpdatePeriodCallbacks : public BLECharacteristicCallbacks {
+    public:
+        explicit UpdatePeriodCallbacks(IntervalId id) : id(id) {}
+
+        void onWrite(BLECharacteristic* pCharacteristic) override {
+            String value = pCharacteristic->getValue();
+            value.trim();
+            bool numeric = !value.isEmpty();
+            for (size_t i = 0; i < value.length(); i++) {
+                numeric = numeric && isdigit((unsigned char)value[i]);
+            }
+            if (numeric && intervals.set(id, strtoul(value.c_str(), nullptr, 10))) {
+                Serial.printf("Interval %s set to %lu ms\n", Intervals::name(id), (unsigned long)intervals.get(id));
+            } else {
+                Serial.printf("Rejected %s interval '%s'\n", Intervals::name(id), value.c_str());
+            }
+            pCharacteristic->setValue(String((unsigned long)intervals.get(id)).c_str());
+        }
+
+    private:
+        IntervalId id;
+    };
+
+    // "record=60000,upload=300000,..." with any of sample, record, upload and bt
+    class IntervalsCallbacks : public BLECharacteristicCallbacks {
+        void onWrite(BLECharacteristic* pCharacteristic) override {
+            String value = pCharacteristic->getValue();
+            if (intervals.assign(value)) {
+                Serial.printf("Intervals set to %s\n", intervals.toString().c_str());
+            } else {
+                Serial.printf("Rejected intervals '%s'\n", value.c_str());
+            }
+            pCharacteristic->setValue(intervals.toString().c_str());
+        }
+    };
+
+    // "probe,dry_mv,wet_mv", or "probe,dry" / "probe,wet" with the probe in the air or in water to take its
+    // current reading; reads back "dry:wet,..." in mV per probe
+    class SoilCalibrationCallbacks : public BLECharacteristicCallbacks {
+        void onWrite(BLECharacteristic* pCharacteristic) override {
+            String value = pCharacteristic->getValue();
+            if (adcCalibration.assign(value)) {
+                Serial.printf("Soil calibration set to %s\n", adcCalibration.toString().c_str());
+            } else {
+                Serial.printf("Rejected soil calibration '%s'\n", value.c_str());
+            }
+            pCharacteristic->setValue(adcCalibration.toString().c_str());
+        }
+
+        void onRead(BLECharacteristic* pCharacteristic) override {
+            pCharacteristic->setValue(adcCalibration.toString().c_str());
+        }
+    };
+
+    // Upload phase percentiles and bytes per upload as uploadProfiler.format() prints them
+    class UploadProfileCallbacks : public BLECharacteristicCallbacks {
+        void onRead(BLECharacteristic* pCharacteristic) override {
+            char profile[320];
+            uploadProfiler.format(profile, sizeof(profile));
+            pCharacteristic->setValue(profile);
+        }
+    };
+
+    // Each characteristic with a descriptor takes three attribute handles, plus one for the service
+    static constexpr uint32_t serviceHandles() {
+        uint32_t characteristics = 8;  // Reset, endpoint, both update periods, probe map, intervals, soil calibration,
+                                       // upload profile
+        for (size_t i = 0; i < CHANNEL_COUNT; i++) {
+            if (CHANNELS[i].enabled && CHANNELS[i].bleUuid != nullptr) characteristics++;
+        }
+        return 1 + characteristics * 3;
+    }
 };
 
-bool BluetoothService::deviceConnected = false;
+std::atomic<bool> BluetoothService::deviceConnected(false);
 bool BluetoothService::oldDeviceConnected = false;
 
-BluetoothService::BluetoothService() : pServer(nullptr), pTemperature1Characteristic(nullptr), pTemperature2Characteristic(nullptr),
-                                       pLightCharacteristic(nullptr), pSoilMoisture1Characteristic(nullptr), pSoilMoisture2Characteristic(nullptr),
-                                       pHumidityCharacteristic(nullptr), pResetCharacteristic(nullptr),
-                                       pEndpointCharacteristic(nullptr), pUpdatePeriodBtCharacteristic(nullptr), pUpdatePeriodWifiCharacteristic(nullptr) {}
+BluetoothService::BluetoothService() : pServer(nullptr), pChannelCharacteristics(), pResetCharacteristic(nullptr),
+                                       pEndpointCharacteristic(nullptr), pUpdatePeriodBtCharacteristic(nullptr), pUpdatePeriodWifiCharacteristic(nullptr),
+                                       pProbeMapCharacteristic(nullptr), pIntervalsCharacteristic(nullptr), pSoilCalibrationCharacteristic(nullptr),
+                                       pUploadProfileCharacteristic(nullptr) {}
 
 void BluetoothService::setup() {
     // Initialize BLE Device
@@ -61,38 +157,20 @@ void BluetoothService::setup() {
     pServer->setCallbacks(new ServerCallbacks());
 
     // Create the BLE Service
-    BLEService* pService = pServer->createService(BLE_SERVICE_UUID);
-
-    // Create BLE Characteristics for each sensor data
-    pTemperature1Characteristic = pService->createCharacteristic(
-        TEMPERATURE1_CHARACTERISTIC_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
-    );
-
-    pTemperature2Characteristic = pService->createCharacteristic(
-        TEMPERATURE2_CHARACTERISTIC_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
-    );
+    // The default 15 handles only fit a handful of characteristics; size it for every probe
+    BLEService* pService = pServer->createService(BLEUUID(BLE_SERVICE_UUID), serviceHandles());
 
-    pLightCharacteristic = pService->createCharacteristic(
-        LIGHT_CHARACTERISTIC_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
-    );
-
-    pSoilMoisture1Characteristic = pService->createCharacteristic(
-        SOILMOISTURE1_CHARACTERISTIC_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
-    );
-
-    pSoilMoisture2Characteristic = pService->createCharacteristic(
-        SOILMOISTURE2_CHARACTERISTIC_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
-    );
-
-    pHumidityCharacteristic = pService->createCharacteristic(
-        HUMIDITY_CHARACTERISTIC_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
-    );
+    // Create a notify characteristic for each channel that declares a BLE UUID
+    forEachChannel([&](auto id) {
+        constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+        if constexpr (spec.bleUuid != nullptr) {
+            pChannelCharacteristics[spec.id] = pService->createCharacteristic(
+                spec.bleUuid,
+                BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
+            );
+            pChannelCharacteristics[spec.id]->addDescriptor(new BLE2902());
+        }
+    });
 
     pResetCharacteristic = pService->createCharacteristic(
         RESET_CHARACTERISTIC_UUID,
@@ -109,23 +187,52 @@ void BluetoothService::setup() {
         UPDATE_PERIOD_BT_CHARACTERISTIC_UUID,
         BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
     );
+    pUpdatePeriodBtCharacteristic->setCallbacks(new UpdatePeriodCallbacks(INTERVAL_BT));
+    pUpdatePeriodBtCharacteristic->setValue(String((unsigned long)intervals.get(INTERVAL_BT)).c_str());
 
     pUpdatePeriodWifiCharacteristic = pService->createCharacteristic(
         UPDATE_PERIOD_WIFI_CHARACTERISTIC_UUID,
         BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
     );
+    pUpdatePeriodWifiCharacteristic->setCallbacks(new UpdatePeriodCallbacks(INTERVAL_UPLOAD));
+    pUpdatePeriodWifiCharacteristic->setValue(String((unsigned long)intervals.get(INTERVAL_UPLOAD)).c_str());
+
+    pProbeMapCharacteristic = pService->createCharacteristic(
+        PROBE_MAP_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
+    );
+    pProbeMapCharacteristic->setCallbacks(new ProbeMapCallbacks());
+    pProbeMapCharacteristic->setValue(plantMap.get().toString().c_str());
+
+    pIntervalsCharacteristic = pService->createCharacteristic(
+        INTERVALS_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
+    );
+    pIntervalsCharacteristic->setCallbacks(new IntervalsCallbacks());
+    pIntervalsCharacteristic->setValue(intervals.toString().c_str());
+
+    pSoilCalibrationCharacteristic = pService->createCharacteristic(
+        SOIL_CALIBRATION_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE
+    );
+    pSoilCalibrationCharacteristic->setCallbacks(new SoilCalibrationCallbacks());
+    pSoilCalibrationCharacteristic->setValue(adcCalibration.toString().c_str());
+
+    pUploadProfileCharacteristic = pService->createCharacteristic(
+        UPLOAD_PROFILE_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_READ
+    );
+    pUploadProfileCharacteristic->setCallbacks(new UploadProfileCallbacks());
 
     // Add descriptors to the characteristics
-    pTemperature1Characteristic->addDescriptor(new BLE2902());
-    pTemperature2Characteristic->addDescriptor(new BLE2902());
-    pLightCharacteristic->addDescriptor(new BLE2902());
-    pSoilMoisture1Characteristic->addDescriptor(new BLE2902());
-    pSoilMoisture2Characteristic->addDescriptor(new BLE2902());
-    pHumidityCharacteristic->addDescriptor(new BLE2902());
     pResetCharacteristic->addDescriptor(new BLE2902());
     pEndpointCharacteristic->addDescriptor(new BLE2902());
     pUpdatePeriodBtCharacteristic->addDescriptor(new BLE2902());
     pUpdatePeriodWifiCharacteristic->addDescriptor(new BLE2902());
+    pProbeMapCharacteristic->addDescriptor(new BLE2902());
+    pIntervalsCharacteristic->addDescriptor(new BLE2902());
+    pSoilCalibrationCharacteristic->addDescriptor(new BLE2902());
+    pUploadProfileCharacteristic->addDescriptor(new BLE2902());
 
     // Start the service
     pService->start();
@@ -143,50 +250,23 @@ void BluetoothService::setup() {
 
 void BluetoothService::updateData(const SensorData& sensorData) {
     if (deviceConnected) {
-        if (!isnan(sensorData.temperature1)) {
-            float temp1 = sensorData.temperature1;
-            pTemperature1Characteristic->setValue(temp1);
-            pTemperature1Characteristic->notify();
-        }
-        
-        if (!isnan(sensorData.temperature2)) {
-            float temp2 = sensorData.temperature2;
-            pTemperature2Characteristic->setValue(temp2);
-            pTemperature2Characteristic->notify();
-        }
-
-        if (!isnan(sensorData.light)) {
-            float light = sensorData.light;
-            pLightCharacteristic->setValue(light);
-            pLightCharacteristic->notify();
-        }
-
-        if (!isnan(sensorData.soilMoisture1)) {
-            float soilMoisture1 = sensorData.soilMoisture1;
-            pSoilMoisture1Characteristic->setValue(soilMoisture1);
-            pSoilMoisture1Characteristic->notify();
-        }
-
-        if (!isnan(sensorData.soilMoisture2)) {
-            float soilMoisture2 = sensorData.soilMoisture2;
-            pSoilMoisture2Characteristic->setValue(soilMoisture2);
-            pSoilMoisture2Characteristic->notify();
-        }
-
-        if (!isnan(sensorData.humidity)) {
-            float humidity = sensorData.humidity;
-            pHumidityCharacteristic->setValue(humidity);
-            pHumidityCharacteristic->notify();
-        }
+        forEachChannel([&](auto id) {
+            constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+            if constexpr (spec.bleUuid != nullptr) {
+                float value = sensorData.get(spec.id);
+                if (!isnan(value)) {
+                    pChannelCharacteristics[spec.id]->setValue(value);
+                    pChannelCharacteristics[spec.id]->notify();
+                }
+            }
+        });
 
         #ifdef DEBUG
         Serial.println("Updated sensor data:");
-        Serial.print("Temperature1: "); Serial.println(sensorData.temperature1);
-        Serial.print("Temperature2: "); Serial.println(sensorData.temperature2);
-        Serial.print("Light: "); Serial.println(sensorData.light);
-        Serial.print("SoilMoisture1: "); Serial.println(sensorData.soilMoisture1);
-        Serial.print("SoilMoisture2: "); Serial.println(sensorData.soilMoisture2);
-        Serial.print("Humidity: "); Serial.println(sensorData.humidity);
+        forEachChannel([&](auto id) {
+            constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+            Serial.printf("%s: %.2f%s\n", spec.label, sensorData.get(spec.id), spec.units);
+        });
         #endif
     }
 }
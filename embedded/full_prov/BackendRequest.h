@@ -0,0 +1,35 @@
+#ifndef BACKENDREQUEST_H
+#define BACKENDREQUEST_H
+
+#include <HTTPClient.h>
+#include <mbedtls/base64.h>
+#include "Config.h"
+#include "UploadCaCert.h"
+
+// UPLOAD_TLS_CA_CERT as PEM, which is the only form HTTPClient takes; converted once
+inline const char *uploadCaPem() {
+  static String pem;
+  if (pem.isEmpty()) {
+    unsigned char base64[4 * ((sizeof(UPLOAD_TLS_CA_CERT) + 2) / 3) + 1];
+    size_t length = 0;
+    mbedtls_base64_encode(base64, sizeof(base64), &length, UPLOAD_TLS_CA_CERT, sizeof(UPLOAD_TLS_CA_CERT));
+    pem = "-----BEGIN CERTIFICATE-----\n";
+    for (size_t i = 0; i < length; i += 64) {
+      pem.concat((const char *)base64 + i, length - i < 64 ? length - i : 64);
+      pem += '\n';
+    }
+    pem += "-----END CERTIFICATE-----\n";
+  }
+  return pem.c_str();
+}
+
+// Starts an HTTPClient request to the backend. An https:// URL (USE_TLS_UPLOAD) only connects
+// if the server's certificate chains to UPLOAD_TLS_CA_CERT and names the URL's host.
+inline bool beginBackendRequest(HTTPClient &http, const String &url) {
+  if (url.startsWith("https://")) {
+    return http.begin(url, uploadCaPem());
+  }
+  return http.begin(url);
+}
+
+#endif // BACKENDREQUEST_H
@@ -0,0 +1,151 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+// Sensor channel registry. Included from Config.h once the pin, UUID and sensor macros are defined.
+//
+// Every channel is declared once in CHANNELS. Sampling (SensorService.h), the record layout and JSON
+// (SensorData), BLE characteristics (BLEService.h) and SD columns (SDmemory.h) are all expanded from
+// this table with forEachChannel(), so adding a sensor is one row here. Disabled rows take no slot in
+// SensorData and generate no code.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+// How a channel produces its reading; value = reading * scale + offset
+enum class ChannelDriver : uint8_t {
+  DS18B20,          // First probe on the OneWire bus
+  DHT_TEMPERATURE,  // DHT22 temperature
+  DHT_HUMIDITY,     // DHT22 relative humidity
+  ANALOG,           // analogRead(pin)
+  ANALOG_MV,        // analogRead(pin) in calibrated millivolts (AdcCalibration.h)
+  SOIL_PROBE        // Percent through the probe's dry/wet calibration; scale and offset are unused
+};
+
+// Also the order of the keys in the upload JSON
+enum ChannelId : uint8_t {
+  CHANNEL_SOIL_MOISTURE_1,  // Soil probes 1..MAX_SOIL_PROBES; the first SOIL_PROBE_COUNT are enabled
+  CHANNEL_SOIL_MOISTURE_2,
+  CHANNEL_SOIL_MOISTURE_3,
+  CHANNEL_SOIL_MOISTURE_4,
+  CHANNEL_SOIL_MOISTURE_5,
+  CHANNEL_SOIL_MOISTURE_6,
+  CHANNEL_SOIL_MOISTURE_7,
+  CHANNEL_SOIL_MOISTURE_8,
+  CHANNEL_SOIL_TEMP,
+  CHANNEL_EXT_TEMP,
+  CHANNEL_HUMIDITY,
+  CHANNEL_LIGHT,
+  CHANNEL_COUNT
+};
+
+struct ChannelSpec {
+  ChannelId id;
+  const char* label;    // Serial logs
+  const char* wireKey;  // JSON key for /api/sensorUpload, also the SD column name. Probes append their number.
+  const char* units;
+  const char* bleUuid;  // Notify characteristic, nullptr if not exposed over BLE
+  ChannelDriver driver;
+  uint8_t pin;
+  float scale;
+  float offset;
+  uint8_t decimals;     // Digits kept on the wire and in SD columns
+  uint8_t probe;        // Soil probe number (1..MAX_SOIL_PROBES), 0 for channels shared by all plants
+  bool enabled;
+};
+
+#define MAX_SOIL_PROBES 8
+
+constexpr uint8_t SOIL_PROBE_PIN_LIST[] = SOIL_PROBE_PINS;
+static_assert(SOIL_PROBE_COUNT >= 1 && SOIL_PROBE_COUNT <= MAX_SOIL_PROBES, "SOIL_PROBE_COUNT must be 1..8");
+static_assert(sizeof(SOIL_PROBE_PIN_LIST) == SOIL_PROBE_COUNT, "SOIL_PROBE_PINS needs one pin per probe");
+
+constexpr ChannelSpec soilProbe(ChannelId id, uint8_t probe, const char* label, const char* bleUuid) {
+  return {id, label, "soil_moisture_", "%", bleUuid, ChannelDriver::SOIL_PROBE,
+          probe <= SOIL_PROBE_COUNT ? SOIL_PROBE_PIN_LIST[probe - 1] : (uint8_t)0,
+          1, 0, 2, probe, probe <= SOIL_PROBE_COUNT};
+}
+
+constexpr ChannelSpec CHANNELS[CHANNEL_COUNT] = {
+  soilProbe(CHANNEL_SOIL_MOISTURE_1, 1, "Soil Moisture 1", SOILMOISTURE1_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_2, 2, "Soil Moisture 2", SOILMOISTURE2_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_3, 3, "Soil Moisture 3", SOILMOISTURE3_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_4, 4, "Soil Moisture 4", SOILMOISTURE4_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_5, 5, "Soil Moisture 5", SOILMOISTURE5_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_6, 6, "Soil Moisture 6", SOILMOISTURE6_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_7, 7, "Soil Moisture 7", SOILMOISTURE7_CHARACTERISTIC_UUID),
+  soilProbe(CHANNEL_SOIL_MOISTURE_8, 8, "Soil Moisture 8", SOILMOISTURE8_CHARACTERISTIC_UUID),
+  {CHANNEL_SOIL_TEMP, "DS18B20 Temperature", "soil_temp", "C", TEMPERATURE1_CHARACTERISTIC_UUID,
+   ChannelDriver::DS18B20, DS18S20_Pin, 1, 0, 2, 0, true},
+  // LM35: 10 mV per degree
+  {CHANNEL_EXT_TEMP, USE_LM35 ? "LM35 Temperature" : "DHT Temperature", "ext_temp", "C",
+   TEMPERATURE2_CHARACTERISTIC_UUID, USE_LM35 ? ChannelDriver::ANALOG_MV : ChannelDriver::DHT_TEMPERATURE,
+   USE_LM35 ? LM35_PIN : DHT22_PIN, USE_LM35 ? 0.1f : 1, 0, 2, 0, true},
+  {CHANNEL_HUMIDITY, "DHT Humidity", "humidity", "%", HUMIDITY_CHARACTERISTIC_UUID,
+   ChannelDriver::DHT_HUMIDITY, DHT22_PIN, 1, 0, 2, 0, !USE_LM35},
+  {CHANNEL_LIGHT, "Light", "light", "%", LIGHT_CHARACTERISTIC_UUID,
+   ChannelDriver::ANALOG, LIGHT_PIN, 100 / ANALOG_MAX, 0, 2, 0, true},
+};
+
+constexpr bool channelTableInOrder() {
+  for (size_t i = 0; i < CHANNEL_COUNT; i++) {
+    if (CHANNELS[i].id != i) return false;
+  }
+  return true;
+}
+static_assert(channelTableInOrder(), "CHANNELS rows must follow ChannelId order");
+
+constexpr bool anyChannelUses(ChannelDriver driver) {
+  for (size_t i = 0; i < CHANNEL_COUNT; i++) {
+    if (CHANNELS[i].enabled && CHANNELS[i].driver == driver) return true;
+  }
+  return false;
+}
+
+constexpr ChannelId soilProbeChannel(int probe) {
+  return (ChannelId)(CHANNEL_SOIL_MOISTURE_1 + probe - 1);
+}
+
+// Position of a channel's value in SensorData; enabled channels are packed
+constexpr size_t channelSlot(size_t id) {
+  size_t slot = 0;
+  for (size_t i = 0; i < id; i++) {
+    if (CHANNELS[i].enabled) slot++;
+  }
+  return slot;
+}
+
+constexpr size_t STORED_CHANNEL_COUNT = channelSlot(CHANNEL_COUNT);
+
+// 10^decimals of the channel stored at a SensorData slot. Buffered and encoded values are fixed point
+// in these units, which keeps everything the wire carries.
+constexpr float slotScale(size_t slot) {
+  for (size_t i = 0; i < CHANNEL_COUNT; i++) {
+    if (CHANNELS[i].enabled && slot-- == 0) {
+      float scale = 1;
+      for (int d = 0; d < CHANNELS[i].decimals; d++) scale *= 10;
+      return scale;
+    }
+  }
+  return 1;
+}
+
+template <typename F, size_t... I>
+inline void forEachChannelImpl(F&& f, std::index_sequence<I...>) {
+  auto visit = [&](auto id) {
+    if constexpr (CHANNELS[decltype(id)::value].enabled) {
+      f(id);
+    }
+  };
+  (visit(std::integral_constant<ChannelId, (ChannelId)I>{}), ...);
+}
+
+// Calls f(std::integral_constant<ChannelId, ID>) for every enabled channel, unrolled at compile time.
+// Inside f, decltype(id)::value is a constant expression, so CHANNELS[...] fields can drive if constexpr.
+template <typename F>
+inline void forEachChannel(F&& f) {
+  forEachChannelImpl(f, std::make_index_sequence<CHANNEL_COUNT>{});
+}
+
+#endif // CHANNELS_H
@@ -0,0 +1,217 @@
+#include "CoapPacket.h"
+#include <string.h>
+
+#define COAP_OPTION_URI_PATH 11
+#define COAP_OPTION_CONTENT_FORMAT 12
+#define COAP_OPTION_BLOCK1 27
+#define COAP_OPTION_SIZE1 60
+
+// Appends options in ascending number order, each as a delta from the previous one
+struct OptionWriter {
+  uint8_t* out;
+  size_t capacity;
+  size_t n;
+  uint16_t last;
+  bool overflow;
+
+  void nibble(uint32_t value, uint8_t& field, uint8_t* ext, size_t& extLength) {
+    if (value < 13) {
+      field = value;
+    } else if (value < 269) {
+      field = 13;
+      ext[extLength++] = value - 13;
+    } else {
+      field = 14;
+      ext[extLength++] = (value - 269) >> 8;
+      ext[extLength++] = (value - 269) & 0xFF;
+    }
+  }
+
+  void add(uint16_t number, const uint8_t* value, size_t length) {
+    uint8_t ext[4];
+    size_t extLength = 0;
+    uint8_t delta, len;
+    nibble(number - last, delta, ext, extLength);
+    nibble(length, len, ext, extLength);
+    if (n + 1 + extLength + length > capacity) {
+      overflow = true;
+      return;
+    }
+    out[n++] = (delta << 4) | len;
+    memcpy(out + n, ext, extLength);
+    n += extLength;
+    memcpy(out + n, value, length);
+    n += length;
+    last = number;
+  }
+
+  // Unsigned integer options drop their leading zero bytes
+  void addUint(uint16_t number, uint32_t value) {
+    uint8_t bytes[4];
+    size_t length = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      if (length > 0 || (value >> shift) != 0) {
+        bytes[length++] = value >> shift;
+      }
+    }
+    add(number, bytes, length);
+  }
+
+  void addBlock(uint16_t number, const CoapBlock& block) {
+    addUint(number, (block.num << 4) | (block.more ? 0x08 : 0) | (block.szx & 0x07));
+  }
+};
+
+static size_t writeHeader(uint8_t* out, size_t capacity, CoapType type, uint8_t code, uint16_t messageId,
+                          const uint8_t* token, uint8_t tokenLength) {
+  if (tokenLength > COAP_TOKEN_MAX || capacity < 4 + (size_t)tokenLength) {
+    return 0;
+  }
+  out[0] = (1 << 6) | (type << 4) | tokenLength;  // Version 1
+  out[1] = code;
+  out[2] = messageId >> 8;
+  out[3] = messageId & 0xFF;
+  memcpy(out + 4, token, tokenLength);
+  return 4 + tokenLength;
+}
+
+static size_t finish(OptionWriter& options, const uint8_t* payload, size_t payloadLength) {
+  if (options.overflow) {
+    return 0;
+  }
+  if (payloadLength == 0) {
+    return options.n;
+  }
+  if (options.n + 1 + payloadLength > options.capacity) {
+    return 0;
+  }
+  options.out[options.n++] = 0xFF;
+  memcpy(options.out + options.n, payload, payloadLength);
+  return options.n + payloadLength;
+}
+
+size_t coapRequest(uint8_t* out, size_t capacity, uint16_t messageId, const uint8_t* token, uint8_t tokenLength,
+                   const char* path, const CoapBlock& block1, size_t totalSize, const uint8_t* payload,
+                   size_t payloadLength) {
+  size_t n = writeHeader(out, capacity, COAP_CON, COAP_POST, messageId, token, tokenLength);
+  if (n == 0) {
+    return 0;
+  }
+  OptionWriter options = {out, capacity, n, 0, false};
+  while (*path) {
+    const char* slash = strchr(path, '/');
+    size_t length = slash ? (size_t)(slash - path) : strlen(path);
+    options.add(COAP_OPTION_URI_PATH, (const uint8_t*)path, length);
+    path += length + (slash ? 1 : 0);
+  }
+  options.addUint(COAP_OPTION_CONTENT_FORMAT, COAP_CONTENT_JSON);
+  options.addBlock(COAP_OPTION_BLOCK1, block1);
+  if (totalSize > 0) {
+    options.addUint(COAP_OPTION_SIZE1, totalSize);
+  }
+  return finish(options, payload, payloadLength);
+}
+
+size_t coapResponse(uint8_t* out, size_t capacity, CoapType type, uint8_t code, uint16_t messageId,
+                    const uint8_t* token, uint8_t tokenLength, const CoapBlock* block1, const uint8_t* payload,
+                    size_t payloadLength) {
+  size_t n = writeHeader(out, capacity, type, code, messageId, token, tokenLength);
+  if (n == 0) {
+    return 0;
+  }
+  OptionWriter options = {out, capacity, n, 0, false};
+  if (payloadLength > 0) {
+    options.addUint(COAP_OPTION_CONTENT_FORMAT, COAP_CONTENT_JSON);
+  }
+  if (block1 != nullptr) {
+    options.addBlock(COAP_OPTION_BLOCK1, *block1);
+  }
+  return finish(options, payload, payloadLength);
+}
+
+bool CoapMessage::sameToken(const uint8_t* other, uint8_t otherLength) const {
+  return tokenLength == otherLength && memcmp(token, other, otherLength) == 0;
+}
+
+// Reads an option delta or length nibble and its extended bytes
+static bool readNibble(uint8_t nibble, const uint8_t* in, size_t length, size_t& n, uint32_t& value) {
+  if (nibble < 13) {
+    value = nibble;
+  } else if (nibble == 13) {
+    if (n + 1 > length) return false;
+    value = in[n++] + 13;
+  } else if (nibble == 14) {
+    if (n + 2 > length) return false;
+    value = ((in[n] << 8) | in[n + 1]) + 269;
+    n += 2;
+  } else {
+    return false;  // 15 is reserved for the payload marker
+  }
+  return true;
+}
+
+bool coapParse(const uint8_t* in, size_t length, CoapMessage& message) {
+  if (length < 4 || (in[0] >> 6) != 1) {
+    return false;
+  }
+  message.type = (CoapType)((in[0] >> 4) & 0x03);
+  message.tokenLength = in[0] & 0x0F;
+  message.code = in[1];
+  message.messageId = (in[2] << 8) | in[3];
+  if (message.tokenLength > COAP_TOKEN_MAX || length < 4 + (size_t)message.tokenLength) {
+    return false;
+  }
+  memcpy(message.token, in + 4, message.tokenLength);
+  message.uriPath[0] = '\0';
+  message.hasBlock1 = false;
+  message.size1 = 0;
+  message.payload = nullptr;
+  message.payloadLength = 0;
+
+  size_t n = 4 + message.tokenLength;
+  size_t pathLength = 0;
+  uint32_t number = 0;
+  while (n < length) {
+    if (in[n] == 0xFF) {
+      if (n + 1 == length) {
+        return false;  // A marker must be followed by a payload
+      }
+      message.payload = in + n + 1;
+      message.payloadLength = length - n - 1;
+      return true;
+    }
+    uint8_t header = in[n++];
+    uint32_t delta, optionLength;
+    if (!readNibble(header >> 4, in, length, n, delta) || !readNibble(header & 0x0F, in, length, n, optionLength) ||
+        n + optionLength > length) {
+      return false;
+    }
+    number += delta;
+    const uint8_t* value = in + n;
+    n += optionLength;
+
+    uint32_t uintValue = 0;
+    for (uint32_t i = 0; i < optionLength && i < 4; i++) {
+      uintValue = (uintValue << 8) | value[i];
+    }
+    if (number == COAP_OPTION_URI_PATH) {
+      if (pathLength + optionLength + 2 > sizeof(message.uriPath)) {
+        return false;
+      }
+      if (pathLength > 0) {
+        message.uriPath[pathLength++] = '/';
+      }
+      memcpy(message.uriPath + pathLength, value, optionLength);
+      pathLength += optionLength;
+      message.uriPath[pathLength] = '\0';
+    } else if (number == COAP_OPTION_BLOCK1) {
+      message.hasBlock1 = true;
+      message.block1.num = uintValue >> 4;
+      message.block1.more = uintValue & 0x08;
+      message.block1.szx = uintValue & 0x07;
+    } else if (number == COAP_OPTION_SIZE1) {
+      message.size1 = uintValue;
+    }
+  }
+  return true;
+}
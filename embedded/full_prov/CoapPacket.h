@@ -0,0 +1,76 @@
+#ifndef COAPPACKET_H
+#define COAPPACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The slice of CoAP (RFC 7252) and block-wise transfer (RFC 7959) an uploading device needs:
+// a confirmable POST sent as Block1 blocks, and the ACKs, Continues and responses that come
+// back. Plain byte buffers so the framing is shared by the firmware's CoapTransport and the
+// host tools.
+enum CoapType : uint8_t {
+  COAP_CON = 0,
+  COAP_NON = 1,
+  COAP_ACK = 2,
+  COAP_RST = 3
+};
+
+// Codes are class << 5 | detail, written c.dd
+#define COAP_CODE(c, dd) (uint8_t)(((c) << 5) | (dd))
+#define COAP_EMPTY COAP_CODE(0, 0)
+#define COAP_POST COAP_CODE(0, 2)
+#define COAP_CREATED COAP_CODE(2, 1)
+#define COAP_CHANGED COAP_CODE(2, 4)
+#define COAP_CONTINUE COAP_CODE(2, 31)
+#define COAP_BAD_REQUEST COAP_CODE(4, 0)
+#define COAP_INCOMPLETE COAP_CODE(4, 8)
+#define COAP_TOO_LARGE COAP_CODE(4, 13)
+
+#define COAP_CONTENT_JSON 50
+#define COAP_TOKEN_MAX 8
+#define COAP_HEADER_MAX 64  // Header, token and the options coapRequest() writes, before the payload
+#define COAP_URI_PATH_MAX 48
+
+inline size_t coapBlockSize(uint8_t szx) {
+  return (size_t)16 << szx;
+}
+
+struct CoapBlock {
+  uint32_t num;
+  bool more;
+  uint8_t szx;  // Block size is 16 << szx, 0-6
+};
+
+// Writes a confirmable POST to path ("api/sensorUpload") carrying one block of a JSON body.
+// totalSize goes out as Size1 when nonzero, so a server can refuse a body it can't take
+// before the rest is sent. Returns the message size, or 0 if it didn't fit.
+size_t coapRequest(uint8_t* out, size_t capacity, uint16_t messageId, const uint8_t* token, uint8_t tokenLength,
+                   const char* path, const CoapBlock& block1, size_t totalSize, const uint8_t* payload,
+                   size_t payloadLength);
+
+// Writes an ACK, RST or response. block1 echoes the block being answered; null leaves it out.
+size_t coapResponse(uint8_t* out, size_t capacity, CoapType type, uint8_t code, uint16_t messageId,
+                    const uint8_t* token, uint8_t tokenLength, const CoapBlock* block1, const uint8_t* payload,
+                    size_t payloadLength);
+
+// One datagram, parsed in place
+struct CoapMessage {
+  CoapType type;
+  uint8_t code;
+  uint16_t messageId;
+  uint8_t token[COAP_TOKEN_MAX];
+  uint8_t tokenLength;
+  char uriPath[COAP_URI_PATH_MAX];  // Uri-Path segments joined with '/'
+  bool hasBlock1;
+  CoapBlock block1;
+  uint32_t size1;  // 0 if absent
+  const uint8_t* payload;
+  size_t payloadLength;
+
+  bool sameToken(const uint8_t* other, uint8_t otherLength) const;
+};
+
+// Returns false for a datagram that isn't a well-formed CoAP message
+bool coapParse(const uint8_t* in, size_t length, CoapMessage& message);
+
+#endif // COAPPACKET_H
@@ -0,0 +1,110 @@
+#ifndef COAPTRANSPORT_H
+#define COAPTRANSPORT_H
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "Config.h"
+#include "UploadTransport.h"
+#include "CoapUpload.h"
+#include "UploadProfiler.h"
+
+// Batches POSTed as confirmable CoAP requests over UDP, in Block1 blocks of COAP_BLOCK_SIZE,
+// with the upload window's batches in flight at once (CoapUpload.h). There is no connection
+// to open or close, so an upload keeps the radio on for its blocks' round trips and no more.
+// A TCP upload adds the handshake and teardown, and HTTP adds its headers on top. Lost
+// datagrams are retransmitted here. A batch whose retransmissions run out fails the upload
+// like a dropped TCP connection would, and the window goes back to the buffer. The backend's
+// sequence dedup makes resending harmless.
+class CoapTransport : public UploadTransport {
+private:
+  WiFiUDP udp;
+  const char* host;
+  uint16_t port;
+  IPAddress address;
+  bool started = false;
+  CoapUploader uploader;
+  uint8_t rx[COAP_HEADER_MAX + 64];  // Responses are an ack at most
+
+  static void transmit(void* context, const uint8_t* data, size_t length) {
+    CoapTransport* transport = (CoapTransport*)context;
+    transport->udp.beginPacket(transport->address, transport->port);
+    transport->udp.write(data, length);
+    transport->udp.endPacket();
+    transport->sent += length;
+  }
+
+  // Hands every datagram waiting from the server to the uploader
+  void poll() {
+    while (true) {
+      int length = udp.parsePacket();
+      if (length <= 0) {
+        return;
+      }
+      if (udp.remoteIP() != address || udp.remotePort() != port) {
+        udp.flush();
+        continue;
+      }
+      length = udp.read(rx, sizeof(rx));
+      if (length > 0) {
+        received += length;
+        uploader.receive(rx, length, millis());
+      }
+    }
+  }
+
+public:
+  CoapTransport(const char* host, uint16_t port) : host(host), port(port), uploader(transmit, this, COAP_UPLOAD_PATH) {}
+
+  const char* name() const override {
+    return "coap";
+  }
+
+  bool begin(const char* deviceId) override {
+    if (started) {
+      return true;
+    }
+    unsigned long startUs = micros();
+    if (!WiFi.hostByName(host, address)) {
+      Serial.printf("Failed to resolve CoAP server %s\n", host);
+      return false;
+    }
+    uploadProfiler.record(UPLOAD_PHASE_DNS, micros() - startUs);
+    if (!udp.begin(0)) {
+      return false;
+    }
+    uploader.seed(esp_random());
+    started = true;
+    return true;
+  }
+
+  bool send(const char* payload, size_t length) override {
+    poll();
+    return uploader.start(payload, length, millis());
+  }
+
+  // Retransmission decides when a batch is lost, so timeoutMs isn't needed here
+  bool receive(UploadReply& reply, unsigned long timeoutMs) override {
+    while (true) {
+      poll();
+      if (uploader.takeReply(reply)) {
+        break;
+      }
+      if (!uploader.service(millis())) {
+        Serial.println("CoAP server stopped answering");
+        return false;
+      }
+      delay(1);
+    }
+    if (!reply.accepted) {
+      Serial.println("Upload refused by the CoAP server");
+    }
+    return true;
+  }
+
+  // Nothing to tear down; exchanges still open belong to batches going back to the buffer
+  void stop() override {
+    uploader.reset();
+  }
+};
+
+#endif // COAPTRANSPORT_H
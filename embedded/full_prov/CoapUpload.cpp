@@ -0,0 +1,192 @@
+#include "CoapUpload.h"
+#include "Intervals.h"
+#include <string.h>
+
+CoapUploader::CoapUploader(Transmit transmit, void *context, const char *path)
+    : transmit(transmit), context(context), path(path), first(0), count(0), nextMessageId(1), nextToken(1),
+      rng(1), highestAck(0), hasHighestAck(false) {}
+
+void CoapUploader::seed(uint32_t seed) {
+  nextMessageId = seed;
+  nextToken = seed * 2654435761u;
+  rng = seed | 1;
+}
+
+uint32_t CoapUploader::initialTimeout() {
+  rng ^= rng << 13;  // xorshift32
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return COAP_ACK_TIMEOUT + rng % (COAP_ACK_TIMEOUT / 2 + 1);
+}
+
+void CoapUploader::send(const uint8_t *data, size_t length) {
+  bytesSent += length;
+  transmit(context, data, length);
+}
+
+void CoapUploader::sendBlock(Exchange &exchange, uint32_t nowMs) {
+  size_t blockSize = coapBlockSize(exchange.szx);
+  CoapBlock block = {(uint32_t)(exchange.offset / blockSize), exchange.offset + blockSize < exchange.length,
+                     exchange.szx};
+  exchange.chunk = block.more ? blockSize : exchange.length - exchange.offset;
+
+  uint8_t datagram[COAP_HEADER_MAX + COAP_BLOCK_SIZE];
+  size_t length = coapRequest(datagram, sizeof(datagram), exchange.messageId, exchange.token,
+                              sizeof(exchange.token), path, block, block.num == 0 ? exchange.length : 0,
+                              (const uint8_t *)exchange.payload + exchange.offset, exchange.chunk);
+  exchange.sentMs = nowMs;
+  send(datagram, length);
+}
+
+bool CoapUploader::start(const char *payload, size_t length, uint32_t nowMs) {
+  if (count == UPLOAD_WINDOW_MAX || length > sizeof(Exchange::payload)) {
+    return false;
+  }
+  Exchange &exchange = at(count);
+  count++;
+  memcpy(exchange.payload, payload, length);
+  exchange.length = length;
+  exchange.offset = 0;
+  exchange.szx = COAP_BLOCK_SZX;
+  memcpy(exchange.token, &nextToken, sizeof(exchange.token));
+  nextToken++;
+  exchange.messageId = nextMessageId++;
+  exchange.timeoutMs = initialTimeout();
+  exchange.retransmits = 0;
+  exchange.separate = false;
+  exchange.done = false;
+  sendBlock(exchange, nowMs);
+  return true;
+}
+
+void CoapUploader::complete(Exchange &exchange, const CoapMessage &response) {
+  exchange.done = true;
+  exchange.reply.accepted = (response.code >> 5) == 2 && response.code != COAP_CONTINUE;
+  exchange.reply.hasAck = false;
+  if (exchange.reply.accepted && response.payloadLength > 0) {
+    char body[160];
+    size_t n = response.payloadLength < sizeof(body) - 1 ? response.payloadLength : sizeof(body) - 1;
+    memcpy(body, response.payload, n);
+    body[n] = '\0';
+    exchange.reply.hasAck = parseAck(body, exchange.reply.ack);
+    intervals.applyResponse(body);
+    if (exchange.reply.hasAck && (!hasHighestAck || exchange.reply.ack > highestAck)) {
+      highestAck = exchange.reply.ack;
+      hasHighestAck = true;
+    }
+  }
+}
+
+void CoapUploader::receive(const uint8_t *data, size_t length, uint32_t nowMs) {
+  bytesReceived += length;
+  CoapMessage response;
+  if (!coapParse(data, length, response)) {
+    return;
+  }
+  for (int i = 0; i < count; i++) {
+    Exchange &exchange = at(i);
+    if (exchange.done) {
+      continue;
+    }
+    if (response.type == COAP_ACK || response.type == COAP_RST) {
+      if (response.messageId != exchange.messageId || exchange.separate) {
+        continue;
+      }
+      if (response.type == COAP_RST) {
+        response.code = COAP_BAD_REQUEST;  // The server doesn't know the exchange; refuse the batch
+        complete(exchange, response);
+        return;
+      }
+      if (response.code == COAP_EMPTY) {
+        exchange.separate = true;
+        exchange.sentMs = nowMs;
+        exchange.timeoutMs = UPLOAD_RESPONSE_TIMEOUT;
+        return;
+      }
+    } else {
+      if (!response.sameToken(exchange.token, sizeof(exchange.token))) {
+        continue;
+      }
+      if (response.type == COAP_CON) {
+        uint8_t ack[4];
+        send(ack, coapResponse(ack, sizeof(ack), COAP_ACK, COAP_EMPTY, response.messageId, nullptr, 0, nullptr,
+                               nullptr, 0));
+      }
+    }
+
+    bool more = exchange.offset + exchange.chunk < exchange.length;
+    if (more && response.code == COAP_CONTINUE) {
+      exchange.offset += exchange.chunk;
+      if (response.hasBlock1 && response.block1.szx < exchange.szx) {
+        exchange.szx = response.block1.szx;  // The server asked for smaller blocks
+      }
+      exchange.messageId = nextMessageId++;
+      exchange.timeoutMs = initialTimeout();
+      exchange.retransmits = 0;
+      exchange.separate = false;
+      sendBlock(exchange, nowMs);
+    } else {
+      complete(exchange, response);  // The final response, or a refusal partway
+    }
+    return;
+  }
+}
+
+bool CoapUploader::service(uint32_t nowMs) {
+  for (int i = 0; i < count; i++) {
+    Exchange &exchange = at(i);
+    if (exchange.done || (int32_t)(nowMs - exchange.sentMs) < (int32_t)exchange.timeoutMs) {
+      continue;
+    }
+    // A separate response gets one response timeout; it is the server's to retransmit
+    if (exchange.separate || exchange.retransmits == COAP_MAX_RETRANSMIT) {
+      return false;
+    }
+    exchange.retransmits++;
+    exchange.timeoutMs *= 2;
+    sendBlock(exchange, nowMs);
+  }
+  return true;
+}
+
+bool CoapUploader::takeReply(UploadReply &reply) {
+  if (count == 0 || !exchanges[first].done) {
+    return false;
+  }
+  reply = exchanges[first].reply;
+  // Batches finish in any order, so an older reply can carry an ack that a newer one has
+  // already moved past. Acks are cumulative, which makes the highest one true for all.
+  if (reply.hasAck) {
+    reply.ack = highestAck;
+  }
+  first = (first + 1) % UPLOAD_WINDOW_MAX;
+  count--;
+  if (count == 0) {
+    hasHighestAck = false;
+  }
+  return true;
+}
+
+uint32_t CoapUploader::nextTimeout(uint32_t nowMs, uint32_t limitMs) const {
+  uint32_t next = limitMs;
+  for (int i = 0; i < count; i++) {
+    const Exchange &exchange = exchanges[(first + i) % UPLOAD_WINDOW_MAX];
+    if (exchange.done) {
+      continue;
+    }
+    int32_t left = (int32_t)(exchange.sentMs + exchange.timeoutMs - nowMs);
+    if (left <= 0) {
+      return 0;
+    }
+    if ((uint32_t)left < next) {
+      next = left;
+    }
+  }
+  return next;
+}
+
+void CoapUploader::reset() {
+  first = 0;
+  count = 0;
+  hasHighestAck = false;
+}
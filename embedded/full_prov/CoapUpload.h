@@ -0,0 +1,89 @@
+#ifndef COAPUPLOAD_H
+#define COAPUPLOAD_H
+
+#include "Config.h"
+#include "UploadBatch.h"
+#include "UploadTransport.h"
+#include "CoapPacket.h"
+
+// Up to UPLOAD_WINDOW_MAX block-wise confirmable POSTs in flight at once, one per batch, each
+// with its own token. Within a batch, blocks go one at a time: the next block leaves when the
+// server's 2.31 Continue for the previous one arrives. With a window of batches going in
+// parallel, a backlog drains in about one round trip per block of a batch rather than per
+// block of the whole backlog. This is RFC 7252's NSTART raised to the upload window, which is
+// fine for the one server a device talks to.
+//
+// Each block is retransmitted at ACK_TIMEOUT x 1-1.5, doubling, until it's acknowledged. If
+// COAP_MAX_RETRANSMIT runs out, service() fails, and the caller puts every batch in flight back
+// in the buffer. No I/O happens here: datagrams go out through transmit and come in through
+// receive(), so the firmware (CoapTransport) and the host tools share this code.
+class CoapUploader {
+public:
+  typedef void (*Transmit)(void *context, const uint8_t *data, size_t length);
+
+  CoapUploader(Transmit transmit, void *context, const char *path);
+
+  // Message IDs and tokens start from seed, so a reboot doesn't reuse the last session's
+  void seed(uint32_t seed);
+
+  // Copies the batch and sends its first block. False if the window is full.
+  bool start(const char *payload, size_t length, uint32_t nowMs);
+
+  // Handles one datagram from the server; anything not for an exchange in flight is ignored
+  void receive(const uint8_t *data, size_t length, uint32_t nowMs);
+
+  // Retransmits every block that's due. False once one ran out of retransmissions.
+  bool service(uint32_t nowMs);
+
+  // The oldest batch's final response, once it has one; replies come out in send order
+  bool takeReply(UploadReply &reply);
+
+  // ms until service() next has work, at most limitMs
+  uint32_t nextTimeout(uint32_t nowMs, uint32_t limitMs) const;
+
+  int inFlight() const { return count; }
+
+  // Forgets every exchange; their batches are going back to the buffer
+  void reset();
+
+  // Every datagram so far, for measuring what an upload costs on the air
+  size_t bytesSent = 0;
+  size_t bytesReceived = 0;
+
+private:
+  struct Exchange {
+    char payload[sizeof(UploadBatch::payload)];
+    size_t length;
+    size_t offset;  // Of the block in flight
+    size_t chunk;
+    uint8_t szx;
+    uint8_t token[4];
+    uint16_t messageId;
+    uint32_t sentMs;
+    uint32_t timeoutMs;
+    uint8_t retransmits;
+    bool separate;  // Empty ACK came back; the response follows as its own message
+    bool done;
+    UploadReply reply;
+  };
+
+  Transmit transmit;
+  void *context;
+  const char *path;
+  Exchange exchanges[UPLOAD_WINDOW_MAX];  // Ring, oldest at first
+  int first;
+  int count;
+  uint16_t nextMessageId;
+  uint32_t nextToken;
+  uint32_t rng;
+  uint32_t highestAck;  // Of the replies in flight
+  bool hasHighestAck;
+
+  Exchange &at(int i) { return exchanges[(first + i) % UPLOAD_WINDOW_MAX]; }
+  uint32_t initialTimeout();
+  void sendBlock(Exchange &exchange, uint32_t nowMs);
+  void complete(Exchange &exchange, const CoapMessage &response);
+  void send(const uint8_t *data, size_t length);
+};
+
+#endif
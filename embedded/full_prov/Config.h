@@ -1,16 +1,15 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#include <ArduinoJson.h>
+#include <Arduino.h>
 #include <Preferences.h>
-#include <BLEDevice.h>
-#include <BLEServer.h>
-#include <BLEUtils.h>
-#include <BLE2902.h>
+#include <time.h>
 
 // ==========================================
 // Global Preferences Instance
 // ==========================================
+// For setup(), loop() and provisioning. A Preferences object can't be shared between tasks, so
+// modules used from the network or BLE task keep a handle of their own.
 extern Preferences preferences;
 
 // ==========================================
@@ -35,12 +34,71 @@ enum DeviceMode {
 
 #if USE_PRODUCTION_SERVER
     #define PLANTGURU_BASE_URL "http://52.14.140.110:3000"
+    #define PLANTGURU_TLS_HOST "api.plantguru.internal"
+    #define PLANTGURU_MQTT_HOST "52.14.140.110"
+    #define PLANTGURU_COAP_HOST "52.14.140.110"
 #else
     #define PLANTGURU_BASE_URL "http://192.168.2.225:3000"
+    #define PLANTGURU_TLS_HOST "dev.plantguru.internal"
+    #define PLANTGURU_MQTT_HOST "192.168.2.225"
+    #define PLANTGURU_COAP_HOST "192.168.2.225"
 #endif
 
-#define PLANTGURU_SERVER PLANTGURU_BASE_URL
-#define PLANTGURU_SENSOR_ENDPOINT PLANTGURU_BASE_URL "/api/sensorUpload"
+// With USE_TLS_UPLOAD every request to the backend goes over HTTPS to PLANTGURU_HTTPS_BASE_URL;
+// sensor batches on a kept-alive connection that resumes the cached session when it has to
+// reconnect (TlsClient.h). The server's certificate must chain to UPLOAD_TLS_CA_CERT (DER,
+// UploadCaCert.h) and name PLANTGURU_TLS_HOST, which must resolve to the backend; a certificate
+// can't be checked against a bare IP address.
+#define USE_TLS_UPLOAD false
+#define UPLOAD_TLS_CA_CERT upload_ca_cert
+#define PLANTGURU_HTTPS_BASE_URL "https://" PLANTGURU_TLS_HOST ":3443"
+#define TLS_SESSION_MAX 2048  // Serialized session, server certificate included; kept in RTC memory and NVS
+
+#if USE_TLS_UPLOAD
+#define PLANTGURU_API_BASE_URL PLANTGURU_HTTPS_BASE_URL
+#else
+#define PLANTGURU_API_BASE_URL PLANTGURU_BASE_URL
+#endif
+#define PLANTGURU_SERVER PLANTGURU_API_BASE_URL
+#define PLANTGURU_SENSOR_ENDPOINT PLANTGURU_API_BASE_URL "/api/sensorUpload"
+#define PLANTGURU_PREDICTION_ENDPOINT PLANTGURU_API_BASE_URL "/api/devicePrediction"
+#define PLANTGURU_TELEMETRY_ENDPOINT PLANTGURU_API_BASE_URL "/api/deviceTelemetry"
+#define PLANTGURU_OTA_ENDPOINT PLANTGURU_API_BASE_URL "/api/deviceOta"
+#define PLANTGURU_ROLLUP_ENDPOINT PLANTGURU_API_BASE_URL "/api/sensorRollups"
+
+// Sensor batches go out over HTTP POST, or with USE_MQTT_UPLOAD as MQTT QoS 1 publishes to
+// MQTT_TOPIC_PREFIX <device_id> MQTT_TOPIC_SUFFIX (MqttTransport.h)
+#define USE_MQTT_UPLOAD false
+#define PLANTGURU_MQTT_PORT 1883
+#define MQTT_TOPIC_PREFIX "plantguru/"
+#define MQTT_TOPIC_SUFFIX "/records"
+#define MQTT_KEEPALIVE_SECONDS 120
+
+// Or with USE_COAP_UPLOAD as confirmable CoAP POSTs over UDP, split into Block1 blocks
+// (CoapTransport.h). Retransmission timing is the RFC 7252 default.
+#define USE_COAP_UPLOAD false
+#define PLANTGURU_COAP_PORT 5683
+#define COAP_UPLOAD_PATH "api/sensorUpload"
+#define COAP_BLOCK_SZX 6  // 1024 byte blocks, the most CoAP allows; fits a WiFi frame
+#define COAP_BLOCK_SIZE (16 << COAP_BLOCK_SZX)
+#define COAP_ACK_TIMEOUT 2000  // ms before the first retransmission, randomized up to 1.5x
+#define COAP_MAX_RETRANSMIT 4
+
+#if USE_MQTT_UPLOAD + USE_COAP_UPLOAD + USE_TLS_UPLOAD > 1
+#error "Pick one of USE_MQTT_UPLOAD, USE_COAP_UPLOAD and USE_TLS_UPLOAD"
+#endif
+
+// ==========================================
+// Firmware Update Configuration
+// ==========================================
+// Updates come from a release directory written by host/ota_delta (OtaUpdater.h). The backend
+// serves one from FIRMWARE_DIR; any static file server will do for testing.
+#define FIRMWARE_VERSION "1.0.0"  // Must be the --to version this build was published under
+#define OTA_MANIFEST_URL PLANTGURU_API_BASE_URL "/firmware/manifest.json"
+#define OTA_MANIFEST_MAX 1024  // JSON document for the manifest, a handful of deltas
+#define OTA_CHECK_INTERVAL 21600000  // ms between manifest checks (6 h)
+#define OTA_READ_TIMEOUT 10000  // ms without data before a download is given up
+#define OTA_CONFIRM_TIMEOUT 600000  // ms a new image has to upload in before it is rolled back
 
 // ==========================================
 // Device Configuration
@@ -61,6 +119,10 @@ enum DeviceMode {
 #define LIGHT_PIN A0
 #define SOIL_PIN1 A1
 #define SOIL_PIN2 A2
+// One ADC1 pin per soil probe (ADC2 pins can't be read while WiFi is on)
+#define SOIL_PROBE_COUNT 2  // 1-8
+#define SOIL_PROBE_PINS {SOIL_PIN1, SOIL_PIN2}
+#define SD_PIN D6
 
 // ==========================================
 // Timing Configuration
@@ -71,8 +133,30 @@ enum DeviceMode {
 #define RESET_BTN_UPDATE_INTERVAL 100
 #define RESET_LISTENER_UPDATE_INTERVAL 100
 #define SENSOR_UPDATE_INTERVAL 0
-#define SENSOR_RECORD_INTERVAL 60000/10
+#define SENSOR_RECORD_INTERVAL 60000
 #define RESTART_DELAY 0
+// SENSOR_UPDATE_INTERVAL, SENSOR_RECORD_INTERVAL, WIFI_UPDATE_INTERVAL and BT_UPDATE_INTERVAL are the
+// defaults; the intervals in use can be changed at run time within these bounds (Intervals.h)
+#define INTERVAL_SAMPLE_MIN 0
+#define INTERVAL_SAMPLE_MAX 60000
+#define INTERVAL_RECORD_MIN 1000
+#define INTERVAL_RECORD_MAX 3600000
+#define INTERVAL_UPLOAD_MIN 5000
+#define INTERVAL_UPLOAD_MAX 86400000
+#define INTERVAL_BT_MIN 500
+#define INTERVAL_BT_MAX 60000
+
+// ==========================================
+// WiFi Connection Configuration
+// ==========================================
+#define WIFI_FAST_RECONNECT true           // Reuse the cached BSSID/channel/IP on boot
+#define WIFI_FAST_RECONNECT_STATIC_IP false // Reuse the last DHCP lease as a static config (skips DHCP)
+#define WIFI_STATIC_IP_MAX_AGE 3600         // s after its DHCP grant a cached lease may be reused; keep it under
+                                            // the router's lease time
+#define WIFI_FAST_CONNECT_TIMEOUT 3000     // ms to wait for the targeted connect before a full scan
+#define WIFI_CONNECT_TIMEOUT 15000         // ms to wait for a full scan connect before backing off
+#define WIFI_BACKOFF_BASE 1000UL           // First reconnect backoff (ms), doubled per failure
+#define WIFI_BACKOFF_MAX 300000UL          // Backoff ceiling (ms)
 
 // ==========================================
 // Sensor Configuration
@@ -80,6 +164,33 @@ enum DeviceMode {
 #define USE_LM35 false  // Set to false to use DHT22 instead
 #define DHTTYPE DHT22
 #define ANALOG_MAX 4095.0
+// Analog conversion (AdcCalibration.h). Soil probe calibrations are in mV at the ADC pin.
+#define ADC_NOMINAL_MV 3100       // Full-scale reading at 12 dB without eFuse calibration data
+#define SOIL_CAL_MIN_SPAN_MV 100  // Closest a probe's dry and wet points may be
+#define SOIL_CAL_MAX_MV 3300
+
+// ==========================================
+// Adaptive Sampling Configuration
+// ==========================================
+// Records come faster while soil moisture or light change and back off while they are flat
+// (AdaptiveRate.h). Rates are per minute between records, spreads within one record's window.
+#define USE_ADAPTIVE_SAMPLING true
+#define ADAPTIVE_FAST_SHIFT 2  // While changing, record every record interval / 4
+#define ADAPTIVE_SLOW_SHIFT 3  // Stable records double the interval up to the record interval * 8
+#define ADAPTIVE_MIN_SAMPLES 3  // Samples in a row past a jump threshold before they count, so a spike doesn't
+#define ADAPTIVE_SOIL_RATE 0.5  // % per minute
+#define ADAPTIVE_SOIL_STDDEV 2.0  // %
+#define ADAPTIVE_SOIL_JUMP 5.0  // % from the last record that records at once
+#define ADAPTIVE_LIGHT_RATE 2.0
+#define ADAPTIVE_LIGHT_STDDEV 8.0
+#define ADAPTIVE_LIGHT_JUMP 25.0
+
+// ==========================================
+// Watering Prediction Configuration
+// ==========================================
+#define USE_ON_DEVICE_PREDICTION true     // Run the exported decision tree (WateringModel.h) locally
+#define WATERING_MOISTURE_THRESHOLD 50.0  // Soil moisture (%) at which the plant needs water
+#define PREDICTION_CHANGE_THRESHOLD 3600  // Only upload a dry time that moved by at least this many seconds
 
 // ==========================================
 // BLE Service Configuration
@@ -94,12 +205,24 @@ enum DeviceMode {
 #define SOILMOISTURE1_CHARACTERISTIC_UUID "19b10004-e8f2-537e-4f6c-d104768a1218"
 #define SOILMOISTURE2_CHARACTERISTIC_UUID "19b10005-e8f2-537e-4f6c-d104768a1219"
 #define HUMIDITY_CHARACTERISTIC_UUID "19b10006-e8f2-537e-4f6c-d104768a1220"
+#define SOILMOISTURE3_CHARACTERISTIC_UUID "19b10011-e8f2-537e-4f6c-d104768a1225"
+#define SOILMOISTURE4_CHARACTERISTIC_UUID "19b10012-e8f2-537e-4f6c-d104768a1226"
+#define SOILMOISTURE5_CHARACTERISTIC_UUID "19b10013-e8f2-537e-4f6c-d104768a1227"
+#define SOILMOISTURE6_CHARACTERISTIC_UUID "19b10014-e8f2-537e-4f6c-d104768a1228"
+#define SOILMOISTURE7_CHARACTERISTIC_UUID "19b10015-e8f2-537e-4f6c-d104768a1229"
+#define SOILMOISTURE8_CHARACTERISTIC_UUID "19b10016-e8f2-537e-4f6c-d104768a1230"
 
 // Settings characteristics
 #define RESET_CHARACTERISTIC_UUID "19b10007-e8f2-537e-4f6c-d104768a1221"
 #define ENDPOINT_CHARACTERISTIC_UUID "19b10008-e8f2-537e-4f6c-d104768a1222"
 #define UPDATE_PERIOD_BT_CHARACTERISTIC_UUID "19b10009-e8f2-537e-4f6c-d104768a1223"
 #define UPDATE_PERIOD_WIFI_CHARACTERISTIC_UUID "19b10010-e8f2-537e-4f6c-d104768a1224"
+#define PROBE_MAP_CHARACTERISTIC_UUID "19b10017-e8f2-537e-4f6c-d104768a1231"
+#define INTERVALS_CHARACTERISTIC_UUID "19b10019-e8f2-537e-4f6c-d104768a1233"
+#define SOIL_CALIBRATION_CHARACTERISTIC_UUID "19b1001a-e8f2-537e-4f6c-d104768a1234"
+
+// Diagnostics characteristics
+#define UPLOAD_PROFILE_CHARACTERISTIC_UUID "19b10018-e8f2-537e-4f6c-d104768a1232"
 
 // ==========================================
 // Bluetooth Configuration
@@ -111,6 +234,16 @@ enum DeviceMode {
 #define CONFIG_BTDM_CTRL_MODE_BTDM 0
 #define CONFIG_BT_CLASSIC_ENABLED 0
 
+// ==========================================
+// Task Configuration
+// ==========================================
+// loop() samples and records on the Arduino core; uploads run on the core with the WiFi stack.
+// The two only share the circular buffer, which is a lock-free SPSC ring (Memory.h).
+#define SAMPLING_CORE ARDUINO_RUNNING_CORE  // Core 1 by default
+#define NETWORK_CORE 0
+#define NETWORK_TASK_STACK 12288  // HTTPClient and TLS need more than the default 8 KB loop stack
+#define NETWORK_TASK_PRIORITY 1
+
 // ==========================================
 // WiFi Provisioning Configuration
 // ==========================================
@@ -120,44 +253,131 @@ enum DeviceMode {
 // ==========================================
 // Memory Configuration
 // ==========================================
-#define BUFFER_SIZE 500  // Maximum number of elements in the circular buffer
+#define BUFFER_SIZE 750  // Maximum number of elements in the circular buffer; 21 B each with two probes (Memory.h)
+#define BUFFER_BLOCK_BYTES 4096  // NVS blob for the compressed buffer; 2.4-4.7 B per record on the QTA traces
+#define BUFFER_SAVE_INTERVAL 600000  // ms between saves of the buffer to NVS. Without a history, a power cut
+                                     // loses the records since the last one; restarts save first.
+#define SEQUENCE_LEASE 256  // Sequence numbers reserved in NVS at a time, and skipped after a power cut
+#define SENSOR_JSON_MAX 384  // Upper bound for one serialized SensorData record (one plant, up to 8 probes)
+#if USE_COAP_UPLOAD
+#define MAX_RECORDS_PER_REQUEST 5  // Keeps a batch to one COAP_BLOCK_SIZE block, one round trip, unless one
+                                   // record has more plants than this (UploadBatch.h)
+#else
+#define MAX_RECORDS_PER_REQUEST 10  // JSON objects per upload batch (one per plant per record)
+#endif
+#define UPLOAD_WINDOW_MAX 4  // Upload batches in flight at once on the persistent connection (UploadWindow.h)
+#define UPLOAD_RESPONSE_TIMEOUT 10000  // ms to wait for each pipelined response before dropping the connection
+#define UPLOAD_KEEP_ALIVE_MS 110000  // ms idle after which the upload connection is reopened rather than reused;
+                                     // under the backend's 120 s keepAliveTimeout
+#define UPLOAD_PROFILE_SAMPLES 32  // Recent timings per upload phase behind the percentiles (UploadProfiler.h)
+#define UPLOAD_PROFILE_REPORT_INTERVAL 3600000  // ms between upload profile telemetry reports
+#define USE_SD_CARD false  // Also keep every record in compressed blocks on the SD card (SDmemory.h)
+#define SD_WRITE_BLOCKS 4  // Sectors of history buffered in RAM and written to the card together
+#define SD_FLUSH_RECORDS 30  // Records at most between writes to the card, all lost on a power cut
+#define SD_FLUSH_INTERVAL 600000  // ms at most between writes to the card while records arrive
+#define SD_PREALLOCATE_BLOCKS 128  // Zeroed sectors the history file grows by at a time (64 KB)
+#define USE_FLASH_HISTORY false  // Keep the history in the flash partition FLASH_HISTORY_LABEL instead (FlashHistory.h)
+#define FLASH_HISTORY_LABEL "history"  // Data partition from partitions.csv
+#define FLASH_BLOCK_BYTES 256  // Compressed block written to flash at a time; records not yet written are lost on a power cut
+#if USE_SD_CARD && USE_FLASH_HISTORY
+#error "Pick one of USE_SD_CARD and USE_FLASH_HISTORY"
+#endif
+#define TIER_REFILL_INTERVAL 1000  // ms between moves of spilled records from the history back into the buffer
+#define USE_ROLLUPS true  // A full buffer folds its oldest records into rollups instead of dropping them (Rollups.h)
+#define ROLLUP_FINE_SPAN 900  // s per rollup of records leaving the buffer
+#define ROLLUP_COARSE_SPAN 3600  // s per rollup once the store is full; must be a multiple of ROLLUP_FINE_SPAN
+#define ROLLUP_CAPACITY 160  // Rollups in RAM, 64 B each with two probes; hourly, a week on top of the buffer
+#define ROLLUPS_PER_REQUEST 4
+#define ROLLUP_JSON_MAX 4096  // One request: ROLLUPS_PER_REQUEST rollups, one object per plant each
+#define ROLLUP_BLOCK_BYTES 2048  // NVS blob for the closed rollups, saved with the buffer; the newest that fit are kept
+
+// ==========================================
+// Sensor Channels
+// ==========================================
+#include "Channels.h"
 
 // ==========================================
 // Data Structures
 // ==========================================
-// Sensor data structure
+// One recorded sample: a value per enabled channel (see CHANNELS), NAN when missing.
+// Holds every soil probe of the node; PlantMap decides which plant each probe is uploaded under.
 class SensorData {
 public:
-    int plant_id;
-    float soilMoisture1;
-    float soilMoisture2;
-    float temperature1;
-    float temperature2;
-    float temperature3;
-    float humidity;
-    float light;
+    float values[STORED_CHANNEL_COUNT];
     long timestamp;
-    String date;
-
-    SensorData() :
-        plant_id(-1), soilMoisture1(NAN), soilMoisture2(NAN), temperature1(NAN),
-        temperature2(NAN), temperature3(NAN), humidity(NAN),
-        light(NAN), timestamp(-1) {}
-
-    String toJson() {
-        StaticJsonDocument<256> doc;
-        if (plant_id != -1) doc["plant_id"] = plant_id;
-        if (!isnan(soilMoisture1)) doc["soil_moisture_1"] = soilMoisture1;
-        if (!isnan(soilMoisture2)) doc["soil_moisture_2"] = soilMoisture2;
-        if (!isnan(temperature1)) doc["soil_temp"] = temperature1;
-        if (!isnan(temperature2)) doc["ext_temp"] = temperature2;
-        if (!isnan(temperature3)) doc["temperature3"] = temperature3;
-        if (!isnan(humidity)) doc["humidity"] = humidity;
-        if (!isnan(light)) doc["light"] = light;
-        if (!date.isEmpty()) doc["time_stamp"] = date;
-        String json;
-        serializeJson(doc, json);
-        return json;
+    uint32_t sequence;  // Per-device record number assigned by pushBack(), 0 until buffered
+
+    SensorData() : timestamp(-1), sequence(0) {
+        for (size_t i = 0; i < STORED_CHANNEL_COUNT; i++) {
+            values[i] = NAN;
+        }
+    }
+
+    // Disabled channels read as NAN and ignore writes
+    float get(ChannelId id) const {
+        return CHANNELS[id].enabled ? values[channelSlot(id)] : NAN;
+    }
+
+    void set(ChannelId id, float value) {
+        if (CHANNELS[id].enabled) {
+            values[channelSlot(id)] = value;
+        }
+    }
+
+    // Appends this record as a JSON object for one plant: the probes in probeMask (bit k for
+    // probe k+1, renumbered soil_moisture_1.. within the plant) and every shared channel.
+    // Returns the number of characters written, or 0 if it didn't fit. Plain snprintf so it
+    // runs without a heap allocation.
+    size_t writeJson(char* out, size_t capacity, int plantId = -1, uint32_t probeMask = 0xFF) const {
+        if (capacity < 3) return 0;
+        size_t len = 0;
+        out[len++] = '{';
+        auto append = [&](const char* key, const char* format, auto... value) {
+            if (len >= capacity) return;
+            int n = snprintf(out + len, capacity - len, len > 1 ? ",\"%s\":" : "\"%s\":", key);
+            len += n > 0 ? n : 0;
+            if (len >= capacity) return;
+            n = snprintf(out + len, capacity - len, format, value...);
+            len += n > 0 ? n : 0;
+        };
+
+        if (plantId != -1) append("plant_id", "%d", plantId);
+        if (sequence > 0) append("seq", "%lu", (unsigned long)sequence);
+        int plantProbe = 0;
+        forEachChannel([&](auto id) {
+            constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+            float value = values[channelSlot(spec.id)];
+            if constexpr (spec.probe > 0) {
+                if (!(probeMask & (1u << (spec.probe - 1)))) return;
+                char key[24];
+                snprintf(key, sizeof(key), "%s%d", spec.wireKey, ++plantProbe);
+                if (!isnan(value)) append(key, "%.*f", (int)spec.decimals, value);
+            } else {
+                if (!isnan(value)) append(spec.wireKey, "%.*f", (int)spec.decimals, value);
+            }
+        });
+        if (timestamp > 0) {
+            // Backend expects ISO-8601 UTC without a zone suffix
+            time_t secs = timestamp;
+            struct tm timeInfo;
+            gmtime_r(&secs, &timeInfo);
+            char iso[20];
+            strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%S", &timeInfo);
+            append("time_stamp", "\"%s\"", (const char*)iso);
+        }
+
+        if (len + 2 > capacity) return 0;
+        out[len++] = '}';
+        out[len] = '\0';
+        return len;
+    }
+
+    String toJson() const {
+        char json[SENSOR_JSON_MAX];
+        if (writeJson(json, sizeof(json)) == 0) {
+            return String("{}");
+        }
+        return String(json);
     }
 };
 
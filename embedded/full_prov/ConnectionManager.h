@@ -0,0 +1,350 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <WiFi.h>
+#include <esp_sleep.h>
+#include <esp_random.h>
+#include <vector>
+#include <functional>
+#include "Config.h"
+#include "UploadProfiler.h"
+
+// ==========================================
+// Fast reconnect cache
+// ==========================================
+#define WIFI_CACHE_MAGIC 0x57434332  // "WCC2"
+#define WIFI_CLOCK_VALID 1600000000  // Unix seconds below which the clock hasn't been set
+
+// Last good association and lease. Laid out without padding so it can be compared with memcmp.
+struct WiFiConnectionCache {
+  uint32_t magic;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t leasedAt;  // Unix seconds DHCP last granted the lease, 0 if the clock wasn't set
+};
+
+// RTC copy survives deep sleep, the NVS copy survives power loss
+RTC_DATA_ATTR WiFiConnectionCache rtcWiFiCache;
+
+// Past begin() in setup, only the network task, which runs the manager, touches the cache and this handle
+Preferences wifiCachePreferences;
+
+bool isWiFiCacheValid(const WiFiConnectionCache& cache) {
+  return cache.magic == WIFI_CACHE_MAGIC && cache.channel > 0 && cache.ip != 0;
+}
+
+bool loadWiFiCache(WiFiConnectionCache& cache) {
+  if (isWiFiCacheValid(rtcWiFiCache)) {
+    cache = rtcWiFiCache;
+    return true;
+  }
+
+  wifiCachePreferences.begin("device_prefs", true);
+  size_t len = wifiCachePreferences.getBytes("wifi_cache", &cache, sizeof(cache));
+  wifiCachePreferences.end();
+
+  if (len == sizeof(cache) && isWiFiCacheValid(cache)) {
+    rtcWiFiCache = cache;
+    return true;
+  }
+  return false;
+}
+
+void clearWiFiCache() {
+  memset(&rtcWiFiCache, 0, sizeof(rtcWiFiCache));
+  wifiCachePreferences.begin("device_prefs", false);
+  wifiCachePreferences.remove("wifi_cache");
+  wifiCachePreferences.end();
+}
+
+// The router may give the address to another client once the lease runs out, so a cached lease
+// is only reused as a static config while it is young and the clock says how young
+bool isWiFiLeaseFresh(const WiFiConnectionCache& cache) {
+  time_t now = time(nullptr);
+  return cache.leasedAt >= WIFI_CLOCK_VALID && now >= (time_t)cache.leasedAt &&
+         now - (time_t)cache.leasedAt < WIFI_STATIC_IP_MAX_AGE;
+}
+
+// Snapshot the current association. Only touches NVS when something changed. leaseRenewed is
+// false when the address came from the cache instead of DHCP, which keeps the lease's age.
+void saveWiFiCache(bool leaseRenewed) {
+  if (WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+
+  WiFiConnectionCache cache = {};
+  cache.magic = WIFI_CACHE_MAGIC;
+  cache.ip = (uint32_t)WiFi.localIP();
+  cache.gateway = (uint32_t)WiFi.gatewayIP();
+  cache.subnet = (uint32_t)WiFi.subnetMask();
+  cache.dns = (uint32_t)WiFi.dnsIP(0);
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = (uint8_t)WiFi.channel();
+  time_t now = time(nullptr);
+  if (!leaseRenewed) {
+    cache.leasedAt = rtcWiFiCache.leasedAt;
+  } else if (now >= WIFI_CLOCK_VALID) {
+    cache.leasedAt = (uint32_t)now;
+  }
+
+  if (memcmp(&cache, &rtcWiFiCache, sizeof(cache)) == 0) {
+    return;
+  }
+
+  rtcWiFiCache = cache;
+  wifiCachePreferences.begin("device_prefs", false);
+  wifiCachePreferences.putBytes("wifi_cache", &cache, sizeof(cache));
+  wifiCachePreferences.end();
+  Serial.printf("WiFi cache updated: channel %d, IP %s\n", cache.channel, WiFi.localIP().toString().c_str());
+}
+
+// ==========================================
+// Connection manager
+// ==========================================
+enum class LinkState {
+  IDLE,
+  CONNECTING_FAST,   // Targeted connect on the cached BSSID/channel
+  CONNECTING_SCAN,   // Full scan + DHCP
+  CONNECTED,
+  BACKOFF
+};
+
+// Owns the station link. WiFi events only set flags; all transitions, NVS writes and
+// subscriber callbacks happen in run(), on the network task, so listeners may do blocking work.
+class ConnectionManager {
+public:
+  typedef std::function<void(bool connected)> Listener;
+
+  ConnectionManager()
+    : state(LinkState::IDLE), enterprise(false), attempt(0), stateSince(0), backoffDelay(0),
+      connectStart(0), connectedAt(0), usedFastPath(false), usedStaticIp(false), firstUploadReported(false),
+      gotIpFlag(false), disconnectedFlag(false), disconnectReason(0) {}
+
+  // Starts connecting. For enterprise networks the station must already be configured
+  // by setupEnterpriseWiFi(); retries then use WiFi.reconnect().
+  void begin(const String& wifiSsid, const String& wifiPassword, bool isEnterprise = false) {
+    ssid = wifiSsid;
+    password = wifiPassword;
+    enterprise = isEnterprise;
+    attempt = 0;
+    connectStart = millis();
+
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);  // Reconnects are paced by our backoff instead
+    WiFi.onEvent(handleEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(handleEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+
+    if (enterprise) {
+      setState(LinkState::CONNECTING_SCAN);  // setupEnterpriseWiFi() already called WiFi.begin()
+      return;
+    }
+    startAttempt(WIFI_FAST_RECONNECT);
+  }
+
+  // Listeners are called on the network task on every link up/down transition
+  void subscribe(Listener listener) {
+    listeners.push_back(listener);
+  }
+
+  bool isConnected() const {
+    return state == LinkState::CONNECTED;
+  }
+
+  LinkState getState() const {
+    return state;
+  }
+
+  void run() {
+    if (disconnectedFlag) {
+      disconnectedFlag = false;
+      handleDisconnect();
+    }
+
+    if (gotIpFlag) {
+      gotIpFlag = false;
+      handleConnected();
+    }
+
+    unsigned long elapsed = millis() - stateSince;
+    switch (state) {
+      case LinkState::CONNECTING_FAST:
+        if (elapsed >= WIFI_FAST_CONNECT_TIMEOUT) {
+          Serial.println("Fast reconnect timed out, falling back to full scan");
+          clearWiFiCache();
+          WiFi.disconnect();
+          startAttempt(false);
+        }
+        break;
+      case LinkState::CONNECTING_SCAN:
+        if (elapsed >= WIFI_CONNECT_TIMEOUT) {
+          Serial.println("WiFi connect timed out");
+          WiFi.disconnect();
+          enterBackoff();
+        }
+        break;
+      case LinkState::BACKOFF:
+        if (elapsed >= backoffDelay) {
+          startAttempt(false);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Logs boot/wake to first successful upload once per boot
+  void reportFirstUpload() {
+    if (firstUploadReported) {
+      return;
+    }
+    firstUploadReported = true;
+
+    bool woke = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED;
+    Serial.printf("Time to first upload: %lu ms after %s (WiFi up at %lu ms via %s)\n",
+                  millis(), woke ? "wake" : "boot", connectedAt,
+                  usedFastPath ? "cached BSSID/channel" : "full scan");
+  }
+
+private:
+  LinkState state;
+  String ssid;
+  String password;
+  bool enterprise;
+  uint8_t attempt;
+  unsigned long stateSince;
+  unsigned long backoffDelay;
+  unsigned long connectStart;
+  unsigned long connectedAt;
+  bool usedFastPath;
+  bool usedStaticIp;
+  bool firstUploadReported;
+  std::vector<Listener> listeners;
+
+  // Written from the WiFi event task
+  volatile bool gotIpFlag;
+  volatile bool disconnectedFlag;
+  volatile uint8_t disconnectReason;
+
+  static void handleEvent(WiFiEvent_t event, WiFiEventInfo_t info);
+
+  void setState(LinkState newState) {
+    state = newState;
+    stateSince = millis();
+  }
+
+  void startAttempt(bool tryFast) {
+    WiFiConnectionCache cache;
+    if (tryFast && loadWiFiCache(cache)) {
+      Serial.printf("Fast reconnect: channel %d, BSSID %02X:%02X:%02X:%02X:%02X:%02X\n", cache.channel,
+                    cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5]);
+      usedFastPath = true;
+      setState(LinkState::CONNECTING_FAST);
+
+      usedStaticIp = WIFI_FAST_RECONNECT_STATIC_IP && isWiFiLeaseFresh(cache);
+      if (usedStaticIp) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+      } else {
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // DHCP
+      }
+      WiFi.begin(ssid.c_str(), password.c_str(), cache.channel, cache.bssid);
+      return;
+    }
+
+    usedFastPath = false;
+    usedStaticIp = false;
+    setState(LinkState::CONNECTING_SCAN);
+    Serial.printf("WiFi connect attempt %d (full scan)\n", attempt + 1);
+
+    if (enterprise) {
+      WiFi.reconnect();
+    } else {
+      WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // DHCP
+      WiFi.begin(ssid.c_str(), password.c_str());
+    }
+  }
+
+  // Jittered exponential backoff: a random delay in [d/2, d] with d = base * 2^attempt, capped
+  void enterBackoff() {
+    unsigned long ceiling = WIFI_BACKOFF_BASE << (attempt < 16 ? attempt : 16);
+    if (ceiling > WIFI_BACKOFF_MAX || ceiling < WIFI_BACKOFF_BASE) {
+      ceiling = WIFI_BACKOFF_MAX;
+    }
+    backoffDelay = ceiling / 2 + esp_random() % (ceiling / 2 + 1);
+    if (attempt < 255) {
+      attempt++;
+    }
+
+    Serial.printf("WiFi backing off for %lu ms\n", backoffDelay);
+    setState(LinkState::BACKOFF);
+  }
+
+  void handleConnected() {
+    bool wasConnected = isConnected();
+    connectedAt = millis();
+    attempt = 0;
+    setState(LinkState::CONNECTED);
+
+    Serial.printf("WiFi up in %lu ms (%s), IP %s\n", connectedAt - connectStart,
+                  usedFastPath ? "cached BSSID/channel" : "full scan", WiFi.localIP().toString().c_str());
+    uploadProfiler.record(UPLOAD_PHASE_WIFI, (connectedAt - connectStart) * 1000);
+    if (!enterprise) {
+      saveWiFiCache(!usedStaticIp);
+    }
+
+    if (!wasConnected) {
+      notify(true);
+    }
+  }
+
+  void handleDisconnect() {
+    bool wasConnected = isConnected();
+    if (!wasConnected && disconnectReason == WIFI_REASON_ASSOC_LEAVE) {
+      return;  // Our own WiFi.disconnect() while switching attempts
+    }
+    Serial.printf("WiFi disconnected, reason %d\n", disconnectReason);
+
+    if (state == LinkState::CONNECTING_FAST) {
+      // The cached AP is gone or rejected us; go straight to a full scan
+      clearWiFiCache();
+      startAttempt(false);
+    } else if (state != LinkState::BACKOFF) {
+      if (wasConnected) {
+        connectStart = millis();
+      }
+      enterBackoff();
+    }
+
+    if (wasConnected) {
+      notify(false);
+    }
+  }
+
+  void notify(bool connected) {
+    for (Listener& listener : listeners) {
+      listener(connected);
+    }
+  }
+};
+
+ConnectionManager connectionManager;
+
+void ConnectionManager::handleEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      connectionManager.gotIpFlag = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      connectionManager.disconnectReason = info.wifi_sta_disconnected.reason;
+      connectionManager.disconnectedFlag = true;
+      break;
+    default:
+      break;
+  }
+}
+
+#endif // CONNECTIONMANAGER_H
@@ -0,0 +1,224 @@
+#include "DeltaPatch.h"
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DeltaPatch::DeltaPatch(ReadOld readOld, WriteNew writeNew, CheckHeader checkHeader, void *context)
+    : readOld(readOld), writeNew(writeNew), checkHeader(checkHeader), context(context), state(HEADER),
+      failure(nullptr), head(), headerLength(0), varint(0), varintShift(0), diffLeft(0), extraLeft(0), seek(0),
+      runLeft(0), oldPos(0), newPos(0) {}
+
+bool DeltaPatch::fail(const char *reason) {
+  state = FAILED;
+  failure = reason;
+  return false;
+}
+
+// Adds one byte of a varint; true once it is complete, in varint
+bool DeltaPatch::takeVarint(uint8_t byte) {
+  if (varintShift == 0) {
+    varint = 0;
+  }
+  varint |= (uint64_t)(byte & 0x7F) << varintShift;
+  varintShift += 7;
+  if (byte & 0x80) {
+    if (varintShift > 35) {
+      fail("varint too long");
+    }
+    return false;
+  }
+  varintShift = 0;
+  return true;
+}
+
+bool DeltaPatch::parseHeader() {
+  if (memcmp(headerBytes, DELTA_MAGIC, 4) != 0) {
+    return fail("not a delta patch");
+  }
+  head.oldSize = readLe32(headerBytes + 4);
+  head.newSize = readLe32(headerBytes + 8);
+  memcpy(head.oldSha256, headerBytes + 12, 32);
+  memcpy(head.newSha256, headerBytes + 44, 32);
+  if (checkHeader && !checkHeader(context, head)) {
+    return fail("patch is for another image");
+  }
+  state = head.newSize == 0 ? DONE : DIFF_LENGTH;
+  return true;
+}
+
+bool DeltaPatch::copyUnchanged(uint32_t length) {
+  if (length > diffLeft || (uint64_t)oldPos + length > head.oldSize || newPos + length > head.newSize) {
+    return fail("unchanged run out of range");
+  }
+  diffLeft -= length;
+  while (length > 0) {
+    size_t n = length < sizeof(chunk) ? length : sizeof(chunk);
+    if (!readOld(context, oldPos, chunk, n)) {
+      return fail("reading the old image failed");
+    }
+    if (!writeNew(context, chunk, n)) {
+      return fail("writing the new image failed");
+    }
+    oldPos += n;
+    newPos += n;
+    length -= n;
+  }
+  return true;
+}
+
+// After an unchanged count and a changed count, or at the start of a diff
+bool DeltaPatch::nextRun() {
+  if (diffLeft == 0) {
+    return endDiff();
+  }
+  state = UNCHANGED_LENGTH;
+  return true;
+}
+
+bool DeltaPatch::endDiff() {
+  if (extraLeft > 0) {
+    state = EXTRA;
+    return true;
+  }
+  return endCommand();
+}
+
+bool DeltaPatch::endCommand() {
+  int64_t moved = (int64_t)oldPos + seek;
+  if (moved < 0 || moved > head.oldSize) {
+    return fail("seek out of range");
+  }
+  oldPos = (uint32_t)moved;
+  state = newPos == head.newSize ? DONE : DIFF_LENGTH;
+  return true;
+}
+
+bool DeltaPatch::feed(const uint8_t *data, size_t length) {
+  size_t i = 0;
+  while (i < length) {
+    switch (state) {
+      case HEADER: {
+        size_t n = DELTA_HEADER_BYTES - headerLength;
+        if (n > length - i) {
+          n = length - i;
+        }
+        memcpy(headerBytes + headerLength, data + i, n);
+        headerLength += n;
+        i += n;
+        if (headerLength == DELTA_HEADER_BYTES && !parseHeader()) {
+          return false;
+        }
+        break;
+      }
+
+      case DIFF_LENGTH:
+        if (takeVarint(data[i++])) {
+          diffLeft = (uint32_t)varint;
+          state = EXTRA_LENGTH;
+        }
+        break;
+
+      case EXTRA_LENGTH:
+        if (takeVarint(data[i++])) {
+          extraLeft = (uint32_t)varint;
+          if ((uint64_t)newPos + diffLeft + extraLeft > head.newSize) {
+            return fail("command runs past the new image");
+          }
+          state = SEEK;
+        }
+        break;
+
+      case SEEK:
+        if (takeVarint(data[i++])) {
+          seek = (int64_t)(varint >> 1) ^ -(int64_t)(varint & 1);
+          if (!nextRun()) {
+            return false;
+          }
+        }
+        break;
+
+      case UNCHANGED_LENGTH:
+        if (takeVarint(data[i++])) {
+          if (varint > diffLeft) {
+            return fail("unchanged run out of range");
+          }
+          if (!copyUnchanged((uint32_t)varint)) {
+            return false;
+          }
+          state = CHANGED_LENGTH;
+        }
+        break;
+
+      case CHANGED_LENGTH:
+        if (takeVarint(data[i++])) {
+          if (varint > diffLeft || (uint64_t)oldPos + varint > head.oldSize) {
+            return fail("changed run out of range");
+          }
+          runLeft = (uint32_t)varint;
+          diffLeft -= runLeft;
+          if (runLeft > 0) {
+            state = CHANGED;
+          } else if (!nextRun()) {
+            return false;
+          }
+        }
+        break;
+
+      case CHANGED: {
+        size_t n = runLeft;
+        if (n > length - i) {
+          n = length - i;
+        }
+        if (n > sizeof(chunk)) {
+          n = sizeof(chunk);
+        }
+        if (!readOld(context, oldPos, chunk, n)) {
+          return fail("reading the old image failed");
+        }
+        for (size_t k = 0; k < n; k++) {
+          chunk[k] += data[i + k];
+        }
+        if (!writeNew(context, chunk, n)) {
+          return fail("writing the new image failed");
+        }
+        i += n;
+        oldPos += n;
+        newPos += n;
+        runLeft -= n;
+        if (runLeft == 0 && !nextRun()) {
+          return false;
+        }
+        break;
+      }
+
+      case EXTRA: {
+        size_t n = extraLeft;
+        if (n > length - i) {
+          n = length - i;
+        }
+        if (!writeNew(context, data + i, n)) {
+          return fail("writing the new image failed");
+        }
+        i += n;
+        newPos += n;
+        extraLeft -= n;
+        if (extraLeft == 0 && !endCommand()) {
+          return false;
+        }
+        break;
+      }
+
+      case DONE:
+        return fail("data after the end of the patch");
+
+      case FAILED:
+        return false;
+    }
+    if (state == FAILED) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+#ifndef DELTAPATCH_H
+#define DELTAPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary delta between two firmware images, after bsdiff. A patch is a header, then commands
+// that each copy a stretch of the old image with a few bytes changed (diff), append bytes that
+// have no counterpart in the old image (extra), then move the read position in the old image
+// (seek). When code moves, most of the words it touches still match, and relocated addresses
+// differ from the old ones by a small constant. The diff encodes only the bytes that changed,
+// as runs, so a patch costs about the changed bytes plus run lengths. host/ota_delta writes
+// patches.
+//
+// Header (76 B): "PGD1", old size, new size (uint32 LE), SHA-256 of the old image, SHA-256 of
+// the new image. Each command: varint diff length, varint extra length, zigzag varint seek.
+// The diff is runs of varint unchanged count, varint changed count, then the changed bytes as
+// (new - old) mod 256. The extra is its bytes as is.
+//
+// DeltaPatch applies a patch as it streams in: the patch arrives in pieces of any size through
+// feed(), old bytes are read through readOld, and the new image goes out in order through
+// writeNew, so neither image is ever held in RAM. No I/O happens here, so the firmware
+// (OtaUpdater.h) and the host tools share this code.
+#define DELTA_MAGIC "PGD1"
+#define DELTA_HEADER_BYTES 76
+
+struct DeltaHeader {
+  uint32_t oldSize;
+  uint32_t newSize;
+  uint8_t oldSha256[32];
+  uint8_t newSha256[32];
+};
+
+class DeltaPatch {
+public:
+  typedef bool (*ReadOld)(void *context, uint32_t offset, uint8_t *out, size_t length);
+  typedef bool (*WriteNew)(void *context, const uint8_t *data, size_t length);
+  // Called once with the header, before anything is read or written; false refuses the patch
+  typedef bool (*CheckHeader)(void *context, const DeltaHeader &header);
+
+  DeltaPatch(ReadOld readOld, WriteNew writeNew, CheckHeader checkHeader, void *context);
+
+  // Applies the next piece of the patch. False once the patch is corrupt, refused, or an I/O
+  // callback failed; error() says which.
+  bool feed(const uint8_t *data, size_t length);
+
+  // The whole new image has been written
+  bool done() const { return state == DONE; }
+  const char *error() const { return failure; }
+  const DeltaHeader &header() const { return head; }
+  uint32_t written() const { return newPos; }
+
+private:
+  enum State : uint8_t {
+    HEADER,
+    DIFF_LENGTH,
+    EXTRA_LENGTH,
+    SEEK,
+    UNCHANGED_LENGTH,
+    CHANGED_LENGTH,
+    CHANGED,
+    EXTRA,
+    DONE,
+    FAILED
+  };
+
+  ReadOld readOld;
+  WriteNew writeNew;
+  CheckHeader checkHeader;
+  void *context;
+  State state;
+  const char *failure;
+  DeltaHeader head;
+  uint8_t headerBytes[DELTA_HEADER_BYTES];
+  size_t headerLength;
+  uint64_t varint;
+  int varintShift;
+  uint32_t diffLeft;   // Of the current command
+  uint32_t extraLeft;
+  int64_t seek;
+  uint32_t runLeft;    // Of the current changed run
+  uint32_t oldPos;
+  uint32_t newPos;
+  uint8_t chunk[256];
+
+  bool fail(const char *reason);
+  bool takeVarint(uint8_t byte);
+  bool parseHeader();
+  bool copyUnchanged(uint32_t length);
+  bool nextRun();
+  bool endDiff();
+  bool endCommand();
+};
+
+#endif
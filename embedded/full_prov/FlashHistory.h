@@ -0,0 +1,323 @@
+#ifndef FLASHHISTORY_H
+#define FLASHHISTORY_H
+
+#include <esp_partition.h>
+#include "Config.h"
+#include "RecordCodec.h"
+
+#define FLASH_SECTOR_BYTES 4096
+#define FLASH_SECTOR_MAGIC 0x31545348  // "HST1"
+#define FLASH_ENTRY_HEADER 4
+#define FLASH_ENTRY_WRITING 0xFFFF     // Erased state: the entry's write may not have finished
+#define FLASH_ENTRY_COMMITTED 0x0000
+
+// Record history in the flash partition labelled FLASH_HISTORY_LABEL (partitions.csv), as a ring
+// of 4 KB sectors holding compressed blocks (RecordCodec.h). The partition is memory mapped once
+// at init(), so every read decodes straight out of flash through the cache: no file handle, no
+// read into a RAM copy. Boot only looks at the sector headers and the entry headers of the newest
+// sector, so it is done in well under a millisecond whatever the history holds.
+//
+// Sector: magic, then the absolute index of its first record, then entries. Entry: little-endian
+// uint16 length, uint16 state, then a block of that length, padded to 4 bytes. An entry is
+// written with its state erased and committed by a second write, so init() skips one that a
+// power cut interrupted. When the ring is full, the oldest sector is erased, and indices keep
+// counting from where they were, so an index names the same record for as long as it is kept.
+//
+// The block being filled stays in RAM until it reaches FLASH_BLOCK_BYTES or flush() is called.
+// Those are the records a power cut loses; until uploaded they are also in the NVS buffer.
+class FlashHistory {
+  private:
+    const esp_partition_t* partition = nullptr;
+    const uint8_t* mapped = nullptr;  // The whole partition
+    esp_partition_mmap_handle_t mapHandle;
+    uint32_t sectors = 0;
+    uint32_t tailSector = 0;   // Oldest sector
+    uint32_t headSector = 0;   // Sector being written
+    uint32_t writeOffset = 0;  // Next entry in headSector
+    int oldest = 0;            // Index of the first record of tailSector
+    int sealedRecords = 0;     // Index past the last record written to flash
+    uint8_t block[FLASH_BLOCK_BYTES];
+    RecordEncoder encoder{block, sizeof(block)};
+    uint32_t hintSector = 0;   // Where the last read started; sequential reads resume from it
+    uint32_t hintOffset = 0;
+    int hintFirst = -1;
+    bool ready = false;
+
+    static uint32_t readWord(const uint8_t* p) {
+      uint32_t value;
+      memcpy(&value, p, sizeof(value));
+      return value;
+    }
+
+    static uint32_t padded(uint32_t length) {
+      return (length + 3) & ~3u;
+    }
+
+    const uint8_t* sectorAt(uint32_t sector) const {
+      return mapped + sector * FLASH_SECTOR_BYTES;
+    }
+
+    bool sectorValid(uint32_t sector) const {
+      return readWord(sectorAt(sector)) == FLASH_SECTOR_MAGIC;
+    }
+
+    int sectorFirst(uint32_t sector) const {
+      return (int)readWord(sectorAt(sector) + 4);
+    }
+
+    // Calls f(block, length) for each committed entry of sector from offset on, stopping early if
+    // f returns false. Returns the offset after the last entry.
+    template <typename F>
+    uint32_t walkSector(uint32_t sector, uint32_t offset, F&& f) const {
+      const uint8_t* base = sectorAt(sector);
+      while (offset + FLASH_ENTRY_HEADER <= FLASH_SECTOR_BYTES) {
+        uint32_t header = readWord(base + offset);
+        uint32_t length = header & 0xFFFF;
+        if (length == 0xFFFF || offset + FLASH_ENTRY_HEADER + length > FLASH_SECTOR_BYTES) {
+          break;  // Erased: the end of the sector's entries
+        }
+        uint32_t next = offset + FLASH_ENTRY_HEADER + padded(length);
+        if ((header >> 16) == FLASH_ENTRY_COMMITTED && !f(base + offset + FLASH_ENTRY_HEADER, length)) {
+          return offset;
+        }
+        offset = next;
+      }
+      return offset;
+    }
+
+    // Erases sector and starts it with records numbered from first
+    bool startSector(uint32_t sector, int first) {
+      if (esp_partition_erase_range(partition, sector * FLASH_SECTOR_BYTES, FLASH_SECTOR_BYTES) != ESP_OK) {
+        return false;
+      }
+      uint32_t header[2] = {FLASH_SECTOR_MAGIC, (uint32_t)first};
+      if (esp_partition_write(partition, sector * FLASH_SECTOR_BYTES, header, sizeof(header)) != ESP_OK) {
+        return false;
+      }
+      headSector = sector;
+      writeOffset = sizeof(header);
+      return true;
+    }
+
+    // Writes the block being filled as one entry, moving to the next sector if it doesn't fit
+    bool writeBlock() {
+      uint32_t length = encoder.size();
+      if (writeOffset + FLASH_ENTRY_HEADER + padded(length) > FLASH_SECTOR_BYTES) {
+        uint32_t next = (headSector + 1) % sectors;
+        if (next == tailSector) {
+          // The ring is full: the oldest sector goes
+          tailSector = (tailSector + 1) % sectors;
+          oldest = sectorFirst(tailSector);
+        }
+        if (!startSector(next, sealedRecords)) {
+          return false;
+        }
+      }
+
+      // esp_flash invalidates the cache over the written range, so the mapping sees the entry at once
+      uint8_t entry[FLASH_ENTRY_HEADER + FLASH_BLOCK_BYTES + 3];
+      uint32_t header = length | (FLASH_ENTRY_WRITING << 16);
+      memcpy(entry, &header, sizeof(header));
+      memcpy(entry + FLASH_ENTRY_HEADER, block, length);
+      memset(entry + FLASH_ENTRY_HEADER + length, 0xFF, padded(length) - length);
+      uint32_t address = headSector * FLASH_SECTOR_BYTES + writeOffset;
+      uint16_t committed = FLASH_ENTRY_COMMITTED;
+      if (esp_partition_write(partition, address, entry, FLASH_ENTRY_HEADER + padded(length)) != ESP_OK ||
+          esp_partition_write(partition, address + 2, &committed, sizeof(committed)) != ESP_OK) {
+        return false;
+      }
+      writeOffset += FLASH_ENTRY_HEADER + padded(length);
+      sealedRecords += encoder.count();
+      encoder = RecordEncoder(block, sizeof(block));
+      return true;
+    }
+
+    // A compressed block as it sits in flash, and the indices of the records it holds
+    struct Span {
+      const uint8_t* data;
+      size_t length;
+      int first;
+      int count;
+    };
+
+    // Calls f(span) for each block holding records from start on, oldest first, until f returns
+    // false. Spans point into flash, or into RAM for the block being filled, and are valid until
+    // the next writeData().
+    template <typename F>
+    void forEachBlock(int start, F&& f) {
+      if (!ready) {
+        return;
+      }
+      uint32_t sector = tailSector;
+      uint32_t offset = 8;
+      int first = oldest;
+      if (hintFirst >= oldest && start >= hintFirst) {
+        sector = hintSector;
+        offset = hintOffset;
+        first = hintFirst;
+      }
+      bool more = true;
+      while (more) {
+        walkSector(sector, offset, [&](const uint8_t* data, uint32_t length) {
+          RecordDecoder decoder(data, length);
+          Span span = {data, length, first, decoder.valid() ? decoder.count() : 0};
+          if (first + span.count > start) {
+            hintSector = sector;
+            hintOffset = data - FLASH_ENTRY_HEADER - sectorAt(sector);
+            hintFirst = first;
+            more = f(span);
+          }
+          first += span.count;
+          return more;
+        });
+        if (!more || sector == headSector) {
+          break;
+        }
+        sector = (sector + 1) % sectors;
+        offset = 8;
+        first = sectorFirst(sector);
+      }
+      if (more && encoder.count() > 0) {
+        f(Span{block, encoder.size(), sealedRecords, encoder.count()});
+      }
+    }
+
+  public:
+    // Maps the partition and finds the newest sector
+    bool init() {
+      partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_HISTORY_LABEL);
+      if (partition == nullptr) {
+        Serial.println("No \"" FLASH_HISTORY_LABEL "\" partition; check partitions.csv");
+        return false;
+      }
+      const void* pointer = nullptr;
+      if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &pointer, &mapHandle) != ESP_OK) {
+        return false;
+      }
+      mapped = (const uint8_t*)pointer;
+      sectors = partition->size / FLASH_SECTOR_BYTES;
+
+      bool found = false;
+      for (uint32_t s = 0; s < sectors; s++) {
+        if (!sectorValid(s)) {
+          continue;
+        }
+        int first = sectorFirst(s);
+        if (!found || first > sectorFirst(headSector)) {
+          headSector = s;
+        }
+        if (!found || first < sectorFirst(tailSector)) {
+          tailSector = s;
+        }
+        found = true;
+      }
+      encoder = RecordEncoder(block, sizeof(block));
+      hintFirst = -1;
+      if (!found) {
+        tailSector = 0;
+        oldest = 0;
+        sealedRecords = 0;
+        ready = startSector(0, 0);
+        return ready;
+      }
+
+      oldest = sectorFirst(tailSector);
+      sealedRecords = sectorFirst(headSector);
+      writeOffset = walkSector(headSector, 8, [&](const uint8_t* data, uint32_t length) {
+        sealedRecords += RecordDecoder(data, length).count();
+        return true;
+      });
+      ready = true;
+      Serial.printf("Flash history: records %d-%d in %u of %u sectors\n", oldest, sealedRecords - 1,
+                    (unsigned)((headSector + sectors - tailSector) % sectors + 1), (unsigned)sectors);
+      return true;
+    }
+
+    // Writes the block being filled to flash; records are durable once this returns true
+    bool flush() {
+      if (!ready || encoder.count() == 0) {
+        return ready;
+      }
+      return writeBlock();
+    }
+
+    bool isSetup() {
+      return ready;
+    }
+
+    // Index past the newest record; indices start at 0 on a fresh partition
+    int getNumRecords() {
+      return sealedRecords + encoder.count();
+    }
+
+    // Index of the oldest record still kept; older ones were erased to make room
+    int oldestRecord() {
+      return oldest;
+    }
+
+    // Appends a single record, writing the block to flash once it is full
+    bool writeData(const SensorData& data) {
+      if (!ready) {
+        return false;
+      }
+      if (!encoder.append(data)) {
+        if (!writeBlock() || !encoder.append(data)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Decodes records [start, end] in place, straight out of the mapping, calling f(index, record)
+    template <typename F>
+    void forEachRecord(int start, int end, F&& f) {
+      forEachBlock(start, [&](const Span& span) {
+        RecordDecoder decoder(span.data, span.length);
+        SensorData record;
+        for (int i = span.first; i <= end && decoder.next(record); i++) {
+          if (i >= start) {
+            f(i, record);
+          }
+        }
+        return span.first + span.count <= end;
+      });
+    }
+
+    // Copies up to maxRecords records from index start on into out; returns how many were copied
+    int readRecords(int start, SensorData* out, int maxRecords) {
+      int end = getNumRecords() - 1;
+      if (start < oldest || start > end || maxRecords <= 0) {
+        return 0;
+      }
+      if (end - start + 1 > maxRecords) {
+        end = start + maxRecords - 1;
+      }
+      int copied = 0;
+      forEachRecord(start, end, [&](int i, const SensorData& record) {
+        out[i - start] = record;
+        copied++;
+      });
+      return copied;
+    }
+
+    bool readSingleData(int index, SensorData& data) {
+      return readRecords(index, &data, 1) == 1;
+    }
+
+    // Erases the whole partition
+    bool clearData() {
+      if (partition == nullptr || esp_partition_erase_range(partition, 0, partition->size) != ESP_OK) {
+        return false;
+      }
+      encoder = RecordEncoder(block, sizeof(block));
+      tailSector = 0;
+      oldest = 0;
+      sealedRecords = 0;
+      hintFirst = -1;
+      return startSector(0, 0);
+    }
+};
+
+FlashHistory flashHistory;
+
+#endif
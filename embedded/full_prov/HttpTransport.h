@@ -0,0 +1,229 @@
+#ifndef HTTPTRANSPORT_H
+#define HTTPTRANSPORT_H
+
+#include <WiFi.h>
+#include "Config.h"
+#include "Intervals.h"
+#include "UploadTransport.h"
+#include "UploadBatch.h"
+#include "UploadProfiler.h"
+#include "TlsClient.h"
+
+// Batches POSTed to /api/sensorUpload as HTTP/1.1 requests written back to back on one kept-alive
+// connection, with the responses read in order (RFC 9112 pipelining). HTTPClient waits for each
+// response before the next request can go out, which caps a backlog drain at one batch per round
+// trip. An https:// URL runs the same requests through TlsClient, which resumes the cached TLS
+// session whenever the connection has to be opened again.
+class HttpTransport : public UploadTransport {
+private:
+  WiFiClient client;
+  TlsClient tls;
+  String url;
+  String host;
+  uint16_t port = 80;
+  String path;
+  bool secure = false;
+  unsigned long lastActive = 0;  // millis() of the last response, or of connecting
+
+  bool connected() {
+    return secure ? tls.connected() : client.connected();
+  }
+
+  int available() {
+    return secure ? tls.available() : client.available();
+  }
+
+  // Only called once available() said there is a byte
+  char readByte() {
+    if (secure) {
+      return tls.read();  // TlsClient counts the bytes on the wire
+    }
+    received++;
+    return client.read();
+  }
+
+  bool writeAll(const uint8_t* data, size_t length) {
+    if (secure) {
+      return tls.write(data, length) == length;
+    }
+    if (client.write(data, length) != length) {
+      return false;
+    }
+    sent += length;
+    return true;
+  }
+
+  // Reads one CRLF-terminated line, without the line break
+  bool readLine(String& line, unsigned long deadline) {
+    line = "";
+    while ((long)(deadline - millis()) > 0) {
+      if (!available()) {
+        if (!connected()) {
+          return false;
+        }
+        delay(1);
+        continue;
+      }
+      char c = readByte();
+      if (c == '\n') {
+        if (line.endsWith("\r")) {
+          line.remove(line.length() - 1);
+        }
+        return true;
+      }
+      line += c;
+    }
+    return false;
+  }
+
+  bool readResponse(int& status, String& body, unsigned long timeoutMs) {
+    unsigned long deadline = millis() + timeoutMs;
+    String line;
+    if (!readLine(line, deadline) || !line.startsWith("HTTP/1.")) {
+      return false;
+    }
+    status = line.substring(9, 12).toInt();
+
+    long contentLength = -1;
+    bool closing = false;
+    while (readLine(line, deadline)) {
+      if (line.length() == 0) {
+        break;
+      }
+      int colon = line.indexOf(':');
+      if (colon < 0) {
+        continue;
+      }
+      String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      name.toLowerCase();
+      value.trim();
+      if (name == "content-length") {
+        contentLength = value.toInt();
+      } else if (name == "connection" && value.equalsIgnoreCase("close")) {
+        closing = true;
+      } else if (name == "transfer-encoding" && !value.equalsIgnoreCase("identity")) {
+        return false;  // The backend always sends a length for its short replies
+      }
+    }
+    if (line.length() != 0) {
+      return false;
+    }
+
+    body = "";
+    while ((contentLength < 0 || (long)body.length() < contentLength) && (long)(deadline - millis()) > 0) {
+      if (!available()) {
+        if (!connected()) {
+          break;
+        }
+        delay(1);
+        continue;
+      }
+      body += readByte();
+    }
+    if (contentLength >= 0 && (long)body.length() < contentLength) {
+      return false;
+    }
+    if (closing) {
+      stop();
+    }
+    lastActive = millis();
+    return true;
+  }
+
+public:
+  explicit HttpTransport(const char* url) : tls(client, sent, received), url(url) {}
+
+  const char* name() const override {
+    return "http";
+  }
+
+  // Splits http[s]://host[:port]/path and connects. A connection idle for longer than the
+  // backend keeps it is reopened: a socket the server has closed can still look connected here,
+  // and the first batch written to it would be lost.
+  bool begin(const char* deviceId) override {
+    if (connected()) {
+      if (millis() - lastActive < UPLOAD_KEEP_ALIVE_MS) {
+        return true;
+      }
+      stop();
+    }
+    secure = url.startsWith("https://");
+    if (!secure && !url.startsWith("http://")) {
+      Serial.println("Pipelined uploads need an http:// or https:// URL");
+      return false;
+    }
+    int hostStart = secure ? 8 : 7;
+    int pathStart = url.indexOf('/', hostStart);
+    String authority = pathStart < 0 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+    path = pathStart < 0 ? String("/") : url.substring(pathStart);
+    int colon = authority.indexOf(':');
+    host = colon < 0 ? authority : authority.substring(0, colon);
+    port = colon < 0 ? (secure ? 443 : 80) : authority.substring(colon + 1).toInt();
+
+    IPAddress address;
+    unsigned long startUs = micros();
+    if (!WiFi.hostByName(host.c_str(), address)) {
+      Serial.println("Failed to resolve " + host);
+      return false;
+    }
+    uploadProfiler.record(UPLOAD_PHASE_DNS, micros() - startUs);
+    startUs = micros();
+    if (!client.connect(address, port)) {
+      Serial.println("Failed to connect to " + host + ":" + String(port));
+      return false;
+    }
+    uploadProfiler.record(UPLOAD_PHASE_CONNECT, micros() - startUs);
+    client.setNoDelay(true);
+
+    if (secure) {
+      if (!tls.handshake(host.c_str(), UPLOAD_RESPONSE_TIMEOUT)) {
+        client.stop();
+        return false;
+      }
+      uploadProfiler.recordTls(tls.handshakeUs(), tls.resumed());
+    }
+    lastActive = millis();
+    return true;
+  }
+
+  bool send(const char* payload, size_t length) override {
+    char header[192];
+    int headerLength = snprintf(header, sizeof(header),
+                                "POST %s HTTP/1.1\r\nHost: %s:%u\r\nConnection: keep-alive\r\n"
+                                "Content-Type: application/json\r\nContent-Length: %u\r\n\r\n",
+                                path.c_str(), host.c_str(), (unsigned)port, (unsigned)length);
+    if (headerLength <= 0 || (size_t)headerLength >= sizeof(header)) {
+      return false;
+    }
+    return writeAll((const uint8_t*)header, headerLength) && writeAll((const uint8_t*)payload, length);
+  }
+
+  // A 200 is accepted, with the backend's {"ack":N} if it sent one, and any intervals it set
+  bool receive(UploadReply& reply, unsigned long timeoutMs) override {
+    int status = 0;
+    String body;
+    if (!readResponse(status, body, timeoutMs)) {
+      return false;
+    }
+    if (status != 200) {
+      Serial.printf("Upload refused: HTTP %d %s\n", status, body.c_str());
+    }
+    reply.accepted = status == 200;
+    reply.hasAck = reply.accepted && parseAck(body.c_str(), reply.ack);
+    if (reply.accepted) {
+      intervals.applyResponse(body.c_str());
+    }
+    return true;
+  }
+
+  void stop() override {
+    if (secure) {
+      tls.stop();
+    } else {
+      client.stop();
+    }
+  }
+};
+
+#endif // HTTPTRANSPORT_H
@@ -0,0 +1,182 @@
+#include "Intervals.h"
+#include <stdlib.h>
+#include <string.h>
+
+Intervals intervals;
+
+// Used by load() in setup, then only by changes, which hold Intervals::lock
+static Preferences intervalPreferences;
+
+static const uint32_t intervalMin[INTERVAL_COUNT] = {INTERVAL_SAMPLE_MIN, INTERVAL_RECORD_MIN, INTERVAL_UPLOAD_MIN,
+                                                     INTERVAL_BT_MIN};
+static const uint32_t intervalMax[INTERVAL_COUNT] = {INTERVAL_SAMPLE_MAX, INTERVAL_RECORD_MAX, INTERVAL_UPLOAD_MAX,
+                                                     INTERVAL_BT_MAX};
+
+Intervals::Intervals() {
+  ms[INTERVAL_SAMPLE] = SENSOR_UPDATE_INTERVAL;
+  ms[INTERVAL_RECORD] = SENSOR_RECORD_INTERVAL;
+  ms[INTERVAL_UPLOAD] = WIFI_UPDATE_INTERVAL;
+  ms[INTERVAL_BT] = BT_UPDATE_INTERVAL;
+}
+
+const char* Intervals::name(IntervalId id) {
+  static const char* const names[INTERVAL_COUNT] = {"sample", "record", "upload", "bt"};
+  return names[id];
+}
+
+bool Intervals::valid(const uint32_t* values) {
+  for (int i = 0; i < INTERVAL_COUNT; i++) {
+    if (values[i] < intervalMin[i] || values[i] > intervalMax[i]) {
+      return false;
+    }
+  }
+  // A record averages at least one sample
+  return values[INTERVAL_SAMPLE] <= values[INTERVAL_RECORD];
+}
+
+void Intervals::copy(uint32_t* values) const {
+  for (int i = 0; i < INTERVAL_COUNT; i++) {
+    values[i] = ms[i].load();
+  }
+}
+
+bool Intervals::update(const uint32_t* values) {
+  if (!valid(values)) {
+    return false;
+  }
+  uint32_t current[INTERVAL_COUNT];
+  copy(current);
+  if (memcmp(values, current, sizeof(current)) == 0) {
+    return true;
+  }
+  for (int i = 0; i < INTERVAL_COUNT; i++) {
+    ms[i].store(values[i]);
+  }
+  save();
+  for (auto& listener : listeners) {
+    listener();
+  }
+  return true;
+}
+
+bool Intervals::set(IntervalId id, uint32_t value) {
+  std::lock_guard<std::mutex> guard(lock);
+  uint32_t values[INTERVAL_COUNT];
+  copy(values);
+  values[id] = value;
+  return update(values);
+}
+
+bool Intervals::assign(const String& text) {
+  std::lock_guard<std::mutex> guard(lock);
+  uint32_t values[INTERVAL_COUNT];
+  copy(values);
+  int from = 0;
+  while (from <= (int)text.length()) {
+    int comma = text.indexOf(',', from);
+    String field = comma < 0 ? text.substring(from) : text.substring(from, comma);
+    int equals = field.indexOf('=');
+    if (equals < 0) {
+      return false;
+    }
+    String key = field.substring(0, equals);
+    String value = field.substring(equals + 1);
+    key.trim();
+    value.trim();
+    int id = 0;
+    while (id < INTERVAL_COUNT && key != name((IntervalId)id)) {
+      id++;
+    }
+    if (id == INTERVAL_COUNT || value.isEmpty() || value[0] < '0' || value[0] > '9') {
+      return false;
+    }
+    values[id] = strtoul(value.c_str(), nullptr, 10);
+    if (comma < 0) {
+      break;
+    }
+    from = comma + 1;
+  }
+  return update(values);
+}
+
+bool Intervals::applyResponse(const char* response) {
+  const char* object = strstr(response, "\"intervals\"");
+  if (object == nullptr || (object = strchr(object, '{')) == nullptr) {
+    return false;
+  }
+  const char* end = strchr(object, '}');
+  if (end == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  uint32_t values[INTERVAL_COUNT];
+  uint32_t current[INTERVAL_COUNT];
+  copy(values);
+  copy(current);
+  bool found = false;
+  for (int id = 0; id < INTERVAL_COUNT; id++) {
+    char key[16];
+    snprintf(key, sizeof(key), "\"%s\"", name((IntervalId)id));
+    const char* at = strstr(object, key);
+    if (at == nullptr || at > end) {
+      continue;
+    }
+    at += strlen(key);
+    while (*at == ' ' || *at == ':') {
+      at++;
+    }
+    if (*at < '0' || *at > '9') {
+      return false;
+    }
+    values[id] = strtoul(at, nullptr, 10);
+    found = true;
+  }
+  if (!found || memcmp(values, current, sizeof(current)) == 0) {
+    return false;
+  }
+  if (!update(values)) {
+    Serial.println("Rejected intervals from the upload response");
+    return false;
+  }
+  Serial.printf("Intervals set by the backend: %s\n", toString().c_str());
+  return true;
+}
+
+String Intervals::toString() const {
+  String out;
+  for (int id = 0; id < INTERVAL_COUNT; id++) {
+    if (id > 0) {
+      out += ",";
+    }
+    out += name((IntervalId)id);
+    out += "=";
+    out += String((unsigned long)ms[id].load());
+  }
+  return out;
+}
+
+void Intervals::subscribe(std::function<void()> listener) {
+  listeners.push_back(listener);
+}
+
+void Intervals::load() {
+  uint32_t values[INTERVAL_COUNT];
+  intervalPreferences.begin("device_prefs", true);
+  size_t stored = intervalPreferences.getBytes("intervals", values, sizeof(values));
+  intervalPreferences.end();
+
+  // A build that moved the bounds keeps its defaults rather than an interval it no longer allows
+  if (stored == sizeof(values) && valid(values)) {
+    for (int i = 0; i < INTERVAL_COUNT; i++) {
+      ms[i].store(values[i]);
+    }
+  }
+}
+
+void Intervals::save() const {
+  uint32_t values[INTERVAL_COUNT];
+  copy(values);
+  intervalPreferences.begin("device_prefs", false);
+  intervalPreferences.putBytes("intervals", values, sizeof(values));
+  intervalPreferences.end();
+}
@@ -0,0 +1,62 @@
+#ifndef INTERVALS_H
+#define INTERVALS_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Config.h"
+
+// Task periods that can change at run time, in ms. Written over BLE ("record=60000,upload=300000",
+// or one number on the update period characteristics) or by the backend in an upload response
+// ({"ack":N,"intervals":{"record":60000}}), checked against INTERVAL_*_MIN/MAX, persisted as
+// "intervals" in device_prefs and picked up by the schedulers through subscribe().
+enum IntervalId : uint8_t {
+  INTERVAL_SAMPLE,  // Sensor reads folded into the running averages; 0 reads every loop pass
+  INTERVAL_RECORD,  // Averages recorded to the buffer
+  INTERVAL_UPLOAD,  // Upload task: buffered records, telemetry and the OTA check
+  INTERVAL_BT,      // BLE sensor notifications
+  INTERVAL_COUNT
+};
+
+struct Intervals {
+  std::atomic<uint32_t> ms[INTERVAL_COUNT];  // Read from any task without the lock
+
+  Intervals();
+
+  uint32_t get(IntervalId id) const { return ms[id].load(); }
+
+  // Sets every interval named in "key=ms,key=ms,...". Returns false, changing nothing, if a key
+  // is unknown or a value is out of bounds.
+  bool assign(const String& text);
+
+  // Sets one interval, within bounds
+  bool set(IntervalId id, uint32_t value);
+
+  // Applies an "intervals" object in a backend response, if there is one and it is valid
+  bool applyResponse(const char* response);
+
+  // Formats every interval as "sample=0,record=60000,..."
+  String toString() const;
+
+  static const char* name(IntervalId id);
+
+  // Called after every change, from whichever task made it and with the lock held: only flag the
+  // tasks that use the intervals (Scheduler::replan())
+  void subscribe(std::function<void()> listener);
+
+  void load();
+  void save() const;
+
+private:
+  std::vector<std::function<void()>> listeners;
+  std::mutex lock;  // Changes come from the BLE and network tasks; held through save() and the listeners
+
+  static bool valid(const uint32_t* values);
+  void copy(uint32_t* values) const;
+  bool update(const uint32_t* values);
+};
+
+extern Intervals intervals;
+
+#endif // INTERVALS_H
@@ -1,85 +1,481 @@
 #include "Memory.h"
+#include "RecordCodec.h"
+#if USE_ROLLUPS
+#include "Rollups.h"
+#endif
 
 // Define the global circular buffer instance
 CircularBuffer cb;
 
+// Buffer state is saved from the sampling task; its own handle keeps it off the global
+// preferences object the network task uses. Its own namespace keeps the sequence counter
+// through the reset button, which clears device_prefs: a device that restarted its numbering
+// would have its new records discarded by the backend as duplicates.
+static Preferences bufferPreferences;
+#define BUFFER_NAMESPACE "buffer_state"
+static uint32_t sequenceLease;  // Numbers below this may have been handed out; persisted as "sequenceLease"
+
+static uint32_t headOf(uint32_t front) {
+  return front >> 16;
+}
+
+static uint32_t reservedOf(uint32_t front) {
+  return front & 0xFFFF;
+}
+
+static uint32_t distance(uint32_t from, uint32_t to) {
+  return (to + RING_POSITIONS - from) % RING_POSITIONS;
+}
+
+static uint32_t advance(uint32_t position, uint32_t n) {
+  return (position + n) % RING_POSITIONS;
+}
+
 // Initialize the circular buffer
 void initCircularBuffer(CircularBuffer &cb) {
-  cb.head = 0;
-  cb.tail = 0;
-  cb.count = 0;
-  Serial.println("Circular buffer initialized.");
+  cb.tail.store(0);
+  cb.front.store(0);
+  cb.dropped.store(0);
+  bufferPreferences.begin(BUFFER_NAMESPACE, true);
+  cb.nextSequence = bufferPreferences.getUInt("nextSequence", 1);
+  sequenceLease = bufferPreferences.getUInt("sequenceLease", 0);
+  bufferPreferences.end();
+  if (sequenceLease > cb.nextSequence) {
+    cb.nextSequence = sequenceLease;  // Whatever was numbered after the last save may be on the backend
+  }
+  Serial.printf("Circular buffer initialized. Next sequence: %lu\n", (unsigned long)cb.nextSequence);
+}
+
+int bufferCount(const CircularBuffer &cb) {
+  uint32_t front = cb.front.load(std::memory_order_acquire);
+  return distance(headOf(front), cb.tail.load(std::memory_order_acquire));
 }
 
 // Check if the buffer is full
 bool isFull(const CircularBuffer &cb) {
-  return cb.count == BUFFER_SIZE;
+  return bufferCount(cb) == BUFFER_SIZE;
 }
 
 // Check if the buffer is empty
 bool isEmpty(const CircularBuffer &cb) {
-  return cb.count == 0;
+  return bufferCount(cb) == 0;
+}
+
+struct SlotScales {
+  float scale[STORED_CHANNEL_COUNT];
+  float inverse[STORED_CHANNEL_COUNT];
+};
+
+static constexpr SlotScales makeSlotScales() {
+  SlotScales scales = {};
+  for (size_t slot = 0; slot < STORED_CHANNEL_COUNT; slot++) {
+    scales.scale[slot] = slotScale(slot);
+    scales.inverse[slot] = 1 / slotScale(slot);
+  }
+  return scales;
+}
+
+static constexpr SlotScales SLOT_SCALES = makeSlotScales();
+
+// NAN stores as 0; its bit in the missing mask tells it apart
+static int16_t toFixed(float value, size_t slot) {
+  if (isnan(value)) {
+    return 0;
+  }
+  float scaled = value * SLOT_SCALES.scale[slot];
+  if (scaled > INT16_MAX) scaled = INT16_MAX;
+  if (scaled < -INT16_MAX) scaled = -INT16_MAX;
+  return (int16_t)lroundf(scaled);
+}
+
+static float fromFixed(int16_t value, size_t slot, ChannelMask missing) {
+  return missing & (1u << slot) ? NAN : value * SLOT_SCALES.inverse[slot];
+}
+
+static ChannelMask missingMask(const SensorData &sensorData) {
+  ChannelMask mask = 0;
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    if (isnan(sensorData.values[c])) {
+      mask |= 1u << c;
+    }
+  }
+  return mask;
+}
+
+// Copies one record into slot i
+static void storeRecord(CircularBuffer &cb, int i, const SensorData &sensorData, uint32_t sequence) {
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    cb.columns[c][i] = toFixed(sensorData.values[c], c);
+  }
+  cb.missing[i] = missingMask(sensorData);
+  cb.timestamps[i] = sensorData.timestamp;
+  cb.sequences[i] = sequence;
+}
+
+static void loadRecord(const CircularBuffer &cb, int i, SensorData &sensorData) {
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    sensorData.values[c] = fromFixed(cb.columns[c][i], c, cb.missing[i]);
+  }
+  sensorData.timestamp = cb.timestamps[i];
+  sensorData.sequence = cb.sequences[i];
+}
+
+#if USE_ROLLUPS
+// Producer: the oldest record just left the buffer; its slot is not reused until the caller stores into it
+static void rollUp(const CircularBuffer &cb, uint32_t slot) {
+  int16_t values[STORED_CHANNEL_COUNT];
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    values[c] = cb.columns[c][slot];
+  }
+  rollups.fold(values, cb.missing[slot], cb.timestamps[slot], cb.sequences[slot]);
+}
+#endif
+
+// Producer: frees the slot at tail if the buffer is full. Returns false if the oldest record
+// is reserved by the consumer and can't be overwritten.
+static bool makeRoom(CircularBuffer &cb, uint32_t tail) {
+  uint32_t front = cb.front.load(std::memory_order_acquire);
+  #if USE_ROLLUPS
+  if (distance(headOf(front), tail) < BUFFER_SIZE) {
+    rollups.close();  // Uploads have caught up with the records after it
+  }
+  #endif
+  while (distance(headOf(front), tail) >= BUFFER_SIZE) {
+    if (reservedOf(front) > 0) {
+      return false;
+    }
+    if (cb.front.compare_exchange_weak(front, advance(headOf(front), 1) << 16, std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+      #if USE_ROLLUPS
+      rollUp(cb, headOf(front) % BUFFER_SIZE);
+      #else
+      Serial.println("Buffer is full. Data has been overwritten.");
+      #endif
+      return true;
+    }
+  }
+  return true;
+}
+
+static int storeBack(CircularBuffer &cb, const SensorData &sensorData, uint32_t sequence) {
+  uint32_t tail = cb.tail.load(std::memory_order_relaxed);
+  if (!makeRoom(cb, tail)) {
+    cb.dropped.fetch_add(1, std::memory_order_relaxed);
+    Serial.println("Buffer is full and its front is being uploaded. Record dropped.");
+    return 0;
+  }
+  storeRecord(cb, tail % BUFFER_SIZE, sensorData, sequence);
+  cb.tail.store(advance(tail, 1), std::memory_order_release);
+  return 1;
+}
+
+void reserveSequences(CircularBuffer &cb, int n) {
+  if (cb.nextSequence + n <= sequenceLease) {
+    return;
+  }
+  sequenceLease = cb.nextSequence + n + SEQUENCE_LEASE;
+  bufferPreferences.begin(BUFFER_NAMESPACE, false);
+  bufferPreferences.putUInt("sequenceLease", sequenceLease);
+  bufferPreferences.end();
+}
+
+// Push an element to the back of the buffer. A dropped record doesn't use up a sequence number.
+int pushBack(CircularBuffer &cb, const SensorData &sensorData) {
+  int stored = storeBack(cb, sensorData, cb.nextSequence);
+  cb.nextSequence += stored;
+  return stored;
+}
+
+int pushBackBatch(CircularBuffer &cb, const SensorData *records, int n) {
+  // Records that fit without overwriting go in column by column and are published together
+  uint32_t tail = cb.tail.load(std::memory_order_relaxed);
+  int space = BUFFER_SIZE - bufferCount(cb);
+  int fits = n < space ? n : space;
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    uint32_t slot = tail % BUFFER_SIZE;
+    for (int r = 0; r < fits; r++) {
+      cb.columns[c][slot] = toFixed(records[r].values[c], c);
+      slot = slot + 1 == BUFFER_SIZE ? 0 : slot + 1;
+    }
+  }
+  uint32_t slot = tail % BUFFER_SIZE;
+  for (int r = 0; r < fits; r++) {
+    cb.missing[slot] = missingMask(records[r]);
+    cb.timestamps[slot] = records[r].timestamp;
+    cb.sequences[slot] = cb.nextSequence++;
+    slot = slot + 1 == BUFFER_SIZE ? 0 : slot + 1;
+  }
+  cb.tail.store(advance(tail, fits), std::memory_order_release);
+
+  // The rest overwrite one at a time so the consumer never reserves a slot being written
+  int stored = fits;
+  for (int r = fits; r < n; r++) {
+    stored += pushBack(cb, records[r]);
+  }
+  return stored;
 }
 
-// Push an element to the back of the buffer
-void pushBack(CircularBuffer &cb, const SensorData &sensorData) {
-  cb.buffer[cb.tail] = sensorData;
-  cb.tail = (cb.tail + 1) % BUFFER_SIZE;
-  if (!isFull(cb)) {
-    cb.count++;
-  } else {
-    Serial.println("Buffer is full. Data has been overwritten.");
+int pushBackNumbered(CircularBuffer &cb, const SensorData &sensorData) {
+  if (isFull(cb)) {
+    return 0;
+  }
+  if (sensorData.sequence >= cb.nextSequence) {
+    cb.nextSequence = sensorData.sequence + 1;
+  }
+  return storeBack(cb, sensorData, sensorData.sequence);
+}
+
+int peekFront(CircularBuffer &cb, SensorData *records, int maxRecords) {
+  uint32_t front = cb.front.load(std::memory_order_acquire);
+  uint32_t n;
+  do {
+    uint32_t count = distance(headOf(front), cb.tail.load(std::memory_order_acquire)) - reservedOf(front);
+    n = (uint32_t)maxRecords < count ? (uint32_t)maxRecords : count;
+    if (n == 0) {
+      return 0;
+    }
+    // Fails if the producer overwrote the oldest record meanwhile; retry from the new head
+  } while (!cb.front.compare_exchange_weak(front, front + n, std::memory_order_acq_rel, std::memory_order_acquire));
+
+  uint32_t head = advance(headOf(front), reservedOf(front)) % BUFFER_SIZE;
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    uint32_t slot = head;
+    for (uint32_t r = 0; r < n; r++) {
+      records[r].values[c] = fromFixed(cb.columns[c][slot], c, cb.missing[slot]);
+      slot = slot + 1 == BUFFER_SIZE ? 0 : slot + 1;
+    }
+  }
+  uint32_t slot = head;
+  for (uint32_t r = 0; r < n; r++) {
+    records[r].timestamp = cb.timestamps[slot];
+    records[r].sequence = cb.sequences[slot];
+    slot = slot + 1 == BUFFER_SIZE ? 0 : slot + 1;
   }
+  return n;
 }
 
-// Push an element to the front of the buffer
-void pushFront(CircularBuffer &cb, const SensorData &sensorData) {
-  cb.head = (cb.head - 1 + BUFFER_SIZE) % BUFFER_SIZE;
-  cb.buffer[cb.head] = sensorData;
-  if (!isFull(cb)) {
-    cb.count++;
-  } else {
-    Serial.println("Buffer is full. Data has been overwritten.");
+// The producer leaves front alone while anything is reserved, but with nothing reserved it may
+// advance the head at any time, so front only changes through a compare-and-swap
+void commitFront(CircularBuffer &cb) {
+  uint32_t front = cb.front.load(std::memory_order_acquire);
+  while (reservedOf(front) > 0 &&
+         !cb.front.compare_exchange_weak(front, advance(headOf(front), reservedOf(front)) << 16,
+                                         std::memory_order_acq_rel, std::memory_order_acquire)) {
   }
 }
 
+void rollbackFront(CircularBuffer &cb) {
+  uint32_t front = cb.front.load(std::memory_order_acquire);
+  while (reservedOf(front) > 0 && !cb.front.compare_exchange_weak(front, headOf(front) << 16, std::memory_order_acq_rel,
+                                                                  std::memory_order_acquire)) {
+  }
+}
+
+void releaseNewest(CircularBuffer &cb, int n) {
+  cb.front.fetch_sub(n, std::memory_order_acq_rel);
+}
+
+int commitThrough(CircularBuffer &cb, uint32_t ack) {
+  uint32_t front = cb.front.load(std::memory_order_acquire);
+  uint32_t n;
+  do {
+    uint32_t head = headOf(front);
+    n = 0;
+    while (n < reservedOf(front) && cb.sequences[advance(head, n) % BUFFER_SIZE] <= ack) {
+      n++;
+    }
+    if (n == 0) {
+      return 0;
+    }
+  } while (!cb.front.compare_exchange_weak(front, (advance(headOf(front), n) << 16) | (reservedOf(front) - n),
+                                           std::memory_order_acq_rel, std::memory_order_acquire));
+  return n;
+}
+
+uint32_t frontSequence(const CircularBuffer &cb) {
+  return cb.sequences[headOf(cb.front.load(std::memory_order_acquire)) % BUFFER_SIZE];
+}
+
 // Pop an element from the front of the buffer
 bool popFront(CircularBuffer &cb, SensorData &sensorData) {
-  if (!isEmpty(cb)) {
-    sensorData = cb.buffer[cb.head];
-    cb.head = (cb.head + 1) % BUFFER_SIZE;
-    cb.count--;
-    return true;
-  } else {
+  if (peekFront(cb, &sensorData, 1) == 0) {
     Serial.println("Buffer is empty. Cannot pop from front.");
     return false;
   }
+  commitFront(cb);
+  return true;
 }
 
-bool popBack(CircularBuffer &cb, SensorData &sensorData) {
-  if (!isEmpty(cb)) {
-    cb.tail = (cb.tail - 1 + BUFFER_SIZE) % BUFFER_SIZE;
-    sensorData = cb.buffer[cb.tail];
-    cb.count--;
-    return true;
-  } else {
-    Serial.println("Buffer is empty. Cannot pop from back.");
-    return false;
+int popFrontBatch(CircularBuffer &cb, SensorData *records, int maxRecords) {
+  int n = peekFront(cb, records, maxRecords);
+  commitFront(cb);
+  return n;
+}
+
+// Copies a run of logical indices out of a ring column in at most two memcpy calls
+template <typename T>
+static int copyRun(const CircularBuffer &cb, const T *column, int start, T *out, int n) {
+  int count = bufferCount(cb);
+  if (start < 0 || start >= count || n <= 0) {
+    return 0;
+  }
+  if (n > count - start) {
+    n = count - start;
+  }
+  int first = (headOf(cb.front.load(std::memory_order_acquire)) + start) % BUFFER_SIZE;
+  int run = BUFFER_SIZE - first < n ? BUFFER_SIZE - first : n;
+  memcpy(out, column + first, run * sizeof(T));
+  memcpy(out + run, column, (n - run) * sizeof(T));
+  return n;
+}
+
+int readColumn(const CircularBuffer &cb, ChannelId id, int start, float *out, int n) {
+  if (!CHANNELS[id].enabled) {
+    return 0;
+  }
+  int count = bufferCount(cb);
+  if (start < 0 || start >= count || n <= 0) {
+    return 0;
+  }
+  if (n > count - start) {
+    n = count - start;
+  }
+  size_t c = channelSlot(id);
+  uint32_t slot = (headOf(cb.front.load(std::memory_order_acquire)) + start) % BUFFER_SIZE;
+  for (int r = 0; r < n; r++) {
+    out[r] = fromFixed(cb.columns[c][slot], c, cb.missing[slot]);
+    slot = slot + 1 == BUFFER_SIZE ? 0 : slot + 1;
   }
+  return n;
 }
 
-// Save the state of the buffer to non-volatile memory
+int readTimestamps(const CircularBuffer &cb, int start, int32_t *out, int n) {
+  return copyRun(cb, cb.timestamps, start, out, n);
+}
+
+int readSequences(const CircularBuffer &cb, int start, uint32_t *out, int n) {
+  return copyRun(cb, cb.sequences, start, out, n);
+}
+
+float columnAt(const CircularBuffer &cb, ChannelId id, int i) {
+  if (!CHANNELS[id].enabled || i < 0 || i >= bufferCount(cb)) {
+    return NAN;
+  }
+  size_t c = channelSlot(id);
+  uint32_t slot = (headOf(cb.front.load(std::memory_order_acquire)) + i) % BUFFER_SIZE;
+  return fromFixed(cb.columns[c][slot], c, cb.missing[slot]);
+}
+
+// Encodes the newest records that fit into block; returns the block size
+static size_t encodeBuffer(const CircularBuffer &cb, uint8_t *block, size_t capacity, int &stored) {
+  // Only the producer writes slots, so a snapshot of [head, tail) stays readable from here
+  uint32_t tail = cb.tail.load(std::memory_order_acquire);
+  uint32_t head = headOf(cb.front.load(std::memory_order_acquire));
+  int count = distance(head, tail);
+  int skip = 0;
+  while (true) {
+    RecordEncoder encoder(block, capacity);
+    SensorData record;
+    int i = skip;
+    for (; i < count; i++) {
+      loadRecord(cb, advance(head, i) % BUFFER_SIZE, record);
+      if (!encoder.append(record)) break;
+    }
+    if (i == count) {
+      stored = encoder.count();
+      return encoder.size();
+    }
+    // Drop the oldest records that didn't fit and try again
+    skip += count - i;
+  }
+}
+
+#if USE_ROLLUPS
+// The closed rollups hold the records the full buffer let go of, so they are saved along with it
+static void saveRollups() {
+  static uint32_t savedChanges = UINT32_MAX;
+  uint32_t changes = rollups.changes();
+  if (changes == savedChanges) {
+    return;
+  }
+  savedChanges = changes;
+
+  static uint8_t block[ROLLUP_BLOCK_BYTES];
+  size_t size = rollups.save(block, sizeof(block));
+  bufferPreferences.begin(BUFFER_NAMESPACE, false);
+  bufferPreferences.putBytes("rollups", block, size);
+  bufferPreferences.end();
+  Serial.printf("Rollups saved to NVS: %u of %d\n", (unsigned)((size - sizeof(uint16_t)) / sizeof(Rollup)),
+                rollups.count());
+}
+#endif
+
+// Save the state of the buffer to non-volatile memory, as one compressed block (RecordCodec.h)
 void saveBufferState(const CircularBuffer &cb) {
-  preferences.putBytes("circularBuffer", &cb, sizeof(cb));
-  preferences.end();
-  Serial.print("Buffer state saved to NVS. Buffer size: ");
-  Serial.println(cb.count);
+  #if USE_ROLLUPS
+  saveRollups();
+  #endif
+
+  // The whole block is rewritten each time, so an unchanged buffer isn't written again
+  static uint32_t savedHead = UINT32_MAX, savedTail, savedNext;
+  uint32_t head = headOf(cb.front.load(std::memory_order_acquire));
+  uint32_t tail = cb.tail.load(std::memory_order_acquire);
+  if (head == savedHead && tail == savedTail && cb.nextSequence == savedNext) {
+    return;
+  }
+  savedHead = head;
+  savedTail = tail;
+  savedNext = cb.nextSequence;
+
+  static uint8_t block[BUFFER_BLOCK_BYTES];
+  int stored = 0;
+  size_t size = encodeBuffer(cb, block, sizeof(block), stored);
+
+  bufferPreferences.begin(BUFFER_NAMESPACE, false);
+  bufferPreferences.putBytes("bufferBlock", block, size);
+  bufferPreferences.putUInt("nextSequence", cb.nextSequence);
+  bufferPreferences.end();
+  Serial.printf("Buffer state saved to NVS. Buffer size: %d (%u B)\n", bufferCount(cb), (unsigned)size);
+  if (stored < bufferCount(cb)) {
+    Serial.printf("Only the newest %d records fit in the NVS block\n", stored);
+  }
+}
+
+void clearBufferState(const CircularBuffer &cb) {
+  bufferPreferences.begin(BUFFER_NAMESPACE, false);
+  bufferPreferences.remove("bufferBlock");
+  bufferPreferences.remove("rollups");
+  bufferPreferences.putUInt("nextSequence", cb.nextSequence);
+  bufferPreferences.end();
 }
 
 // Load the state of the buffer from non-volatile memory
 void loadBufferState(CircularBuffer &cb) {
-  preferences.getBytes("circularBuffer", &cb, sizeof(cb));
-  preferences.end();
-  Serial.print("Buffer state loaded from NVS. Buffer size: ");
-  Serial.println(cb.count);
-}
\ No newline at end of file
+  static uint8_t block[BUFFER_BLOCK_BYTES];
+  bufferPreferences.begin(BUFFER_NAMESPACE, true);
+  size_t size = bufferPreferences.getBytes("bufferBlock", block, sizeof(block));
+  #if USE_ROLLUPS
+  static uint8_t rollupBlock[ROLLUP_BLOCK_BYTES];
+  size_t rollupSize = bufferPreferences.getBytes("rollups", rollupBlock, sizeof(rollupBlock));
+  #endif
+  bufferPreferences.end();
+
+  initCircularBuffer(cb);
+  RecordDecoder decoder(block, size);
+  SensorData record;
+  while (decoder.next(record)) {
+    // Keep the numbers the backend may already have seen
+    storeBack(cb, record, record.sequence);
+    if (record.sequence >= cb.nextSequence) {
+      cb.nextSequence = record.sequence + 1;
+    }
+  }
+  Serial.printf("Buffer state loaded from NVS. Buffer size: %d, next sequence: %lu\n", bufferCount(cb),
+                (unsigned long)cb.nextSequence);
+  #if USE_ROLLUPS
+  rollups.load(rollupBlock, rollupSize);
+  if (rollups.count() > 0) {
+    Serial.printf("%d rollups loaded from NVS\n", rollups.count());
+  }
+  #endif
+}
@@ -1,28 +1,97 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <atomic>
+#include <type_traits>
 #include "Config.h"
 
-// Circular buffer structure
+// Positions run over twice the capacity so a full buffer and an empty one differ
+#define RING_POSITIONS (2 * BUFFER_SIZE)
+static_assert(RING_POSITIONS < 0x10000, "ring positions must fit in 16 bits");
+
+// Bit per stored channel (SensorData slot)
+typedef std::conditional_t<STORED_CHANNEL_COUNT <= 8, uint8_t, uint16_t> ChannelMask;
+static_assert(STORED_CHANNEL_COUNT <= 16, "ChannelMask holds at most 16 channels");
+
+// Circular buffer structure. Stored column by column: one contiguous array per enabled channel
+// (indexed by channelSlot()) plus a timestamp column, so per-channel scans and encoders walk
+// adjacent values instead of striding over whole records.
+//
+// Values are int16 fixed point in slotScale() units, the channel's wire precision, so a record
+// converts back to the same upload JSON. Missing (NAN) values are a bit in the record's missing
+// mask. With two probes a record takes 21 B instead of 32 B as floats; values beyond +-32767
+// units (327.67 at two decimals) are clamped.
+//
+// Every record pushed gets the next per-device sequence number. The counter is persisted with
+// the buffer and survives reboots and factory resets, so the backend can deduplicate retried
+// uploads and acknowledge by sequence (commitThrough()).
+//
+// Lock-free single producer (the sampling task) / single consumer (the upload task). The
+// producer alone writes tail. front packs the head position (high 16 bits) with the number of
+// records the consumer has reserved (low 16 bits); the consumer moves it, and the producer only
+// bumps the head to overwrite the oldest record when the buffer is full and nothing is reserved.
 struct CircularBuffer {
-  SensorData buffer[BUFFER_SIZE];
-  int head;
-  int tail;
-  int count;
+  int16_t columns[STORED_CHANNEL_COUNT][BUFFER_SIZE];
+  ChannelMask missing[BUFFER_SIZE];
+  int32_t timestamps[BUFFER_SIZE];  // Unix seconds, the width of long on the ESP32
+  uint32_t sequences[BUFFER_SIZE];
+  uint32_t nextSequence;            // Producer only; numbering starts at 1
+  std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> front;
+  std::atomic<uint32_t> dropped;    // New records refused because the full buffer's front was reserved
 };
 
-// Function declarations
+// Setup only, before either task runs. Empties the buffer and picks up the persisted sequence counter.
 void initCircularBuffer(CircularBuffer &cb);
+
+// Either side; a snapshot that may be stale by the time it returns
+int bufferCount(const CircularBuffer &cb);
 bool isFull(const CircularBuffer &cb);
 bool isEmpty(const CircularBuffer &cb);
-void pushBack(CircularBuffer &cb, const SensorData &sensorData);
-void pushFront(CircularBuffer &cb, const SensorData &sensorData);
-bool popFront(CircularBuffer &cb, SensorData &sensorData);
-bool popBack(CircularBuffer &cb, SensorData &sensorData);
+
+// Producer side. A full buffer overwrites its oldest record, unless the consumer has it reserved,
+// in which case the new record is dropped. Stored records are numbered from nextSequence, whatever
+// their sequence field says. Return the number of records stored.
+int pushBack(CircularBuffer &cb, const SensorData &sensorData);
+int pushBackBatch(CircularBuffer &cb, const SensorData *records, int n);
+// Stores a record that was numbered before it was buffered (TieredStore.h) under its own sequence.
+// Never overwrites: returns 0 if the buffer is full.
+int pushBackNumbered(CircularBuffer &cb, const SensorData &sensorData);
+// Producer side, before numbering n records. The buffer is only saved every
+// BUFFER_SAVE_INTERVAL, so numbers are leased in NVS SEQUENCE_LEASE at a time and a power cut skips
+// the rest of the lease instead of handing out numbers the backend may already hold.
+void reserveSequences(CircularBuffer &cb, int n);
+// Producer side. Skips the write if nothing was stored or removed since the last save.
 void saveBufferState(const CircularBuffer &cb);
 void loadBufferState(CircularBuffer &cb);
+// Before a restart: empties the saved buffer, keeping the sequence counter. The ring itself is
+// left to the consumer, which may still have records reserved.
+void clearBufferState(const CircularBuffer &cb);
+
+// Consumer side. peekFront() reserves up to maxRecords following those already reserved and
+// copies them out, so several batches can be reserved at once; they stay in the buffer until
+// commitFront() removes them or rollbackFront() releases them.
+int peekFront(CircularBuffer &cb, SensorData *records, int maxRecords);
+void commitFront(CircularBuffer &cb);
+void rollbackFront(CircularBuffer &cb);
+// Releases the n most recently reserved records, keeping the older ones reserved
+void releaseNewest(CircularBuffer &cb, int n);
+// Removes the reserved records numbered up to ack, keeping the rest reserved; returns how many were removed
+int commitThrough(CircularBuffer &cb, uint32_t ack);
+// Sequence of the oldest record; only stable while something is reserved
+uint32_t frontSequence(const CircularBuffer &cb);
+bool popFront(CircularBuffer &cb, SensorData &sensorData);
+int popFrontBatch(CircularBuffer &cb, SensorData *records, int maxRecords);
+
+// Per-column access from the producer side. Index 0 is the oldest record. Copies up to n values
+// starting at index start and returns how many were copied; disabled channels copy nothing.
+int readColumn(const CircularBuffer &cb, ChannelId id, int start, float *out, int n);
+int readTimestamps(const CircularBuffer &cb, int start, int32_t *out, int n);
+int readSequences(const CircularBuffer &cb, int start, uint32_t *out, int n);
+// Value of one channel in the record at index i (0 is the oldest)
+float columnAt(const CircularBuffer &cb, ChannelId id, int i);
 
 // Global circular buffer instance
 extern CircularBuffer cb;
 
-#endif
\ No newline at end of file
+#endif
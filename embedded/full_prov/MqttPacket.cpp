@@ -0,0 +1,128 @@
+#include "MqttPacket.h"
+#include <string.h>
+
+// Remaining length: 7 bits per byte, low group first, high bit set while more follow
+static size_t writeLength(uint8_t* out, size_t length) {
+  size_t n = 0;
+  do {
+    uint8_t digit = length % 128;
+    length /= 128;
+    out[n++] = digit | (length > 0 ? 0x80 : 0);
+  } while (length > 0 && n < 4);
+  return n;
+}
+
+static size_t lengthBytes(size_t length) {
+  return length < 128 ? 1 : length < 16384 ? 2 : length < 2097152 ? 3 : 4;
+}
+
+static size_t writeString(uint8_t* out, const char* s) {
+  size_t len = strlen(s);
+  out[0] = len >> 8;
+  out[1] = len & 0xFF;
+  memcpy(out + 2, s, len);
+  return len + 2;
+}
+
+size_t mqttConnect(uint8_t* out, size_t capacity, const char* clientId, uint16_t keepAliveSeconds,
+                   bool cleanSession) {
+  // Protocol name "MQTT", level 4, flags, keep alive; then the client ID as the only payload field
+  size_t remaining = 10 + 2 + strlen(clientId);
+  size_t size = 1 + lengthBytes(remaining) + remaining;
+  if (size > capacity || remaining > 268435455) {
+    return 0;
+  }
+  size_t n = 0;
+  out[n++] = MQTT_CONNECT << 4;
+  n += writeLength(out + n, remaining);
+  n += writeString(out + n, "MQTT");
+  out[n++] = 4;
+  out[n++] = cleanSession ? 0x02 : 0x00;
+  out[n++] = keepAliveSeconds >> 8;
+  out[n++] = keepAliveSeconds & 0xFF;
+  n += writeString(out + n, clientId);
+  return n;
+}
+
+size_t mqttPublishHeader(uint8_t* out, size_t capacity, const char* topic, uint16_t packetId,
+                         size_t payloadLength) {
+  size_t remaining = 2 + strlen(topic) + 2 + payloadLength;
+  size_t header = 1 + lengthBytes(remaining) + remaining - payloadLength;
+  if (header > capacity || remaining > 268435455) {
+    return 0;
+  }
+  size_t n = 0;
+  out[n++] = (MQTT_PUBLISH << 4) | (1 << 1);  // QoS 1, not a duplicate, not retained
+  n += writeLength(out + n, remaining);
+  n += writeString(out + n, topic);
+  out[n++] = packetId >> 8;
+  out[n++] = packetId & 0xFF;
+  return n;
+}
+
+size_t mqttPingReq(uint8_t* out, size_t capacity) {
+  if (capacity < 2) {
+    return 0;
+  }
+  out[0] = MQTT_PINGREQ << 4;
+  out[1] = 0;
+  return 2;
+}
+
+size_t mqttDisconnect(uint8_t* out, size_t capacity) {
+  if (capacity < 2) {
+    return 0;
+  }
+  out[0] = MQTT_DISCONNECT << 4;
+  out[1] = 0;
+  return 2;
+}
+
+uint16_t MqttPacket::packetId() const {
+  if (type == MQTT_PUBACK) {
+    return bodyLength >= 2 ? (body[0] << 8) | body[1] : 0;
+  }
+  if (type == MQTT_PUBLISH && (flags & 0x06) && bodyLength >= 2) {
+    size_t topicLength = (body[0] << 8) | body[1];
+    if (bodyLength >= topicLength + 4) {
+      return (body[topicLength + 2] << 8) | body[topicLength + 3];
+    }
+  }
+  return 0;
+}
+
+uint8_t MqttPacket::connectCode() const {
+  return type == MQTT_CONNACK && bodyLength >= 2 ? body[1] : 0xFF;
+}
+
+bool mqttParse(const uint8_t* in, size_t length, MqttPacket& packet, bool& malformed) {
+  malformed = false;
+  if (length < 2) {
+    return false;
+  }
+  size_t remaining = 0;
+  size_t n = 1;
+  for (int shift = 0;; shift += 7) {
+    if (n >= length) {
+      return false;
+    }
+    if (shift > 21) {
+      malformed = true;
+      return false;
+    }
+    uint8_t digit = in[n++];
+    remaining |= (size_t)(digit & 0x7F) << shift;
+    if (!(digit & 0x80)) {
+      break;
+    }
+  }
+  if (length < n + remaining) {
+    return false;
+  }
+  packet.type = (MqttPacketType)(in[0] >> 4);
+  packet.flags = in[0] & 0x0F;
+  packet.body = in + n;
+  packet.bodyLength = remaining;
+  packet.size = n + remaining;
+  return true;
+}
@@ -0,0 +1,48 @@
+#ifndef MQTTPACKET_H
+#define MQTTPACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The few MQTT 3.1.1 packets an uploading device needs: CONNECT, PUBLISH at QoS 1, PINGREQ and
+// DISCONNECT out; CONNACK, PUBACK and PINGRESP in. Plain byte buffers so the framing is shared by
+// the firmware's MqttTransport and the host tools.
+enum MqttPacketType : uint8_t {
+  MQTT_CONNECT = 1,
+  MQTT_CONNACK = 2,
+  MQTT_PUBLISH = 3,
+  MQTT_PUBACK = 4,
+  MQTT_PINGREQ = 12,
+  MQTT_PINGRESP = 13,
+  MQTT_DISCONNECT = 14
+};
+
+#define MQTT_FIXED_HEADER_MAX 5  // Type byte plus up to four length bytes
+
+// Each returns the packet size written to out, or 0 if it didn't fit.
+// cleanSession false keeps the broker-side session across reconnects.
+size_t mqttConnect(uint8_t* out, size_t capacity, const char* clientId, uint16_t keepAliveSeconds,
+                   bool cleanSession);
+// Everything of a QoS 1 PUBLISH before its payload, so the payload can be written from where it lies
+size_t mqttPublishHeader(uint8_t* out, size_t capacity, const char* topic, uint16_t packetId,
+                         size_t payloadLength);
+size_t mqttPingReq(uint8_t* out, size_t capacity);
+size_t mqttDisconnect(uint8_t* out, size_t capacity);
+
+// One packet split from the front of a byte stream
+struct MqttPacket {
+  MqttPacketType type;
+  uint8_t flags;            // Low nibble of the fixed header
+  const uint8_t* body;      // Variable header and payload
+  size_t bodyLength;
+  size_t size;              // Whole packet, fixed header included
+
+  uint16_t packetId() const;  // PUBACK, or a PUBLISH above QoS 0
+  uint8_t connectCode() const;  // CONNACK return code, 0 when accepted
+};
+
+// Returns true with packet set if in holds a complete packet, false if more bytes are needed.
+// malformed is set if in can never become a packet (a length over four bytes).
+bool mqttParse(const uint8_t* in, size_t length, MqttPacket& packet, bool& malformed);
+
+#endif // MQTTPACKET_H
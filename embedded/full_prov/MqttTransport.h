@@ -0,0 +1,182 @@
+#ifndef MQTTTRANSPORT_H
+#define MQTTTRANSPORT_H
+
+#include <WiFi.h>
+#include "Config.h"
+#include "UploadTransport.h"
+#include "UploadBatch.h"
+#include "MqttPacket.h"
+#include "UploadProfiler.h"
+
+// Batches published at QoS 1 to plantguru/<device_id>/records on one MQTT session. A PUBLISH
+// costs a 2-4 byte fixed header, the topic and a packet ID, and the PUBACK 4 bytes, against a
+// few hundred bytes of HTTP request and response headers per batch. The broker acknowledges QoS 1
+// publishes in order, so each PUBACK answers the oldest batch in flight. It only says the broker
+// has the batch: the backend's subscriber stores it with the same sequence dedup as an HTTP
+// upload, which makes redelivery harmless.
+//
+// The session is not clean, so the broker keeps it across reconnects under the device ID.
+class MqttTransport : public UploadTransport {
+private:
+  WiFiClient client;
+  const char* host;
+  uint16_t port;
+  char topic[sizeof(MQTT_TOPIC_PREFIX) + DEVICE_ID_MAX + sizeof(MQTT_TOPIC_SUFFIX)];
+  uint16_t nextPacketId = 1;
+  uint16_t oldestPacketId = 1;  // Of the oldest publish not yet acknowledged
+  unsigned long lastSendMs = 0;
+  uint8_t rx[64];  // Only short acknowledgements come back
+  size_t rxLength = 0;
+
+  bool writeAll(const uint8_t* data, size_t length) {
+    if (client.write(data, length) != length) {
+      return false;
+    }
+    sent += length;
+    lastSendMs = millis();
+    return true;
+  }
+
+  // Reads until one whole packet is in rx; the caller drops it with consume()
+  bool readPacket(MqttPacket& packet, unsigned long deadline) {
+    while (true) {
+      bool malformed = false;
+      if (mqttParse(rx, rxLength, packet, malformed)) {
+        return packet.size <= sizeof(rx);
+      }
+      if (malformed || rxLength == sizeof(rx) || (long)(deadline - millis()) <= 0) {
+        return false;
+      }
+      if (!client.available()) {
+        if (!client.connected()) {
+          return false;
+        }
+        delay(1);
+        continue;
+      }
+      int n = client.read(rx + rxLength, sizeof(rx) - rxLength);
+      if (n > 0) {
+        rxLength += n;
+        received += n;
+      }
+    }
+  }
+
+  void consume(const MqttPacket& packet) {
+    memmove(rx, rx + packet.size, rxLength - packet.size);
+    rxLength -= packet.size;
+  }
+
+  // Waits for a packet of the given type, skipping anything else the broker sends
+  bool expect(MqttPacketType type, MqttPacket& packet, unsigned long timeoutMs) {
+    unsigned long deadline = millis() + timeoutMs;
+    while (readPacket(packet, deadline)) {
+      if (packet.type == type) {
+        return true;
+      }
+      consume(packet);
+    }
+    return false;
+  }
+
+  static uint16_t followingId(uint16_t id) {
+    return id == 0xFFFF ? 1 : id + 1;  // 0 is not a valid packet ID
+  }
+
+  bool connect(const char* deviceId) {
+    client.stop();
+    rxLength = 0;
+    oldestPacketId = nextPacketId;
+    IPAddress address;
+    unsigned long startUs = micros();
+    if (!WiFi.hostByName(host, address)) {
+      Serial.printf("Failed to resolve MQTT broker %s\n", host);
+      return false;
+    }
+    uploadProfiler.record(UPLOAD_PHASE_DNS, micros() - startUs);
+    startUs = micros();
+    if (!client.connect(address, port)) {
+      Serial.printf("Failed to connect to MQTT broker %s:%u\n", host, (unsigned)port);
+      return false;
+    }
+    client.setNoDelay(true);
+
+    uint8_t packet[32 + DEVICE_ID_MAX];
+    size_t length = mqttConnect(packet, sizeof(packet), deviceId, MQTT_KEEPALIVE_SECONDS, false);
+    MqttPacket connack;
+    if (length == 0 || !writeAll(packet, length) || !expect(MQTT_CONNACK, connack, UPLOAD_RESPONSE_TIMEOUT)) {
+      client.stop();
+      return false;
+    }
+    uint8_t code = connack.connectCode();
+    consume(connack);
+    if (code != 0) {
+      Serial.printf("MQTT broker refused the session: %u\n", code);
+      client.stop();
+      return false;
+    }
+    uploadProfiler.record(UPLOAD_PHASE_CONNECT, micros() - startUs);
+    return true;
+  }
+
+  // Only called with nothing in flight, so the next packet is the PINGRESP
+  bool ping() {
+    uint8_t packet[2];
+    MqttPacket pong;
+    if (!writeAll(packet, mqttPingReq(packet, sizeof(packet))) ||
+        !expect(MQTT_PINGRESP, pong, UPLOAD_RESPONSE_TIMEOUT)) {
+      return false;
+    }
+    consume(pong);
+    return true;
+  }
+
+public:
+  MqttTransport(const char* host, uint16_t port) : host(host), port(port) {
+    topic[0] = '\0';
+  }
+
+  const char* name() const override {
+    return "mqtt";
+  }
+
+  bool begin(const char* deviceId) override {
+    snprintf(topic, sizeof(topic), "%s%.*s%s", MQTT_TOPIC_PREFIX, DEVICE_ID_MAX, deviceId, MQTT_TOPIC_SUFFIX);
+    if (client.connected()) {
+      // Past half the keep alive the broker may be about to drop us, or a NAT already has
+      if (millis() - lastSendMs < MQTT_KEEPALIVE_SECONDS * 500UL || ping()) {
+        return true;
+      }
+    }
+    return connect(deviceId);
+  }
+
+  bool send(const char* payload, size_t length) override {
+    uint8_t header[MQTT_FIXED_HEADER_MAX + 2 + sizeof(topic) + 2];
+    size_t headerLength = mqttPublishHeader(header, sizeof(header), topic, nextPacketId, length);
+    nextPacketId = followingId(nextPacketId);
+    return headerLength > 0 && writeAll(header, headerLength) && writeAll((const uint8_t*)payload, length);
+  }
+
+  bool receive(UploadReply& reply, unsigned long timeoutMs) override {
+    MqttPacket puback;
+    if (!expect(MQTT_PUBACK, puback, timeoutMs) || puback.packetId() != oldestPacketId) {
+      return false;
+    }
+    consume(puback);
+    oldestPacketId = followingId(oldestPacketId);
+    reply.accepted = true;
+    reply.hasAck = false;
+    return true;
+  }
+
+  void stop() override {
+    if (client.connected()) {
+      uint8_t packet[2];
+      writeAll(packet, mqttDisconnect(packet, sizeof(packet)));
+    }
+    client.stop();
+  }
+};
+
+#endif // MQTTTRANSPORT_H
@@ -0,0 +1,22 @@
+#ifndef OTASIGNINGKEY_H
+#define OTASIGNINGKEY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Public half of the release key OTA manifests are signed with (ECDSA P-256, DER
+// SubjectPublicKeyInfo). OtaUpdater.h refuses a manifest whose signature doesn't verify against it.
+// The private half stays with whoever publishes releases (host/ota_delta --key); to use your own,
+// generate one and paste the output of
+//   openssl ec -in ota_signing_key.pem -pubout -outform DER | xxd -i
+const uint8_t ota_signing_key[] = {
+  0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01, 0x06, 0x08, 0x2a,
+  0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0x03, 0xfd, 0x1a, 0x6f, 0x26,
+  0x79, 0xd1, 0x3a, 0x32, 0xad, 0xe4, 0xf6, 0xd4, 0x40, 0x13, 0x54, 0x24, 0x13, 0x60, 0x22, 0xe6,
+  0x23, 0x46, 0xce, 0xb1, 0x37, 0xc9, 0x86, 0x39, 0x6c, 0x7b, 0x54, 0xfd, 0x15, 0x5a, 0x8d, 0x9d,
+  0x33, 0x6d, 0xb9, 0xf2, 0xc9, 0xfb, 0x58, 0x84, 0xc8, 0x3d, 0xdf, 0xb5, 0xc7, 0x04, 0x86, 0x47,
+  0x08, 0x6a, 0x46, 0x71, 0x43, 0x53, 0x9e, 0xa5, 0x06, 0x29, 0x99,
+};
+const size_t ota_signing_key_len = 91;
+
+#endif // OTASIGNINGKEY_H
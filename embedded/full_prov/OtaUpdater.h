@@ -0,0 +1,408 @@
+#ifndef OTAUPDATER_H
+#define OTAUPDATER_H
+
+#include <atomic>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/ecdsa.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+#include "Config.h"
+#include "DeltaPatch.h"
+#include "OtaSigningKey.h"
+#include "WiFiService.h"
+
+// Firmware updates from the manifest host/ota_delta publishes. The manifest names the newest
+// version with its size and SHA-256, the full image, and a delta patch from each older version.
+// It comes over plain HTTP, so it is only used once its signature (<manifest URL>.sig, base64 DER
+// ECDSA P-256 over the manifest's bytes) verifies against ota_signing_key (OtaSigningKey.h), and
+// only for a version newer than the running one. The image and patches need no signature of their
+// own: whatever they produce must match the signed SHA-256.
+// When the running version has one, the patch is downloaded and applied against the running
+// partition (DeltaPatch.h), otherwise, or when the delta fails, the full image is. Either way the
+// new image streams straight into the inactive OTA slot; only the patch stream's buffer is in RAM.
+//
+// The slot is only made bootable once the image's SHA-256 matches the manifest and esp_ota_end()
+// has validated it. The new image then boots pending verification and confirms itself after its
+// first successful upload (confirm()); if it crashes first, or hasn't uploaded within
+// OTA_CONFIRM_TIMEOUT, the bootloader goes back to the previous image, which reports the rollback
+// and skips that version from then on.
+//
+// Each attempt is reported to PLANTGURU_OTA_ENDPOINT with the bytes downloaded and the time taken.
+class OtaUpdater {
+public:
+  OtaUpdater() : pendingVerify(false), checked(false), lastCheckMs(0), restartDue(false) {}
+
+  void begin() {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    pendingVerify = esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY;
+    Serial.printf("Firmware %s in %s%s\n", FIRMWARE_VERSION, running->label,
+                  pendingVerify ? ", pending verification" : "");
+
+    // An update that never confirmed itself leaves its version behind
+    statePreferences.begin("ota_state", false);
+    String updatedTo = statePreferences.getString("updated_to", "");
+    if (!updatedTo.isEmpty() && updatedTo != FIRMWARE_VERSION) {
+      Serial.printf("Update to %s was rolled back\n", updatedTo.c_str());
+      statePreferences.putString("skip", updatedTo);
+      rolledBack = updatedTo;
+    }
+    if (!pendingVerify) {
+      statePreferences.remove("updated_to");
+    }
+    skipVersion = statePreferences.getString("skip", "");
+    statePreferences.end();
+  }
+
+  // The new image works: keep it as the boot image
+  void confirm() {
+    if (!pendingVerify) {
+      return;
+    }
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+      Serial.printf("Firmware %s confirmed\n", FIRMWARE_VERSION);
+      pendingVerify = false;
+      statePreferences.begin("ota_state", false);
+      statePreferences.remove("updated_to");
+      statePreferences.end();
+    }
+  }
+
+  // A new image that can't upload within OTA_CONFIRM_TIMEOUT goes back to the previous one
+  void checkRollback() {
+    if (pendingVerify && millis() > OTA_CONFIRM_TIMEOUT) {
+      Serial.println("New firmware hasn't uploaded, rolling back");
+      esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+  }
+
+  // Checks the manifest on the first call, then every OTA_CHECK_INTERVAL. Once a new image is
+  // written and verified, asks the sampling task to save the buffer and restart into it.
+  bool check(const String& manifestUrl) {
+    if (pendingVerify || (checked && millis() - lastCheckMs < OTA_CHECK_INTERVAL)) {
+      return false;
+    }
+    if (!connectionManager.isConnected() || !isTimeSet()) {
+      return false;
+    }
+    checked = true;
+    lastCheckMs = millis();
+
+    if (!rolledBack.isEmpty()) {
+      Report report;
+      report.method = "rollback";
+      report.error = "new image didn't confirm";
+      postReport(rolledBack, report);
+      rolledBack = "";
+    }
+
+    HTTPClient http;
+    beginBackendRequest(http, manifestUrl);
+    int code = http.GET();
+    if (code != 200) {
+      Serial.printf("OTA manifest: HTTP %d\n", code);
+      http.end();
+      return false;
+    }
+    String body = http.getString();
+    http.end();
+    if (!verifySignature(manifestUrl, body)) {
+      Serial.println("OTA manifest: signature missing or doesn't verify");
+      return false;
+    }
+    StaticJsonDocument<OTA_MANIFEST_MAX> manifest;
+    DeserializationError error = deserializeJson(manifest, body);
+    if (error) {
+      Serial.printf("OTA manifest: %s\n", error.c_str());
+      return false;
+    }
+
+    String version = manifest["version"] | "";
+    String sha = manifest["sha256"] | "";
+    uint32_t size = manifest["size"] | 0;
+    if (version.isEmpty() || !isNewer(version.c_str(), FIRMWARE_VERSION) || version == skipVersion) {
+      return false;
+    }
+    if (sha.length() != 64 || size == 0) {
+      Serial.println("OTA manifest: no sha256 or size");
+      return false;
+    }
+    Target target;
+    target.size = size;
+    for (int i = 0; i < 32; i++) {
+      target.sha256[i] = strtoul(sha.substring(2 * i, 2 * i + 2).c_str(), nullptr, 16);
+    }
+
+    bool updated = false;
+    for (JsonObject delta : manifest["deltas"].as<JsonArray>()) {
+      if (strcmp(delta["from"] | "", FIRMWARE_VERSION) == 0) {
+        Report report;
+        report.method = "delta";
+        updated = download(resolve(manifestUrl, delta["url"] | ""), true, target, report);
+        postReport(version, report);
+        break;
+      }
+    }
+    if (!updated) {
+      Report report;
+      report.method = "full";
+      updated = download(resolve(manifestUrl, manifest["url"] | ""), false, target, report);
+      postReport(version, report);
+    }
+    if (!updated) {
+      return false;
+    }
+
+    statePreferences.begin("ota_state", false);
+    statePreferences.putString("updated_to", version);
+    statePreferences.end();
+    Serial.printf("Restarting into firmware %s\n", version.c_str());
+    restartDue.store(true);
+    return true;
+  }
+
+  // Polled from the sampling task, which owns the buffer
+  bool restartRequested() const { return restartDue.load(); }
+
+private:
+  Preferences statePreferences;  // begin() in setup, the rest on the network task
+
+  struct Target {
+    uint32_t size;
+    uint8_t sha256[32];
+  };
+
+  struct Report {
+    const char* method = "";
+    const char* error = nullptr;
+    uint32_t bytes = 0;  // Downloaded, HTTP headers excluded
+    uint32_t imageBytes = 0;  // Written to the slot
+    uint32_t ms = 0;
+    bool ok = false;
+  };
+
+  // What the patch callbacks work on
+  struct Session {
+    const esp_partition_t* running;
+    esp_ota_handle_t handle;
+    mbedtls_sha256_context sha;
+    const Target* target;
+    uint32_t written;
+  };
+
+  bool pendingVerify;
+  bool checked;
+  unsigned long lastCheckMs;
+  std::atomic<bool> restartDue;
+  String skipVersion;
+  String rolledBack;
+
+  // Fetches the manifest's signature and checks it against the key built into the firmware
+  static bool verifySignature(const String& manifestUrl, const String& body) {
+    HTTPClient http;
+    beginBackendRequest(http, manifestUrl + ".sig");
+    int code = http.GET();
+    String signature = code == 200 ? http.getString() : String();
+    http.end();
+    signature.trim();
+    uint8_t der[MBEDTLS_ECDSA_MAX_LEN];
+    size_t derLength = 0;
+    if (signature.isEmpty() || mbedtls_base64_decode(der, sizeof(der), &derLength, (const uint8_t*)signature.c_str(),
+                                                     signature.length()) != 0) {
+      return false;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256((const uint8_t*)body.c_str(), body.length(), digest, 0);
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    bool ok = mbedtls_pk_parse_public_key(&key, ota_signing_key, ota_signing_key_len) == 0 &&
+              mbedtls_pk_can_do(&key, MBEDTLS_PK_ECDSA) &&
+              mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, digest, sizeof(digest), der, derLength) == 0;
+    mbedtls_pk_free(&key);
+    return ok;
+  }
+
+  // Dotted versions compared field by field. A signed manifest stays valid, so without this an
+  // old one served again would take the device back to that version.
+  static bool isNewer(const char* version, const char* current) {
+    while (true) {
+      char* versionEnd;
+      char* currentEnd;
+      unsigned long a = strtoul(version, &versionEnd, 10);
+      unsigned long b = strtoul(current, &currentEnd, 10);
+      if (a != b) {
+        return a > b;
+      }
+      if (*versionEnd != '.' && *currentEnd != '.') {
+        return false;
+      }
+      version = *versionEnd == '.' ? versionEnd + 1 : versionEnd;
+      current = *currentEnd == '.' ? currentEnd + 1 : currentEnd;
+    }
+  }
+
+  // Manifest URLs are relative to the manifest
+  static String resolve(const String& manifestUrl, const String& url) {
+    if (url.indexOf("://") >= 0) {
+      return url;
+    }
+    return manifestUrl.substring(0, manifestUrl.lastIndexOf('/') + 1) + url;
+  }
+
+  static bool readRunning(void* context, uint32_t offset, uint8_t* out, size_t length) {
+    Session* session = (Session*)context;
+    return esp_partition_read(session->running, offset, out, length) == ESP_OK;
+  }
+
+  static bool writeUpdate(void* context, const uint8_t* data, size_t length) {
+    Session* session = (Session*)context;
+    if (session->written + length > session->target->size) {
+      return false;
+    }
+    mbedtls_sha256_update(&session->sha, data, length);
+    session->written += length;
+    return esp_ota_write(session->handle, data, length) == ESP_OK;
+  }
+
+  // Only a patch from exactly the running image to exactly the manifest's image is applied
+  static bool checkDelta(void* context, const DeltaHeader& header) {
+    Session* session = (Session*)context;
+    if (header.newSize != session->target->size || memcmp(header.newSha256, session->target->sha256, 32) != 0 ||
+        header.oldSize > session->running->size) {
+      return false;
+    }
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    uint8_t buffer[1024];
+    for (uint32_t offset = 0; offset < header.oldSize; offset += sizeof(buffer)) {
+      size_t n = min((uint32_t)sizeof(buffer), header.oldSize - offset);
+      if (esp_partition_read(session->running, offset, buffer, n) != ESP_OK) {
+        mbedtls_sha256_free(&sha);
+        return false;
+      }
+      mbedtls_sha256_update(&sha, buffer, n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    return memcmp(digest, header.oldSha256, 32) == 0;
+  }
+
+  // Streams url into the inactive slot, as a patch or as the image itself, and makes the slot
+  // the boot partition if the result is the manifest's image
+  bool download(const String& url, bool delta, const Target& target, Report& report) {
+    unsigned long startMs = millis();
+    Session session;
+    session.running = esp_ota_get_running_partition();
+    session.target = &target;
+    session.written = 0;
+    const esp_partition_t* update = esp_ota_get_next_update_partition(nullptr);
+    if (update == nullptr || target.size > update->size) {
+      report.error = "no OTA slot for the image";
+      return finish(report, startMs);
+    }
+
+    HTTPClient http;
+    beginBackendRequest(http, url);
+    http.setTimeout(OTA_READ_TIMEOUT);
+    int code = http.GET();
+    if (code != 200) {
+      Serial.printf("OTA %s: HTTP %d\n", url.c_str(), code);
+      http.end();
+      report.error = "download failed";
+      return finish(report, startMs);
+    }
+    if (esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &session.handle) != ESP_OK) {
+      http.end();
+      report.error = "esp_ota_begin failed";
+      return finish(report, startMs);
+    }
+    mbedtls_sha256_init(&session.sha);
+    mbedtls_sha256_starts(&session.sha, 0);
+
+    DeltaPatch patch(readRunning, writeUpdate, checkDelta, &session);
+    WiFiClient* stream = http.getStreamPtr();
+    int remaining = http.getSize();  // -1 when the server didn't say
+    uint8_t buffer[1024];
+    bool ok = true;
+    unsigned long lastDataMs = millis();
+    while (ok && remaining != 0 && (http.connected() || stream->available())) {
+      size_t available = stream->available();
+      if (available == 0) {
+        if (millis() - lastDataMs > OTA_READ_TIMEOUT) {
+          break;
+        }
+        delay(1);
+        continue;
+      }
+      int n = stream->readBytes(buffer, min(available, sizeof(buffer)));
+      if (n <= 0) {
+        continue;
+      }
+      lastDataMs = millis();
+      report.bytes += n;
+      if (remaining > 0) {
+        remaining -= n;
+      }
+      ok = delta ? patch.feed(buffer, n) : writeUpdate(&session, buffer, n);
+    }
+    http.end();
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&session.sha, digest);
+    mbedtls_sha256_free(&session.sha);
+    report.imageBytes = session.written;
+    if (delta && !patch.done()) {
+      report.error = patch.error() ? patch.error() : "patch ended early";
+    } else if (!ok) {
+      report.error = "writing the image failed";
+    } else if (session.written != target.size || memcmp(digest, target.sha256, 32) != 0) {
+      report.error = "image doesn't match the manifest";
+    }
+    if (report.error) {
+      esp_ota_abort(session.handle);
+      return finish(report, startMs);
+    }
+
+    // Checks the image header, segments and appended digest (and signature under secure boot)
+    if (esp_ota_end(session.handle) != ESP_OK) {
+      report.error = "image failed validation";
+    } else if (esp_ota_set_boot_partition(update) != ESP_OK) {
+      report.error = "esp_ota_set_boot_partition failed";
+    } else {
+      report.ok = true;
+    }
+    return finish(report, startMs);
+  }
+
+  static bool finish(Report& report, unsigned long startMs) {
+    report.ms = millis() - startMs;
+    Serial.printf("OTA %s: %lu B downloaded, %lu B image in %lu ms, %s\n", report.method,
+                  (unsigned long)report.bytes, (unsigned long)report.imageBytes, (unsigned long)report.ms,
+                  report.ok ? "verified" : report.error);
+    return report.ok;
+  }
+
+  void postReport(const String& version, const Report& report) {
+    char payload[320];
+    int n = snprintf(payload, sizeof(payload),
+                     "{\"device_id\":\"%s\",\"from_version\":\"%s\",\"to_version\":\"%s\",\"method\":\"%s\","
+                     "\"bytes\":%lu,\"image_bytes\":%lu,\"duration_ms\":%lu,\"ok\":%s,\"error\":\"%s\"}",
+                     uploadDeviceId().c_str(), FIRMWARE_VERSION, version.c_str(), report.method,
+                     (unsigned long)report.bytes, (unsigned long)report.imageBytes, (unsigned long)report.ms,
+                     report.ok ? "true" : "false", report.error ? report.error : "");
+    if (n > 0 && n < (int)sizeof(payload)) {
+      postData(PLANTGURU_OTA_ENDPOINT, String(payload), 3);
+    }
+  }
+};
+
+OtaUpdater otaUpdater;
+
+#endif
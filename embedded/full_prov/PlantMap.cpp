@@ -0,0 +1,169 @@
+#include "PlantMap.h"
+
+SharedPlantMap plantMap;
+
+// Used by setup() and then the sampling task only; the BLE task hands its writes over (sync())
+static Preferences plantPreferences;
+
+void PlantMap::assignAll(int plantId) {
+  int plants[SOIL_PROBE_COUNT];
+  for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+    plants[i] = plantId;
+  }
+  if (!assign(plants, SOIL_PROBE_COUNT)) {
+    // No plant yet: keep the probes together so records still serialize without a plant_id
+    for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+      probePlant[i] = -1;
+    }
+    plantIds[0] = -1;
+    probeMask[0] = (1 << SOIL_PROBE_COUNT) - 1;
+    plantCount = 1;
+  }
+}
+
+bool PlantMap::assign(const int* plants, int count) {
+  if (count != SOIL_PROBE_COUNT) {
+    return false;
+  }
+  int ids[SOIL_PROBE_COUNT];
+  uint8_t masks[SOIL_PROBE_COUNT];
+  int n = 0;
+  for (int probe = 0; probe < SOIL_PROBE_COUNT; probe++) {
+    if (plants[probe] < 0) {
+      continue;
+    }
+    int i = 0;
+    while (i < n && ids[i] != plants[probe]) {
+      i++;
+    }
+    if (i == n) {
+      ids[n] = plants[probe];
+      masks[n] = 0;
+      n++;
+    }
+    masks[i] |= 1 << probe;
+  }
+  if (n == 0) {
+    return false;
+  }
+
+  for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+    probePlant[i] = plants[i] < 0 ? -1 : plants[i];
+  }
+  for (int i = 0; i < n; i++) {
+    plantIds[i] = ids[i];
+    probeMask[i] = masks[i];
+  }
+  plantCount = n;
+  return true;
+}
+
+bool PlantMap::assign(const String& csv) {
+  int plants[SOIL_PROBE_COUNT];
+  int count = 0;
+  int from = 0;
+  while (from <= (int)csv.length()) {
+    int comma = csv.indexOf(',', from);
+    String field = comma < 0 ? csv.substring(from) : csv.substring(from, comma);
+    field.trim();
+    if (field.isEmpty() || count == SOIL_PROBE_COUNT) {
+      return false;
+    }
+    plants[count++] = field.toInt();
+    if (comma < 0) {
+      break;
+    }
+    from = comma + 1;
+  }
+  return assign(plants, count);
+}
+
+String PlantMap::toString() const {
+  String out;
+  for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+    if (i > 0) {
+      out += ",";
+    }
+    out += String(probePlant[i]);
+  }
+  return out;
+}
+
+ChannelId PlantMap::primaryProbe(int i) const {
+  int probe = 1;
+  while (probe < SOIL_PROBE_COUNT && !(probeMask[i] & (1 << (probe - 1)))) {
+    probe++;
+  }
+  return soilProbeChannel(probe);
+}
+
+void PlantMap::load() {
+  int plants[SOIL_PROBE_COUNT];
+  plantPreferences.begin("device_prefs", true);
+  size_t stored = plantPreferences.getBytes("probe_plants", plants, sizeof(plants));
+  int plantId = plantPreferences.getInt("plant_id", -1);
+  plantPreferences.end();
+
+  if (stored != sizeof(plants) || !assign(plants, SOIL_PROBE_COUNT)) {
+    assignAll(plantId);
+  }
+}
+
+void PlantMap::save() const {
+  plantPreferences.begin("device_prefs", false);
+  plantPreferences.putBytes("probe_plants", probePlant, sizeof(probePlant));
+  plantPreferences.end();
+}
+
+PlantMap SharedPlantMap::get() {
+  std::lock_guard<std::mutex> guard(lock);
+  return map;
+}
+
+void SharedPlantMap::publish(const PlantMap& next, bool save) {
+  std::lock_guard<std::mutex> guard(lock);
+  map = next;
+  changes++;
+  unsaved = save;
+}
+
+bool SharedPlantMap::refresh(PlantMap& copy, uint32_t& version) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (version == changes) {
+    return false;
+  }
+  copy = map;
+  version = changes;
+  return true;
+}
+
+void SharedPlantMap::sync() {
+  PlantMap current;
+  uint32_t version;
+  bool save;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    current = map;
+    version = changes;
+    save = unsaved;
+    unsaved = false;
+  }
+  if (save) {
+    current.save();
+    return;
+  }
+  if (current.plantIds[0] != -1) {
+    return;
+  }
+
+  PlantMap stored;
+  stored.load();
+  if (stored.plantIds[0] == -1) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  if (changes == version) {  // Unless the BLE task published a map meanwhile
+    map = stored;
+    changes++;
+  }
+}
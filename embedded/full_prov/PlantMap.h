@@ -0,0 +1,65 @@
+#ifndef PLANTMAP_H
+#define PLANTMAP_H
+
+#include <mutex>
+#include "Config.h"
+
+// Which plant each soil probe sits in. A node can serve several plants; every plant gets its own
+// upload objects carrying its probes plus the shared channels (soil temp, ext temp, humidity, light).
+// Persisted as "probe_plants" in device_prefs; when unset every probe belongs to "plant_id".
+struct PlantMap {
+  int probePlant[SOIL_PROBE_COUNT];  // Plant ID per probe, -1 if the probe is unused
+  int plantIds[SOIL_PROBE_COUNT];    // Distinct plants in order of their first probe
+  uint8_t probeMask[SOIL_PROBE_COUNT];  // Bit k set when probe k+1 belongs to plantIds[i]
+  int plantCount;
+
+  PlantMap() { assignAll(-1); }
+
+  // Puts every probe in one plant
+  void assignAll(int plantId);
+
+  // Sets the plant of each probe from a list of SOIL_PROBE_COUNT IDs. Returns false, leaving
+  // the map unchanged, if the count is wrong or no probe is assigned.
+  bool assign(const int* plants, int count);
+
+  // Parses "id,id,..." (one per probe, -1 for unused) as written over BLE
+  bool assign(const String& csv);
+
+  // Formats the map as "id,id,..."
+  String toString() const;
+
+  // First probe of plant i; its moisture drives the watering prediction
+  ChannelId primaryProbe(int i) const;
+
+  void load();
+  void save() const;
+};
+
+// The map the tasks share. A change is built in a PlantMap of its own and published whole; every
+// task works from its own copy, so none sees a new plantCount with the old IDs and masks.
+class SharedPlantMap {
+public:
+  PlantMap get();
+
+  // Replaces the map; copies taken before it are out of date. A map published with save set is
+  // saved by the sampling task's next sync().
+  void publish(const PlantMap& map, bool save = false);
+
+  // Copies the map into copy if it was published since version, and updates version. Returns
+  // true if it was.
+  bool refresh(PlantMap& copy, uint32_t& version);
+
+  // Sampling task only, as it owns the stored map: saves a published map marked for saving, and
+  // while no plant is assigned picks up one provisioning stored after boot
+  void sync();
+
+private:
+  std::mutex lock;
+  PlantMap map;
+  uint32_t changes = 0;
+  bool unsaved = false;
+};
+
+extern SharedPlantMap plantMap;
+
+#endif // PLANTMAP_H
@@ -47,6 +47,7 @@
 #endif
 #include <HTTPClient.h>
 #include "Config.h"
+#include "BackendRequest.h"
 
 extern Preferences preferences;
 
@@ -161,7 +162,7 @@ bool ProvisioningClass::updateBackendState(const char* new_state) {
 
     HTTPClient http;
     String url = String(backend_url) + "/api/provisioning/status";
-    http.begin(url);
+    beginBackendRequest(http, url);
     http.addHeader("Content-Type", "application/json");
 
     // Create JSON payload
@@ -197,7 +198,7 @@ bool ProvisioningClass::verifyBackendConnection() {
 
     HTTPClient http;
     String url = String(backend_url) + "/api/provisioning/verify";
-    http.begin(url);
+    beginBackendRequest(http, url);
     http.addHeader("Content-Type", "application/json");
 
     // Create JSON payload
@@ -745,7 +746,7 @@ void handle_wifi_connected() {
             HTTPClient http;
             String url = String(PLANTGURU_SERVER) + "/api/provision/verify";
             Serial.printf("Making verification request to: %s\n", url.c_str());
-            http.begin(url);
+            beginBackendRequest(http, url);
             http.addHeader("Content-Type", "application/json");
 
             // Create verification payload
@@ -887,7 +888,7 @@ bool ProvisioningClass::verifyWiFiConnection() {
     // Try to ping the backend server to verify internet connectivity
     HTTPClient http;
     String url = String(backend_url) + "/api/ping";
-    http.begin(url);
+    beginBackendRequest(http, url);
     
     int httpCode = http.GET();
     bool success = (httpCode == 200);
@@ -0,0 +1,191 @@
+#include "RecordCodec.h"
+
+// Payload bits for the 10, 110 and 1110 prefixes
+static const uint8_t TIMESTAMP_WIDTHS[3] = {7, 9, 12};  // Delta-of-delta in seconds
+static const uint8_t SEQUENCE_WIDTHS[3] = {4, 8, 16};   // Records skipped since the previous one
+static const uint8_t VALUE_WIDTHS[3] = {4, 8, 16};      // Change in units of the last kept decimal
+static const uint8_t PREFIXES[3] = {0x2, 0x6, 0xE};      // 10, 110, 1110
+
+static const int32_t MISSING = INT32_MIN;
+
+struct SlotScales {
+  float scale[STORED_CHANNEL_COUNT];
+};
+
+static constexpr SlotScales makeSlotScales() {
+  SlotScales scales = {};
+  for (size_t slot = 0; slot < STORED_CHANNEL_COUNT; slot++) {
+    scales.scale[slot] = slotScale(slot);
+  }
+  return scales;
+}
+
+static constexpr SlotScales SLOT_SCALES = makeSlotScales();
+
+static int32_t quantize(float value, size_t slot) {
+  if (isnan(value)) {
+    return MISSING;
+  }
+  float scaled = value * SLOT_SCALES.scale[slot];
+  if (scaled > 2.0e9f) scaled = 2.0e9f;
+  if (scaled < -2.0e9f) scaled = -2.0e9f;
+  return (int32_t)lroundf(scaled);
+}
+
+static uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+RecordEncoder::RecordEncoder(uint8_t* out, size_t capacity)
+  : out(out), capacityBits(capacity * 8), bitPos(RECORD_BLOCK_HEADER * 8), overflow(false), records(0),
+    prevTimestamp(0), prevDelta(0), prevSequence(0), prevValues() {
+  out[0] = RECORD_BLOCK_VERSION;
+  out[1] = STORED_CHANNEL_COUNT;
+  out[2] = 0;
+  out[3] = 0;
+}
+
+void RecordEncoder::writeBits(uint32_t value, int bits) {
+  if (bitPos + bits > capacityBits) {
+    overflow = true;
+    return;
+  }
+  for (int i = bits - 1; i >= 0; i--) {
+    uint8_t mask = 0x80 >> (bitPos & 7);
+    if ((value >> i) & 1) {
+      out[bitPos >> 3] |= mask;
+    } else {
+      out[bitPos >> 3] &= ~mask;
+    }
+    bitPos++;
+  }
+}
+
+void RecordEncoder::writeField(int64_t change, int32_t absolute, bool forceAbsolute, const uint8_t (&widths)[3]) {
+  if (!forceAbsolute) {
+    if (change == 0) {
+      writeBits(0, 1);
+      return;
+    }
+    uint64_t zz = zigzag(change);
+    for (int k = 0; k < 3; k++) {
+      if (zz < (1ull << widths[k])) {
+        writeBits(PREFIXES[k], k + 2);
+        writeBits((uint32_t)zz, widths[k]);
+        return;
+      }
+    }
+  }
+  writeBits(0xF, 4);
+  writeBits((uint32_t)absolute, 32);
+}
+
+bool RecordEncoder::append(const SensorData& data) {
+  if (records == 0xFFFF) {
+    return false;
+  }
+  size_t startBit = bitPos;
+  int32_t timestamp = (int32_t)data.timestamp;
+  int64_t delta = (int64_t)timestamp - prevTimestamp;
+  writeField(delta - prevDelta, timestamp, records == 0, TIMESTAMP_WIDTHS);
+  // Sequences only increase; anything else (a reset counter) is escaped
+  int64_t skipped = (int64_t)data.sequence - prevSequence - 1;
+  writeField(skipped, (int32_t)data.sequence, records == 0 || skipped < 0, SEQUENCE_WIDTHS);
+
+  int32_t values[STORED_CHANNEL_COUNT];
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    values[c] = quantize(data.values[c], c);
+    // Going to or from missing is escaped; staying missing is an ordinary zero change
+    bool absolute = records == 0 || (values[c] == MISSING) != (prevValues[c] == MISSING);
+    writeField((int64_t)values[c] - prevValues[c], values[c], absolute, VALUE_WIDTHS);
+  }
+
+  if (overflow) {
+    bitPos = startBit;
+    overflow = false;
+    return false;
+  }
+
+  prevDelta = records == 0 ? 0 : delta;
+  prevTimestamp = timestamp;
+  prevSequence = data.sequence;
+  memcpy(prevValues, values, sizeof(values));
+  records++;
+  out[2] = records & 0xFF;
+  out[3] = records >> 8;
+  return true;
+}
+
+RecordDecoder::RecordDecoder(const uint8_t* in, size_t length)
+  : in(in), lengthBits(length * 8), bitPos(RECORD_BLOCK_HEADER * 8), ok(false), records(0), decoded(0),
+    prevTimestamp(0), prevDelta(0), prevSequence(0), prevValues() {
+  if (length >= RECORD_BLOCK_HEADER && in[0] == RECORD_BLOCK_VERSION && in[1] == STORED_CHANNEL_COUNT) {
+    records = in[2] | (in[3] << 8);
+    ok = true;
+  }
+}
+
+uint32_t RecordDecoder::readBits(int bits) {
+  if (bitPos + bits > lengthBits) {
+    ok = false;
+    return 0;
+  }
+  uint32_t value = 0;
+  for (int i = 0; i < bits; i++) {
+    value = (value << 1) | ((in[bitPos >> 3] >> (7 - (bitPos & 7))) & 1);
+    bitPos++;
+  }
+  return value;
+}
+
+bool RecordDecoder::readField(int64_t& change, int32_t& absolute, const uint8_t (&widths)[3]) {
+  int ones = 0;
+  while (ones < 4 && readBits(1)) {
+    ones++;
+  }
+  if (ones == 4) {
+    absolute = (int32_t)readBits(32);
+    return true;
+  }
+  change = ones == 0 ? 0 : unzigzag(readBits(widths[ones - 1]));
+  return false;
+}
+
+bool RecordDecoder::next(SensorData& data) {
+  if (!ok || decoded >= records) {
+    return false;
+  }
+
+  int64_t change = 0;
+  int32_t absolute = 0;
+  int32_t timestamp;
+  if (readField(change, absolute, TIMESTAMP_WIDTHS)) {
+    timestamp = absolute;
+  } else {
+    timestamp = (int32_t)(prevTimestamp + prevDelta + change);
+  }
+  prevDelta = decoded == 0 ? 0 : (int64_t)timestamp - prevTimestamp;
+  prevTimestamp = timestamp;
+  data.timestamp = timestamp;
+
+  uint32_t sequence = readField(change, absolute, SEQUENCE_WIDTHS) ? (uint32_t)absolute
+                                                                   : (uint32_t)(prevSequence + 1 + change);
+  prevSequence = sequence;
+  data.sequence = sequence;
+
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    int32_t value = readField(change, absolute, VALUE_WIDTHS) ? absolute : (int32_t)(prevValues[c] + change);
+    prevValues[c] = value;
+    data.values[c] = value == MISSING ? NAN : value / SLOT_SCALES.scale[c];
+  }
+
+  if (!ok) {
+    return false;
+  }
+  decoded++;
+  return true;
+}
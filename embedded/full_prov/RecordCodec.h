@@ -0,0 +1,78 @@
+#ifndef RECORDCODEC_H
+#define RECORDCODEC_H
+
+#include "Config.h"
+
+// Compressed blocks of SensorData for the persisted buffer and the SD history, after Facebook's
+// Gorilla format. Timestamps are stored as delta-of-delta, so a steady record interval costs one
+// bit. Sequence numbers are stored as the gap to the previous one less one, so consecutive
+// records also cost one bit. Channel values are fixed point at the channel's wire precision (CHANNELS[].decimals) and
+// stored as the change from the previous record, so an unchanged reading also costs one bit.
+//
+// Block: version byte, channel count byte, little-endian uint16 record count, then the bit
+// stream, MSB first. Every field uses the same prefix code:
+//   0              no change
+//   10   + small   zigzag change
+//   110  + medium
+//   1110 + large
+//   1111 + 32 bits absolute value; the first record, missing values (NAN) and anything larger
+// Each record is its timestamp, its sequence number, then one field per stored channel.
+#define RECORD_BLOCK_VERSION 2
+#define RECORD_BLOCK_HEADER 4
+
+class RecordEncoder {
+public:
+  // Encodes into out[0..capacity); capacity must be at least RECORD_BLOCK_HEADER
+  RecordEncoder(uint8_t* out, size_t capacity);
+
+  // Adds one record. Returns false, leaving the block as it was, once it is full.
+  bool append(const SensorData& data);
+
+  // Block size in bytes so far; the block is always complete and decodable
+  size_t size() const { return (bitPos + 7) / 8; }
+  int count() const { return records; }
+
+private:
+  uint8_t* out;
+  size_t capacityBits;
+  size_t bitPos;
+  bool overflow;
+  int records;
+  int32_t prevTimestamp;
+  int64_t prevDelta;
+  uint32_t prevSequence;
+  int32_t prevValues[STORED_CHANNEL_COUNT];
+
+  void writeBits(uint32_t value, int bits);
+  void writeField(int64_t change, int32_t absolute, bool forceAbsolute, const uint8_t (&widths)[3]);
+};
+
+class RecordDecoder {
+public:
+  // Returns false from valid() if the header doesn't match this firmware's channel layout
+  RecordDecoder(const uint8_t* in, size_t length);
+
+  bool valid() const { return ok; }
+  int count() const { return records; }
+
+  // Decodes the next record; false at the end of the block or on a truncated block
+  bool next(SensorData& data);
+
+private:
+  const uint8_t* in;
+  size_t lengthBits;
+  size_t bitPos;
+  bool ok;
+  int records;
+  int decoded;
+  int32_t prevTimestamp;
+  int64_t prevDelta;
+  uint32_t prevSequence;
+  int32_t prevValues[STORED_CHANNEL_COUNT];
+
+  uint32_t readBits(int bits);
+  // Returns true with the absolute value in absolute, or false with the change in change
+  bool readField(int64_t& change, int32_t& absolute, const uint8_t (&widths)[3]);
+};
+
+#endif // RECORDCODEC_H
@@ -0,0 +1,268 @@
+#include "Rollups.h"
+#include <string.h>
+
+RollupStore rollups;
+
+static int32_t coarseStart(int32_t start) {
+  return start - start % ROLLUP_COARSE_SPAN;
+}
+
+// Folds b, which is newer, into a
+static void combine(Rollup& a, const Rollup& b) {
+  uint32_t records = (uint32_t)a.records + b.records;
+  a.records = records > UINT16_MAX ? UINT16_MAX : records;
+  a.lastSequence = b.lastSequence;
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    if (b.count[c] == 0) {
+      continue;
+    }
+    if (a.count[c] == 0) {
+      a.min[c] = b.min[c];
+      a.max[c] = b.max[c];
+      a.mean[c] = b.mean[c];
+      a.count[c] = b.count[c];
+      continue;
+    }
+    uint32_t count = (uint32_t)a.count[c] + b.count[c];
+    int64_t sum = (int64_t)a.mean[c] * a.count[c] + (int64_t)b.mean[c] * b.count[c];
+    a.mean[c] = (int16_t)((sum + (sum < 0 ? -(int64_t)count : (int64_t)count) / 2) / (int64_t)count);
+    a.count[c] = count > UINT16_MAX ? UINT16_MAX : count;
+    if (b.min[c] < a.min[c]) a.min[c] = b.min[c];
+    if (b.max[c] > a.max[c]) a.max[c] = b.max[c];
+  }
+}
+
+size_t Rollup::writeJson(char* out, size_t capacity, int plantId, uint32_t probeMask) const {
+  if (capacity < 3) return 0;
+  size_t len = 0;
+  out[len++] = '{';
+  auto append = [&](const char* format, auto... value) {
+    if (len >= capacity) return;
+    int n = snprintf(out + len, capacity - len, format, value...);
+    len += n > 0 ? n : 0;
+  };
+
+  time_t secs = start;
+  struct tm timeInfo;
+  gmtime_r(&secs, &timeInfo);
+  char iso[20];
+  strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%S", &timeInfo);
+  append("\"plant_id\":%d,\"first_seq\":%lu,\"last_seq\":%lu,\"span\":%u,\"records\":%u,\"time_stamp\":\"%s\"",
+         plantId, (unsigned long)firstSequence, (unsigned long)lastSequence, (unsigned)span, (unsigned)records, iso);
+
+  int plantProbe = 0;
+  forEachChannel([&](auto id) {
+    constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+    constexpr size_t slot = channelSlot(spec.id);
+    char key[24];
+    if constexpr (spec.probe > 0) {
+      if (!(probeMask & (1u << (spec.probe - 1)))) return;
+      snprintf(key, sizeof(key), "%s%d", spec.wireKey, ++plantProbe);
+    } else {
+      snprintf(key, sizeof(key), "%s", spec.wireKey);
+    }
+    if (count[slot] == 0) return;
+    float scale = slotScale(slot);
+    int decimals = spec.decimals;
+    append(",\"%s\":{\"min\":%.*f,\"max\":%.*f,\"mean\":%.*f,\"count\":%u}", key, decimals, min[slot] / scale,
+           decimals, max[slot] / scale, decimals, mean[slot] / scale, (unsigned)count[slot]);
+  });
+
+  if (len + 2 > capacity) return 0;
+  out[len++] = '}';
+  out[len] = '\0';
+  return len;
+}
+
+RollupStore::RollupStore() : size(0), reserved(0), changeCount(0), isOpen(false), open(), sums(), folded(0), lost(0) {}
+
+void RollupStore::start(int32_t bucket, uint32_t sequence) {
+  memset(&open, 0, sizeof(open));
+  memset(sums, 0, sizeof(sums));
+  open.start = bucket;
+  open.span = ROLLUP_FINE_SPAN;
+  open.firstSequence = sequence;
+  isOpen = true;
+}
+
+void RollupStore::fold(const int16_t* values, ChannelMask missing, int32_t timestamp, uint32_t sequence) {
+  if (timestamp <= 0) {
+    lost++;  // Recorded before the clock was set; there is no span to put it in
+    return;
+  }
+  int32_t bucket = timestamp - timestamp % ROLLUP_FINE_SPAN;
+  if (isOpen && bucket != open.start) {
+    close();
+  }
+  if (!isOpen) {
+    start(bucket, sequence);
+  }
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    if (missing & (1u << c)) {
+      continue;
+    }
+    int16_t value = values[c];
+    if (open.count[c] == 0 || value < open.min[c]) open.min[c] = value;
+    if (open.count[c] == 0 || value > open.max[c]) open.max[c] = value;
+    sums[c] += value;
+    open.count[c]++;
+  }
+  open.records++;
+  open.lastSequence = sequence;
+  folded++;
+}
+
+void RollupStore::close() {
+  if (!isOpen) {
+    return;
+  }
+  for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+    int32_t n = open.count[c];
+    if (n > 0) {
+      open.mean[c] = (int16_t)((sums[c] + (sums[c] < 0 ? -n : n) / 2) / n);
+    }
+  }
+  isOpen = false;
+  append(open);
+}
+
+// Merges the oldest unreserved run of rollups within one coarse span into one coarse rollup.
+// Returns false if no run has more than one rollup.
+bool RollupStore::merge() {
+  int i = reserved;
+  while (i < size) {
+    int32_t hour = coarseStart(entries[i].start);
+    int j = i + 1;
+    while (j < size && coarseStart(entries[j].start) == hour) {
+      j++;
+    }
+    if (j - i > 1) {
+      for (int k = i + 1; k < j; k++) {
+        combine(entries[i], entries[k]);
+      }
+      entries[i].start = hour;
+      entries[i].span = ROLLUP_COARSE_SPAN;
+      memmove(&entries[i + 1], &entries[j], (size - j) * sizeof(Rollup));
+      size -= j - i - 1;
+      return true;
+    }
+    i = j;
+  }
+  return false;
+}
+
+void RollupStore::append(const Rollup& rollup) {
+  std::lock_guard<std::mutex> guard(lock);
+  changeCount++;
+  if (size == ROLLUP_CAPACITY && !merge()) {
+    if (reserved == size) {
+      lost += rollup.records;
+      return;
+    }
+    // No two unreserved rollups share a coarse span: the oldest goes
+    lost += entries[reserved].records;
+    Serial.printf("Rollups full. Dropped the oldest, %u records\n", (unsigned)entries[reserved].records);
+    memmove(&entries[reserved], &entries[reserved + 1], (size - reserved - 1) * sizeof(Rollup));
+    size--;
+  }
+  entries[size++] = rollup;
+}
+
+int RollupStore::take(RollupBatch& batch, const PlantMap& plants, const char* deviceId) {
+  int n;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    n = size - reserved < ROLLUPS_PER_REQUEST ? size - reserved : ROLLUPS_PER_REQUEST;
+    memcpy(batch.rollups, &entries[reserved], n * sizeof(Rollup));
+    reserved += n;
+  }
+
+  int header = snprintf(batch.payload, sizeof(batch.payload), "{\"device_id\":\"%.*s\",\"rollups\":[",
+                        DEVICE_ID_MAX, deviceId);
+  batch.payloadLength = header > 0 ? header : 0;
+  batch.count = 0;
+  for (int r = 0; r < n; r++) {
+    size_t length = batch.payloadLength;
+    bool fits = true;
+    for (int i = 0; i < plants.plantCount && fits; i++) {
+      if (length > batch.payloadLength || r > 0) {
+        batch.payload[length++] = ',';
+      }
+      size_t written = batch.rollups[r].writeJson(batch.payload + length, sizeof(batch.payload) - length - 2,
+                                                  plants.plantIds[i], plants.probeMask[i]);
+      fits = written > 0;
+      length += written;
+    }
+    if (!fits) {
+      break;  // The rest wait for the next request
+    }
+    batch.payloadLength = length;
+    batch.count++;
+  }
+  batch.payload[batch.payloadLength++] = ']';
+  batch.payload[batch.payloadLength++] = '}';
+  batch.payload[batch.payloadLength] = '\0';
+
+  std::lock_guard<std::mutex> guard(lock);
+  reserved -= n - batch.count;
+  return batch.count;
+}
+
+void RollupStore::commit(RollupBatch& batch) {
+  std::lock_guard<std::mutex> guard(lock);
+  changeCount++;
+  memmove(&entries[0], &entries[batch.count], (size - batch.count) * sizeof(Rollup));
+  size -= batch.count;
+  reserved -= batch.count;
+  batch.count = 0;
+}
+
+void RollupStore::release(RollupBatch& batch) {
+  std::lock_guard<std::mutex> guard(lock);
+  reserved -= batch.count;
+  batch.count = 0;
+}
+
+size_t RollupStore::save(uint8_t* out, size_t capacity) {
+  uint16_t layout = sizeof(Rollup);
+  if (capacity < sizeof(layout)) return 0;
+  memcpy(out, &layout, sizeof(layout));
+  std::lock_guard<std::mutex> guard(lock);
+  int n = (capacity - sizeof(layout)) / sizeof(Rollup);
+  if (n > size) n = size;
+  memcpy(out + sizeof(layout), &entries[size - n], n * sizeof(Rollup));
+  return sizeof(layout) + n * sizeof(Rollup);
+}
+
+void RollupStore::load(const uint8_t* data, size_t length) {
+  uint16_t layout = 0;
+  if (length < sizeof(layout)) return;
+  memcpy(&layout, data, sizeof(layout));
+  length -= sizeof(layout);
+  if (layout != sizeof(Rollup) || length % sizeof(Rollup) != 0 || length / sizeof(Rollup) > ROLLUP_CAPACITY) {
+    return;  // Saved by a firmware with other channels
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  size = length / sizeof(Rollup);
+  reserved = 0;
+  memcpy(entries, data + sizeof(layout), length);
+}
+
+uint32_t RollupStore::changes() {
+  std::lock_guard<std::mutex> guard(lock);
+  return changeCount;
+}
+
+int RollupStore::count() {
+  std::lock_guard<std::mutex> guard(lock);
+  return size;
+}
+
+int RollupStore::coarseCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  int n = 0;
+  for (int i = 0; i < size; i++) {
+    n += entries[i].span == ROLLUP_COARSE_SPAN;
+  }
+  return n;
+}
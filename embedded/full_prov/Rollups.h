@@ -0,0 +1,100 @@
+#ifndef ROLLUPS_H
+#define ROLLUPS_H
+
+#include <mutex>
+#include "Config.h"
+#include "Memory.h"
+#include "PlantMap.h"
+#include "UploadBatch.h"
+
+static_assert(ROLLUP_COARSE_SPAN % ROLLUP_FINE_SPAN == 0, "a coarse rollup must cover whole fine ones");
+
+// Lower-resolution history for outages longer than the buffer. Instead of dropping the oldest
+// record, a full buffer folds it into a rollup (Memory.cpp): min, max, mean and count per channel
+// over ROLLUP_FINE_SPAN seconds, kept as running sums so no raw records are held. A rollup closes
+// when a record past its span is folded in, or when the buffer has room again. When the store is
+// full its oldest rollups are merged into ROLLUP_COARSE_SPAN ones, and only a store of those drops
+// its oldest. Values are in the buffer's fixed point (slotScale()).
+//
+// Rollups go to their own endpoint, oldest first, tagged with their span and the sequence numbers
+// of the records they replace. The closed ones are saved to NVS with the buffer (Memory.cpp), as
+// many of the newest as fit in ROLLUP_BLOCK_BYTES, and reloaded with it at boot. The open one is
+// lost with a restart.
+//
+// The producer (the sampling task) folds and closes; the consumer (the upload task) reserves the
+// oldest rollups with take() and removes them with commit() or releases them with release().
+// Merging skips reserved rollups.
+struct Rollup {
+  int32_t start;           // Unix seconds, a multiple of span
+  uint16_t span;           // ROLLUP_FINE_SPAN or ROLLUP_COARSE_SPAN seconds
+  uint16_t records;        // Raw records folded in
+  uint32_t firstSequence;  // Numbers of the first and last of them
+  uint32_t lastSequence;
+  int16_t min[STORED_CHANNEL_COUNT];
+  int16_t max[STORED_CHANNEL_COUNT];
+  int16_t mean[STORED_CHANNEL_COUNT];
+  uint16_t count[STORED_CHANNEL_COUNT];  // Records that had the channel; 0 leaves it out
+
+  // Appends this rollup as a JSON object for one plant, its probes picked by probeMask as in
+  // SensorData::writeJson(). Returns the number of characters written, or 0 if it didn't fit.
+  size_t writeJson(char* out, size_t capacity, int plantId, uint32_t probeMask) const;
+};
+
+// Rollups reserved for one upload and their serialized request:
+//   {"device_id":"<id>","rollups":[...]}
+struct RollupBatch {
+  Rollup rollups[ROLLUPS_PER_REQUEST];
+  int count;
+  char payload[ROLLUP_JSON_MAX];
+  size_t payloadLength;
+};
+
+class RollupStore {
+public:
+  RollupStore();
+
+  // Producer: a record leaving the full buffer, as its fixed point values and missing mask
+  void fold(const int16_t* values, ChannelMask missing, int32_t timestamp, uint32_t sequence);
+  // Producer: closes the open rollup, if any, so it can be uploaded
+  void close();
+
+  // Consumer: reserves the oldest rollups that fit one request and serializes them once per
+  // plant. Returns the number taken.
+  int take(RollupBatch& batch, const PlantMap& plants, const char* deviceId);
+  void commit(RollupBatch& batch);
+  void release(RollupBatch& batch);
+
+  // Producer: copies the newest closed rollups that fit in capacity into out, tagged with the size
+  // of a Rollup. Returns the bytes written.
+  size_t save(uint8_t* out, size_t capacity);
+  // Setup only: restores rollups written by save(); ignores a block from a different Rollup layout
+  void load(const uint8_t* data, size_t length);
+  // Changes whenever the closed rollups do, so a caller can tell when to save them again
+  uint32_t changes();
+
+  int count();
+  uint32_t foldedRecords() const { return folded; }  // Raw records replaced by rollups
+  uint32_t lostRecords() const { return lost; }      // Raw records dropped without one
+  int coarseCount();
+
+private:
+  Rollup entries[ROLLUP_CAPACITY];  // Oldest first
+  int size;
+  int reserved;
+  uint32_t changeCount;
+  std::mutex lock;  // Between append() and the consumer; the open rollup is the producer's alone
+
+  bool isOpen;
+  Rollup open;
+  int32_t sums[STORED_CHANNEL_COUNT];
+  uint32_t folded;
+  uint32_t lost;
+
+  void start(int32_t bucket, uint32_t sequence);
+  void append(const Rollup& rollup);
+  bool merge();
+};
+
+extern RollupStore rollups;
+
+#endif // ROLLUPS_H
@@ -0,0 +1,348 @@
+#ifndef SDMEMORY_H
+#define SDMEMORY_H
+
+/*
+ * Connect the SD card to the following pins:
+ *
+ * SD Card | ESP32
+ *    D2       -
+ *    D3       SS
+ *    CMD      MOSI
+ *    VSS      GND
+ *    VDD      3.3V
+ *    CLK      SCK
+ *    VSS      GND
+ *    D0       MISO
+ *    D1       -
+ */
+#include "FS.h"
+#include "SD.h"
+#include "SPI.h"
+#include "Config.h"
+#include "RecordCodec.h"
+
+#define SD_BLOCK_BYTES 512  // One SD sector per compressed block
+
+// Record history on the SD card as a sequence of compressed blocks (RecordCodec.h), one per sector.
+// The file stays open, and the blocks written since the last flush live in a RAM run of
+// SD_WRITE_BLOCKS sectors that maps onto the file sector for sector. flush() writes the changed
+// blocks of the run in one write and syncs the file; a record costs an encode into RAM, and the
+// card only sees a write every SD_FLUSH_RECORDS records or SD_FLUSH_INTERVAL, or when the run is
+// full. The file grows SD_PREALLOCATE_BLOCKS zeroed sectors at a time, so a flush rewrites
+// sectors the file already owns instead of allocating clusters and updating the FAT.
+//
+// Records are durable once flush() returns true. A power cut loses at most the records since,
+// which are also in the NVS upload buffer until uploaded. Call flush() before sleeping or
+// restarting on purpose.
+class SDmemory {
+  private:
+    static_assert(SD_WRITE_BLOCKS >= 2, "init() needs a spare sector");
+
+    const char* filename = "/history.bin";
+    File file;
+    uint8_t blocks[SD_WRITE_BLOCKS][SD_BLOCK_BYTES];  // Blocks firstBuffered..blockIndex of the file
+    RecordEncoder encoder{blocks[0], SD_BLOCK_BYTES};
+    uint32_t firstBuffered = 0;
+    uint32_t blockIndex = 0;        // Block being filled
+    uint32_t firstDirty = 0;        // First block changed since the last flush, when dirty
+    uint32_t allocatedBlocks = 0;   // Sectors in the file, written or preallocated
+    int sealedRecords = 0;          // Records in the blocks before blockIndex
+    int unflushedRecords = 0;
+    uint32_t hintBlock = 0;         // A sealed block and the index of its first record, where
+    int hintFirst = 0;              // the last read started; sequential reads resume from it
+    unsigned long lastFlushMs = 0;
+    bool dirty = false;
+    bool ready = false;
+
+    // Worst case per record: every field escaped to a 36 bit absolute value
+    static constexpr int maxRecordBits() {
+      return 36 * (1 + (int)STORED_CHANNEL_COUNT);
+    }
+
+    uint8_t* slot(uint32_t index) {
+      return blocks[index - firstBuffered];
+    }
+
+    // Extends the file with zeroed sectors until it holds blocksNeeded. Zeroed sectors never
+    // decode as blocks, so init() stops at the first one.
+    bool preallocate(uint32_t blocksNeeded) {
+      if (blocksNeeded <= allocatedBlocks) {
+        return true;
+      }
+      static const uint8_t zeros[SD_BLOCK_BYTES] = {};
+      uint32_t target = allocatedBlocks + SD_PREALLOCATE_BLOCKS;
+      if (target < blocksNeeded) {
+        target = blocksNeeded;
+      }
+      if (!file.seek(allocatedBlocks * SD_BLOCK_BYTES)) {
+        return false;
+      }
+      while (allocatedBlocks < target) {
+        if (file.write(zeros, sizeof(zeros)) != sizeof(zeros)) {
+          return false;
+        }
+        allocatedBlocks++;
+      }
+      return true;
+    }
+
+    bool openFile() {
+      if (!SD.exists(filename)) {
+        File created = SD.open(filename, FILE_WRITE);
+        if (!created) {
+          return false;
+        }
+        created.close();
+      }
+      file = SD.open(filename, "r+");
+      return (bool)file;
+    }
+
+  public:
+    // Decodes records [start, end] in order, calling f(index, record)
+    template <typename F>
+    bool forEachRecord(int start, int end, F&& f) {
+      if (!file) {
+        return false;
+      }
+      static uint8_t readBlock[SD_BLOCK_BYTES];
+      uint32_t b = 0;
+      int first = 0;
+      if (start >= hintFirst && hintBlock <= blockIndex) {
+        b = hintBlock;
+        first = hintFirst;
+      }
+      for (; b <= blockIndex && first <= end; b++) {
+        const uint8_t* data = readBlock;
+        if (b >= firstBuffered) {
+          data = slot(b);  // Not necessarily on the card yet
+        } else if (!file.seek(b * SD_BLOCK_BYTES) || file.read(readBlock, sizeof(readBlock)) != sizeof(readBlock)) {
+          break;
+        }
+        RecordDecoder decoder(data, SD_BLOCK_BYTES);
+        if (!decoder.valid()) {
+          break;
+        }
+        if (first + decoder.count() <= start) {
+          first += decoder.count();  // Whole block is before the range; skip decoding it
+          continue;
+        }
+        if (first <= start && b < blockIndex) {
+          hintBlock = b;
+          hintFirst = first;
+        }
+        SensorData record;
+        for (int i = first; i <= end && decoder.next(record); i++) {
+          if (i >= start) {
+            f(i, record);
+          }
+        }
+        first += decoder.count();
+      }
+      return true;
+    }
+
+    // Opens the file, creating it if it doesn't exist, and picks up its last block
+    bool init() {
+      if (!SD.begin(SD_PIN, SPI, 4000000, "/sd", 5)) {
+        return false;
+      }
+      if (SD.cardType() == CARD_NONE) {
+        return false;
+      }
+      if (!openFile()) {
+        return false;
+      }
+
+      allocatedBlocks = file.size() / SD_BLOCK_BYTES;
+      sealedRecords = 0;
+      int lastCount = -1;  // Records in the last valid block found so far
+      uint32_t b = 0;
+      for (; b < allocatedBlocks; b++) {
+        if (!file.seek(b * SD_BLOCK_BYTES) || file.read(blocks[0], SD_BLOCK_BYTES) != SD_BLOCK_BYTES) {
+          break;
+        }
+        RecordDecoder decoder(blocks[0], SD_BLOCK_BYTES);
+        if (!decoder.valid()) {
+          break;  // Preallocated, or unreadable and overwritten by the next block
+        }
+        if (lastCount >= 0) {
+          sealedRecords += lastCount;
+        }
+        lastCount = decoder.count();
+      }
+
+      blockIndex = lastCount < 0 ? 0 : b - 1;
+      firstBuffered = blockIndex;
+      encoder = RecordEncoder(blocks[0], SD_BLOCK_BYTES);
+      if (lastCount >= 0) {
+        // Re-encode the last block so appends continue from its state
+        if (!file.seek(blockIndex * SD_BLOCK_BYTES) || file.read(blocks[1], SD_BLOCK_BYTES) != SD_BLOCK_BYTES) {
+          return false;
+        }
+        RecordDecoder last(blocks[1], SD_BLOCK_BYTES);
+        SensorData record;
+        while (last.next(record)) {
+          encoder.append(record);
+        }
+      }
+      dirty = false;
+      unflushedRecords = 0;
+      hintBlock = 0;
+      hintFirst = 0;
+      lastFlushMs = millis();
+      ready = true;
+      return true;
+    }
+
+    // Writes every block changed since the last flush and syncs the file
+    bool flush() {
+      if (!ready || !dirty) {
+        return ready;
+      }
+      if (!preallocate(blockIndex + 1)) {
+        return false;
+      }
+      size_t length = (blockIndex - firstDirty + 1) * SD_BLOCK_BYTES;
+      bool ok = file.seek(firstDirty * SD_BLOCK_BYTES) && file.write(slot(firstDirty), length) == length;
+      file.flush();
+      if (!ok) {
+        return false;
+      }
+      dirty = false;
+      unflushedRecords = 0;
+      lastFlushMs = millis();
+      return true;
+    }
+
+    // Returns true if the setup was successful
+    bool isSetup() {
+      return ready && file;
+    }
+
+    // Returns the number of records stored on the SD card
+    int getNumRecords() {
+      return sealedRecords + encoder.count();
+    }
+
+    // Index of the oldest record kept; the card keeps them all
+    int oldestRecord() {
+      return 0;
+    }
+
+    // Estimates the number of records the card can hold at the compression seen so far
+    int getMaxRecords() {
+      uint64_t blocks = SD.cardSize() / SD_BLOCK_BYTES;
+      uint64_t perBlock = blockIndex > 0 ? sealedRecords / blockIndex
+                                         : (SD_BLOCK_BYTES - RECORD_BLOCK_HEADER) * 8 / maxRecordBits();
+      uint64_t records = blocks * perBlock;
+      return records > INT32_MAX ? INT32_MAX : (int)records;
+    }
+
+    // Returns the number of records that can still be stored on the SD card
+    int getRemainingRecords() {
+      return getMaxRecords() - getNumRecords();
+    }
+
+    // Appends a single record to the current block; flushes when a threshold is reached
+    bool writeData(const SensorData& data) {
+      if (!encoder.append(data)) {
+        // The block is full. Start the next one in the following sector of the run, or write
+        // the run out and start it over if this was its last sector.
+        if (blockIndex + 1 - firstBuffered == SD_WRITE_BLOCKS) {
+          if (!flush()) {
+            return false;
+          }
+          firstBuffered = blockIndex + 1;
+        }
+        sealedRecords += encoder.count();
+        blockIndex++;
+        encoder = RecordEncoder(slot(blockIndex), SD_BLOCK_BYTES);
+        if (!encoder.append(data)) {
+          return false;
+        }
+      }
+      if (!dirty) {
+        firstDirty = blockIndex;
+        dirty = true;
+      }
+      unflushedRecords++;
+      if (unflushedRecords >= SD_FLUSH_RECORDS || millis() - lastFlushMs >= SD_FLUSH_INTERVAL) {
+        return flush();
+      }
+      return true;
+    }
+
+    // Reads a single record at the given index
+    bool readSingleData(int index, SensorData& data) {
+      bool found = false;
+      if (index < 0 || index >= getNumRecords()) {
+        return false;
+      }
+      forEachRecord(index, index, [&](int, const SensorData& record) {
+        data = record;
+        found = true;
+      });
+      return found;
+    }
+
+    // Reads all records from the file
+    bool readAllData(SensorData*& data, int& numRecords) {
+      numRecords = getNumRecords();
+      if (numRecords <= 0) {
+        return false;
+      }
+      return readDataRange(0, numRecords - 1, data, numRecords);
+    }
+
+    // Reads records within the given index range
+    bool readDataRange(int start, int end, SensorData*& data, int& numRecords) {
+      if (end > getNumRecords()-1 || start > end || start < 0 || end < 0) {
+        return false;
+      }
+      numRecords = end - start + 1;
+      data = new SensorData[numRecords];
+      return forEachRecord(start, end, [&](int i, const SensorData& record) {
+        data[i - start] = record;
+      });
+    }
+
+    // Copies up to maxRecords records from index start on into out; returns how many were copied
+    int readRecords(int start, SensorData* out, int maxRecords) {
+      int end = getNumRecords() - 1;
+      if (start < 0 || start > end || maxRecords <= 0) {
+        return 0;
+      }
+      if (end - start + 1 > maxRecords) {
+        end = start + maxRecords - 1;
+      }
+      int copied = 0;
+      forEachRecord(start, end, [&](int i, const SensorData& record) {
+        out[i - start] = record;
+        copied++;
+      });
+      return copied;
+    }
+
+    // Clears all data in the file
+    bool clearData() {
+      firstBuffered = 0;
+      hintBlock = 0;
+      hintFirst = 0;
+      blockIndex = 0;
+      sealedRecords = 0;
+      allocatedBlocks = 0;
+      unflushedRecords = 0;
+      dirty = false;
+      encoder = RecordEncoder(blocks[0], SD_BLOCK_BYTES);
+      file.close();
+      if (!SD.remove(filename)) {
+        return false;
+      }
+      return openFile();
+    }
+};
+
+SDmemory sdMemory;
+
+#endif
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <vector>
 #include <functional>
 
@@ -6,31 +7,73 @@ public:
   std::function<void()> task;
   uint32_t lastRun;
   uint32_t interval;
+  std::atomic<bool> triggered;  // The one field other tasks may write
 
   SchedulingBlock(std::function<void()> task, uint32_t interval)
     : task(task), interval(interval) {
     lastRun = 0;
+    triggered = false;
   }
 
+  // For the vector in Scheduler; blocks are only added before the owner starts running them
+  SchedulingBlock(const SchedulingBlock& other)
+    : task(other.task), lastRun(other.lastRun), interval(other.interval), triggered(other.triggered.load()) {}
+
   void run() {
-    if (millis() - lastRun >= interval) {
+    if (triggered || millis() - lastRun >= interval) {
+      triggered = false;
       task();
       lastRun = millis();
     }
   }
 };
 
+// Owned by the task that calls run(). Other tasks may only call trigger() and replan().
 class Scheduler {
 public:
   std::vector<SchedulingBlock> blocks;
 
-  void add(std::function<void()> task, uint32_t interval) {
+  // Returns an id that can be passed to trigger()
+  size_t add(std::function<void()> task, uint32_t interval) {
     blocks.push_back(SchedulingBlock(task, interval));
+    return blocks.size() - 1;
+  }
+
+  // Takes effect on the next pass, measured from the task's last run: a shorter interval that
+  // has already elapsed runs it at once
+  void setInterval(size_t id, uint32_t interval) {
+    if (id < blocks.size()) {
+      blocks[id].interval = interval;
+    }
+  }
+
+  // Runs the task on the next pass regardless of its interval
+  void trigger(size_t id) {
+    if (id < blocks.size()) {
+      blocks[id].triggered = true;
+    }
+  }
+
+  // Called by run() after replan(), so intervals are only ever set by the owner
+  void setPlanner(std::function<void()> planner) {
+    this->planner = planner;
+  }
+
+  // Has the owner call the planner at the top of its next pass
+  void replan() {
+    replanRequested = true;
   }
 
   void run() {
+    if (replanRequested.exchange(false) && planner) {
+      planner();
+    }
     for (SchedulingBlock& block : blocks) {
       block.run();
     }
   }
-};
\ No newline at end of file
+
+private:
+  std::function<void()> planner;
+  std::atomic<bool> replanRequested{false};
+};
@@ -1,52 +1,100 @@
 #ifndef SENSORSERVICE_H
 #define SENSORSERVICE_H
 
+#include <mutex>
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include "DHT.h"
-#include <ArduinoJson.h>
 #include "Config.h"
 #include "Memory.h"
 #include "TimeService.h"
+#include "PlantMap.h"
+#include "Intervals.h"
+#include "AdcCalibration.h"
+#if USE_ADAPTIVE_SAMPLING
+#include "AdaptiveRate.h"
+#endif
+#if USE_ON_DEVICE_PREDICTION
+#include "WateringPredictor.h"
+#endif
+#if USE_SD_CARD || USE_FLASH_HISTORY
+#include "TieredStore.h"
+#endif
 
 OneWire oneWire(DS18S20_Pin);
 DallasTemperature sensors(&oneWire);
-
-#if !USE_LM35
 DHT dht(DHT22_PIN, DHTTYPE);
-#endif
 
 class SensorManager {
 private:
   SensorData currentData;
-  int sampleCount;
-  float runningAvgTemperature1;
-  float runningAvgTemperature2;
-  float runningAvgHumidity;
-  float runningAvgLight;
-  float runningAvgSoilMoisture1;
-  float runningAvgSoilMoisture2;
-  bool validTemperature1;
-  bool validTemperature2;
-  bool validHumidity;
-  bool validLight;
-  bool validSoilMoisture1;
-  bool validSoilMoisture2;
-
-  void updateRunningAverage(float& runningAvg, int& count, float newValue, bool& validFlag) {
+  // Per-channel running averages over the current record interval, indexed by ChannelId
+  float runningAvg[CHANNEL_COUNT];
+  int sampleCount[CHANNEL_COUNT];
+  #if USE_ON_DEVICE_PREDICTION
+  WateringPredictor predictors[SOIL_PROBE_COUNT];  // Indexed like plants.plantIds
+  PlantMap plants;             // This task's copy of plantMap
+  uint32_t plantsVersion = 0;
+
+  // Predictions waiting for the upload task, serialized here so it never touches the predictors
+  struct QueuedPrediction {
+    char payload[160];
+    uint32_t version;  // 0 when nothing is queued
+  };
+  QueuedPrediction predictionOutbox[SOIL_PROBE_COUNT] = {};
+  uint32_t predictionVersion = 0;
+  std::mutex predictionLock;
+
+  void queuePrediction(int plant) {
+    char payload[sizeof(QueuedPrediction::payload)];
+    if (plants.plantIds[plant] == -1 ||
+        predictors[plant].writeJson(payload, sizeof(payload), plants.plantIds[plant]) == 0) {
+      return;
+    }
+    predictors[plant].markQueued();
+    std::lock_guard<std::mutex> guard(predictionLock);
+    memcpy(predictionOutbox[plant].payload, payload, sizeof(payload));
+    predictionOutbox[plant].version = ++predictionVersion;
+  }
+  #endif
+  #if USE_ADAPTIVE_SAMPLING
+  AdaptiveRate adaptiveRate;
+  #endif
+  unsigned long lastBufferSave = 0;
+
+  // False for a reading left out of the average
+  bool updateRunningAverage(ChannelId id, float newValue) {
     if (!isnan(newValue) && newValue >= 0) {
-      runningAvg = ((runningAvg * count) + newValue) / (count + 1);
-      count++;
-      validFlag = true;
+      runningAvg[id] = ((runningAvg[id] * sampleCount[id]) + newValue) / (sampleCount[id] + 1);
+      sampleCount[id]++;
+      return true;
+    }
+    return false;
+  }
+
+  // Reads one channel through its driver; resolved at compile time from CHANNELS
+  template <ChannelId ID>
+  float readChannel() {
+    constexpr const ChannelSpec& spec = CHANNELS[ID];
+    if constexpr (spec.driver == ChannelDriver::DS18B20) {
+      return sensors.getTempCByIndex(0) * spec.scale + spec.offset;
+    } else if constexpr (spec.driver == ChannelDriver::DHT_TEMPERATURE) {
+      return dht.readTemperature() * spec.scale + spec.offset;
+    } else if constexpr (spec.driver == ChannelDriver::DHT_HUMIDITY) {
+      return dht.readHumidity() * spec.scale + spec.offset;
+    } else if constexpr (spec.driver == ChannelDriver::SOIL_PROBE) {
+      return adcCalibration.soilCentiPercent(spec.probe - 1, analogRead(spec.pin)) * 0.01f;
+    } else if constexpr (spec.driver == ChannelDriver::ANALOG_MV) {
+      return adcCalibration.millivolts(analogRead(spec.pin)) * spec.scale + spec.offset;
+    } else {
+      return analogRead(spec.pin) * spec.scale + spec.offset;
     }
   }
 
 public:
-  SensorManager()
-    : currentData(), sampleCount(0), runningAvgTemperature1(0), runningAvgTemperature2(0),
-      runningAvgHumidity(0), runningAvgLight(0), runningAvgSoilMoisture1(0), runningAvgSoilMoisture2(0),
-      validTemperature1(false), validTemperature2(false), validHumidity(false), validLight(false),
-      validSoilMoisture1(false), validSoilMoisture2(false) {}
+  SensorManager() : currentData() {
+    resetAverages();
+  }
 
   void run() {
     if (isTimeSet()) {
@@ -56,31 +104,112 @@ public:
     }
   }
 
-  void recordToBuffer() {
-    Serial.printf("T1 = %.2f, T2 = %.2f, L = %.2f, S1 = %.2f, S2 = %.2f, H = %.2f\n",
-                  currentData.temperature1, currentData.temperature2, currentData.light,
-                  currentData.soilMoisture1, currentData.soilMoisture2, currentData.humidity);
-    
-    pushBack(cb, currentData);
+  // Saves the buffer, and with a history where its cold tier starts, to NVS
+  void saveState() {
+    #if USE_SD_CARD || USE_FLASH_HISTORY
+    tieredStore.save();
+    #else
     saveBufferState(cb);
-    
+    #endif
+    lastBufferSave = millis();
+  }
+
+  void recordToBuffer() {
+    forEachChannel([&](auto id) {
+      constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+      Serial.printf("%s = %.*f%s  ", spec.label, (int)spec.decimals, currentData.get(spec.id), spec.units);
+    });
+    Serial.println();
+
+    #if USE_SD_CARD || USE_FLASH_HISTORY
+    tieredStore.push(currentData);  // Numbers the record and keeps it in the history
+    #else
+    reserveSequences(cb, 1);
+    if (pushBack(cb, currentData)) {
+      currentData.sequence = cb.nextSequence - 1;
+    }
+    #endif
+    if (millis() - lastBufferSave >= BUFFER_SAVE_INTERVAL) {
+      saveState();
+    }
+    plantMap.sync();
+    #if USE_ON_DEVICE_PREDICTION
+    if (plantMap.refresh(plants, plantsVersion)) {
+      // A predictor's history belongs to the plant and probe it was fed from
+      std::lock_guard<std::mutex> guard(predictionLock);
+      for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+        predictors[i] = WateringPredictor();
+        predictionOutbox[i].version = 0;
+      }
+    }
+    for (int i = 0; i < plants.plantCount; i++) {
+      predictors[i].addRecord(currentData, plants.primaryProbe(i));
+      if (predictors[i].hasPendingUpload()) {
+        queuePrediction(i);
+      }
+    }
+    #endif
+    #if USE_ADAPTIVE_SAMPLING
+    uint32_t next = adaptiveRate.recorded(millis(), intervals.get(INTERVAL_RECORD));
+    Serial.printf("Next record in %lu ms%s\n", (unsigned long)next, adaptiveRate.changing() ? " (changing)" : "");
+    #endif
     // Reset averages after recording to start fresh for next interval
     resetAverages();
   }
 
-  void setupBeforeSerial() {
-    pinMode(LIGHT_PIN, INPUT);
-    pinMode(SOIL_PIN1, INPUT);
-    pinMode(SOIL_PIN2, INPUT);
-    #if USE_LM35
-    pinMode(LM35_PIN, INPUT);
+  // Interval until the next record: the configured one, or the adaptive rate's
+  uint32_t recordInterval() const {
+    #if USE_ADAPTIVE_SAMPLING
+    return adaptiveRate.interval(intervals.get(INTERVAL_RECORD));
+    #else
+    return intervals.get(INTERVAL_RECORD);
+    #endif
+  }
+
+  // A tracked channel jumped and the record shouldn't wait for its interval
+  bool recordDue() const {
+    #if USE_ADAPTIVE_SAMPLING
+    return adaptiveRate.recordDue();
+    #else
+    return false;
     #endif
   }
 
+  #if USE_ADAPTIVE_SAMPLING
+  const AdaptiveRate& getAdaptiveRate() const {
+    return adaptiveRate;
+  }
+  #endif
+
+  void setupBeforeSerial() {
+    forEachChannel([&](auto id) {
+      constexpr const ChannelSpec& spec = CHANNELS[decltype(id)::value];
+      if constexpr (spec.driver == ChannelDriver::ANALOG || spec.driver == ChannelDriver::ANALOG_MV ||
+                    spec.driver == ChannelDriver::SOIL_PROBE) {
+        pinMode(spec.pin, INPUT);
+      }
+    });
+  }
+
   void setupAfterSerial() {
-    sensors.begin();
-    #if !USE_LM35
-    dht.begin();
+    PlantMap stored;
+    stored.load();
+    plantMap.publish(stored);
+    adcCalibration.begin();
+    if constexpr (anyChannelUses(ChannelDriver::DS18B20)) {
+      sensors.begin();
+    }
+    if constexpr (anyChannelUses(ChannelDriver::DHT_TEMPERATURE) || anyChannelUses(ChannelDriver::DHT_HUMIDITY)) {
+      dht.begin();
+    }
+    #if USE_SD_CARD
+    if (!sdMemory.init()) {
+      Serial.println("Failed to setup SD memory");
+    }
+    #elif USE_FLASH_HISTORY
+    if (!flashHistory.init()) {
+      Serial.println("Failed to setup the flash history");
+    }
     #endif
   }
 
@@ -88,98 +217,72 @@ public:
     return currentData.toJson();
   }
 
+  // Sampling task only
+  const SensorData& getCurrentData() const {
+    return currentData;
+  }
+
+  #if USE_ON_DEVICE_PREDICTION
+  // Sampling task only
+  WateringPredictor& getPredictor(int plant = 0) {
+    return predictors[plant];
+  }
+
+  // Upload task: copies a plant's queued prediction. Returns its version, or 0 if none is queued.
+  uint32_t takePrediction(int plant, char* out, size_t capacity) {
+    std::lock_guard<std::mutex> guard(predictionLock);
+    const QueuedPrediction& queued = predictionOutbox[plant];
+    if (queued.version == 0 || strlen(queued.payload) >= capacity) {
+      return 0;
+    }
+    strcpy(out, queued.payload);
+    return queued.version;
+  }
+
+  // Upload task: the backend accepted that version. One queued since stays for the next upload.
+  void predictionUploaded(int plant, uint32_t version) {
+    std::lock_guard<std::mutex> guard(predictionLock);
+    if (predictionOutbox[plant].version == version) {
+      predictionOutbox[plant].version = 0;
+    }
+  }
+  #endif
+
   void updateSensorData() {
     Serial.println("\n=== Sensor Data Update ===");
-    
-    // DS18B20 Temperature Sensor
-    sensors.requestTemperatures();
-    float s1 = sensors.getTempCByIndex(0);
-    Serial.printf("DS18B20 Raw Temperature: %.2f°C\n", s1);
-    updateRunningAverage(runningAvgTemperature1, sampleCount, s1, validTemperature1);
-    currentData.temperature1 = validTemperature1 ? runningAvgTemperature1 : NAN;
-    Serial.printf("DS18B20 Running Average: %.2f°C (Valid: %s)\n", 
-                 currentData.temperature1, 
-                 validTemperature1 ? "Yes" : "No");
-
-    // Soil Moisture Sensor 1
-    float rawSoil1 = analogRead(SOIL_PIN1);
-    float soilMoisture1 = (1 - rawSoil1 / (float)ANALOG_MAX) * 100;
-    Serial.printf("Soil Moisture 1 Raw: %.0f, Calculated: %.1f%%\n", rawSoil1, soilMoisture1);
-    updateRunningAverage(runningAvgSoilMoisture1, sampleCount, soilMoisture1, validSoilMoisture1);
-    currentData.soilMoisture1 = validSoilMoisture1 ? runningAvgSoilMoisture1 : NAN;
-    Serial.printf("Soil Moisture 1 Running Average: %.1f%% (Valid: %s)\n", 
-                 currentData.soilMoisture1, 
-                 validSoilMoisture1 ? "Yes" : "No");
-
-    // Soil Moisture Sensor 2
-    float rawSoil2 = analogRead(SOIL_PIN2);
-    float soilMoisture2 = (1 - rawSoil2 / (float)ANALOG_MAX) * 100;
-    Serial.printf("Soil Moisture 2 Raw: %.0f, Calculated: %.1f%%\n", rawSoil2, soilMoisture2);
-    updateRunningAverage(runningAvgSoilMoisture2, sampleCount, soilMoisture2, validSoilMoisture2);
-    currentData.soilMoisture2 = validSoilMoisture2 ? runningAvgSoilMoisture2 : NAN;
-    Serial.printf("Soil Moisture 2 Running Average: %.1f%% (Valid: %s)\n", 
-                 currentData.soilMoisture2, 
-                 validSoilMoisture2 ? "Yes" : "No");
-
-    // Light Sensor
-    float rawLight = analogRead(LIGHT_PIN);
-    float light = (rawLight / (float)ANALOG_MAX) * 100;
-    Serial.printf("Light Raw: %.0f, Calculated: %.1f%%\n", rawLight, light);
-    updateRunningAverage(runningAvgLight, sampleCount, light, validLight);
-    currentData.light = validLight ? runningAvgLight : NAN;
-    Serial.printf("Light Running Average: %.1f%% (Valid: %s)\n", 
-                 currentData.light, 
-                 validLight ? "Yes" : "No");
-
-    #if USE_LM35
-    // LM35 Temperature Sensor
-    float voltage = analogRead(LM35_PIN);
-    Serial.printf("LM35 Raw Reading: %.2f\n", voltage);
-    updateRunningAverage(runningAvgTemperature2, sampleCount, voltage, validTemperature2);
-    currentData.temperature2 = validTemperature2 ? runningAvgTemperature2 : NAN;
-    currentData.humidity = -1;
-    Serial.printf("LM35 Running Average: %.2f°C (Valid: %s)\n", 
-                 currentData.temperature2, 
-                 validTemperature2 ? "Yes" : "No");
-    #else
-    // DHT Temperature & Humidity Sensor
-    float s2 = dht.readTemperature();
-    float h1 = dht.readHumidity();
-    Serial.printf("DHT Raw Temperature: %.2f°C, Raw Humidity: %.1f%%\n", s2, h1);
-    
-    updateRunningAverage(runningAvgTemperature2, sampleCount, s2, validTemperature2);
-    currentData.temperature2 = validTemperature2 ? runningAvgTemperature2 : NAN;
-    Serial.printf("DHT Temperature Running Average: %.2f°C (Valid: %s)\n", 
-                 currentData.temperature2, 
-                 validTemperature2 ? "Yes" : "No");
-
-    updateRunningAverage(runningAvgHumidity, sampleCount, h1, validHumidity);
-    currentData.humidity = validHumidity ? runningAvgHumidity : NAN;
-    Serial.printf("DHT Humidity Running Average: %.1f%% (Valid: %s)\n", 
-                 currentData.humidity, 
-                 validHumidity ? "Yes" : "No");
-    #endif
+
+    if constexpr (anyChannelUses(ChannelDriver::DS18B20)) {
+      sensors.requestTemperatures();
+    }
+
+    forEachChannel([&](auto id) {
+      constexpr ChannelId channel = decltype(id)::value;
+      constexpr const ChannelSpec& spec = CHANNELS[channel];
+      float value = readChannel<channel>();
+      [[maybe_unused]] bool accepted = updateRunningAverage(channel, value);
+      #if USE_ADAPTIVE_SAMPLING
+      if constexpr (spec.probe > 0 || channel == CHANNEL_LIGHT) {
+        if (accepted) {
+          adaptiveRate.addSample(spec.probe > 0 ? spec.probe - 1 : AdaptiveRate::LIGHT_TRACK, value);
+        }
+      }
+      #endif
+      bool valid = sampleCount[channel] > 0;
+      currentData.set(channel, valid ? runningAvg[channel] : NAN);
+      Serial.printf("%s: %.2f%s, Running Average: %.2f%s (Valid: %s)\n", spec.label, value, spec.units,
+                    currentData.get(channel), spec.units, valid ? "Yes" : "No");
+    });
 
     currentData.timestamp = getUnixTime();
     Serial.printf("Timestamp: %lu\n", currentData.timestamp);
-    Serial.printf("Sample Count: %d\n", sampleCount);
     Serial.println("=== End Sensor Update ===\n");
 }
 
   void resetAverages() {
-    sampleCount = 0;
-    runningAvgTemperature1 = 0;
-    runningAvgTemperature2 = 0;
-    runningAvgHumidity = 0;
-    runningAvgLight = 0;
-    runningAvgSoilMoisture1 = 0;
-    runningAvgSoilMoisture2 = 0;
-    validTemperature1 = false;
-    validTemperature2 = false;
-    validHumidity = false;
-    validLight = false;
-    validSoilMoisture1 = false;
-    validSoilMoisture2 = false;
+    for (int i = 0; i < CHANNEL_COUNT; i++) {
+      runningAvg[i] = 0;
+      sampleCount[i] = 0;
+    }
   }
 };
 
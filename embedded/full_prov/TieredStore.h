@@ -0,0 +1,213 @@
+#ifndef TIEREDSTORE_H
+#define TIEREDSTORE_H
+
+#include <Preferences.h>
+#include "Config.h"
+#include "Memory.h"
+#if USE_FLASH_HISTORY
+#include "FlashHistory.h"
+#else
+#include "SDmemory.h"
+#endif
+
+// Two tiers of records waiting for upload: the circular buffer is the hot tier, and the record
+// history (SDmemory.h, or FlashHistory.h with USE_FLASH_HISTORY) is the cold tier. The uploader
+// only ever reads the circular buffer, whose front stays its one cursor. Records that arrive
+// while the buffer is full stay in the history instead of overwriting the oldest record, and are refilled into the buffer, oldest first, as uploads
+// make room.
+//
+// The history already keeps every record, so the cold tier is just the range of it from
+// coldNext to the end. While that range is non-empty, new records join it rather than the
+// buffer, which keeps the buffer strictly older than the cold tier and the upload in sequence
+// order. Spilled records are numbered when they arrive and flushed to the history at once, since
+// the NVS copy of the buffer doesn't hold them.
+//
+// The buffer and coldNext are saved together every BUFFER_SAVE_INTERVAL, not per record. After a
+// power cut, init() takes the records numbered since that save back from the history, those that
+// were flushed to it, as the cold tier; those already uploaded go again and the backend drops them as duplicates.
+//
+// Producer side (the sampling task) only. Without a history, push() falls back to pushBack().
+class TieredStore {
+  private:
+    #if USE_FLASH_HISTORY
+    FlashHistory& history = flashHistory;
+    #else
+    SDmemory& history = sdMemory;
+    #endif
+    Preferences tierPreferences;  // Same namespace as Memory.cpp's buffer state
+    int coldNext = -1;            // History index of the oldest record not yet refilled; -1 if none
+    int savedColdNext = -1;
+
+    bool hasCold() {
+      return coldNext >= 0 && coldNext < history.getNumRecords();
+    }
+
+    void saveColdNext() {
+      if (coldNext == savedColdNext) {
+        return;
+      }
+      savedColdNext = coldNext;
+      tierPreferences.begin("buffer_state", false);
+      if (coldNext < 0) {
+        tierPreferences.remove("coldNext");
+      } else {
+        tierPreferences.putInt("coldNext", coldNext);
+      }
+      tierPreferences.end();
+    }
+
+    // History index of the first record numbered sequence or later, given the last one. Records are
+    // numbered as they are written, so it is at most lastSequence - sequence records back; a write
+    // that failed only moves it closer.
+    int firstNumberedFrom(uint32_t sequence, int lastIndex, uint32_t lastSequence) {
+      uint32_t back = lastSequence - sequence;
+      int start = back > (uint32_t)(lastIndex - history.oldestRecord()) ? history.oldestRecord() : lastIndex - (int)back;
+      int found = lastIndex;
+      bool seen = false;
+      history.forEachRecord(start, lastIndex, [&](int i, const SensorData& record) {
+        if (!seen && record.sequence >= sequence) {
+          found = i;
+          seen = true;
+        }
+      });
+      return found;
+    }
+
+    // Sequence of the newest record in the buffer, 0 if it is empty
+    uint32_t newestBuffered() {
+      int count = bufferCount(cb);
+      uint32_t sequence = 0;
+      if (count > 0) {
+        readSequences(cb, count - 1, &sequence, 1);
+      }
+      return sequence;
+    }
+
+  public:
+    // After history.init() and loadBufferState()
+    void init() {
+      tierPreferences.begin("buffer_state", true);
+      coldNext = tierPreferences.getInt("coldNext", -1);
+      uint32_t savedNext = tierPreferences.getUInt("nextSequence", 1);  // As of the last save, before any lease skip
+      tierPreferences.end();
+      savedColdNext = coldNext;
+      if (!history.isSetup()) {
+        return;
+      }
+
+      // Records in the history may be numbered past the counter last saved with the buffer
+      SensorData last;
+      int lastIndex = history.getNumRecords() - 1;
+      if (history.readSingleData(lastIndex, last) && last.sequence >= savedNext) {
+        if (last.sequence >= cb.nextSequence) {
+          cb.nextSequence = last.sequence + 1;
+        }
+        if (coldNext < 0 || coldNext > lastIndex) {
+          coldNext = firstNumberedFrom(savedNext, lastIndex, last.sequence);
+          Serial.printf("Recovering %d records from the history\n", lastIndex - coldNext + 1);
+        }
+      }
+      if (coldNext >= 0 && !hasCold()) {
+        coldNext = -1;  // The tail of the history was lost with power before it was flushed
+        saveColdNext();
+      }
+      Serial.printf("Tiered store: %d buffered, %d in the history\n", bufferCount(cb), coldCount());
+    }
+
+    // Records in the cold tier
+    int coldCount() {
+      return hasCold() ? history.getNumRecords() - coldNext : 0;
+    }
+
+    // Records waiting for upload in both tiers
+    int pendingCount() {
+      return bufferCount(cb) + coldCount();
+    }
+
+    // Numbers record and stores it in the buffer, or only in the history if the buffer is full or the
+    // cold tier holds older records. Every record also goes into the history.
+    bool push(SensorData& record) {
+      reserveSequences(cb, 1);
+      if (!history.isSetup()) {
+        if (pushBack(cb, record)) {
+          record.sequence = cb.nextSequence - 1;
+          return true;
+        }
+        return false;
+      }
+
+      refill();
+      bool spill = hasCold() || isFull(cb);
+      int index = history.getNumRecords();
+      record.sequence = cb.nextSequence;
+      if (!history.writeData(record)) {
+        Serial.println("Failed to write data to the history");
+        return spill ? false : pushBack(cb, record) > 0;
+      }
+      cb.nextSequence++;
+      if (!spill) {
+        return pushBackNumbered(cb, record) > 0;
+      }
+
+      history.flush();
+      if (coldNext < 0) {
+        coldNext = index;
+        Serial.println("Buffer is full. Spilling new records to the history.");
+      }
+      return true;
+    }
+
+    // Saves the buffer, then coldNext: a reset between the two writes refills duplicates rather
+    // than losing records
+    void save() {
+      saveBufferState(cb);
+      saveColdNext();
+    }
+
+    // Moves the oldest cold records into whatever room uploads have made in the buffer. Returns
+    // how many were moved.
+    int refill() {
+      if (!hasCold()) {
+        return 0;
+      }
+      if (coldNext < history.oldestRecord()) {
+        // The outage outlasted the history; the ring has reused the space of the oldest
+        Serial.printf("%d spilled records were overwritten in the history\n", history.oldestRecord() - coldNext);
+        coldNext = history.oldestRecord();
+      }
+      // Uploads only make more room while this runs, so the room now always fits
+      int end = history.getNumRecords() - 1;
+      int room = BUFFER_SIZE - bufferCount(cb);
+      if (room == 0) {
+        return 0;
+      }
+      if (end - coldNext + 1 > room) {
+        end = coldNext + room - 1;
+      }
+      uint32_t newest = newestBuffered();
+      int moved = 0;
+      // Decoded straight from the history into the buffer, without a copy in between
+      history.forEachRecord(coldNext, end, [&](int, const SensorData& record) {
+        // Already refilled before a reset that came between saving the buffer and coldNext
+        if (record.sequence > newest) {
+          pushBackNumbered(cb, record);
+          newest = record.sequence;
+        }
+        moved++;
+      });
+      coldNext += moved;
+      if (moved == 0) {
+        return 0;
+      }
+      if (!hasCold()) {
+        coldNext = -1;
+        Serial.println("Cold tier drained");
+      }
+      Serial.printf("Refilled %d records from the history, %d left there\n", moved, coldCount());
+      return moved;
+    }
+};
+
+TieredStore tieredStore;
+
+#endif
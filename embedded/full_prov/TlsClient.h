@@ -0,0 +1,316 @@
+#ifndef TLSCLIENT_H
+#define TLSCLIENT_H
+
+#include <WiFi.h>
+#include <stddef.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/net_sockets.h>
+#include "Config.h"
+#include "UploadCaCert.h"
+
+// ==========================================
+// TLS session cache
+// ==========================================
+#define TLS_SESSION_MAGIC 0x544c5331  // "TLS1"
+
+// Last negotiated session as mbedtls_ssl_session_save() writes it: ticket or session ID, master
+// secret and the server's certificate. It is only ever offered back to the upload server.
+struct TlsSessionCache {
+  uint32_t magic;
+  uint32_t length;
+  uint8_t data[TLS_SESSION_MAX];
+};
+
+// RTC copy survives deep sleep, the NVS copy survives power loss
+RTC_DATA_ATTR TlsSessionCache rtcTlsSession;
+
+// Only the network task, which makes every TLS connection, touches the session and this handle
+Preferences tlsPreferences;
+
+bool isTlsSessionValid(const TlsSessionCache& cache) {
+  return cache.magic == TLS_SESSION_MAGIC && cache.length > 0 && cache.length <= TLS_SESSION_MAX;
+}
+
+// Fills rtcTlsSession from NVS after a power loss. False if there is no session to offer.
+bool loadTlsSession() {
+  if (isTlsSessionValid(rtcTlsSession)) {
+    return true;
+  }
+
+  tlsPreferences.begin("device_prefs", true);
+  size_t len = tlsPreferences.getBytes("tls_session", &rtcTlsSession, sizeof(rtcTlsSession));
+  tlsPreferences.end();
+
+  if (len >= offsetof(TlsSessionCache, data) && isTlsSessionValid(rtcTlsSession) &&
+      len == offsetof(TlsSessionCache, data) + rtcTlsSession.length) {
+    return true;
+  }
+  rtcTlsSession.magic = 0;
+  return false;
+}
+
+void clearTlsSession() {
+  rtcTlsSession.magic = 0;
+  rtcTlsSession.length = 0;
+  tlsPreferences.begin("device_prefs", false);
+  tlsPreferences.remove("tls_session");
+  tlsPreferences.end();
+}
+
+// Stores the session just negotiated. Only touches NVS when the server handed out a new one.
+void saveTlsSession(const mbedtls_ssl_session& session) {
+  uint8_t* buffer = (uint8_t*)malloc(TLS_SESSION_MAX);
+  size_t length = 0;
+  if (buffer == nullptr) {
+    return;
+  }
+  int ret = mbedtls_ssl_session_save(&session, buffer, TLS_SESSION_MAX, &length);
+  if (ret != 0) {
+    Serial.printf("TLS session not cached: %d (TLS_SESSION_MAX %d)\n", ret, TLS_SESSION_MAX);
+    free(buffer);
+    return;
+  }
+  if (isTlsSessionValid(rtcTlsSession) && rtcTlsSession.length == length &&
+      memcmp(rtcTlsSession.data, buffer, length) == 0) {
+    free(buffer);
+    return;
+  }
+
+  rtcTlsSession.magic = TLS_SESSION_MAGIC;
+  rtcTlsSession.length = length;
+  memcpy(rtcTlsSession.data, buffer, length);
+  free(buffer);
+  tlsPreferences.begin("device_prefs", false);
+  tlsPreferences.putBytes("tls_session", &rtcTlsSession, offsetof(TlsSessionCache, data) + length);
+  tlsPreferences.end();
+  Serial.printf("TLS session cached (%u B)\n", (unsigned)length);
+}
+
+// ==========================================
+// TLS client
+// ==========================================
+// TLS 1.2 over an already connected WiFiClient, offering the cached session on every handshake.
+// A resumed handshake skips the certificate chain and the key exchange, so it costs one round
+// trip and symmetric crypto only, where a full one costs two round trips and an ECDHE plus a
+// signature check (hundreds of ms on an ESP32). If the server won't resume, it answers with a
+// full handshake and the new session replaces the cached one. TLS 1.2 is pinned: TLS 1.3 only
+// sends its tickets after the handshake, when there would be no session to save yet.
+//
+// I/O never blocks: the socket callbacks say WANT_READ when nothing has arrived, and callers
+// poll like they do a WiFiClient. sent and received count every byte on the wire.
+class TlsClient {
+public:
+  TlsClient(WiFiClient& tcp, size_t& sent, size_t& received) : tcp(tcp), sent(sent), received(received) {}
+
+  ~TlsClient() {
+    if (configured) {
+      mbedtls_ssl_free(&ssl);
+      mbedtls_ssl_config_free(&conf);
+      mbedtls_x509_crt_free(&ca);
+      mbedtls_ctr_drbg_free(&drbg);
+      mbedtls_entropy_free(&entropy);
+    }
+  }
+
+  // Runs the handshake on tcp, which must be connected, and verifies the server against
+  // UPLOAD_TLS_CA_CERT and host. The result is in resumed() and handshakeUs().
+  bool handshake(const char* host, unsigned long timeoutMs) {
+    open = false;
+    if (!configure()) {
+      return false;
+    }
+    int ret = setUp ? mbedtls_ssl_session_reset(&ssl) : mbedtls_ssl_setup(&ssl, &conf);
+    setUp = setUp || ret == 0;
+    if (ret != 0 || mbedtls_ssl_set_hostname(&ssl, host) != 0) {
+      Serial.printf("TLS setup failed: %d\n", ret);
+      return false;
+    }
+    mbedtls_ssl_set_bio(&ssl, this, bioSend, bioRecv, nullptr);
+
+    bool offered = false;
+    if (loadTlsSession()) {
+      mbedtls_ssl_session session;
+      mbedtls_ssl_session_init(&session);
+      offered = mbedtls_ssl_session_load(&session, rtcTlsSession.data, rtcTlsSession.length) == 0 &&
+                mbedtls_ssl_set_session(&ssl, &session) == 0;
+      mbedtls_ssl_session_free(&session);
+      if (!offered) {
+        clearTlsSession();  // Saved by a firmware with another mbedTLS configuration
+      }
+    }
+
+    certificateChecked = false;
+    unsigned long startUs = micros();
+    unsigned long deadline = millis() + timeoutMs;
+    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+      if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+          (long)(deadline - millis()) <= 0) {
+        Serial.printf("TLS handshake failed: -0x%04x\n", (unsigned)-ret);
+        if (offered) {
+          clearTlsSession();  // Don't let a session the server chokes on block the next try
+        }
+        return false;
+      }
+      delay(1);
+    }
+    lastHandshakeUs = micros() - startUs;
+    // The certificate chain is only verified in a full handshake
+    lastResumed = offered && !certificateChecked;
+    open = true;
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_get_session(&ssl, &session) == 0) {
+      saveTlsSession(session);
+    }
+    mbedtls_ssl_session_free(&session);
+    Serial.printf("TLS %s in %lu ms\n", lastResumed ? "session resumed" : "full handshake", lastHandshakeUs / 1000);
+    return true;
+  }
+
+  bool resumed() const {
+    return lastResumed;
+  }
+
+  unsigned long handshakeUs() const {
+    return lastHandshakeUs;
+  }
+
+  bool connected() {
+    return open && (tcp.connected() || mbedtls_ssl_get_bytes_avail(&ssl) > 0);
+  }
+
+  // Decrypted bytes ready to read; decrypts the next record if one has arrived
+  int available() {
+    if (!open) {
+      return 0;
+    }
+    if (mbedtls_ssl_get_bytes_avail(&ssl) == 0 && tcp.available()) {
+      int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+      if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        open = false;  // Closed by the server, or a record that didn't authenticate
+      }
+    }
+    return mbedtls_ssl_get_bytes_avail(&ssl);
+  }
+
+  // One byte, or -1 if none is ready
+  int read() {
+    uint8_t c;
+    if (!open || mbedtls_ssl_read(&ssl, &c, 1) != 1) {
+      return -1;
+    }
+    return c;
+  }
+
+  size_t write(const uint8_t* data, size_t length) {
+    size_t written = 0;
+    unsigned long deadline = millis() + UPLOAD_RESPONSE_TIMEOUT;
+    while (open && written < length) {
+      int n = mbedtls_ssl_write(&ssl, data + written, length - written);
+      if (n > 0) {
+        written += n;
+      } else if ((n != MBEDTLS_ERR_SSL_WANT_READ && n != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+                 (long)(deadline - millis()) <= 0) {
+        open = false;
+      } else {
+        delay(1);
+      }
+    }
+    return written;
+  }
+
+  void stop() {
+    if (open) {
+      mbedtls_ssl_close_notify(&ssl);
+      open = false;
+    }
+    tcp.stop();
+  }
+
+private:
+  WiFiClient& tcp;
+  size_t& sent;
+  size_t& received;
+  bool configured = false;
+  bool setUp = false;  // ssl has its I/O buffers; later handshakes only reset it
+  bool open = false;
+  bool certificateChecked = false;
+  bool lastResumed = false;
+  unsigned long lastHandshakeUs = 0;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_x509_crt ca;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_entropy_context entropy;
+
+  // Once per client
+  bool configure() {
+    if (configured) {
+      return true;
+    }
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_x509_crt_init(&ca);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_entropy_init(&entropy);
+    configured = true;
+
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, nullptr, 0);
+    if (ret == 0) {
+      ret = mbedtls_x509_crt_parse_der(&ca, UPLOAD_TLS_CA_CERT, sizeof(UPLOAD_TLS_CA_CERT));
+    }
+    if (ret == 0) {
+      ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret != 0) {
+      Serial.printf("TLS configuration failed: -0x%04x\n", (unsigned)-ret);
+      return false;
+    }
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&conf, &ca, nullptr);
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ssl_conf_verify(&conf, onVerify, this);
+    mbedtls_ssl_conf_max_tls_version(&conf, MBEDTLS_SSL_VERSION_TLS1_2);
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    return true;
+  }
+
+  // Called for each certificate of the chain; only notes that verification happened
+  static int onVerify(void* context, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+    ((TlsClient*)context)->certificateChecked = true;
+    return 0;
+  }
+
+  static int bioSend(void* context, const unsigned char* data, size_t length) {
+    TlsClient* client = (TlsClient*)context;
+    if (!client->tcp.connected()) {
+      return MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    size_t n = client->tcp.write(data, length);
+    if (n == 0) {
+      return MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+    client->sent += n;
+    return n;
+  }
+
+  static int bioRecv(void* context, unsigned char* data, size_t length) {
+    TlsClient* client = (TlsClient*)context;
+    if (!client->tcp.available()) {
+      return client->tcp.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    int n = client->tcp.read(data, length);
+    if (n <= 0) {
+      return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    client->received += n;
+    return n;
+  }
+};
+
+#endif // TLSCLIENT_H
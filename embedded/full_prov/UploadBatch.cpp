@@ -0,0 +1,88 @@
+#include "UploadBatch.h"
+
+int takeBatch(CircularBuffer &cb, UploadBatch &batch, const PlantMap &plants, const char *deviceId) {
+  batch.objects = 0;
+  batch.payloadLength = 0;
+
+  // Each record expands to one object per plant; the shared channels are repeated per plant
+  // but the probes are not, so the bytes per probe stay flat as probes are added
+  int recordsPerBatch = MAX_RECORDS_PER_REQUEST / plants.plantCount;
+  if (recordsPerBatch < 1) {
+    recordsPerBatch = 1;
+  }
+
+  batch.count = peekFront(cb, batch.records, recordsPerBatch);
+  // With earlier batches still in flight the front is older than this batch's first record
+  int header = snprintf(batch.payload, UPLOAD_ENVELOPE_MAX, "{\"device_id\":\"%.*s\",\"base\":%lu,\"records\":[",
+                        DEVICE_ID_MAX, deviceId, (unsigned long)(batch.count > 0 ? frontSequence(cb) : 0));
+  batch.payloadLength = header > 0 ? header : 0;
+  int taken = 0;
+  for (; taken < batch.count; taken++) {
+    const SensorData &record = batch.records[taken];
+    size_t length = batch.payloadLength;
+    int objects = batch.objects;
+    bool fits = true;
+    for (int i = 0; i < plants.plantCount && fits; i++) {
+      if (objects > 0) {
+        batch.payload[length++] = ',';
+      }
+      size_t room = sizeof(batch.payload) - length;  // Keeps two bytes for the closing "]}"
+      size_t written = room > 2 ? record.writeJson(batch.payload + length, room - 2, plants.plantIds[i],
+                                                   plants.probeMask[i])
+                                : 0;
+      fits = written > 0;
+      length += written;
+      objects++;
+    }
+    if (!fits) {
+      break;
+    }
+    batch.payloadLength = length;
+    batch.objects = objects;
+  }
+  if (taken < batch.count) {
+    releaseNewest(cb, batch.count - taken);
+    batch.count = taken;
+  }
+
+  batch.payload[batch.payloadLength++] = ']';
+  batch.payload[batch.payloadLength++] = '}';
+  batch.payload[batch.payloadLength] = '\0';
+  return batch.count;
+}
+
+bool parseAck(const char *response, uint32_t &ack) {
+  const char *key = strstr(response, "\"ack\"");
+  if (key == nullptr) {
+    return false;
+  }
+  const char *value = key + 5;
+  while (*value == ' ' || *value == ':') {
+    value++;
+  }
+  if (*value < '0' || *value > '9') {
+    return false;
+  }
+  ack = strtoul(value, nullptr, 10);
+  return true;
+}
+
+int ackBatch(CircularBuffer &cb, UploadBatch &batch, uint32_t ack) {
+  int removed = commitThrough(cb, ack);
+  rollbackFront(cb);
+  batch.count = 0;
+  batch.objects = 0;
+  return removed;
+}
+
+void commitBatch(CircularBuffer &cb, UploadBatch &batch) {
+  commitFront(cb);
+  batch.count = 0;
+  batch.objects = 0;
+}
+
+void returnBatch(CircularBuffer &cb, UploadBatch &batch) {
+  rollbackFront(cb);
+  batch.count = 0;
+  batch.objects = 0;
+}
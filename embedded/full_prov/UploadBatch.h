@@ -0,0 +1,48 @@
+#ifndef UPLOADBATCH_H
+#define UPLOADBATCH_H
+
+#include "Config.h"
+#include "Memory.h"
+#include "PlantMap.h"
+
+#define DEVICE_ID_MAX 24
+#define UPLOAD_ENVELOPE_MAX (DEVICE_ID_MAX + 64)  // {"device_id":...,"base":...,"records":[...]}
+// A record's objects go out together, so a batch holds one record's worth even when there are more
+// plants than MAX_RECORDS_PER_REQUEST
+#define UPLOAD_OBJECTS_MAX (MAX_RECORDS_PER_REQUEST > SOIL_PROBE_COUNT ? MAX_RECORDS_PER_REQUEST : SOIL_PROBE_COUNT)
+
+// Records reserved at the front of the buffer for one upload, plus their serialized request:
+//   {"device_id":"<id>","base":<seq>,"records":[...]}
+// with one object per plant per record, each carrying its record's "seq". base is the oldest
+// sequence the device still holds, so the backend can move its acknowledgement past records the
+// buffer overwrote. The records stay in the buffer until ackBatch() or commitBatch() removes them
+// or returnBatch() releases them.
+struct UploadBatch {
+  SensorData records[MAX_RECORDS_PER_REQUEST];
+  int count;
+  int objects;
+  char payload[UPLOAD_OBJECTS_MAX * SENSOR_JSON_MAX + UPLOAD_ENVELOPE_MAX];
+  size_t payloadLength;
+};
+
+// Reserves records at the front of the buffer and serializes each once per plant in plants,
+// keeping the request at MAX_RECORDS_PER_REQUEST objects, or one record's if it has more plants.
+// A record whose objects don't all fit is released with the rest for the next batch. Returns the
+// number of records taken.
+int takeBatch(CircularBuffer &cb, UploadBatch &batch, const PlantMap &plants, const char *deviceId);
+
+// Reads the backend's {"ack":N}: the highest sequence up to which it has stored every record.
+// Returns false if the response has no ack (a backend that predates sequence numbers).
+bool parseAck(const char *response, uint32_t &ack);
+
+// The upload was answered with ack: removes the batch's records numbered up to it and leaves the
+// rest at the front of the buffer to be sent again. Returns the number removed.
+int ackBatch(CircularBuffer &cb, UploadBatch &batch, uint32_t ack);
+
+// The upload succeeded without an ack: removes the whole batch from the buffer
+void commitBatch(CircularBuffer &cb, UploadBatch &batch);
+
+// The upload failed: leaves the batch at the front of the buffer for the next attempt
+void returnBatch(CircularBuffer &cb, UploadBatch &batch);
+
+#endif
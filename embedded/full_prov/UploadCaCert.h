@@ -0,0 +1,55 @@
+#ifndef UPLOADCACERT_H
+#define UPLOADCACERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The CA the backend's HTTPS certificate is issued from (PlantGuru Upload CA, ECDSA P-256, DER).
+// With USE_TLS_UPLOAD every request to PLANTGURU_HTTPS_BASE_URL must present a certificate that
+// chains to it and names PLANTGURU_TLS_HOST. backend/scripts/make_tls_certs.sh makes the CA and the
+// server certificate; after making a new CA, paste the output of
+//   openssl x509 -in upload_ca.pem -outform DER | xxd -i
+const uint8_t upload_ca_cert[] = {
+  0x30, 0x82, 0x01, 0xcd, 0x30, 0x82, 0x01, 0x72, 0xa0, 0x03, 0x02, 0x01,
+  0x02, 0x02, 0x14, 0x63, 0x2d, 0x50, 0x18, 0x83, 0xd0, 0x1d, 0x42, 0x22,
+  0xce, 0xb0, 0x86, 0x50, 0xb6, 0x93, 0xc7, 0x11, 0x24, 0x60, 0xd3, 0x30,
+  0x0a, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02, 0x30,
+  0x32, 0x31, 0x12, 0x30, 0x10, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x0c, 0x09,
+  0x50, 0x6c, 0x61, 0x6e, 0x74, 0x47, 0x75, 0x72, 0x75, 0x31, 0x1c, 0x30,
+  0x1a, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x13, 0x50, 0x6c, 0x61, 0x6e,
+  0x74, 0x47, 0x75, 0x72, 0x75, 0x20, 0x55, 0x70, 0x6c, 0x6f, 0x61, 0x64,
+  0x20, 0x43, 0x41, 0x30, 0x1e, 0x17, 0x0d, 0x32, 0x36, 0x31, 0x30, 0x31,
+  0x39, 0x31, 0x34, 0x30, 0x34, 0x33, 0x33, 0x5a, 0x17, 0x0d, 0x34, 0x36,
+  0x31, 0x30, 0x31, 0x34, 0x31, 0x34, 0x30, 0x34, 0x33, 0x33, 0x5a, 0x30,
+  0x32, 0x31, 0x12, 0x30, 0x10, 0x06, 0x03, 0x55, 0x04, 0x0a, 0x0c, 0x09,
+  0x50, 0x6c, 0x61, 0x6e, 0x74, 0x47, 0x75, 0x72, 0x75, 0x31, 0x1c, 0x30,
+  0x1a, 0x06, 0x03, 0x55, 0x04, 0x03, 0x0c, 0x13, 0x50, 0x6c, 0x61, 0x6e,
+  0x74, 0x47, 0x75, 0x72, 0x75, 0x20, 0x55, 0x70, 0x6c, 0x6f, 0x61, 0x64,
+  0x20, 0x43, 0x41, 0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48,
+  0xce, 0x3d, 0x02, 0x01, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03,
+  0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0xfc, 0xcb, 0x5c, 0xb8, 0xb6, 0x9e,
+  0x76, 0x86, 0x4b, 0xb3, 0x92, 0x16, 0x66, 0x09, 0xa4, 0x86, 0xfe, 0xe7,
+  0x79, 0xee, 0xaa, 0xe1, 0x4d, 0x67, 0x77, 0xfc, 0xde, 0x3b, 0x6b, 0xbc,
+  0xa8, 0xb8, 0x5e, 0x06, 0xcf, 0xac, 0xba, 0x5d, 0xac, 0x90, 0x98, 0x4f,
+  0x56, 0x4f, 0xdf, 0x7e, 0x82, 0x1e, 0xe1, 0xc9, 0xd1, 0x23, 0x70, 0x5d,
+  0x45, 0xa5, 0xf2, 0x65, 0x85, 0x81, 0x23, 0x6f, 0x10, 0xb7, 0xa3, 0x66,
+  0x30, 0x64, 0x30, 0x1d, 0x06, 0x03, 0x55, 0x1d, 0x0e, 0x04, 0x16, 0x04,
+  0x14, 0x00, 0x62, 0xf9, 0x1b, 0x09, 0xcc, 0x20, 0x62, 0x44, 0xf3, 0x10,
+  0x93, 0xa1, 0xd3, 0x6d, 0x37, 0x86, 0x4b, 0x79, 0xb1, 0x30, 0x1f, 0x06,
+  0x03, 0x55, 0x1d, 0x23, 0x04, 0x18, 0x30, 0x16, 0x80, 0x14, 0x00, 0x62,
+  0xf9, 0x1b, 0x09, 0xcc, 0x20, 0x62, 0x44, 0xf3, 0x10, 0x93, 0xa1, 0xd3,
+  0x6d, 0x37, 0x86, 0x4b, 0x79, 0xb1, 0x30, 0x12, 0x06, 0x03, 0x55, 0x1d,
+  0x13, 0x01, 0x01, 0xff, 0x04, 0x08, 0x30, 0x06, 0x01, 0x01, 0xff, 0x02,
+  0x01, 0x00, 0x30, 0x0e, 0x06, 0x03, 0x55, 0x1d, 0x0f, 0x01, 0x01, 0xff,
+  0x04, 0x04, 0x03, 0x02, 0x01, 0x06, 0x30, 0x0a, 0x06, 0x08, 0x2a, 0x86,
+  0x48, 0xce, 0x3d, 0x04, 0x03, 0x02, 0x03, 0x49, 0x00, 0x30, 0x46, 0x02,
+  0x21, 0x00, 0xc4, 0x37, 0x0a, 0xb8, 0x84, 0xa3, 0xe5, 0xee, 0x07, 0xc1,
+  0x8b, 0x8b, 0x83, 0xa6, 0xdd, 0xe9, 0x7f, 0x54, 0x87, 0xae, 0x55, 0x00,
+  0xec, 0x6d, 0x0d, 0xcd, 0x88, 0xec, 0xdb, 0xeb, 0x6b, 0x47, 0x02, 0x21,
+  0x00, 0xf1, 0xe5, 0xfe, 0x23, 0x02, 0x53, 0xdb, 0xf9, 0x11, 0xd2, 0x1a,
+  0x9b, 0xad, 0xc4, 0x96, 0x9a, 0x74, 0x98, 0x8f, 0x3c, 0x60, 0x20, 0x2f,
+  0x4c, 0xe4, 0xa0, 0xb4, 0x26, 0xaa, 0x97, 0x86, 0x1e,
+};
+const size_t upload_ca_cert_len = 465;
+
+#endif // UPLOADCACERT_H
@@ -0,0 +1,131 @@
+#include "UploadProfiler.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+UploadProfiler uploadProfiler;
+
+static const char *const PHASE_NAMES[UPLOAD_PHASE_COUNT] = {"wifi", "dns", "connect", "tls", "send", "wait", "upload"};
+
+// Appends to out at length, which stays past capacity once anything didn't fit
+static void append(char *out, size_t capacity, size_t &length, const char *format, ...) {
+  if (length >= capacity) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(out + length, capacity - length, format, args);
+  va_end(args);
+  length = n < 0 ? capacity : length + n;
+}
+
+void UploadProfiler::Series::add(uint32_t value) {
+  values[next] = value;
+  next = (next + 1) % UPLOAD_PROFILE_SAMPLES;
+  if (count < UPLOAD_PROFILE_SAMPLES) {
+    count++;
+  }
+}
+
+// Nearest rank, like the host tools' percentile(); the ring is small enough to sort a copy
+uint32_t UploadProfiler::Series::percentile(uint8_t p) const {
+  uint16_t n = count;
+  if (n == 0) {
+    return 0;
+  }
+  uint32_t sorted[UPLOAD_PROFILE_SAMPLES];
+  for (uint16_t i = 0; i < n; i++) {
+    uint32_t value = values[i];
+    uint16_t j = i;
+    for (; j > 0 && sorted[j - 1] > value; j--) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = value;
+  }
+  return sorted[(p * (n - 1) + 50) / 100];
+}
+
+UploadProfiler::UploadProfiler()
+    : uploads(0), failures(0), totalSent(0), totalReceived(0), tlsHandshakes(0), tlsResumed(0), phases(), sent(),
+      received() {}
+
+void UploadProfiler::record(UploadPhase phase, uint32_t us) {
+  std::lock_guard<std::mutex> guard(lock);
+  phases[phase].add(us);
+}
+
+void UploadProfiler::recordTls(uint32_t us, bool resumed) {
+  std::lock_guard<std::mutex> guard(lock);
+  phases[UPLOAD_PHASE_TLS].add(us);
+  tlsHandshakes++;
+  if (resumed) {
+    tlsResumed++;
+  }
+}
+
+void UploadProfiler::endUpload(bool ok, uint32_t bytesSent, uint32_t bytesReceived) {
+  std::lock_guard<std::mutex> guard(lock);
+  uploads++;
+  if (!ok) {
+    failures++;
+  }
+  totalSent += bytesSent;
+  totalReceived += bytesReceived;
+  sent.add(bytesSent);
+  received.add(bytesReceived);
+}
+
+uint32_t UploadProfiler::percentile(UploadPhase phase, uint8_t p) const {
+  std::lock_guard<std::mutex> guard(lock);
+  return phases[phase].percentile(p);
+}
+
+const char *UploadProfiler::phaseName(UploadPhase phase) {
+  return PHASE_NAMES[phase];
+}
+
+size_t UploadProfiler::format(char *out, size_t capacity) const {
+  std::lock_guard<std::mutex> guard(lock);
+  size_t length = 0;
+  out[0] = '\0';
+  for (int i = 0; i < UPLOAD_PHASE_COUNT; i++) {
+    const Series &series = phases[i];
+    if (series.count > 0) {
+      append(out, capacity, length, "%s %.1f/%.1f ms, ", PHASE_NAMES[i], series.percentile(50) / 1000.0,
+             series.percentile(90) / 1000.0);
+    }
+  }
+  append(out, capacity, length, "tx %lu/%lu B, rx %lu/%lu B (p50/p90 of %u uploads, %lu failed)",
+         (unsigned long)sent.percentile(50), (unsigned long)sent.percentile(90),
+         (unsigned long)received.percentile(50), (unsigned long)received.percentile(90), (unsigned)sent.count,
+         (unsigned long)failures);
+  if (tlsHandshakes > 0) {
+    append(out, capacity, length, ", TLS resumed %lu/%lu", (unsigned long)tlsResumed, (unsigned long)tlsHandshakes);
+  }
+  return length < capacity ? length : capacity - 1;
+}
+
+size_t UploadProfiler::writeJson(char *out, size_t capacity, const char *deviceId) const {
+  std::lock_guard<std::mutex> guard(lock);
+  size_t length = 0;
+  append(out, capacity, length,
+         "{\"device_id\":\"%s\",\"uploads\":%lu,\"failures\":%lu,\"bytes_sent\":%llu,\"bytes_received\":%llu,"
+         "\"sent_p50\":%lu,\"sent_p90\":%lu,\"received_p50\":%lu,\"received_p90\":%lu,\"tls_handshakes\":%lu,"
+         "\"tls_resumed\":%lu,\"phases\":{",
+         deviceId, (unsigned long)uploads, (unsigned long)failures, (unsigned long long)totalSent,
+         (unsigned long long)totalReceived, (unsigned long)sent.percentile(50), (unsigned long)sent.percentile(90),
+         (unsigned long)received.percentile(50), (unsigned long)received.percentile(90),
+         (unsigned long)tlsHandshakes, (unsigned long)tlsResumed);
+  bool first = true;
+  for (int i = 0; i < UPLOAD_PHASE_COUNT; i++) {
+    const Series &series = phases[i];
+    if (series.count == 0) {
+      continue;
+    }
+    append(out, capacity, length, "%s\"%s\":{\"n\":%u,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f}",
+           first ? "" : ",", PHASE_NAMES[i], (unsigned)series.count, series.percentile(50) / 1000.0,
+           series.percentile(90) / 1000.0, series.percentile(99) / 1000.0, series.percentile(100) / 1000.0);
+    first = false;
+  }
+  append(out, capacity, length, "}}");
+  return length < capacity ? length : 0;
+}
@@ -0,0 +1,74 @@
+#ifndef UPLOADPROFILER_H
+#define UPLOADPROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include "Config.h"
+
+// Where an upload spends its radio time. Each phase keeps the last UPLOAD_PROFILE_SAMPLES
+// timings, so percentiles follow the link as it is now rather than since boot.
+enum UploadPhase : uint8_t {
+  UPLOAD_PHASE_WIFI,     // Boot or link loss until DHCP gives an address, any backoff included
+  UPLOAD_PHASE_DNS,      // Resolving the upload host
+  UPLOAD_PHASE_CONNECT,  // TCP handshake plus any session setup (MQTT CONNECT/CONNACK)
+  UPLOAD_PHASE_TLS,      // TLS handshake, full or resumed
+  UPLOAD_PHASE_SEND,     // Writing one batch to the connection
+  UPLOAD_PHASE_WAIT,     // One batch from written to answered: the round trip plus the server
+  UPLOAD_PHASE_UPLOAD,   // A whole postSensorData() drain, first connect to last reply
+  UPLOAD_PHASE_COUNT
+};
+
+// Rolling per-phase timings and bytes per upload, printed over Serial after each upload, read
+// over BLE and reported to the backend as telemetry. Everything is recorded from the network
+// task; the BLE task reads it, so recording and reading take a lock.
+class UploadProfiler {
+public:
+  UploadProfiler();
+
+  void record(UploadPhase phase, uint32_t us);
+
+  // A TLS handshake, and whether it resumed the cached session
+  void recordTls(uint32_t us, bool resumed);
+
+  // One postSensorData() call finished, with the bytes it moved, framing included
+  void endUpload(bool ok, uint32_t bytesSent, uint32_t bytesReceived);
+
+  // p-th percentile (0..100) of the phase's recent timings in us; 0 before the first one
+  uint32_t percentile(UploadPhase phase, uint8_t p) const;
+  uint16_t samples(UploadPhase phase) const { return phases[phase].count; }
+
+  static const char *phaseName(UploadPhase phase);
+
+  // "dns 1.2/3.4 ms, connect ..." with p50/p90 of each phase that has samples, then bytes
+  size_t format(char *out, size_t capacity) const;
+
+  // Telemetry report for POST /api/deviceTelemetry; 0 if it doesn't fit
+  size_t writeJson(char *out, size_t capacity, const char *deviceId) const;
+
+  uint32_t uploads;
+  uint32_t failures;
+  uint64_t totalSent;
+  uint64_t totalReceived;
+  uint32_t tlsHandshakes;
+  uint32_t tlsResumed;  // tlsResumed / tlsHandshakes is the session cache's hit rate
+
+private:
+  struct Series {
+    uint32_t values[UPLOAD_PROFILE_SAMPLES];  // Ring, newest at next - 1
+    uint16_t next;
+    uint16_t count;
+
+    void add(uint32_t value);
+    uint32_t percentile(uint8_t p) const;
+  };
+
+  Series phases[UPLOAD_PHASE_COUNT];
+  Series sent;      // Bytes per upload
+  Series received;
+  mutable std::mutex lock;
+};
+
+extern UploadProfiler uploadProfiler;
+
+#endif // UPLOADPROFILER_H
@@ -0,0 +1,43 @@
+#ifndef UPLOADTRANSPORT_H
+#define UPLOADTRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Reply to one upload batch. Replies come back in the order the batches were sent.
+struct UploadReply {
+  bool accepted;  // The batch was taken; false for a refused request
+  bool hasAck;    // ack is the backend's cumulative sequence acknowledgement
+  uint32_t ack;
+};
+
+// How postSensorData() moves serialized batches to the backend over one long-lived connection.
+// Batches are sent without waiting, so an UploadWindow of them can be in flight at once.
+class UploadTransport {
+public:
+  virtual ~UploadTransport() {}
+
+  virtual const char* name() const = 0;
+
+  // Connects unless the connection is still up
+  virtual bool begin(const char* deviceId) = 0;
+
+  // Writes one batch without waiting for its reply
+  virtual bool send(const char* payload, size_t length) = 0;
+
+  // Waits for the reply to the oldest batch still unanswered. Returns false if the connection
+  // broke or timed out; stop() it then, since the batches behind it are lost.
+  virtual bool receive(UploadReply& reply, unsigned long timeoutMs) = 0;
+
+  virtual void stop() = 0;
+
+  // Every byte written and read so far, protocol framing included
+  size_t bytesSent() const { return sent; }
+  size_t bytesReceived() const { return received; }
+
+protected:
+  size_t sent = 0;
+  size_t received = 0;
+};
+
+#endif // UPLOADTRANSPORT_H
@@ -0,0 +1,54 @@
+#include "UploadWindow.h"
+
+UploadWindow::UploadWindow(int maxWindow)
+  : first(0), count(0), window(1),
+    maxWindow(maxWindow < 1 ? 1 : maxWindow > UPLOAD_WINDOW_MAX ? UPLOAD_WINDOW_MAX : maxWindow),
+    cleanResponses(0) {}
+
+bool UploadWindow::take(CircularBuffer &cb, UploadBatch &batch, const PlantMap &plants, const char *deviceId) {
+  if (count >= window || takeBatch(cb, batch, plants, deviceId) == 0) {
+    return false;
+  }
+  lastSequences[(first + count) % UPLOAD_WINDOW_MAX] = batch.records[batch.count - 1].sequence;
+  count++;
+  return true;
+}
+
+void UploadWindow::completeOldest(CircularBuffer &cb) {
+  first = (first + 1) % UPLOAD_WINDOW_MAX;
+  count--;
+  if (++cleanResponses >= window) {
+    cleanResponses = 0;
+    if (window < maxWindow) {
+      window++;
+    }
+  }
+  // Records a short ack left behind are resent once nothing is in flight past them
+  if (count == 0) {
+    rollbackFront(cb);
+  }
+}
+
+void UploadWindow::acknowledge(CircularBuffer &cb, uint32_t ack) {
+  if (count == 0) {
+    return;
+  }
+  commitThrough(cb, ack);
+  completeOldest(cb);
+}
+
+void UploadWindow::acknowledgeOldest(CircularBuffer &cb) {
+  if (count == 0) {
+    return;
+  }
+  commitThrough(cb, lastSequences[first]);
+  completeOldest(cb);
+}
+
+void UploadWindow::fail(CircularBuffer &cb) {
+  rollbackFront(cb);
+  first = 0;
+  count = 0;
+  cleanResponses = 0;
+  window = window > 1 ? window / 2 : 1;
+}
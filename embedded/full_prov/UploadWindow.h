@@ -0,0 +1,44 @@
+#ifndef UPLOADWINDOW_H
+#define UPLOADWINDOW_H
+
+#include "Config.h"
+#include "Memory.h"
+#include "UploadBatch.h"
+
+// Sliding window of upload batches in flight on one connection. Requests are written back to
+// back and answered in order, so draining a backlog takes about one round trip per window
+// instead of one per batch. The reservations of all batches in flight stack up at the front of
+// the buffer (peekFront()); acks are cumulative and trim it from the front (commitThrough()).
+//
+// The window opens by one batch after a window's worth of clean responses and halves on any
+// failure, when every batch in flight goes back to the buffer to be sent again.
+class UploadWindow {
+public:
+  explicit UploadWindow(int maxWindow = UPLOAD_WINDOW_MAX);
+
+  // Reserves and serializes the next batch into batch if the window has room and records are
+  // left to send. The batch is only needed until it has been written to the connection.
+  bool take(CircularBuffer &cb, UploadBatch &batch, const PlantMap &plants, const char *deviceId);
+
+  // The oldest batch in flight was answered with ack
+  void acknowledge(CircularBuffer &cb, uint32_t ack);
+  // The oldest batch in flight was accepted by a backend that doesn't send acks
+  void acknowledgeOldest(CircularBuffer &cb);
+  // The connection failed or a request was refused: every batch in flight goes back
+  void fail(CircularBuffer &cb);
+
+  int inFlight() const { return count; }
+  int size() const { return window; }
+
+private:
+  uint32_t lastSequences[UPLOAD_WINDOW_MAX];  // Ring of the batches in flight, oldest at first
+  int first;
+  int count;
+  int window;
+  int maxWindow;
+  int cleanResponses;
+
+  void completeOldest(CircularBuffer &cb);
+};
+
+#endif
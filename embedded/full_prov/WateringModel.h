@@ -0,0 +1,743 @@
+// Generated by backend/export_model.py from backend/decision_tree. Do not edit.
+// DecisionTreeRegressor: 699 nodes, depth 15. Inputs are the means of the
+// current 30min bucket; the output is soil_moisture_1 8 buckets later.
+#ifndef WATERINGMODEL_H
+#define WATERINGMODEL_H
+
+#include <stdint.h>
+
+#define WATERING_MODEL_FEATURES 4
+#define WATERING_MODEL_RESAMPLE_MINUTES 30
+#define WATERING_MODEL_FUTURE_STEPS 8
+
+enum WateringFeature {
+  WATERING_FEATURE_EXT_TEMP = 0,
+  WATERING_FEATURE_HUMIDITY = 1,
+  WATERING_FEATURE_LIGHT = 2,
+  WATERING_FEATURE_SOIL_MOISTURE_1 = 3,
+};
+
+struct WateringTreeNode {
+  int16_t left;     // Child for feature <= threshold, -1 at a leaf
+  int16_t right;    // Child for feature > threshold, -1 at a leaf
+  int8_t feature;   // WateringFeature, -1 at a leaf
+  float threshold;
+  float value;      // Predicted soil_moisture_1 at a leaf
+};
+
+constexpr WateringTreeNode WATERING_TREE[] = {
+  {1, 314, 3, 69.06012725830078f, 0.0f},
+  {2, 115, 3, 64.31647491455078f, 0.0f},
+  {3, 40, 3, 59.85312271118164f, 0.0f},
+  {4, 19, 1, 51.47581481933594f, 0.0f},
+  {5, 12, 3, 58.873199462890625f, 0.0f},
+  {6, 7, 3, 58.45359802246094f, 0.0f},
+  {-1, -1, -1, 0.0f, 57.196773529052734f},
+  {8, 11, 3, 58.74393844604492f, 0.0f},
+  {9, 10, 2, 50.374576568603516f, 0.0f},
+  {-1, -1, -1, 0.0f, 57.40605926513672f},
+  {-1, -1, -1, 0.0f, 57.34687423706055f},
+  {-1, -1, -1, 0.0f, 57.52424240112305f},
+  {13, 16, 0, 22.574356079101562f, 0.0f},
+  {14, 15, 3, 59.117942810058594f, 0.0f},
+  {-1, -1, -1, 0.0f, 58.051513671875f},
+  {-1, -1, -1, 0.0f, 58.21562576293945f},
+  {17, 18, 2, 51.731075286865234f, 0.0f},
+  {-1, -1, -1, 0.0f, 57.73125076293945f},
+  {-1, -1, -1, 0.0f, 57.87272644042969f},
+  {20, 33, 2, 12.055620193481445f, 0.0f},
+  {21, 26, 0, 21.51980972290039f, 0.0f},
+  {22, 25, 2, 2.7177734375f, 0.0f},
+  {23, 24, 0, 21.469058990478516f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.02727127075195f},
+  {-1, -1, -1, 0.0f, 59.051513671875f},
+  {-1, -1, -1, 0.0f, 58.931251525878906f},
+  {27, 30, 0, 21.615066528320312f, 0.0f},
+  {28, 29, 1, 57.57345962524414f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.19696807861328f},
+  {-1, -1, -1, 0.0f, 59.18437576293945f},
+  {31, 32, 1, 56.50386047363281f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.384376525878906f},
+  {-1, -1, -1, 0.0f, 59.29090881347656f},
+  {34, 37, 3, 59.337642669677734f, 0.0f},
+  {35, 36, 0, 21.777877807617188f, 0.0f},
+  {-1, -1, -1, 0.0f, 58.537498474121094f},
+  {-1, -1, -1, 0.0f, 58.36969757080078f},
+  {38, 39, 2, 24.738990783691406f, 0.0f},
+  {-1, -1, -1, 0.0f, 58.81515121459961f},
+  {-1, -1, -1, 0.0f, 58.672725677490234f},
+  {41, 100, 3, 62.92646789550781f, 0.0f},
+  {42, 61, 2, 1.5135557651519775f, 0.0f},
+  {43, 48, 3, 60.076560974121094f, 0.0f},
+  {44, 47, 0, 21.865306854248047f, 0.0f},
+  {45, 46, 0, 21.801448822021484f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.40909194946289f},
+  {-1, -1, -1, 0.0f, 59.457576751708984f},
+  {-1, -1, -1, 0.0f, 59.58124923706055f},
+  {49, 52, 1, 52.588951110839844f, 0.0f},
+  {50, 51, 1, 51.28079605102539f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.990909576416016f},
+  {-1, -1, -1, 0.0f, 59.918182373046875f},
+  {53, 58, 0, 22.222511291503906f, 0.0f},
+  {54, 57, 3, 60.131202697753906f, 0.0f},
+  {55, 56, 3, 60.10151290893555f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.681819915771484f},
+  {-1, -1, -1, 0.0f, 59.68484878540039f},
+  {-1, -1, -1, 0.0f, 59.70000076293945f},
+  {59, 60, 3, 60.19545364379883f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.80937576293945f},
+  {-1, -1, -1, 0.0f, 59.77878952026367f},
+  {62, 93, 3, 62.45487594604492f, 0.0f},
+  {63, 90, 3, 62.14848327636719f, 0.0f},
+  {64, 77, 0, 23.75136375427246f, 0.0f},
+  {65, 76, 3, 61.64999771118164f, 0.0f},
+  {66, 71, 0, 23.22923469543457f, 0.0f},
+  {67, 68, 0, 22.92548179626465f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.053123474121094f},
+  {69, 70, 0, 23.120201110839844f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.103031158447266f},
+  {-1, -1, -1, 0.0f, 60.109092712402344f},
+  {72, 73, 0, 23.3157901763916f, 0.0f},
+  {-1, -1, -1, 0.0f, 59.896873474121094f},
+  {74, 75, 0, 23.43308448791504f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.048484802246094f},
+  {-1, -1, -1, 0.0f, 60.099998474121094f},
+  {-1, -1, -1, 0.0f, 60.209373474121094f},
+  {78, 85, 1, 46.38637924194336f, 0.0f},
+  {79, 84, 3, 60.46150588989258f, 0.0f},
+  {80, 81, 3, 60.00298309326172f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.20606231689453f},
+  {82, 83, 2, 60.550540924072266f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.18484878540039f},
+  {-1, -1, -1, 0.0f, 60.19091033935547f},
+  {-1, -1, -1, 0.0f, 60.165626525878906f},
+  {86, 87, 1, 46.472652435302734f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.10606002807617f},
+  {88, 89, 0, 24.356576919555664f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.15937423706055f},
+  {-1, -1, -1, 0.0f, 60.146873474121094f},
+  {91, 92, 1, 50.90350341796875f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.3636360168457f},
+  {-1, -1, -1, 0.0f, 60.339393615722656f},
+  {94, 97, 3, 62.57291793823242f, 0.0f},
+  {95, 96, 0, 23.367952346801758f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.67878723144531f},
+  {-1, -1, -1, 0.0f, 60.55937576293945f},
+  {98, 99, 2, 54.925697326660156f, 0.0f},
+  {-1, -1, -1, 0.0f, 60.79697036743164f},
+  {-1, -1, -1, 0.0f, 60.837501525878906f},
+  {101, 112, 0, 22.422454833984375f, 0.0f},
+  {102, 105, 0, 20.853744506835938f, 0.0f},
+  {103, 104, 0, 20.588726043701172f, 0.0f},
+  {-1, -1, -1, 0.0f, 62.806060791015625f},
+  {-1, -1, -1, 0.0f, 62.63333511352539f},
+  {106, 109, 0, 21.600894927978516f, 0.0f},
+  {107, 108, 3, 63.90473175048828f, 0.0f},
+  {-1, -1, -1, 0.0f, 62.487876892089844f},
+  {-1, -1, -1, 0.0f, 62.51250076293945f},
+  {110, 111, 0, 22.031503677368164f, 0.0f},
+  {-1, -1, -1, 0.0f, 62.390907287597656f},
+  {-1, -1, -1, 0.0f, 62.421875f},
+  {113, 114, 0, 22.69275665283203f, 0.0f},
+  {-1, -1, -1, 0.0f, 61.90605926513672f},
+  {-1, -1, -1, 0.0f, 61.39393997192383f},
+  {116, 251, 3, 67.3336181640625f, 0.0f},
+  {117, 138, 3, 65.4772720336914f, 0.0f},
+  {118, 129, 1, 54.65879440307617f, 0.0f},
+  {119, 122, 1, 48.74290466308594f, 0.0f},
+  {120, 121, 0, 22.034482955932617f, 0.0f},
+  {-1, -1, -1, 0.0f, 64.859375f},
+  {-1, -1, -1, 0.0f, 64.5f},
+  {123, 126, 0, 19.19709014892578f, 0.0f},
+  {124, 125, 0, 19.165172576904297f, 0.0f},
+  {-1, -1, -1, 0.0f, 64.24545288085938f},
+  {-1, -1, -1, 0.0f, 64.38749694824219f},
+  {127, 128, 3, 65.16368103027344f, 0.0f},
+  {-1, -1, -1, 0.0f, 64.01249694824219f},
+  {-1, -1, -1, 0.0f, 64.09696960449219f},
+  {130, 133, 3, 64.60454559326172f, 0.0f},
+  {131, 132, 2, 33.088966369628906f, 0.0f},
+  {-1, -1, -1, 0.0f, 63.272727966308594f},
+  {-1, -1, -1, 0.0f, 63.046875f},
+  {134, 137, 2, 3.762744426727295f, 0.0f},
+  {135, 136, 3, 64.91098022460938f, 0.0f},
+  {-1, -1, -1, 0.0f, 63.642425537109375f},
+  {-1, -1, -1, 0.0f, 63.79697036743164f},
+  {-1, -1, -1, 0.0f, 63.478126525878906f},
+  {139, 208, 1, 52.95849609375f, 0.0f},
+  {140, 159, 1, 40.204193115234375f, 0.0f},
+  {141, 150, 0, 24.73933219909668f, 0.0f},
+  {142, 147, 2, 47.639766693115234f, 0.0f},
+  {143, 144, 3, 66.04241943359375f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.0250015258789f},
+  {145, 146, 3, 66.55757141113281f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.96666717529297f},
+  {-1, -1, -1, 0.0f, 65.90908813476562f},
+  {148, 149, 3, 65.58465576171875f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.10302734375f},
+  {-1, -1, -1, 0.0f, 66.17878723144531f},
+  {151, 156, 3, 66.09237670898438f, 0.0f},
+  {152, 153, 0, 26.736190795898438f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.1875f},
+  {154, 155, 2, 57.95604705810547f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.23636627197266f},
+  {-1, -1, -1, 0.0f, 66.19091033935547f},
+  {157, 158, 2, 55.06448745727539f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.1757583618164f},
+  {-1, -1, -1, 0.0f, 66.1312484741211f},
+  {160, 179, 3, 66.06401062011719f, 0.0f},
+  {161, 166, 0, 19.427865982055664f, 0.0f},
+  {162, 165, 1, 52.058223724365234f, 0.0f},
+  {163, 164, 0, 19.36871337890625f, 0.0f},
+  {-1, -1, -1, 0.0f, 64.70909118652344f},
+  {-1, -1, -1, 0.0f, 64.82499694824219f},
+  {-1, -1, -1, 0.0f, 64.5f},
+  {167, 174, 3, 65.93333435058594f, 0.0f},
+  {168, 173, 0, 21.826265335083008f, 0.0f},
+  {169, 172, 3, 65.87120819091797f, 0.0f},
+  {170, 171, 3, 65.78181457519531f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.04545593261719f},
+  {-1, -1, -1, 0.0f, 65.1312484741211f},
+  {-1, -1, -1, 0.0f, 64.9969711303711f},
+  {-1, -1, -1, 0.0f, 64.93333435058594f},
+  {175, 176, 3, 65.96770477294922f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.1242446899414f},
+  {177, 178, 0, 20.454273223876953f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.203125f},
+  {-1, -1, -1, 0.0f, 65.18788146972656f},
+  {180, 199, 2, 47.19447326660156f, 0.0f},
+  {181, 188, 2, 1.1228833198547363f, 0.0f},
+  {182, 187, 1, 48.73702621459961f, 0.0f},
+  {183, 186, 0, 20.134925842285156f, 0.0f},
+  {184, 185, 2, 0.04330134764313698f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.46969604492188f},
+  {-1, -1, -1, 0.0f, 65.55000305175781f},
+  {-1, -1, -1, 0.0f, 65.68788146972656f},
+  {-1, -1, -1, 0.0f, 65.29090881347656f},
+  {189, 192, 1, 44.434906005859375f, 0.0f},
+  {190, 191, 1, 43.43280029296875f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.7212142944336f},
+  {-1, -1, -1, 0.0f, 65.5718765258789f},
+  {193, 196, 1, 46.12044143676758f, 0.0f},
+  {194, 195, 3, 66.43030548095703f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.80000305175781f},
+  {-1, -1, -1, 0.0f, 65.84242248535156f},
+  {197, 198, 2, 32.77586364746094f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.9000015258789f},
+  {-1, -1, -1, 0.0f, 65.96875f},
+  {200, 203, 2, 47.64065170288086f, 0.0f},
+  {201, 202, 3, 66.93209838867188f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.45757293701172f},
+  {-1, -1, -1, 0.0f, 65.48750305175781f},
+  {204, 205, 0, 20.912599563598633f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.39697265625f},
+  {206, 207, 3, 66.23484802246094f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.3272705078125f},
+  {-1, -1, -1, 0.0f, 65.3187484741211f},
+  {209, 226, 3, 66.63333129882812f, 0.0f},
+  {210, 223, 3, 66.50814056396484f, 0.0f},
+  {211, 212, 3, 66.10965728759766f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.6697006225586f},
+  {213, 220, 0, 19.092321395874023f, 0.0f},
+  {214, 219, 0, 19.075702667236328f, 0.0f},
+  {215, 216, 3, 66.1490478515625f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.71514892578125f},
+  {217, 218, 2, 9.174513816833496f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.69999694824219f},
+  {-1, -1, -1, 0.0f, 66.703125f},
+  {-1, -1, -1, 0.0f, 66.71818542480469f},
+  {221, 222, 1, 69.22525024414062f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.69393920898438f},
+  {-1, -1, -1, 0.0f, 66.6937484741211f},
+  {224, 225, 2, 17.0720272064209f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.6242446899414f},
+  {-1, -1, -1, 0.0f, 66.54545593261719f},
+  {227, 246, 3, 67.12059783935547f, 0.0f},
+  {228, 231, 3, 66.69384002685547f, 0.0f},
+  {229, 230, 2, 20.760908126831055f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.47879028320312f},
+  {-1, -1, -1, 0.0f, 66.45625305175781f},
+  {232, 241, 3, 66.9053955078125f, 0.0f},
+  {233, 234, 0, 18.708900451660156f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.32121276855469f},
+  {235, 240, 1, 69.50518798828125f, 0.0f},
+  {236, 239, 3, 66.79914855957031f, 0.0f},
+  {237, 238, 3, 66.71884155273438f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.14848327636719f},
+  {-1, -1, -1, 0.0f, 66.13749694824219f},
+  {-1, -1, -1, 0.0f, 66.16060638427734f},
+  {-1, -1, -1, 0.0f, 66.08181762695312f},
+  {242, 245, 1, 66.87415313720703f, 0.0f},
+  {243, 244, 1, 66.63737487792969f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.34242248535156f},
+  {-1, -1, -1, 0.0f, 66.3187484741211f},
+  {-1, -1, -1, 0.0f, 66.42424011230469f},
+  {247, 250, 2, 1.6061112880706787f, 0.0f},
+  {248, 249, 0, 20.30278778076172f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.5374984741211f},
+  {-1, -1, -1, 0.0f, 66.64242553710938f},
+  {-1, -1, -1, 0.0f, 66.7787857055664f},
+  {252, 259, 1, 47.648685455322266f, 0.0f},
+  {253, 258, 1, 42.259159088134766f, 0.0f},
+  {254, 255, 1, 41.02418518066406f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.68181610107422f},
+  {256, 257, 2, 50.42188262939453f, 0.0f},
+  {-1, -1, -1, 0.0f, 65.58125305175781f},
+  {-1, -1, -1, 0.0f, 65.48484802246094f},
+  {-1, -1, -1, 0.0f, 65.88787841796875f},
+  {260, 289, 3, 68.20255279541016f, 0.0f},
+  {261, 272, 3, 67.60965728759766f, 0.0f},
+  {262, 265, 2, 26.295629501342773f, 0.0f},
+  {263, 264, 0, 20.92287254333496f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.7437515258789f},
+  {-1, -1, -1, 0.0f, 66.85454559326172f},
+  {266, 269, 2, 42.73220443725586f, 0.0f},
+  {267, 268, 1, 61.307830810546875f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.9969711303711f},
+  {-1, -1, -1, 0.0f, 66.95625305175781f},
+  {270, 271, 3, 67.51211547851562f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.08181762695312f},
+  {-1, -1, -1, 0.0f, 67.15937805175781f},
+  {273, 286, 2, 61.74065017700195f, 0.0f},
+  {274, 281, 3, 67.8742446899414f, 0.0f},
+  {275, 276, 2, 50.0150146484375f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.26969909667969f},
+  {277, 280, 2, 61.13606262207031f, 0.0f},
+  {278, 279, 3, 67.7984848022461f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.3484878540039f},
+  {-1, -1, -1, 0.0f, 67.36969757080078f},
+  {-1, -1, -1, 0.0f, 67.3187484741211f},
+  {282, 285, 1, 55.02560806274414f, 0.0f},
+  {283, 284, 2, 58.38037872314453f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.4375f},
+  {-1, -1, -1, 0.0f, 67.44242095947266f},
+  {-1, -1, -1, 0.0f, 67.41515350341797f},
+  {287, 288, 3, 68.15254974365234f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.58181762695312f},
+  {-1, -1, -1, 0.0f, 67.63749694824219f},
+  {290, 301, 3, 68.55804443359375f, 0.0f},
+  {291, 296, 0, 23.356103897094727f, 0.0f},
+  {292, 293, 3, 68.40605926513672f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.91212463378906f},
+  {294, 295, 0, 22.741811752319336f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.96875f},
+  {-1, -1, -1, 0.0f, 68.01212310791016f},
+  {297, 298, 0, 23.641530990600586f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.83636474609375f},
+  {299, 300, 3, 68.3045425415039f, 0.0f},
+  {-1, -1, -1, 0.0f, 67.76060485839844f},
+  {-1, -1, -1, 0.0f, 67.796875f},
+  {302, 307, 1, 58.847103118896484f, 0.0f},
+  {303, 304, 0, 23.243244171142578f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.23636627197266f},
+  {305, 306, 1, 55.37254333496094f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.16874694824219f},
+  {-1, -1, -1, 0.0f, 68.13636016845703f},
+  {308, 313, 3, 68.97120666503906f, 0.0f},
+  {309, 310, 0, 22.665401458740234f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.38787841796875f},
+  {311, 312, 2, 51.1864013671875f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.37272644042969f},
+  {-1, -1, -1, 0.0f, 68.36250305175781f},
+  {-1, -1, -1, 0.0f, 68.42424011230469f},
+  {315, 432, 3, 72.61212158203125f, 0.0f},
+  {316, 359, 1, 51.25554656982422f, 0.0f},
+  {317, 318, 3, 71.1124038696289f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.296875f},
+  {319, 344, 0, 25.135746002197266f, 0.0f},
+  {320, 335, 2, 52.45977783203125f, 0.0f},
+  {321, 334, 1, 51.14287185668945f, 0.0f},
+  {322, 325, 3, 71.53181457519531f, 0.0f},
+  {323, 324, 0, 23.64029884338379f, 0.0f},
+  {-1, -1, -1, 0.0f, 70.44242095947266f},
+  {-1, -1, -1, 0.0f, 70.60606384277344f},
+  {326, 333, 3, 72.59848022460938f, 0.0f},
+  {327, 332, 0, 24.641098022460938f, 0.0f},
+  {328, 331, 0, 24.15707778930664f, 0.0f},
+  {329, 330, 0, 22.3748722076416f, 0.0f},
+  {-1, -1, -1, 0.0f, 70.65757751464844f},
+  {-1, -1, -1, 0.0f, 70.6937484741211f},
+  {-1, -1, -1, 0.0f, 70.75151824951172f},
+  {-1, -1, -1, 0.0f, 70.9454574584961f},
+  {-1, -1, -1, 0.0f, 71.03125f},
+  {-1, -1, -1, 0.0f, 71.63636016845703f},
+  {336, 339, 0, 21.980701446533203f, 0.0f},
+  {337, 338, 0, 21.577932357788086f, 0.0f},
+  {-1, -1, -1, 0.0f, 70.46562194824219f},
+  {-1, -1, -1, 0.0f, 70.26060485839844f},
+  {340, 341, 3, 72.11572265625f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.88484954833984f},
+  {342, 343, 3, 72.2732925415039f, 0.0f},
+  {-1, -1, -1, 0.0f, 70.09062194824219f},
+  {-1, -1, -1, 0.0f, 70.1212158203125f},
+  {345, 352, 3, 72.26121520996094f, 0.0f},
+  {346, 349, 3, 72.06060791015625f, 0.0f},
+  {347, 348, 2, 52.04496383666992f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.015625f},
+  {-1, -1, -1, 0.0f, 71.10606384277344f},
+  {350, 351, 1, 41.06911849975586f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.3187484741211f},
+  {-1, -1, -1, 0.0f, 71.25151824951172f},
+  {353, 356, 3, 72.41368103027344f, 0.0f},
+  {354, 355, 3, 72.30302429199219f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.50605773925781f},
+  {-1, -1, -1, 0.0f, 71.55757904052734f},
+  {357, 358, 0, 26.111921310424805f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.69999694824219f},
+  {-1, -1, -1, 0.0f, 71.640625f},
+  {360, 361, 1, 51.29090881347656f, 0.0f},
+  {-1, -1, -1, 0.0f, 62.2599983215332f},
+  {362, 411, 3, 70.53584289550781f, 0.0f},
+  {363, 372, 3, 69.44175720214844f, 0.0f},
+  {364, 367, 3, 69.16666412353516f, 0.0f},
+  {365, 366, 0, 22.364397048950195f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.58484649658203f},
+  {-1, -1, -1, 0.0f, 68.53125f},
+  {368, 369, 1, 59.886287689208984f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.796875f},
+  {370, 371, 2, 1.5745877027511597f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.69091033935547f},
+  {-1, -1, -1, 0.0f, 68.69999694824219f},
+  {373, 392, 0, 22.029571533203125f, 0.0f},
+  {374, 389, 3, 70.24710845947266f, 0.0f},
+  {375, 380, 2, 13.585047721862793f, 0.0f},
+  {376, 379, 0, 21.95758056640625f, 0.0f},
+  {377, 378, 0, 21.929121017456055f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.3787841796875f},
+  {-1, -1, -1, 0.0f, 69.4272689819336f},
+  {-1, -1, -1, 0.0f, 69.28437805175781f},
+  {381, 382, 1, 62.432640075683594f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.60909271240234f},
+  {383, 384, 1, 63.81673049926758f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.44999694824219f},
+  {385, 388, 1, 64.72614288330078f, 0.0f},
+  {386, 387, 1, 64.400634765625f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.5062484741211f},
+  {-1, -1, -1, 0.0f, 69.51212310791016f},
+  {-1, -1, -1, 0.0f, 69.4969711303711f},
+  {390, 391, 3, 70.37589263916016f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.53437805175781f},
+  {-1, -1, -1, 0.0f, 69.6242446899414f},
+  {393, 402, 2, 12.718633651733398f, 0.0f},
+  {394, 397, 1, 59.430694580078125f, 0.0f},
+  {395, 396, 3, 69.87045288085938f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.1212158203125f},
+  {-1, -1, -1, 0.0f, 69.21212005615234f},
+  {398, 401, 3, 69.6757583618164f, 0.0f},
+  {399, 400, 3, 69.57930755615234f, 0.0f},
+  {-1, -1, -1, 0.0f, 68.94242095947266f},
+  {-1, -1, -1, 0.0f, 69.0f},
+  {-1, -1, -1, 0.0f, 69.0687484741211f},
+  {403, 406, 0, 22.51864242553711f, 0.0f},
+  {404, 405, 2, 49.8574333190918f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.31428527832031f},
+  {-1, -1, -1, 0.0f, 69.36060333251953f},
+  {407, 410, 3, 70.36311340332031f, 0.0f},
+  {408, 409, 2, 28.741634368896484f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.43636322021484f},
+  {-1, -1, -1, 0.0f, 69.45625305175781f},
+  {-1, -1, -1, 0.0f, 69.5545425415039f},
+  {412, 431, 3, 71.9803466796875f, 0.0f},
+  {413, 426, 3, 71.06865692138672f, 0.0f},
+  {414, 417, 3, 70.6756591796875f, 0.0f},
+  {415, 416, 3, 70.63182067871094f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.7272720336914f},
+  {-1, -1, -1, 0.0f, 69.68788146972656f},
+  {418, 425, 3, 71.0234375f, 0.0f},
+  {419, 422, 3, 70.8484878540039f, 0.0f},
+  {420, 421, 0, 22.244396209716797f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.8499984741211f},
+  {-1, -1, -1, 0.0f, 69.89090728759766f},
+  {423, 424, 0, 22.487646102905273f, 0.0f},
+  {-1, -1, -1, 0.0f, 69.97272491455078f},
+  {-1, -1, -1, 0.0f, 70.09062194824219f},
+  {-1, -1, -1, 0.0f, 69.73750305175781f},
+  {427, 430, 3, 71.35454559326172f, 0.0f},
+  {428, 429, 1, 53.28258514404297f, 0.0f},
+  {-1, -1, -1, 0.0f, 70.30937194824219f},
+  {-1, -1, -1, 0.0f, 70.18484497070312f},
+  {-1, -1, -1, 0.0f, 69.84242248535156f},
+  {-1, -1, -1, 0.0f, 71.55000305175781f},
+  {433, 606, 3, 75.36212158203125f, 0.0f},
+  {434, 515, 3, 73.73181915283203f, 0.0f},
+  {435, 486, 3, 73.3709716796875f, 0.0f},
+  {436, 465, 1, 59.12110137939453f, 0.0f},
+  {437, 452, 3, 73.0030288696289f, 0.0f},
+  {438, 439, 0, 20.10653305053711f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.23750305175781f},
+  {440, 445, 0, 22.104143142700195f, 0.0f},
+  {441, 442, 1, 49.63910675048828f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.45757293701172f},
+  {443, 444, 0, 21.131322860717773f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.99394226074219f},
+  {-1, -1, -1, 0.0f, 71.76667022705078f},
+  {446, 447, 0, 22.154281616210938f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.00909423828125f},
+  {448, 451, 2, 57.39725875854492f, 0.0f},
+  {449, 450, 0, 23.80545997619629f, 0.0f},
+  {-1, -1, -1, 0.0f, 71.88749694824219f},
+  {-1, -1, -1, 0.0f, 71.8968734741211f},
+  {-1, -1, -1, 0.0f, 71.93333435058594f},
+  {453, 458, 3, 73.11259460449219f, 0.0f},
+  {454, 455, 1, 46.21156311035156f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.2406234741211f},
+  {456, 457, 0, 23.717166900634766f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.1781234741211f},
+  {-1, -1, -1, 0.0f, 72.18788146972656f},
+  {459, 464, 2, 58.992591857910156f, 0.0f},
+  {460, 461, 0, 22.383018493652344f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.28485107421875f},
+  {462, 463, 2, 29.230207443237305f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.33333587646484f},
+  {-1, -1, -1, 0.0f, 72.3242416381836f},
+  {-1, -1, -1, 0.0f, 72.28181457519531f},
+  {466, 471, 3, 72.7708740234375f, 0.0f},
+  {467, 470, 2, 42.36901092529297f, 0.0f},
+  {468, 469, 3, 72.73484802246094f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.46875f},
+  {-1, -1, -1, 0.0f, 72.42424011230469f},
+  {-1, -1, -1, 0.0f, 72.30908966064453f},
+  {472, 481, 1, 61.395721435546875f, 0.0f},
+  {473, 474, 1, 60.094486236572266f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.76363372802734f},
+  {475, 478, 1, 60.66048049926758f, 0.0f},
+  {476, 477, 0, 19.805747985839844f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.64242553710938f},
+  {-1, -1, -1, 0.0f, 72.70606231689453f},
+  {479, 480, 0, 19.668184280395508f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.7125015258789f},
+  {-1, -1, -1, 0.0f, 72.703125f},
+  {482, 483, 0, 19.310331344604492f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.58787536621094f},
+  {484, 485, 3, 72.91515350341797f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.60909271240234f},
+  {-1, -1, -1, 0.0f, 72.61515045166016f},
+  {487, 500, 3, 73.56893920898438f, 0.0f},
+  {488, 491, 0, 21.177242279052734f, 0.0f},
+  {489, 490, 0, 19.84812355041504f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.86666870117188f},
+  {-1, -1, -1, 0.0f, 72.77812194824219f},
+  {492, 497, 3, 73.51818084716797f, 0.0f},
+  {493, 496, 3, 73.46888732910156f, 0.0f},
+  {494, 495, 0, 22.57122802734375f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.50312805175781f},
+  {-1, -1, -1, 0.0f, 72.60606384277344f},
+  {-1, -1, -1, 0.0f, 72.50312805175781f},
+  {498, 499, 3, 73.5477294921875f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.7757568359375f},
+  {-1, -1, -1, 0.0f, 72.57878875732422f},
+  {501, 514, 2, 52.2869987487793f, 0.0f},
+  {502, 505, 3, 73.6216812133789f, 0.0f},
+  {503, 504, 2, 2.398085832595825f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.91874694824219f},
+  {-1, -1, -1, 0.0f, 72.9000015258789f},
+  {506, 513, 2, 50.52080535888672f, 0.0f},
+  {507, 510, 2, 29.364500045776367f, 0.0f},
+  {508, 509, 1, 52.53460693359375f, 0.0f},
+  {-1, -1, -1, 0.0f, 72.98787689208984f},
+  {-1, -1, -1, 0.0f, 72.96363830566406f},
+  {511, 512, 3, 73.6873550415039f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.01818084716797f},
+  {-1, -1, -1, 0.0f, 73.02424621582031f},
+  {-1, -1, -1, 0.0f, 72.8968734741211f},
+  {-1, -1, -1, 0.0f, 72.75757598876953f},
+  {516, 533, 1, 44.83671569824219f, 0.0f},
+  {517, 518, 0, 23.54323387145996f, 0.0f},
+  {-1, -1, -1, 0.0f, 66.66666412353516f},
+  {519, 528, 1, 41.71329879760742f, 0.0f},
+  {520, 523, 2, 58.35151672363281f, 0.0f},
+  {521, 522, 2, 55.892845153808594f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.54545593261719f},
+  {-1, -1, -1, 0.0f, 73.4468765258789f},
+  {524, 525, 1, 39.7589225769043f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.70909118652344f},
+  {526, 527, 1, 40.23954772949219f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.58787536621094f},
+  {-1, -1, -1, 0.0f, 73.6312484741211f},
+  {529, 532, 0, 25.181663513183594f, 0.0f},
+  {530, 531, 1, 42.79903030395508f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.2242431640625f},
+  {-1, -1, -1, 0.0f, 73.1312484741211f},
+  {-1, -1, -1, 0.0f, 73.38484954833984f},
+  {534, 567, 3, 74.39545440673828f, 0.0f},
+  {535, 548, 3, 73.98905944824219f, 0.0f},
+  {536, 543, 1, 59.387332916259766f, 0.0f},
+  {537, 542, 3, 73.89928436279297f, 0.0f},
+  {538, 539, 0, 19.965171813964844f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.04242706298828f},
+  {540, 541, 1, 57.618160247802734f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.09394073486328f},
+  {-1, -1, -1, 0.0f, 73.09687805175781f},
+  {-1, -1, -1, 0.0f, 73.23636627197266f},
+  {544, 547, 3, 73.86817932128906f, 0.0f},
+  {545, 546, 2, 34.70132064819336f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.35757446289062f},
+  {-1, -1, -1, 0.0f, 73.2437515258789f},
+  {-1, -1, -1, 0.0f, 73.49090576171875f},
+  {549, 554, 0, 20.433347702026367f, 0.0f},
+  {550, 553, 3, 74.19137573242188f, 0.0f},
+  {551, 552, 0, 20.22147560119629f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.31818389892578f},
+  {-1, -1, -1, 0.0f, 73.3843765258789f},
+  {-1, -1, -1, 0.0f, 73.49090576171875f},
+  {555, 564, 0, 22.48274040222168f, 0.0f},
+  {556, 559, 0, 22.21640396118164f, 0.0f},
+  {557, 558, 1, 56.942787170410156f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.61212158203125f},
+  {-1, -1, -1, 0.0f, 73.55000305175781f},
+  {560, 561, 1, 58.3636360168457f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.6656265258789f},
+  {562, 563, 0, 22.35879898071289f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.68788146972656f},
+  {-1, -1, -1, 0.0f, 73.70606231689453f},
+  {565, 566, 1, 57.638771057128906f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.83636474609375f},
+  {-1, -1, -1, 0.0f, 73.75454711914062f},
+  {568, 595, 0, 23.163915634155273f, 0.0f},
+  {569, 590, 3, 75.11666107177734f, 0.0f},
+  {570, 575, 0, 21.4273738861084f, 0.0f},
+  {571, 574, 2, 32.748382568359375f, 0.0f},
+  {572, 573, 3, 74.62030792236328f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.6937484741211f},
+  {-1, -1, -1, 0.0f, 73.76363372802734f},
+  {-1, -1, -1, 0.0f, 73.84545135498047f},
+  {576, 579, 3, 74.46969604492188f, 0.0f},
+  {577, 578, 3, 74.4000015258789f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.9000015258789f},
+  {-1, -1, -1, 0.0f, 73.7750015258789f},
+  {580, 589, 0, 23.098581314086914f, 0.0f},
+  {581, 582, 0, 21.66644287109375f, 0.0f},
+  {-1, -1, -1, 0.0f, 73.953125f},
+  {583, 584, 0, 22.330352783203125f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.08181762695312f},
+  {585, 588, 3, 74.57637023925781f, 0.0f},
+  {586, 587, 0, 22.852882385253906f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.0250015258789f},
+  {-1, -1, -1, 0.0f, 74.03030395507812f},
+  {-1, -1, -1, 0.0f, 74.04545593261719f},
+  {-1, -1, -1, 0.0f, 74.1781234741211f},
+  {591, 594, 2, 48.94595718383789f, 0.0f},
+  {592, 593, 3, 75.22504425048828f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.1515121459961f},
+  {-1, -1, -1, 0.0f, 74.23124694824219f},
+  {-1, -1, -1, 0.0f, 74.39393615722656f},
+  {596, 603, 0, 23.467012405395508f, 0.0f},
+  {597, 598, 0, 23.20956802368164f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.2757568359375f},
+  {599, 600, 1, 53.665916442871094f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.37187194824219f},
+  {601, 602, 1, 54.79370880126953f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.40303039550781f},
+  {-1, -1, -1, 0.0f, 74.39697265625f},
+  {604, 605, 0, 23.583927154541016f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.53636169433594f},
+  {-1, -1, -1, 0.0f, 74.5406265258789f},
+  {607, 646, 3, 76.36060333251953f, 0.0f},
+  {608, 627, 3, 75.75757598876953f, 0.0f},
+  {609, 620, 3, 75.48332977294922f, 0.0f},
+  {610, 615, 3, 75.43385314941406f, 0.0f},
+  {611, 614, 2, 43.92223358154297f, 0.0f},
+  {612, 613, 3, 75.41060638427734f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.61212158203125f},
+  {-1, -1, -1, 0.0f, 74.6515121459961f},
+  {-1, -1, -1, 0.0f, 74.5406265258789f},
+  {616, 619, 1, 51.27659225463867f, 0.0f},
+  {617, 618, 2, 50.98097610473633f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.7437515258789f},
+  {-1, -1, -1, 0.0f, 74.69999694824219f},
+  {-1, -1, -1, 0.0f, 74.80908966064453f},
+  {621, 624, 3, 75.60454559326172f, 0.0f},
+  {622, 623, 3, 75.5227279663086f, 0.0f},
+  {-1, -1, -1, 0.0f, 74.92424011230469f},
+  {-1, -1, -1, 0.0f, 74.9749984741211f},
+  {625, 626, 2, 55.494625091552734f, 0.0f},
+  {-1, -1, -1, 0.0f, 75.046875f},
+  {-1, -1, -1, 0.0f, 75.03636169433594f},
+  {628, 633, 0, 20.59660530090332f, 0.0f},
+  {629, 632, 0, 20.486352920532227f, 0.0f},
+  {630, 631, 1, 56.67995071411133f, 0.0f},
+  {-1, -1, -1, 0.0f, 75.69999694824219f},
+  {-1, -1, -1, 0.0f, 75.81515502929688f},
+  {-1, -1, -1, 0.0f, 75.5484848022461f},
+  {634, 641, 0, 22.13545799255371f, 0.0f},
+  {635, 638, 3, 76.09119415283203f, 0.0f},
+  {636, 637, 3, 76.03181457519531f, 0.0f},
+  {-1, -1, -1, 0.0f, 75.35454559326172f},
+  {-1, -1, -1, 0.0f, 75.36969757080078f},
+  {639, 640, 2, 53.90309143066406f, 0.0f},
+  {-1, -1, -1, 0.0f, 75.46969604492188f},
+  {-1, -1, -1, 0.0f, 75.4375f},
+  {642, 645, 3, 75.96690368652344f, 0.0f},
+  {643, 644, 3, 75.86666870117188f, 0.0f},
+  {-1, -1, -1, 0.0f, 75.19696807861328f},
+  {-1, -1, -1, 0.0f, 75.25312805175781f},
+  {-1, -1, -1, 0.0f, 75.06969451904297f},
+  {647, 684, 2, 21.576080322265625f, 0.0f},
+  {648, 661, 0, 19.264881134033203f, 0.0f},
+  {649, 654, 3, 76.91969299316406f, 0.0f},
+  {650, 651, 3, 76.86907958984375f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.30908966064453f},
+  {652, 653, 3, 76.89393615722656f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.41212463378906f},
+  {-1, -1, -1, 0.0f, 76.4781265258789f},
+  {655, 656, 0, 19.185972213745117f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.55757904052734f},
+  {657, 658, 1, 55.648250579833984f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.70909118652344f},
+  {659, 660, 3, 76.95890045166016f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.63333129882812f},
+  {-1, -1, -1, 0.0f, 76.6656265258789f},
+  {662, 675, 0, 20.07438087463379f, 0.0f},
+  {663, 670, 1, 53.57676315307617f, 0.0f},
+  {664, 669, 0, 19.891183853149414f, 0.0f},
+  {665, 666, 3, 77.23484802246094f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.90908813476562f},
+  {667, 668, 3, 77.25719451904297f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.93030548095703f},
+  {-1, -1, -1, 0.0f, 76.9312515258789f},
+  {-1, -1, -1, 0.0f, 76.98750305175781f},
+  {671, 672, 0, 19.348073959350586f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.80908966064453f},
+  {673, 674, 3, 77.15350341796875f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.859375f},
+  {-1, -1, -1, 0.0f, 76.8787841796875f},
+  {676, 679, 0, 20.555843353271484f, 0.0f},
+  {677, 678, 0, 20.301591873168945f, 0.0f},
+  {-1, -1, -1, 0.0f, 77.02424621582031f},
+  {-1, -1, -1, 0.0f, 77.0545425415039f},
+  {680, 683, 2, 11.762235641479492f, 0.0f},
+  {681, 682, 2, 2.0901334285736084f, 0.0f},
+  {-1, -1, -1, 0.0f, 77.1312484741211f},
+  {-1, -1, -1, 0.0f, 77.1757583618164f},
+  {-1, -1, -1, 0.0f, 77.23030090332031f},
+  {685, 698, 0, 23.151752471923828f, 0.0f},
+  {686, 691, 3, 76.59545135498047f, 0.0f},
+  {687, 688, 3, 76.44512176513672f, 0.0f},
+  {-1, -1, -1, 0.0f, 75.91818237304688f},
+  {689, 690, 2, 44.37637710571289f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.06363677978516f},
+  {-1, -1, -1, 0.0f, 76.0f},
+  {692, 695, 1, 58.67115020751953f, 0.0f},
+  {693, 694, 3, 76.64947509765625f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.1187515258789f},
+  {-1, -1, -1, 0.0f, 76.16363525390625f},
+  {696, 697, 2, 29.698623657226562f, 0.0f},
+  {-1, -1, -1, 0.0f, 76.25312805175781f},
+  {-1, -1, -1, 0.0f, 76.24545288085938f},
+  {-1, -1, -1, 0.0f, 75.20606231689453f},
+};
+
+constexpr int WATERING_TREE_NODES = sizeof(WATERING_TREE) / sizeof(WATERING_TREE[0]);
+
+// Walks the tree from the root; at most depth 15 comparisons
+constexpr float predictWateringMoisture(const float (&features)[WATERING_MODEL_FEATURES]) {
+  int node = 0;
+  while (WATERING_TREE[node].feature != -1) {
+    node = features[WATERING_TREE[node].feature] <= WATERING_TREE[node].threshold
+               ? WATERING_TREE[node].left
+               : WATERING_TREE[node].right;
+  }
+  return WATERING_TREE[node].value;
+}
+
+#endif // WATERINGMODEL_H
@@ -0,0 +1,136 @@
+#ifndef WATERINGPREDICTOR_H
+#define WATERINGPREDICTOR_H
+
+#include "Config.h"
+#include "WateringModel.h"
+
+#define WATERING_BUCKET_SECONDS (WATERING_MODEL_RESAMPLE_MINUTES * 60L)
+#define WATERING_HORIZON_HOURS (WATERING_MODEL_FUTURE_STEPS * WATERING_MODEL_RESAMPLE_MINUTES / 60.0f)
+
+// Predicts the next watering time on the device with the tree exported from the backend.
+// Records are folded into running sums for the current 30 minute bucket (the backend's
+// resample('30min').mean()), so each record costs O(1) and the tree runs once per bucket.
+class WateringPredictor {
+private:
+  long bucketStart;
+  float sums[WATERING_MODEL_FEATURES];
+  int counts[WATERING_MODEL_FEATURES];
+
+  bool valid;
+  float currentMoisture;
+  float predictedMoisture;
+  long predictedDryTime;
+  long uploadedDryTime;
+  bool uploadPending;
+  unsigned long predictions;
+
+  void addFeature(int feature, float value) {
+    if (!isnan(value) && value >= 0) {
+      sums[feature] += value;
+      counts[feature]++;
+    }
+  }
+
+  // Ported from average_moisture_loss_rate() in backend/model_predict.py (% per hour)
+  static float heuristicLossRate(float temp, float light, float humidity) {
+    float rate = 0.1f + (temp - 20) * 0.02f + (light / 100) * 0.1f - (50 - humidity) * 0.02f;
+    return rate > 0.08f ? rate : 0.08f;
+  }
+
+  void closeBucket() {
+    float features[WATERING_MODEL_FEATURES];
+    for (int i = 0; i < WATERING_MODEL_FEATURES; i++) {
+      if (counts[i] == 0) {
+        return;  // The tree was trained on complete buckets only
+      }
+      features[i] = sums[i] / counts[i];
+    }
+
+    currentMoisture = features[WATERING_FEATURE_SOIL_MOISTURE_1];
+    predictedMoisture = predictWateringMoisture(features);
+
+    // Moisture lost per hour according to the tree, never slower than the backend's heuristic
+    float rate = (currentMoisture - predictedMoisture) / WATERING_HORIZON_HOURS;
+    float minRate = heuristicLossRate(features[WATERING_FEATURE_EXT_TEMP], features[WATERING_FEATURE_LIGHT],
+                                      features[WATERING_FEATURE_HUMIDITY]);
+    if (rate < minRate) {
+      rate = minRate;
+    }
+    float hours = currentMoisture > WATERING_MOISTURE_THRESHOLD
+                      ? (currentMoisture - WATERING_MOISTURE_THRESHOLD) / rate
+                      : 0;
+
+    predictedDryTime = bucketStart + WATERING_BUCKET_SECONDS + (long)(hours * 3600);
+    valid = true;
+    predictions++;
+
+    long change = predictedDryTime - uploadedDryTime;
+    if (uploadedDryTime <= 0 || change >= PREDICTION_CHANGE_THRESHOLD || -change >= PREDICTION_CHANGE_THRESHOLD) {
+      uploadPending = true;
+    }
+  }
+
+public:
+  WateringPredictor()
+    : bucketStart(-1), valid(false), currentMoisture(NAN), predictedMoisture(NAN), predictedDryTime(0),
+      uploadedDryTime(0), uploadPending(false), predictions(0) {
+    resetBucket();
+  }
+
+  void resetBucket() {
+    for (int i = 0; i < WATERING_MODEL_FEATURES; i++) {
+      sums[i] = 0;
+      counts[i] = 0;
+    }
+  }
+
+  // Feeds one recorded average, reading moisture from the plant's soil probe; runs the tree
+  // when the record starts a new bucket
+  void addRecord(const SensorData& data, ChannelId soilProbe = CHANNEL_SOIL_MOISTURE_1) {
+    if (data.timestamp <= 0) {
+      return;
+    }
+    long bucket = data.timestamp - data.timestamp % WATERING_BUCKET_SECONDS;
+    if (bucket != bucketStart) {
+      if (bucketStart >= 0) {
+        closeBucket();
+      }
+      resetBucket();
+      bucketStart = bucket;
+    }
+
+    addFeature(WATERING_FEATURE_EXT_TEMP, data.get(CHANNEL_EXT_TEMP));
+    addFeature(WATERING_FEATURE_HUMIDITY, data.get(CHANNEL_HUMIDITY));
+    addFeature(WATERING_FEATURE_LIGHT, data.get(CHANNEL_LIGHT));
+    addFeature(WATERING_FEATURE_SOIL_MOISTURE_1, data.get(soilProbe));
+  }
+
+  bool hasPrediction() const { return valid; }
+  bool hasPendingUpload() const { return uploadPending; }
+  unsigned long getPredictionCount() const { return predictions; }
+  float getPredictedMoisture() const { return predictedMoisture; }
+  long getPredictedDryTime() const { return predictedDryTime; }
+
+  // Call once the pending prediction is queued for upload; the queue retries it until accepted
+  void markQueued() {
+    uploadedDryTime = predictedDryTime;
+    uploadPending = false;
+  }
+
+  // Serializes the latest prediction for /api/devicePrediction. Returns 0 if it didn't fit.
+  size_t writeJson(char* out, size_t capacity, int plantId) const {
+    time_t secs = predictedDryTime;
+    struct tm timeInfo;
+    gmtime_r(&secs, &timeInfo);
+    char iso[20];
+    strftime(iso, sizeof(iso), "%Y-%m-%dT%H:%M:%S", &timeInfo);
+
+    int n = snprintf(out, capacity,
+                     "{\"plant_id\":%d,\"predicted_dry_time\":\"%s\",\"current_moisture\":%.7g,"
+                     "\"predicted_moisture\":%.7g}",
+                     plantId, iso, currentMoisture, predictedMoisture);
+    return n > 0 && (size_t)n < capacity ? (size_t)n : 0;
+  }
+};
+
+#endif // WATERINGPREDICTOR_H
@@ -3,21 +3,34 @@
 
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include "BackendRequest.h"
 #include "Memory.h"
+#include "UploadBatch.h"
+#include "UploadWindow.h"
+#include "UploadProfiler.h"
+#if USE_MQTT_UPLOAD
+#include "MqttTransport.h"
+#elif USE_COAP_UPLOAD
+#include "CoapTransport.h"
+#else
+#include "HttpTransport.h"
+#endif
 // #include "esp_wpa2.h"
 #include <esp_wifi.h>
 #include "Certificate.h"
 #include "TimeService.h"
-
-// Forward declaration of SensorManager class
-class SensorManager;
+#include "ConnectionManager.h"
+#include "SensorService.h"
+#if USE_ROLLUPS
+#include "Rollups.h"
+#endif
 
 bool postData(const String& url, const String& jsonPayload, int numRetries) {
   Serial.println("Attempting to post data to webserver");
   Serial.println("URL: " + url);
   Serial.println("Payload: " + jsonPayload);
 
-  if(WiFi.status() != WL_CONNECTED) {
+  if(!connectionManager.isConnected()) {
     Serial.println("Cannot post: WiFi is disconnected");
     return false;
   }
@@ -29,7 +42,7 @@ bool postData(const String& url, const String& jsonPayload, int numRetries) {
   }
 
   HTTPClient http;
-  http.begin(url);
+  beginBackendRequest(http, url);
   http.addHeader("Content-Type", "application/json");
 
   int httpResponseCode = 0;
@@ -55,64 +68,202 @@ bool postData(const String& url, const String& jsonPayload, int numRetries) {
   return false;
 }
 
-bool postSensorData(const String& url, int numRetries, SensorManager& sensorManager) {
+// Identifies the device's sequence numbers to the backend: the ID provisioning stored, or the
+// station MAC it is derived from when the device was never provisioned
+const String& uploadDeviceId() {
+  static Preferences devicePreferences;  // The network task's own handle
+  static String deviceId;
+  if (deviceId.isEmpty()) {
+    devicePreferences.begin("device_prefs", true);
+    deviceId = devicePreferences.getString("device_id", "");
+    devicePreferences.end();
+  }
+  if (deviceId.isEmpty()) {
+    String mac = WiFi.macAddress();
+    mac.replace(":", "");
+    deviceId = mac;
+  }
+  return deviceId;
+}
+
+#if USE_MQTT_UPLOAD
+MqttTransport uploadTransport(PLANTGURU_MQTT_HOST, PLANTGURU_MQTT_PORT);
+#elif USE_COAP_UPLOAD
+CoapTransport uploadTransport(PLANTGURU_COAP_HOST, PLANTGURU_COAP_PORT);
+#else
+HttpTransport uploadTransport(PLANTGURU_SENSOR_ENDPOINT);
+#endif
+
+bool postSensorData(UploadTransport& transport, int numRetries, SensorManager& sensorManager) {
   if (isEmpty(cb)){
     Serial.println("Cannot post: No Data");
     return false;
   }
 
-  SensorData data;
-  int maxPerRequest = 10;
-  SensorData sendSensorDataBuffer[maxPerRequest];
-  int i = 0;
-  String json_info = "[";
-  
-  while (popFront(cb, data) && i < maxPerRequest) {
-    sendSensorDataBuffer[i] = data;
-    
-    time_t unixTimestampSecs = sendSensorDataBuffer[i].timestamp;
-    struct tm timeInfo;
-    gmtime_r(&unixTimestampSecs, &timeInfo);
-    
-    char timestampStr[20];
-    strftime(timestampStr, sizeof(timestampStr), "%Y-%m-%dT%H:%M:%S", &timeInfo);
-    sendSensorDataBuffer[i].date = String(timestampStr);
-    
-    preferences.begin("device_prefs", true);
-    sendSensorDataBuffer[i].plant_id = preferences.getInt("plant_id", -1);
-    preferences.end();
-    
-    if (i != 0) {
-      json_info = json_info + "," + sendSensorDataBuffer[i].toJson();
-    } else {
-      json_info = json_info + sendSensorDataBuffer[i].toJson();
-    }
-    i++;
+  // Don't reserve a batch we already know can't go out
+  if (!connectionManager.isConnected() || !isTimeSet()) {
+    return false;
   }
-  json_info = json_info + "]";
 
-  if (sendSensorDataBuffer[0].plant_id == -1) {
+  // The sampling task picks up a plant provisioning assigns after boot (SharedPlantMap::sync())
+  PlantMap plants = plantMap.get();
+  if (plants.plantIds[0] == -1) {
     Serial.println("Cannot post: Invalid plant ID");
-    for (int j = i - 1; j >= 0; j--) {
-      pushFront(cb, sendSensorDataBuffer[j]);
+    return false;
+  }
+
+  // Drains the whole backlog with up to UPLOAD_WINDOW_MAX batches in flight. Retrying is safe:
+  // the backend ignores sequences it already stored.
+  static UploadWindow window;
+  static UploadBatch batch;
+  const char* deviceId = uploadDeviceId().c_str();
+  int batchesAcked = 0;
+  int failures = 0;
+  unsigned long uploadStartUs = micros();  // How long the upload keeps the radio busy
+  size_t sentBefore = transport.bytesSent();
+  size_t receivedBefore = transport.bytesReceived();
+  unsigned long sentAtUs[UPLOAD_WINDOW_MAX];  // When each batch in flight was written, oldest at sentAtFirst
+  int sentAtFirst = 0;
+
+  while (failures < numRetries) {
+    if (!transport.begin(deviceId)) {
+      failures++;
+      delay(1000);
+      continue;
+    }
+
+    bool sendFailed = false;
+    while (window.take(cb, batch, plants, deviceId)) {
+      unsigned long sendStartUs = micros();
+      if (!transport.send(batch.payload, batch.payloadLength)) {
+        sendFailed = true;
+        break;
+      }
+      unsigned long sentUs = micros();
+      uploadProfiler.record(UPLOAD_PHASE_SEND, sentUs - sendStartUs);
+      sentAtUs[(sentAtFirst + window.inFlight() - 1) % UPLOAD_WINDOW_MAX] = sentUs;
+      Serial.printf("Sent %d records (%d in flight, window %d)\n", batch.count, window.inFlight(), window.size());
+    }
+    if (!sendFailed && window.inFlight() == 0) {
+      break;  // Nothing left to send
+    }
+
+    UploadReply reply = {};
+    if (sendFailed || !transport.receive(reply, UPLOAD_RESPONSE_TIMEOUT) || !reply.accepted) {
+      Serial.printf("Upload over %s failed, reverting %d batches in flight\n", transport.name(), window.inFlight());
+      window.fail(cb);
+      transport.stop();
+      failures++;
+      continue;
+    }
+
+    uploadProfiler.record(UPLOAD_PHASE_WAIT, micros() - sentAtUs[sentAtFirst]);
+    sentAtFirst = (sentAtFirst + 1) % UPLOAD_WINDOW_MAX;
+
+    // The sampling task persists the trimmed buffer with its next record
+    if (reply.hasAck) {
+      window.acknowledge(cb, reply.ack);
+    } else {
+      window.acknowledgeOldest(cb);
     }
+    batchesAcked++;
+  }
+
+  if (window.inFlight() > 0) {
+    window.fail(cb);
+    transport.stop();
+  }
+  unsigned long uploadUs = micros() - uploadStartUs;
+  if (batchesAcked > 0) {
+    Serial.printf("Successfully posted %d batches over %s in %lu ms, %d records left\n", batchesAcked,
+                  transport.name(), uploadUs / 1000, bufferCount(cb));
+    connectionManager.reportFirstUpload();
+  }
+
+  bool ok = batchesAcked > 0 && failures < numRetries;
+  uploadProfiler.record(UPLOAD_PHASE_UPLOAD, uploadUs);
+  uploadProfiler.endUpload(ok, transport.bytesSent() - sentBefore, transport.bytesReceived() - receivedBefore);
+  char profile[320];
+  uploadProfiler.format(profile, sizeof(profile));
+  Serial.printf("Upload profile: %s\n", profile);
+  return ok;
+}
+
+// Reports the upload profile after the first upload, then every UPLOAD_PROFILE_REPORT_INTERVAL
+bool postUploadProfile(const String& url, int numRetries) {
+  static unsigned long lastReportMs = 0;
+  static bool reported = false;
+  if (uploadProfiler.uploads == 0 || (reported && millis() - lastReportMs < UPLOAD_PROFILE_REPORT_INTERVAL)) {
     return false;
   }
+  if (!connectionManager.isConnected() || !isTimeSet()) {
+    return false;
+  }
+
+  char payload[1024];
+  if (uploadProfiler.writeJson(payload, sizeof(payload), uploadDeviceId().c_str()) == 0) {
+    return false;
+  }
+  if (!postData(url, String(payload), numRetries)) {
+    return false;
+  }
+  reported = true;
+  lastReportMs = millis();
+  return true;
+}
 
-  bool success = postData(url, json_info, numRetries);
-  
-  if (!success) {
-    Serial.println("Failed to post to webserver, reverting buffer");
-    for (int j = i - 1; j >= 0; j--) {
-      pushFront(cb, sendSensorDataBuffer[j]);
+#if USE_ROLLUPS
+// Sends the rollups of records the full buffer let go, oldest first. They are older than anything
+// in the buffer, so this runs before postSensorData().
+bool postRollups(const String& url, int numRetries) {
+  if (rollups.count() == 0 || !connectionManager.isConnected() || !isTimeSet()) {
+    return false;
+  }
+  PlantMap plants = plantMap.get();
+  if (plants.plantIds[0] == -1) {
+    return false;
+  }
+
+  static RollupBatch batch;
+  int sent = 0;
+  while (rollups.take(batch, plants, uploadDeviceId().c_str()) > 0) {
+    if (!postData(url, String(batch.payload), numRetries)) {
+      rollups.release(batch);
+      return false;
     }
-  } else {
-    Serial.println("Successfully posted data to webserver, saving buffer state");
-    saveBufferState(cb);
+    sent += batch.count;
+    rollups.commit(batch);
+  }
+  Serial.printf("Posted %d rollups\n", sent);
+  return sent > 0;
+}
+#endif
+
+#if USE_ON_DEVICE_PREDICTION
+// Sends each plant's locally predicted dry time, only when it has moved since the last accepted upload
+bool postWateringPrediction(const String& url, int numRetries, SensorManager& sensorManager) {
+  if (!connectionManager.isConnected() || !isTimeSet()) {
+    return false;
   }
 
+  // The sampling task queues them (SensorManager::queuePrediction())
+  bool success = true;
+  for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+    char payload[160];
+    uint32_t version = sensorManager.takePrediction(i, payload, sizeof(payload));
+    if (version == 0) {
+      continue;
+    }
+
+    if (postData(url, String(payload), numRetries)) {
+      sensorManager.predictionUploaded(i, version);
+    } else {
+      success = false;
+    }
+  }
   return success;
 }
+#endif
 
 void setupEnterpriseWiFi() {
     Serial.println("\n=== Starting Enterprise WiFi Setup ===");
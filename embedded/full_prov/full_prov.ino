@@ -5,7 +5,9 @@
 #include "Scheduling.h"
 #include "SensorService.h"
 #include "WifiService.h"
+#include "OtaUpdater.h"
 #include "Memory.h"
+#include "Intervals.h"
 #include "BLEService.h"
 #include "Config.h"
 #include <HTTPClient.h>
@@ -15,19 +17,18 @@
 #define BUTTON_DEBOUNCE_TIME 50
 #define LED_PIN 2
 
-#define BT_UPDATE_INTERVAL 2000
-#define WIFI_UPDATE_INTERVAL 20000
 #define RESET_BTN_UPDATE_INTERVAL 100
 #define RESET_LISTENER_UPDATE_INTERVAL 100
-#define SENSOR_UPDATE_INTERVAL 0
-#define SENSOR_RECORD_INTERVAL 60000
 #define RESTART_DELAY 0
+#define RESET_NETWORK_STOP_TIMEOUT 30000  // Longest the reset button waits for an upload to finish
 
 
 
 
 SensorManager sensorManager;
-Scheduler scheduler;
+BluetoothService bluetoothService;  // Activated mode: readings, intervals, probe map, calibration, upload profile
+Scheduler scheduler;         // loop(): sampling, recording and buttons, on SAMPLING_CORE
+Scheduler networkScheduler;  // networkTask(): link management and uploads, on NETWORK_CORE
 
 DeviceMode mode = MODE_PROVISION;
 bool beginRestart = false;
@@ -43,6 +44,29 @@ const char* service_key = "password";
 
 void handle_wifi_connected();
 
+// A new image stays pending until OtaUpdater confirms it, rather than the core confirming it at boot
+bool verifyRollbackLater() {
+  return true;
+}
+
+static_assert(NETWORK_CORE != SAMPLING_CORE, "uploads and sampling must run on different cores");
+
+// The reset button asks the network task to stop, and waits for it, before it clears anything
+TaskHandle_t networkTaskHandle = nullptr;
+std::atomic<bool> networkStopRequested(false);
+std::atomic<bool> networkStopped(false);
+
+// The only consumer of cb; sampling in loop() is the only producer
+void networkTask(void* param) {
+  while (!networkStopRequested.load()) {
+    networkScheduler.run();  // Every pass ends with nothing reserved in cb
+    vTaskDelay(1);  // Let the idle task on this core feed the watchdog
+  }
+  clearWiFiCache();
+  networkStopped.store(true);
+  vTaskDelete(nullptr);
+}
+
 void SysProvEvent(arduino_event_t *sys_event) {
     bool verified = false;
     
@@ -236,35 +260,115 @@ void setup() {
       bool isEnterprise = preferences.getBool("is_enterprise", false);
       preferences.end();
       
+      preferences.begin("device_prefs");
+      String ssid = preferences.getString("wifi_ssid", "No SSID");
+      String password = preferences.getString("wifi_password", "No Password");
+      preferences.end();
+
       if (isEnterprise) {
           setupEnterpriseWiFi();
-      } else {
-          preferences.begin("device_prefs");
-          WiFi.begin(preferences.getString("wifi_ssid", "No SSID").c_str(), 
-                    preferences.getString("wifi_password", "No Password").c_str());
-          preferences.end();
-      }
-      
-      Serial.println("Connecting to WiFi...");
-      if (WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-        Serial.println("Connected to wifi");
-      } else {
-        Serial.println("Could not connect to wifi");
       }
 
       // Memory
       loadBufferState(cb);
+      #if USE_SD_CARD || USE_FLASH_HISTORY
+      tieredStore.init();
+      #endif
+      otaUpdater.begin();
+      intervals.load();
+      Serial.printf("Intervals: %s\n", intervals.toString().c_str());
 
       // Scheduled tasks
-      scheduler.add([&]() { sensorManager.run(); }, SENSOR_UPDATE_INTERVAL);  // Fast sensor readings
-      scheduler.add([&]() { sensorManager.recordToBuffer(); }, SENSOR_RECORD_INTERVAL);  // Record every minute
-      
-      // get plant id from preferences
-      int plant_id = preferences.getInt("plant_id", -1);
-      scheduler.add([&]() {
-        postSensorData(PLANTGURU_SENSOR_ENDPOINT, 3, sensorManager);
-      }, WIFI_UPDATE_INTERVAL);
+      static size_t recordTask;
+      size_t sampleTask = scheduler.add([]() {  // Fast sensor readings
+        sensorManager.run();
+        if (sensorManager.recordDue()) {
+          scheduler.trigger(recordTask);  // A watering or a light change shouldn't wait out a long interval
+        }
+      }, intervals.get(INTERVAL_SAMPLE));
+      recordTask = scheduler.add([]() {  // Every minute by default, faster or slower with adaptive sampling
+        sensorManager.recordToBuffer();
+        scheduler.setInterval(recordTask, sensorManager.recordInterval());
+      }, sensorManager.recordInterval());
+      #if USE_SD_CARD || USE_FLASH_HISTORY
+      scheduler.add([]() { tieredStore.refill(); }, TIER_REFILL_INTERVAL);  // Keep the uploader fed after an outage
+      #endif
+      scheduler.add([]() {  // The buffer is saved every BUFFER_SAVE_INTERVAL; a new image shouldn't lose the rest
+        if (otaUpdater.restartRequested()) {
+          sensorManager.saveState();
+          delay(100);
+          ESP.restart();
+        }
+      }, RESET_BTN_UPDATE_INTERVAL);
+
+      // Its characteristics are written on the BLE task; notifications go out from here
+      bluetoothService.setup();
+      size_t bluetoothTask = scheduler.add([]() {
+        bluetoothService.updateData(sensorManager.getCurrentData());
+      }, intervals.get(INTERVAL_BT));
+
+      networkScheduler.add([&]() { connectionManager.run(); }, 0);  // Link state machine and backoff
+      networkScheduler.add([&]() {
+        if (connectionManager.isConnected()) {
+          static unsigned long lastDebugPrint = 0;
+          if (millis() - lastDebugPrint > 5000) {  // Print every 5 seconds
+            PlantMap plants = plantMap.get();
+            if (plants.plantIds[0] != -1) {
+              Serial.printf("Current probe map: %s\n", plants.toString().c_str());
+            }
+            lastDebugPrint = millis();
+          }
+
+          if (!isTimeSet()) {
+            requestTime();
+          }
+        }
+      }, 0);
+
+      size_t uploadTask = networkScheduler.add([&]() {
+        otaUpdater.checkRollback();
+        #if USE_ROLLUPS
+        postRollups(PLANTGURU_ROLLUP_ENDPOINT, 3);
+        #endif
+        if (postSensorData(uploadTransport, 3, sensorManager)) {
+          otaUpdater.confirm();
+        }
+        postUploadProfile(PLANTGURU_TELEMETRY_ENDPOINT, 3);
+        #if USE_ON_DEVICE_PREDICTION
+        postWateringPrediction(PLANTGURU_PREDICTION_ENDPOINT, 3, sensorManager);
+        #endif
+        otaUpdater.check(OTA_MANIFEST_URL);
+      }, intervals.get(INTERVAL_UPLOAD));
+
+      // Intervals changed over BLE or by an upload response apply from the next pass, no restart.
+      // Each scheduler re-reads them on its own task.
+      scheduler.setPlanner([sampleTask, bluetoothTask]() {
+        scheduler.setInterval(sampleTask, intervals.get(INTERVAL_SAMPLE));
+        scheduler.setInterval(recordTask, sensorManager.recordInterval());
+        scheduler.setInterval(bluetoothTask, intervals.get(INTERVAL_BT));
+      });
+      networkScheduler.setPlanner([uploadTask]() {
+        networkScheduler.setInterval(uploadTask, intervals.get(INTERVAL_UPLOAD));
+      });
+      intervals.subscribe([]() {
+        scheduler.replan();
+        networkScheduler.replan();
+      });
+
+      // Sync time and drain the buffer as soon as the link comes up
+      connectionManager.subscribe([uploadTask](bool connected) {
+        if (connected) {
+          if (!isTimeSet()) {
+            requestTime();
+          }
+          networkScheduler.trigger(uploadTask);
+        }
+      });
+
+      Serial.println("Connecting to WiFi...");
+      connectionManager.begin(ssid, password, isEnterprise);
+      xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY,
+                              &networkTaskHandle, NETWORK_CORE);
       break;
     }
     default: {
@@ -283,6 +387,15 @@ void setup() {
         // Debounce check
         if (millis() - lastButtonPress > BUTTON_DEBOUNCE_TIME) {
             Serial.println("Reset button pressed!");
+
+            // Let an upload in progress finish; the network task then forgets its WiFi cache
+            if (networkTaskHandle != nullptr) {
+              networkStopRequested.store(true);
+              unsigned long waitStart = millis();
+              while (!networkStopped.load() && millis() - waitStart < RESET_NETWORK_STOP_TIMEOUT) {
+                delay(10);
+              }
+            }
             
             // Clear all preferences namespaces
             preferences.begin("device_prefs", false);
@@ -294,11 +407,15 @@ void setup() {
             preferences.putString("enterprise_password", "");
             preferences.end();
 
-            // Initialize an empty buffer
-            initCircularBuffer(cb);
-            saveBufferState(cb);
+            // Only the saved buffer needs emptying: the one in RAM goes with the restart
+            clearBufferState(cb);
 
             Serial.println("All preferences cleared!");
+            #if USE_SD_CARD
+            sdMemory.flush();  // History on the card outlives the reset
+            #elif USE_FLASH_HISTORY
+            flashHistory.flush();
+            #endif
             delay(100);  // Small delay to ensure serial prints
             ESP.restart();  // Hard restart the device
         }
@@ -310,24 +427,4 @@ void setup() {
 
 void loop() {
     scheduler.run();
-
-    if (WiFi.status() == WL_CONNECTED) {
-        static unsigned long lastDebugPrint = 0;
-        if (millis() - lastDebugPrint > 5000) {  // Print every 5 seconds
-            preferences.begin("device_prefs", true);
-            int plantId = preferences.getInt("plant_id", -1);
-            preferences.end();
-            
-            if (plantId != -1) {
-                Serial.printf("Current Plant ID: %d\n", plantId);
-            }
-            lastDebugPrint = millis();
-        }
-        
-        if (!isTimeSet()) {
-            requestTime();
-        } else {
-            //Serial.printf("Time: %d\n", getUnixTime());
-        }
-    }
 }
@@ -0,0 +1,57 @@
+// ECDSA P-256 manifest signatures for the host OTA tools, through OpenSSL's libcrypto; the
+// firmware checks the same base64 DER signature with mbedTLS (OtaUpdater.h)
+#ifndef HOST_SIGNATURE_H
+#define HOST_SIGNATURE_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+// Signs data with the PEM private key at keyPath; returns the base64 signature, or "" on failure
+inline std::string signManifest(const std::string& keyPath, const std::string& data) {
+  FILE* f = fopen(keyPath.c_str(), "r");
+  if (!f) return "";
+  EVP_PKEY* key = PEM_read_PrivateKey(f, nullptr, nullptr, nullptr);
+  fclose(f);
+  if (!key) return "";
+  EVP_MD_CTX* md = EVP_MD_CTX_new();
+  std::vector<uint8_t> der(EVP_PKEY_size(key));
+  size_t derLength = der.size();
+  bool ok = EVP_PKEY_base_id(key) == EVP_PKEY_EC && EVP_DigestSignInit(md, nullptr, EVP_sha256(), nullptr, key) == 1 &&
+            EVP_DigestSign(md, der.data(), &derLength, (const uint8_t*)data.data(), data.size()) == 1;
+  EVP_MD_CTX_free(md);
+  EVP_PKEY_free(key);
+  if (!ok) return "";
+  std::string base64(4 * ((derLength + 2) / 3) + 1, '\0');
+  base64.resize(EVP_EncodeBlock((uint8_t*)&base64[0], der.data(), derLength));
+  return base64;
+}
+
+// Checks a base64 signature over data against a DER SubjectPublicKeyInfo key
+inline bool verifyManifest(const uint8_t* publicKey, size_t publicKeyLength, const std::string& data,
+                           std::string signature) {
+  while (!signature.empty() && isspace((unsigned char)signature.back())) signature.pop_back();
+  std::vector<uint8_t> der(signature.size());
+  int decoded = EVP_DecodeBlock(der.data(), (const uint8_t*)signature.data(), signature.size());
+  if (signature.empty() || decoded < 0) return false;
+  // EVP_DecodeBlock counts the padding as zero bytes, which would break the DER
+  size_t derLength = decoded;
+  for (size_t i = signature.size(); i > 0 && signature[i - 1] == '='; i--) derLength--;
+
+  const uint8_t* p = publicKey;
+  EVP_PKEY* key = d2i_PUBKEY(nullptr, &p, publicKeyLength);
+  if (!key) return false;
+  EVP_MD_CTX* md = EVP_MD_CTX_new();
+  bool ok = EVP_DigestVerifyInit(md, nullptr, EVP_sha256(), nullptr, key) == 1 &&
+            EVP_DigestVerify(md, der.data(), derLength, (const uint8_t*)data.data(), data.size()) == 1;
+  EVP_MD_CTX_free(md);
+  EVP_PKEY_free(key);
+  return ok;
+}
+
+#endif  // HOST_SIGNATURE_H
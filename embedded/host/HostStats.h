@@ -0,0 +1,85 @@
+// Throughput and latency bookkeeping shared by the host tools
+#ifndef HOST_STATS_H
+#define HOST_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+inline uint64_t nowUs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Returns the p-th percentile (0..100) of samples; sorts in place
+inline uint64_t percentile(std::vector<uint64_t>& samples, double p) {
+  if (samples.empty()) return 0;
+  size_t rank = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+  std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+  return samples[rank];
+}
+
+struct UploadStats {
+  uint64_t startUs = 0;
+  uint64_t endUs = 0;
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  uint64_t records = 0;
+  uint64_t payloadBytes = 0;
+  uint64_t wireBytes = 0;  // Payload plus HTTP framing
+  std::vector<uint64_t> latencyUs;
+  std::vector<uint64_t> uploadUs;  // Each device upload, first request to last reply
+
+  void begin(uint64_t now) { startUs = now; }
+  void end(uint64_t now) { endUs = now; }
+
+  void addRequest(uint64_t payload, uint64_t framing, uint64_t recordCount) {
+    requests++;
+    records += recordCount;
+    payloadBytes += payload;
+    wireBytes += payload + framing;
+  }
+
+  void addLatency(uint64_t us) { latencyUs.push_back(us); }
+  void addUpload(uint64_t us) { uploadUs.push_back(us); }
+
+  void merge(const UploadStats& other) {
+    requests += other.requests;
+    errors += other.errors;
+    records += other.records;
+    payloadBytes += other.payloadBytes;
+    wireBytes += other.wireBytes;
+    latencyUs.insert(latencyUs.end(), other.latencyUs.begin(), other.latencyUs.end());
+    uploadUs.insert(uploadUs.end(), other.uploadUs.begin(), other.uploadUs.end());
+  }
+
+  void print(const char* label, FILE* out) {
+    double seconds = endUs > startUs ? (endUs - startUs) / 1e6 : 0;
+    double rate = seconds > 0 ? 1.0 / seconds : 0;
+    fprintf(out, "[%s] %.1f s\n", label, seconds);
+    fprintf(out, "  requests     %llu (%.1f req/s), errors %llu\n", (unsigned long long)requests, requests * rate,
+            (unsigned long long)errors);
+    fprintf(out, "  records      %llu (%.1f rec/s)\n", (unsigned long long)records, records * rate);
+    fprintf(out, "  payload      %llu B (%.1f KiB/s, %.1f B/req, %.1f B/record)\n", (unsigned long long)payloadBytes,
+            payloadBytes * rate / 1024, requests ? (double)payloadBytes / requests : 0,
+            records ? (double)payloadBytes / records : 0);
+    fprintf(out, "  on the wire  %llu B (%.1f%% framing)\n", (unsigned long long)wireBytes,
+            wireBytes ? 100.0 * (wireBytes - payloadBytes) / wireBytes : 0);
+    if (!latencyUs.empty()) {
+      fprintf(out, "  latency ms   p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+              percentile(latencyUs, 50) / 1000.0, percentile(latencyUs, 90) / 1000.0,
+              percentile(latencyUs, 99) / 1000.0, percentile(latencyUs, 99.9) / 1000.0,
+              percentile(latencyUs, 100) / 1000.0);
+    }
+    if (!uploadUs.empty()) {
+      fprintf(out, "  upload ms    p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", percentile(uploadUs, 50) / 1000.0,
+              percentile(uploadUs, 90) / 1000.0, percentile(uploadUs, 99) / 1000.0,
+              percentile(uploadUs, 100) / 1000.0);
+    }
+    fflush(out);
+  }
+};
+
+#endif  // HOST_STATS_H
@@ -0,0 +1,728 @@
+// Local stand-in for the backend's POST /api/sensorUpload.
+// Accepts the payloads postSensorData() produces, checks their shape and records
+// request rate, payload size and service latency. Keeps the backend's per-device ledger of
+// sequence numbers: answers {"ack":N} with the highest sequence stored contiguously and counts
+// retried records it had already stored.
+//
+// With --mqtt-port it also stands in for an MQTT broker plus the backend's subscriber: QoS 1
+// PUBLISHes of the same payloads to plantguru/<device_id>/records are checked, stored in the same
+// ledger and answered with a PUBACK.
+//
+// With --coap-port it takes the same payloads as confirmable CoAP POSTs to api/sensorUpload,
+// reassembled from Block1 blocks, and answers with 2.31 Continue per block and {"ack":N} at
+// the end.
+//
+//   ./build/ingest_server --port 3000 [--mqtt-port 1883] [--coap-port 5683] [--delay-ms 0] [--report-every 5]
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CoapPacket.h"
+#include "Config.h"
+#include "HostStats.h"
+#include "MqttPacket.h"
+
+struct Connection {
+  int fd;
+  std::string in;
+  std::string out;
+  uint64_t requestStartUs;  // First byte of the request currently being parsed
+  size_t pendingResponses;
+  bool closeAfterWrite;
+  bool mqtt;
+};
+
+struct PendingResponse {
+  int fd;
+  uint64_t dueUs;
+  uint64_t startUs;
+  int status;
+  long long ack;  // -1 for a legacy array payload, answered with text
+  std::string framed;  // MQTT and CoAP replies, sent as is
+  sockaddr_in peer;    // CoAP only; fd is then the UDP socket
+};
+
+// A CoAP request body being reassembled from its Block1 blocks
+struct CoapTransfer {
+  std::string body;
+  size_t wireBytes = 0;  // Every datagram of the request so far
+  uint64_t startUs = 0;
+  uint64_t lastUs = 0;
+};
+
+// Recent confirmable messages from a CoAP client and the replies they got, so a
+// retransmission is answered again instead of being processed twice
+struct CoapPeer {
+  std::deque<std::pair<uint16_t, std::string>> replies;  // Oldest first
+};
+
+// What the backend keeps per device: everything up to acked is stored, ahead holds the
+// sequences stored past a gap
+struct DeviceLedger {
+  uint32_t acked = 0;
+  std::set<uint32_t> ahead;
+};
+
+struct SensorPayload {
+  int records = 0;
+  std::string deviceId;  // Empty for a legacy array payload
+  uint32_t base = 0;
+  std::vector<uint32_t> sequences;
+};
+
+struct Options {
+  int port = 3000;
+  int mqttPort = 0;
+  int coapPort = 0;
+  int delayMs = 0;
+  int reportEvery = 5;
+  bool verbose = false;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+  stopRequested = 1;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--port N] [--mqtt-port N] [--coap-port N] [--delay-ms N] [--report-every S] [--verbose]\n"
+          "  --mqtt-port     also accept MQTT QoS 1 publishes on this port\n"
+          "  --coap-port     also accept block-wise CoAP POSTs on this UDP port\n"
+          "  --delay-ms      simulated backend service time added to every response\n"
+          "  --report-every  seconds between interval reports (0 disables)\n",
+          argv0);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char* value = nullptr;
+    if (arg == "--port" && (value = next())) {
+      opt.port = atoi(value);
+    } else if (arg == "--mqtt-port" && (value = next())) {
+      opt.mqttPort = atoi(value);
+    } else if (arg == "--coap-port" && (value = next())) {
+      opt.coapPort = atoi(value);
+    } else if (arg == "--delay-ms" && (value = next())) {
+      opt.delayMs = atoi(value);
+    } else if (arg == "--report-every" && (value = next())) {
+      opt.reportEvery = atoi(value);
+    } else if (arg == "--verbose") {
+      opt.verbose = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Value of "key": in a flat JSON object, as text; empty if absent
+static std::string jsonField(const std::string& object, const char* key) {
+  std::string quoted = std::string("\"") + key + "\":";
+  size_t at = object.find(quoted);
+  if (at == std::string::npos) return std::string();
+  size_t start = at + quoted.size();
+  if (start < object.size() && object[start] == '"') {
+    size_t end = object.find('"', start + 1);
+    return end == std::string::npos ? std::string() : object.substr(start + 1, end - start - 1);
+  }
+  size_t end = object.find_first_of(",}", start);
+  return object.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+// Counts the record objects of the {"device_id","base","records":[...]} envelope, or of a bare
+// JSON array from older firmware, and checks each carries the fields the backend inserts on.
+// Not a full JSON parser - just enough to catch malformed batches. Returns -1 if malformed.
+static int validateSensorPayload(const char* body, size_t len, SensorPayload& payload) {
+  size_t i = 0;
+  while (i < len && isspace((unsigned char)body[i])) i++;
+  bool isArray = i < len && body[i] == '[';
+  int recordDepth = isArray ? 1 : 2;
+  if (!isArray) {
+    size_t records = std::string(body, len).find("\"records\"");
+    if (records == std::string::npos) return -1;
+    std::string head(body, records);
+    payload.deviceId = jsonField(head, "device_id");
+    payload.base = strtoul(jsonField(head, "base").c_str(), nullptr, 10);
+    if (payload.deviceId.empty()) return -1;
+  }
+
+  int records = 0;
+  int depth = 0;
+  bool inString = false;
+  size_t objectStart = 0;
+  for (; i < len; i++) {
+    char c = body[i];
+    if (inString) {
+      if (c == '\\') i++;
+      else if (c == '"') inString = false;
+      continue;
+    }
+    if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      if (c == '{' && depth == recordDepth) objectStart = i;
+      depth++;
+    } else if (c == '}' || c == ']') {
+      depth--;
+      if (depth < 0) return -1;
+      if (c == '}' && depth == recordDepth) {
+        std::string object(body + objectStart, i - objectStart + 1);
+        if (object.find("\"plant_id\"") == std::string::npos || object.find("\"time_stamp\"") == std::string::npos) {
+          return -1;
+        }
+        if (!isArray) {
+          std::string seq = jsonField(object, "seq");
+          if (seq.empty()) return -1;
+          payload.sequences.push_back(strtoul(seq.c_str(), nullptr, 10));
+        }
+        records++;
+      }
+    }
+  }
+  payload.records = records;
+  return depth == 0 && !inString ? records : -1;
+}
+
+class IngestServer {
+public:
+  explicit IngestServer(const Options& opt) : opt(opt) {}
+
+  bool start() {
+    epollFd = epoll_create1(0);
+    listenFd = listenOn(opt.port);
+    if (listenFd < 0) return false;
+    if (opt.mqttPort > 0) {
+      mqttListenFd = listenOn(opt.mqttPort);
+      if (mqttListenFd < 0) return false;
+    }
+    if (opt.coapPort > 0) {
+      coapFd = bindUdp(opt.coapPort);
+      if (coapFd < 0) return false;
+    }
+    return true;
+  }
+
+  void run() {
+    printf("Ingest stand-in listening on :%d (delay %d ms)\n", opt.port, opt.delayMs);
+    if (mqttListenFd >= 0) printf("MQTT stand-in listening on :%d\n", opt.mqttPort);
+    if (coapFd >= 0) printf("CoAP stand-in listening on udp :%d\n", opt.coapPort);
+    fflush(stdout);
+
+    total.begin(nowUs());
+    interval.begin(nowUs());
+    uint64_t nextReportUs = nowUs() + (uint64_t)opt.reportEvery * 1000000;
+    std::vector<epoll_event> events(256);
+
+    while (!stopRequested) {
+      int timeoutMs = 100;
+      if (!pending.empty()) {
+        uint64_t now = nowUs();
+        timeoutMs = pending.front().dueUs > now ? (int)((pending.front().dueUs - now) / 1000) : 0;
+        if (timeoutMs > 100) timeoutMs = 100;
+      }
+
+      int n = epoll_wait(epollFd, events.data(), (int)events.size(), timeoutMs);
+      for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == listenFd || fd == mqttListenFd) {
+          acceptAll(fd);
+          continue;
+        }
+        if (fd == coapFd) {
+          readDatagrams();
+          continue;
+        }
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readFrom(fd);
+        if (events[i].events & EPOLLOUT) flush(fd);
+      }
+
+      releaseDueResponses();
+
+      if (opt.reportEvery > 0 && nowUs() >= nextReportUs) {
+        interval.end(nowUs());
+        interval.print("interval", stdout);
+        interval = UploadStats();
+        interval.begin(nowUs());
+        nextReportUs += (uint64_t)opt.reportEvery * 1000000;
+      }
+    }
+
+    total.end(nowUs());
+    total.print("total", stdout);
+    printf("  rejected     %llu\n", (unsigned long long)rejected);
+    printf("  duplicates   %llu records already stored, across %zu devices\n", (unsigned long long)duplicates,
+           ledgers.size());
+  }
+
+private:
+  Options opt;
+  int listenFd = -1;
+  int mqttListenFd = -1;
+  int coapFd = -1;
+  int epollFd = -1;
+  std::unordered_map<int, Connection> connections;
+  std::deque<PendingResponse> pending;  // Constant delay keeps this ordered by due time
+  UploadStats total;
+  UploadStats interval;
+  uint64_t rejected = 0;
+  uint64_t duplicates = 0;
+  std::unordered_map<std::string, DeviceLedger> ledgers;
+  std::unordered_map<std::string, CoapTransfer> coapTransfers;  // By client address and token
+  std::unordered_map<std::string, CoapPeer> coapPeers;          // By client address
+  uint64_t lastCoapSweepUs = 0;
+
+  // Stores the payload's sequences and returns the device's new acknowledgement. Objects of
+  // one record share its sequence, one per plant.
+  uint32_t acknowledge(const SensorPayload& payload) {
+    DeviceLedger& ledger = ledgers[payload.deviceId];
+    // The device no longer holds anything before base; stop waiting for it
+    if (payload.base > 0 && payload.base - 1 > ledger.acked) {
+      ledger.acked = payload.base - 1;
+      ledger.ahead.erase(ledger.ahead.begin(), ledger.ahead.upper_bound(ledger.acked));
+    }
+    uint32_t previous = 0;
+    for (uint32_t seq : payload.sequences) {
+      if (seq == previous) continue;
+      previous = seq;
+      if (seq <= ledger.acked || !ledger.ahead.insert(seq).second) duplicates++;
+    }
+    while (!ledger.ahead.empty() && *ledger.ahead.begin() == ledger.acked + 1) {
+      ledger.acked++;
+      ledger.ahead.erase(ledger.ahead.begin());
+    }
+    return ledger.acked;
+  }
+
+  int listenOn(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1024) < 0) {
+      perror("bind/listen");
+      close(fd);
+      return -1;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    return fd;
+  }
+
+  int bindUdp(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+      perror("bind");
+      close(fd);
+      return -1;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    return fd;
+  }
+
+  void acceptAll(int listener) {
+    while (true) {
+      int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+      if (fd < 0) return;
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      connections[fd] = Connection{fd, std::string(), std::string(), 0, 0, false, listener == mqttListenFd};
+
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.fd = fd;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+  }
+
+  void closeConnection(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+  }
+
+  void readFrom(int fd) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+    Connection& conn = it->second;
+
+    char buf[16384];
+    while (true) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n > 0) {
+        if (conn.in.empty()) conn.requestStartUs = nowUs();
+        conn.in.append(buf, n);
+        continue;
+      }
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        closeConnection(fd);
+        return;
+      }
+      break;
+    }
+
+    // Handle every complete request in the buffer (clients may pipeline)
+    while (conn.mqtt ? parseMqtt(conn) : parseRequest(conn)) {
+      if (!conn.in.empty()) conn.requestStartUs = nowUs();
+    }
+  }
+
+  void reply(Connection& conn, int status, long long ack, const uint8_t* framed, size_t framedLength) {
+    conn.pendingResponses++;
+    pending.push_back(PendingResponse{conn.fd, conn.requestStartUs + (uint64_t)opt.delayMs * 1000, conn.requestStartUs,
+                                      status, ack, std::string((const char*)framed, framedLength), sockaddr_in()});
+  }
+
+  void readDatagrams() {
+    uint8_t buf[2048];
+    while (true) {
+      sockaddr_in peer = {};
+      socklen_t peerLength = sizeof(peer);
+      ssize_t n = recvfrom(coapFd, buf, sizeof(buf), 0, (sockaddr*)&peer, &peerLength);
+      if (n < 0) return;
+      handleCoap(buf, n, peer);
+    }
+  }
+
+  void replyCoap(const sockaddr_in& peer, CoapPeer& state, uint64_t startUs, int status, const CoapMessage& request,
+                 uint8_t code, const CoapBlock* block1, const char* payload) {
+    uint8_t out[COAP_HEADER_MAX + 32];
+    size_t length = coapResponse(out, sizeof(out), COAP_ACK, code, request.messageId, request.token,
+                                 request.tokenLength, block1, (const uint8_t*)payload, payload ? strlen(payload) : 0);
+    std::string reply((const char*)out, length);
+    state.replies.emplace_back(request.messageId, reply);
+    if (state.replies.size() > 4 * UPLOAD_WINDOW_MAX) state.replies.pop_front();
+    pending.push_back(PendingResponse{coapFd, nowUs() + (uint64_t)opt.delayMs * 1000, startUs, status, -1, reply, peer});
+  }
+
+  // One datagram from a CoAP client. Blocks must arrive in order, which a client holding one
+  // exchange open at a time (NSTART 1) does; a gap answers 4.08 and the client starts over.
+  void handleCoap(const uint8_t* data, size_t length, const sockaddr_in& peer) {
+    uint64_t now = nowUs();
+    CoapMessage request;
+    if (!coapParse(data, length, request) || request.type != COAP_CON) {
+      return;  // Only confirmable requests expect anything back
+    }
+    std::string address((const char*)&peer.sin_addr, sizeof(peer.sin_addr));
+    address.append((const char*)&peer.sin_port, sizeof(peer.sin_port));
+    CoapPeer& state = coapPeers[address];
+    for (const auto& previous : state.replies) {
+      if (previous.first == request.messageId) {
+        // A retransmission: the reply was lost, or is still waiting out the delay
+        pending.push_back(PendingResponse{coapFd, now + (uint64_t)opt.delayMs * 1000, now, 0, -1, previous.second, peer});
+        return;
+      }
+    }
+
+    if (request.code != COAP_POST || strcmp(request.uriPath, "api/sensorUpload") != 0) {
+      rejected++;
+      replyCoap(peer, state, now, 404, request, COAP_CODE(4, 4), nullptr, nullptr);
+      return;
+    }
+    CoapBlock block = request.hasBlock1 ? request.block1 : CoapBlock{0, false, 6};
+    std::string key = address + std::string((const char*)request.token, request.tokenLength);
+    if (block.num == 0) {
+      sweepCoapTransfers(now);
+      coapTransfers[key] = CoapTransfer{std::string(), 0, now, now};
+    }
+    auto it = coapTransfers.find(key);
+    if (it == coapTransfers.end() || it->second.body.size() != block.num * coapBlockSize(block.szx) ||
+        (block.more && request.payloadLength != coapBlockSize(block.szx))) {
+      if (it != coapTransfers.end()) coapTransfers.erase(it);
+      rejected++;
+      replyCoap(peer, state, now, 400, request, COAP_INCOMPLETE, nullptr, nullptr);
+      return;
+    }
+    CoapTransfer& transfer = it->second;
+    transfer.body.append((const char*)request.payload, request.payloadLength);
+    transfer.wireBytes += length;
+    transfer.lastUs = now;
+    if (block.more) {
+      replyCoap(peer, state, now, 0, request, COAP_CONTINUE, &block, nullptr);
+      return;
+    }
+
+    SensorPayload payload;
+    int records = validateSensorPayload(transfer.body.data(), transfer.body.size(), payload);
+    if (records > 0 && !payload.deviceId.empty()) {
+      char ackJson[32];
+      snprintf(ackJson, sizeof(ackJson), "{\"ack\":%u}", acknowledge(payload));
+      total.addRequest(transfer.body.size(), transfer.wireBytes - transfer.body.size(), records);
+      interval.addRequest(transfer.body.size(), transfer.wireBytes - transfer.body.size(), records);
+      replyCoap(peer, state, transfer.startUs, 200, request, COAP_CHANGED, &block, ackJson);
+    } else {
+      rejected++;
+      if (opt.verbose) {
+        fprintf(stderr, "Rejected CoAP upload: %.*s\n", (int)std::min<size_t>(transfer.body.size(), 200),
+                transfer.body.data());
+      }
+      replyCoap(peer, state, now, 400, request, COAP_BAD_REQUEST, &block, nullptr);
+    }
+    coapTransfers.erase(key);
+  }
+
+  // Drops transfers whose client gave up partway
+  void sweepCoapTransfers(uint64_t now) {
+    if (now - lastCoapSweepUs < 1000000) return;
+    lastCoapSweepUs = now;
+    for (auto it = coapTransfers.begin(); it != coapTransfers.end();) {
+      it = now - it->second.lastUs > 60000000 ? coapTransfers.erase(it) : std::next(it);
+    }
+  }
+
+  // One packet from an MQTT client. QoS 1 publishes get their PUBACK after the same delay an
+  // HTTP response would; anything unexpected drops the connection like a broker would.
+  bool parseMqtt(Connection& conn) {
+    MqttPacket packet;
+    bool malformed = false;
+    if (!mqttParse((const uint8_t*)conn.in.data(), conn.in.size(), packet, malformed)) {
+      if (malformed) closeConnection(conn.fd);
+      return false;
+    }
+
+    int fd = conn.fd;
+    uint8_t out[4];
+    switch (packet.type) {
+      case MQTT_CONNECT: {
+        const uint8_t connack[4] = {MQTT_CONNACK << 4, 2, 0, 0};
+        reply(conn, 200, -1, connack, sizeof(connack));
+        break;
+      }
+      case MQTT_PUBLISH: {
+        size_t topicLength = packet.bodyLength >= 2 ? (packet.body[0] << 8) | packet.body[1] : 0;
+        size_t offset = 2 + topicLength + ((packet.flags & 0x06) ? 2 : 0);
+        if ((packet.flags & 0x06) != 0x02 || offset > packet.bodyLength) {
+          closeConnection(fd);  // Devices only publish at QoS 1
+          return false;
+        }
+        const char* body = (const char*)packet.body + offset;
+        size_t length = packet.bodyLength - offset;
+        SensorPayload payload;
+        int records = validateSensorPayload(body, length, payload);
+        if (records > 0 && !payload.deviceId.empty()) {
+          acknowledge(payload);
+          total.addRequest(length, packet.size - length, records);
+          interval.addRequest(length, packet.size - length, records);
+        } else {
+          rejected++;
+          if (opt.verbose) fprintf(stderr, "Rejected MQTT publish: %.*s\n", (int)std::min<size_t>(length, 200), body);
+        }
+        // A broker acknowledges whatever it takes; the subscriber's problems are its own
+        uint16_t id = packet.packetId();
+        out[0] = MQTT_PUBACK << 4;
+        out[1] = 2;
+        out[2] = id >> 8;
+        out[3] = id & 0xFF;
+        reply(conn, records > 0 ? 200 : 400, -1, out, 4);
+        break;
+      }
+      case MQTT_PINGREQ: {
+        const uint8_t pingresp[2] = {MQTT_PINGRESP << 4, 0};
+        reply(conn, 0, -1, pingresp, sizeof(pingresp));
+        break;
+      }
+      case MQTT_DISCONNECT:
+        closeConnection(fd);
+        return false;
+      default:
+        closeConnection(fd);
+        return false;
+    }
+    conn.in.erase(0, packet.size);
+    return true;
+  }
+
+  bool parseRequest(Connection& conn) {
+    size_t headerEnd = conn.in.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) return false;
+
+    std::string head = conn.in.substr(0, headerEnd);
+    size_t contentLength = 0;
+    bool keepAlive = true;
+
+    size_t lineStart = head.find("\r\n");
+    std::string requestLine = head.substr(0, lineStart);
+    while (lineStart != std::string::npos) {
+      size_t next = head.find("\r\n", lineStart + 2);
+      std::string line = head.substr(lineStart + 2, next == std::string::npos ? std::string::npos : next - lineStart - 2);
+      size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        std::string name = line.substr(0, colon);
+        for (char& c : name) c = (char)tolower(c);
+        const char* value = line.c_str() + colon + 1;
+        while (*value == ' ') value++;
+        if (name == "content-length") contentLength = strtoul(value, nullptr, 10);
+        if (name == "connection" && strncasecmp(value, "close", 5) == 0) keepAlive = false;
+      }
+      lineStart = next;
+    }
+
+    size_t bodyStart = headerEnd + 4;
+    if (conn.in.size() < bodyStart + contentLength) return false;
+
+    const char* body = conn.in.data() + bodyStart;
+    int status = 404;
+    int records = 0;
+    long long ack = -1;
+    size_t pathEnd = requestLine.find(' ', 5);
+    bool isPost = requestLine.compare(0, 5, "POST ") == 0;
+    std::string path = isPost && pathEnd != std::string::npos ? requestLine.substr(5, pathEnd - 5) : std::string();
+    if (path == "/api/sensorUpload") {
+      SensorPayload payload;
+      records = validateSensorPayload(body, contentLength, payload);
+      status = records > 0 ? 200 : 400;
+      if (status == 200 && !payload.deviceId.empty()) {
+        ack = acknowledge(payload);
+      }
+    }
+
+    if (status == 200) {
+      total.addRequest(contentLength, bodyStart, records);
+      interval.addRequest(contentLength, bodyStart, records);
+    } else {
+      rejected++;
+      if (opt.verbose) {
+        fprintf(stderr, "Rejected %s (%d): %.*s\n", requestLine.c_str(), status, (int)std::min<size_t>(contentLength, 200), body);
+      }
+    }
+
+    if (!keepAlive) conn.closeAfterWrite = true;
+    reply(conn, status, ack, nullptr, 0);
+    conn.in.erase(0, bodyStart + contentLength);
+    return true;
+  }
+
+  void releaseDueResponses() {
+    uint64_t now = nowUs();
+    while (!pending.empty() && pending.front().dueUs <= now) {
+      PendingResponse resp = pending.front();
+      pending.pop_front();
+
+      if (resp.fd == coapFd) {
+        sendto(coapFd, resp.framed.data(), resp.framed.size(), 0, (const sockaddr*)&resp.peer, sizeof(resp.peer));
+        if (resp.status == 200) {
+          uint64_t latency = nowUs() - resp.startUs;
+          total.addLatency(latency);
+          interval.addLatency(latency);
+        }
+        continue;
+      }
+
+      auto it = connections.find(resp.fd);
+      if (it == connections.end()) continue;
+      Connection& conn = it->second;
+
+      if (conn.mqtt) {
+        conn.out.append(resp.framed);
+        conn.pendingResponses--;
+        if (resp.status == 200) {
+          uint64_t latency = nowUs() - resp.startUs;
+          total.addLatency(latency);
+          interval.addLatency(latency);
+        }
+        flush(resp.fd);
+        continue;
+      }
+
+      char ackJson[32];
+      snprintf(ackJson, sizeof(ackJson), "{\"ack\":%lld}", resp.ack);
+      const char* text = resp.status == 200 ? (resp.ack >= 0 ? ackJson : "Successfully uploaded sensor data")
+                         : resp.status == 400 ? "Malformed sensor payload" : "Not found";
+      char header[256];
+      int len = snprintf(header, sizeof(header),
+                         "HTTP/1.1 %d %s\r\nContent-Type: %s; charset=utf-8\r\n"
+                         "Content-Length: %zu\r\nConnection: %s\r\n\r\n",
+                         resp.status, resp.status == 200 ? "OK" : resp.status == 400 ? "Bad Request" : "Not Found",
+                         resp.ack >= 0 ? "application/json" : "text/html", strlen(text),
+                         conn.closeAfterWrite ? "close" : "keep-alive");
+      conn.out.append(header, len);
+      conn.out.append(text);
+      conn.pendingResponses--;
+
+      if (resp.status == 200) {
+        uint64_t latency = nowUs() - resp.startUs;
+        total.addLatency(latency);
+        interval.addLatency(latency);
+      }
+      flush(resp.fd);
+    }
+  }
+
+  void flush(int fd) {
+    auto it = connections.find(fd);
+    if (it == connections.end()) return;
+    Connection& conn = it->second;
+
+    while (!conn.out.empty()) {
+      ssize_t n = send(fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+      if (n > 0) {
+        conn.out.erase(0, n);
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      closeConnection(fd);
+      return;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | (conn.out.empty() ? 0u : (uint32_t)EPOLLOUT);
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+
+    if (conn.out.empty() && conn.closeAfterWrite && conn.pendingResponses == 0) {
+      closeConnection(fd);
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  IngestServer server(opt);
+  if (!server.start()) return 1;
+  server.run();
+  return 0;
+}
@@ -0,0 +1,519 @@
+// Fleet load generator for /api/sensorUpload, or for an MQTT broker taking the same batches.
+// Every simulated device buffers readings in the firmware's CircularBuffer and drains it with
+// the firmware's UploadWindow, pipelining batches on each connection the way postSensorData() does.
+//
+//   ./build/load_generator --devices 2000 --connections 32 --duration 10 [--interval-ms 20000] [--window 4]
+//   ./build/load_generator --transport mqtt --port 1883 ...
+//   ./build/load_generator --transport coap --port 5683 --cold --link-rtt-ms 50 ...   # radio-on time per upload
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CoapUpload.h"
+#include "Config.h"
+#include "Memory.h"
+#include "MqttPacket.h"
+#include "UploadBatch.h"
+#include "UploadWindow.h"
+#include "HostStats.h"
+
+enum class Encoding { JSON };
+enum class Transport { HTTP, MQTT, COAP };
+
+struct Options {
+  std::string host = "127.0.0.1";
+  int port = 3000;
+  std::string path = "/api/sensorUpload";
+  int devices = 1000;
+  int connections = 16;
+  int durationSec = 10;
+  int intervalMs = 0;          // 0 = closed loop, each connection sends as fast as responses come back
+  int recordsPerUpload = MAX_RECORDS_PER_REQUEST;
+  int window = UPLOAD_WINDOW_MAX;  // Batches in flight per connection; 1 is stop-and-wait
+  Encoding encoding = Encoding::JSON;
+  Transport transport = Transport::HTTP;
+  bool cold = false;    // Every upload starts on a new connection, like a device waking from sleep
+  int linkRttMs = 0;    // Added to each TCP handshake, the one round trip the stand-in can't delay
+};
+
+// Synthetic plant: slow random walk around plausible values
+struct SimulatedDevice {
+  int plantId;
+  char deviceId[DEVICE_ID_MAX];
+  uint32_t nextSequence;
+  uint32_t rng;
+  float soil1, soil2, soilTemp, airTemp, humidity, light;
+  long timestamp;
+  uint64_t nextDueUs;
+
+  float step(float value, float spread, float lo, float hi) {
+    rng = rng * 1664525u + 1013904223u;
+    value += ((rng >> 8) / 16777216.0f - 0.5f) * spread;
+    return value < lo ? lo : value > hi ? hi : value;
+  }
+
+  SensorData nextReading() {
+    SensorData data;
+    soil1 = step(soil1, 0.4f, 0, 100);
+    soil2 = step(soil2, 0.4f, 0, 100);
+    soilTemp = step(soilTemp, 0.1f, 5, 40);
+    airTemp = step(airTemp, 0.1f, 5, 40);
+    humidity = step(humidity, 0.5f, 0, 100);
+    light = step(light, 1.0f, 0, 100);
+    timestamp += 60;
+
+    data.set(CHANNEL_SOIL_MOISTURE_1, soil1);
+    data.set(CHANNEL_SOIL_MOISTURE_2, soil2);
+    data.set(CHANNEL_SOIL_TEMP, soilTemp);
+    data.set(CHANNEL_EXT_TEMP, airTemp);
+    data.set(CHANNEL_HUMIDITY, humidity);
+    data.set(CHANNEL_LIGHT, light);
+    data.timestamp = timestamp;
+    return data;
+  }
+};
+
+static std::atomic<bool> stopRequested(false);
+
+static void onSignal(int) {
+  stopRequested = true;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--host H] [--port N] [--path P] [--devices N] [--connections N]\n"
+          "          [--duration S] [--interval-ms N] [--records N] [--window N] [--encoding json]\n"
+          "          [--transport http|mqtt|coap] [--cold] [--link-rtt-ms N]\n"
+          "  --interval-ms  per-device upload period; 0 runs closed loop at maximum rate\n"
+          "  --records      readings buffered per device between uploads (batched %d per request)\n"
+          "  --window       most batches in flight per connection, 1-%d (1 waits for every response)\n"
+          "  --transport    mqtt publishes each batch at QoS 1 to plantguru/<device_id>/records,\n"
+          "                 coap POSTs it over UDP in Block1 blocks\n"
+          "  --cold         reconnect for every upload; the upload ms line is then radio-on time\n"
+          "  --link-rtt-ms  round trip added to every TCP handshake (pair with the server's --delay-ms)\n",
+          argv0, MAX_RECORDS_PER_REQUEST, UPLOAD_WINDOW_MAX);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char* value = nullptr;
+    if (arg == "--host" && (value = next())) opt.host = value;
+    else if (arg == "--port" && (value = next())) opt.port = atoi(value);
+    else if (arg == "--path" && (value = next())) opt.path = value;
+    else if (arg == "--devices" && (value = next())) opt.devices = atoi(value);
+    else if (arg == "--connections" && (value = next())) opt.connections = atoi(value);
+    else if (arg == "--duration" && (value = next())) opt.durationSec = atoi(value);
+    else if (arg == "--interval-ms" && (value = next())) opt.intervalMs = atoi(value);
+    else if (arg == "--records" && (value = next())) opt.recordsPerUpload = atoi(value);
+    else if (arg == "--window" && (value = next())) opt.window = atoi(value);
+    else if (arg == "--encoding" && (value = next())) {
+      if (strcmp(value, "json") != 0) return false;
+      opt.encoding = Encoding::JSON;
+    } else if (arg == "--transport" && (value = next())) {
+      if (strcmp(value, "http") == 0) opt.transport = Transport::HTTP;
+      else if (strcmp(value, "mqtt") == 0) opt.transport = Transport::MQTT;
+      else if (strcmp(value, "coap") == 0) opt.transport = Transport::COAP;
+      else return false;
+    } else if (arg == "--cold") opt.cold = true;
+    else if (arg == "--link-rtt-ms" && (value = next())) opt.linkRttMs = atoi(value);
+    else return false;
+  }
+  return opt.devices > 0 && opt.connections > 0 && opt.recordsPerUpload > 0 && opt.recordsPerUpload < BUFFER_SIZE &&
+         opt.window >= 1 && opt.window <= UPLOAD_WINDOW_MAX;
+}
+
+// One socket to the ingest host carrying batches the way an UploadTransport does. Requests can
+// be written back to back; replies come back in order.
+class UploadConnection {
+public:
+  UploadConnection(const Options& opt) : opt(opt) {}
+  virtual ~UploadConnection() { disconnect(); }
+
+  // Returns the protocol bytes written ahead of the body, or 0 if the connection failed
+  size_t send(const char* deviceId, const char* body, size_t length) {
+    if (fd < 0 && !connect()) return 0;
+    size_t header = sendBatch(deviceId, body, length);
+    if (header == 0) disconnect();
+    return header;
+  }
+
+  // Reads the oldest outstanding reply. On failure the connection is dropped along with
+  // every request still unanswered on it.
+  bool receive(int& status, size_t& responseBytes, std::string& response) {
+    if (fd < 0 || !readReply(status, responseBytes, response)) {
+      disconnect();
+      return false;
+    }
+    return true;
+  }
+
+  virtual void disconnect() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+    in.clear();
+  }
+
+protected:
+  const Options& opt;
+  int fd = -1;
+  std::string in;
+
+  virtual int socketType() const { return SOCK_STREAM; }
+  virtual bool handshake() { return true; }
+  virtual size_t sendBatch(const char* deviceId, const char* body, size_t length) = 0;
+  virtual bool readReply(int& status, size_t& responseBytes, std::string& response) = 0;
+
+  bool connect() {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = socketType();
+    addrinfo* res = nullptr;
+    if (getaddrinfo(opt.host.c_str(), std::to_string(opt.port).c_str(), &hints, &res) != 0) return false;
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    bool ok = fd >= 0 && ::connect(fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok) {
+      disconnect();
+      return false;
+    }
+    if (socketType() == SOCK_STREAM) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (opt.linkRttMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(opt.linkRttMs));
+    }
+    timeval tv = {10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (!handshake()) {
+      disconnect();
+      return false;
+    }
+    return true;
+  }
+
+  bool sendAll(const char* data, size_t len) {
+    while (len > 0) {
+      ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      data += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool readMore() {
+    char buf[4096];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) return false;
+    in.append(buf, n);
+    return true;
+  }
+};
+
+// Keep-alive HTTP/1.1, framed the way HttpTransport frames a POST
+class HttpConnection : public UploadConnection {
+public:
+  using UploadConnection::UploadConnection;
+
+protected:
+  size_t sendBatch(const char* deviceId, const char* body, size_t length) override {
+    char header[512];
+    int headerLen = snprintf(header, sizeof(header),
+                             "POST %s HTTP/1.1\r\nHost: %s:%d\r\nConnection: keep-alive\r\n"
+                             "Content-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+                             opt.path.c_str(), opt.host.c_str(), opt.port, length);
+    return sendAll(header, headerLen) && sendAll(body, length) ? headerLen : 0;
+  }
+
+  bool readReply(int& status, size_t& responseBytes, std::string& response) override {
+    size_t headerEnd;
+    while ((headerEnd = in.find("\r\n\r\n")) == std::string::npos) {
+      if (!readMore()) return false;
+    }
+
+    status = atoi(in.c_str() + 9);  // "HTTP/1.1 200"
+    size_t contentLength = 0;
+    const char* cl = strcasestr(in.c_str(), "\r\ncontent-length:");
+    if (cl && (size_t)(cl - in.c_str()) < headerEnd) contentLength = strtoul(cl + 17, nullptr, 10);
+    bool closing = strcasestr(in.c_str(), "\r\nconnection: close") != nullptr;
+
+    size_t total = headerEnd + 4 + contentLength;
+    while (in.size() < total) {
+      if (!readMore()) return false;
+    }
+    response.assign(in, headerEnd + 4, contentLength);
+    in.erase(0, total);
+    responseBytes = total;
+    if (closing) disconnect();
+    return true;
+  }
+};
+
+// One MQTT session per connection, publishing the way MqttTransport does. A connection serves
+// many simulated devices, so the client ID is the connection's; each batch still goes to its
+// own device's topic. PUBACKs carry no ack, so replies come back without a body.
+class MqttConnection : public UploadConnection {
+public:
+  MqttConnection(const Options& opt, int workerId) : UploadConnection(opt) {
+    snprintf(clientId, sizeof(clientId), "LOADGEN-C%d", workerId);
+  }
+
+protected:
+  char clientId[24];
+  uint16_t nextPacketId = 1;
+
+  bool readPacket(MqttPacket& packet) {
+    bool malformed = false;
+    while (!mqttParse((const uint8_t*)in.data(), in.size(), packet, malformed)) {
+      if (malformed || !readMore()) return false;
+    }
+    return true;
+  }
+
+  bool handshake() override {
+    uint8_t packet[64];
+    size_t length = mqttConnect(packet, sizeof(packet), clientId, MQTT_KEEPALIVE_SECONDS, false);
+    MqttPacket connack;
+    if (!sendAll((const char*)packet, length) || !readPacket(connack) || connack.type != MQTT_CONNACK) return false;
+    uint8_t code = connack.connectCode();
+    in.erase(0, connack.size);
+    return code == 0;
+  }
+
+  size_t sendBatch(const char* deviceId, const char* body, size_t length) override {
+    char topic[sizeof(MQTT_TOPIC_PREFIX) + DEVICE_ID_MAX + sizeof(MQTT_TOPIC_SUFFIX)];
+    snprintf(topic, sizeof(topic), "%s%s%s", MQTT_TOPIC_PREFIX, deviceId, MQTT_TOPIC_SUFFIX);
+    uint8_t header[MQTT_FIXED_HEADER_MAX + 2 + sizeof(topic) + 2];
+    size_t headerLen = mqttPublishHeader(header, sizeof(header), topic, nextPacketId, length);
+    nextPacketId = nextPacketId == 0xFFFF ? 1 : nextPacketId + 1;
+    return headerLen > 0 && sendAll((const char*)header, headerLen) && sendAll(body, length) ? headerLen : 0;
+  }
+
+  bool readReply(int& status, size_t& responseBytes, std::string& response) override {
+    MqttPacket packet;
+    do {
+      if (!readPacket(packet)) return false;
+      responseBytes = packet.size;
+      in.erase(0, packet.size);
+    } while (packet.type != MQTT_PUBACK);
+    status = 200;
+    response.clear();
+    return true;
+  }
+};
+
+// Block-wise confirmable POSTs over UDP through the firmware's CoapUploader, so batches in
+// flight, blocks and retransmission behave as on the device
+class CoapConnection : public UploadConnection {
+public:
+  CoapConnection(const Options& opt) : UploadConnection(opt), uploader(transmit, this, COAP_UPLOAD_PATH) {}
+
+  void disconnect() override {
+    UploadConnection::disconnect();
+    uploader.reset();
+  }
+
+protected:
+  CoapUploader uploader;
+  uint8_t rx[2048];
+
+  int socketType() const override { return SOCK_DGRAM; }
+
+  static void transmit(void* context, const uint8_t* data, size_t length) {
+    CoapConnection* conn = (CoapConnection*)context;
+    conn->sendAll((const char*)data, length);
+  }
+
+  static uint32_t nowMs() { return (uint32_t)(nowUs() / 1000); }
+
+  // Feeds datagrams to the uploader for up to waitMs
+  bool pump(int waitMs) {
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, waitMs) < 0) return false;
+    while (true) {
+      ssize_t n = recv(fd, rx, sizeof(rx), MSG_DONTWAIT);
+      if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+      uploader.receive(rx, n, nowMs());
+    }
+  }
+
+  size_t sendBatch(const char* deviceId, const char* body, size_t length) override {
+    size_t before = uploader.bytesSent;
+    if (!pump(0) || !uploader.start(body, length, nowMs())) return 0;
+    // Later blocks go out as Continues arrive, each framed like the first
+    size_t blocks = (length + COAP_BLOCK_SIZE - 1) / COAP_BLOCK_SIZE;
+    return (uploader.bytesSent - before - std::min(length, (size_t)COAP_BLOCK_SIZE)) * blocks;
+  }
+
+  bool readReply(int& status, size_t& responseBytes, std::string& response) override {
+    size_t before = uploader.bytesReceived;
+    UploadReply reply;
+    while (!uploader.takeReply(reply)) {
+      if (!uploader.service(nowMs()) || !pump((int)uploader.nextTimeout(nowMs(), 100))) return false;
+    }
+    status = reply.accepted ? 200 : 400;
+    responseBytes = uploader.bytesReceived - before;
+    response = reply.hasAck ? "{\"ack\":" + std::to_string(reply.ack) + "}" : std::string();
+    return true;
+  }
+};
+
+static void runWorker(const Options& opt, int workerId, uint64_t stopAtUs, UploadStats& stats) {
+  std::vector<SimulatedDevice> devices;
+  for (int d = workerId; d < opt.devices; d += opt.connections) {
+    SimulatedDevice dev = {};
+    dev.plantId = d + 1;
+    snprintf(dev.deviceId, sizeof(dev.deviceId), "LOADGEN%06d", d + 1);
+    dev.nextSequence = 1;
+    dev.rng = 2654435761u * (d + 1);
+    dev.soil1 = 60;
+    dev.soil2 = 65;
+    dev.soilTemp = 21;
+    dev.airTemp = 22;
+    dev.humidity = 50;
+    dev.light = 40;
+    dev.timestamp = 1717874856 + d;
+    // Spread first uploads over one interval so the fleet doesn't start in lockstep
+    dev.nextDueUs = nowUs() + (opt.intervalMs > 0 ? (uint64_t)opt.intervalMs * 1000 * d / opt.devices : 0);
+    devices.push_back(dev);
+  }
+  if (devices.empty()) return;
+
+  // One firmware buffer per connection, reused by each device it serves in turn. It is left
+  // empty after every device, so it only needs that device's sequence counter swapped in;
+  // initCircularBuffer() would read it from the single NVS shim every thread shares.
+  static thread_local CircularBuffer buffer;
+  static thread_local UploadBatch batch;
+  UploadWindow window(opt.window);
+  PlantMap plants;
+  std::unique_ptr<UploadConnection> conn;
+  if (opt.transport == Transport::MQTT) {
+    conn.reset(new MqttConnection(opt, workerId));
+  } else if (opt.transport == Transport::COAP) {
+    conn.reset(new CoapConnection(opt));
+  } else {
+    conn.reset(new HttpConnection(opt));
+  }
+
+  size_t next = 0;
+  while (!stopRequested && nowUs() < stopAtUs) {
+    SimulatedDevice& dev = devices[next];
+    next = (next + 1) % devices.size();
+
+    if (opt.intervalMs > 0) {
+      uint64_t now = nowUs();
+      if (dev.nextDueUs > now) {
+        uint64_t waitUs = std::min<uint64_t>(dev.nextDueUs - now, stopAtUs > now ? stopAtUs - now : 0);
+        std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+        if (nowUs() >= stopAtUs) break;
+      }
+      dev.nextDueUs += (uint64_t)opt.intervalMs * 1000;
+    }
+
+    buffer.nextSequence = dev.nextSequence;
+    for (int r = 0; r < opt.recordsPerUpload; r++) {
+      pushBack(buffer, dev.nextReading());
+    }
+    dev.nextSequence = buffer.nextSequence;
+
+    // Drain the way postSensorData() does: keep the window full, one response per batch
+    plants.assignAll(dev.plantId);
+    std::deque<uint64_t> sentAt;
+    uint64_t uploadStartUs = nowUs();
+    while (true) {
+      bool sendFailed = false;
+      while (window.take(buffer, batch, plants, dev.deviceId)) {
+        uint64_t sendUs = nowUs();
+        size_t header = conn->send(dev.deviceId, batch.payload, batch.payloadLength);
+        if (header == 0) {
+          sendFailed = true;
+          break;
+        }
+        stats.addRequest(batch.payloadLength, header, batch.count);
+        sentAt.push_back(sendUs);
+      }
+      if (!sendFailed && window.inFlight() == 0) {
+        stats.addUpload(nowUs() - uploadStartUs);
+        if (opt.cold) conn->disconnect();
+        break;
+      }
+
+      int status = 0;
+      size_t responseBytes = 0;
+      std::string response;
+      if (sendFailed || !conn->receive(status, responseBytes, response) || status != 200) {
+        // The next device must start from an empty buffer, so what's left is dropped; the
+        // backend skips those sequences once this device's next request moves its base past them
+        stats.errors++;
+        window.fail(buffer);
+        conn->disconnect();
+        while (popFrontBatch(buffer, batch.records, MAX_RECORDS_PER_REQUEST) > 0) {
+        }
+        break;
+      }
+      stats.addLatency(nowUs() - sentAt.front());
+      stats.wireBytes += responseBytes;
+      sentAt.pop_front();
+
+      uint32_t ack = 0;
+      if (parseAck(response.c_str(), ack)) {
+        window.acknowledge(buffer, ack);
+      } else {
+        window.acknowledgeOldest(buffer);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (opt.connections > opt.devices) opt.connections = opt.devices;
+
+  signal(SIGINT, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  static const char* transports[] = {"http", "mqtt", "coap"};
+  printf("Load: %d devices over %d connections for %d s, %s, %d records/upload, encoding json, %s%s\n",
+         opt.devices, opt.connections, opt.durationSec,
+         opt.intervalMs > 0 ? (std::to_string(opt.intervalMs) + " ms interval").c_str() : "closed loop",
+         opt.recordsPerUpload, transports[(int)opt.transport],
+         opt.cold ? ", cold" : "");
+  fflush(stdout);
+
+  std::vector<UploadStats> perWorker(opt.connections);
+  std::vector<std::thread> workers;
+  uint64_t start = nowUs();
+  uint64_t stopAt = start + (uint64_t)opt.durationSec * 1000000;
+  for (int w = 0; w < opt.connections; w++) {
+    workers.emplace_back(runWorker, std::cref(opt), w, stopAt, std::ref(perWorker[w]));
+  }
+  for (std::thread& t : workers) t.join();
+
+  UploadStats total;
+  total.begin(start);
+  for (const UploadStats& s : perWorker) total.merge(s);
+  total.end(nowUs());
+  total.print("client", stdout);
+  return total.requests > 0 ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+// Stand-in for a device taking an OTA update, for testing a release directory from ota_delta
+// against a local file server. Follows OtaUpdater's steps: fetch the manifest and check its
+// signature against the firmware's key (OtaSigningKey.h) or --public-key, stream the patch for
+// --version through the firmware's DeltaPatch against --image, check the result's SHA-256 and
+// fall back to the full image if any of that fails. Prints the bytes and time of each transfer.
+//
+//   ./build/ota_client --manifest http://127.0.0.1:8000/manifest.json --image v1.bin --version 1.0.0 [--out new.bin] [--full]
+//                      [--public-key ota_signing_key.pub.der]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <netdb.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "DeltaPatch.h"
+#include "HostSha256.h"
+#include "HostSignature.h"
+#include "HostStats.h"
+#include "OtaSigningKey.h"
+
+struct Options {
+  std::string manifestUrl;
+  std::string imagePath;
+  std::string version;
+  std::string outPath = "ota_out.bin";
+  std::string publicKeyPath;
+  bool full = false;
+};
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s --manifest URL --image FILE --version VERSION [--out FILE] [--full] [--public-key DER]\n"
+          "  --image       the running image the patches are against\n"
+          "  --full        skip the delta and download the full image\n"
+          "  --public-key  check the manifest against this key instead of the firmware's\n",
+          argv0);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char* value = nullptr;
+    if (arg == "--manifest" && (value = next())) opt.manifestUrl = value;
+    else if (arg == "--image" && (value = next())) opt.imagePath = value;
+    else if (arg == "--version" && (value = next())) opt.version = value;
+    else if (arg == "--out" && (value = next())) opt.outPath = value;
+    else if (arg == "--public-key" && (value = next())) opt.publicKeyPath = value;
+    else if (arg == "--full") opt.full = true;
+    else return false;
+  }
+  return !opt.manifestUrl.empty() && !opt.imagePath.empty() && !opt.version.empty();
+}
+
+// ==========================================
+// HTTP GET, body streamed to a callback
+// ==========================================
+static bool httpGet(const std::string& url, const std::function<bool(const uint8_t*, size_t)>& body) {
+  if (url.compare(0, 7, "http://") != 0) {
+    fprintf(stderr, "only http:// URLs: %s\n", url.c_str());
+    return false;
+  }
+  size_t hostEnd = url.find('/', 7);
+  std::string hostPort = url.substr(7, hostEnd == std::string::npos ? std::string::npos : hostEnd - 7);
+  std::string path = hostEnd == std::string::npos ? "/" : url.substr(hostEnd);
+  std::string host = hostPort, port = "80";
+  size_t colon = hostPort.find(':');
+  if (colon != std::string::npos) {
+    host = hostPort.substr(0, colon);
+    port = hostPort.substr(colon + 1);
+  }
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+    fprintf(stderr, "can't resolve %s\n", host.c_str());
+    return false;
+  }
+  int fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+  bool connected = fd >= 0 && connect(fd, addresses->ai_addr, addresses->ai_addrlen) == 0;
+  freeaddrinfo(addresses);
+  if (!connected) {
+    fprintf(stderr, "can't connect to %s\n", hostPort.c_str());
+    if (fd >= 0) close(fd);
+    return false;
+  }
+
+  std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + hostPort + "\r\n\r\n";
+  if (send(fd, request.data(), request.size(), 0) != (ssize_t)request.size()) {
+    close(fd);
+    return false;
+  }
+
+  std::string head;
+  bool inBody = false, ok = true;
+  uint8_t buffer[4096];
+  ssize_t n;
+  while (ok && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    if (inBody) {
+      ok = body(buffer, n);
+      continue;
+    }
+    head.append((const char*)buffer, n);
+    size_t end = head.find("\r\n\r\n");
+    if (end == std::string::npos) continue;
+    if (head.compare(0, 12, "HTTP/1.0 200") != 0 && head.compare(0, 12, "HTTP/1.1 200") != 0) {
+      fprintf(stderr, "GET %s: %s\n", path.c_str(), head.substr(0, head.find("\r\n")).c_str());
+      ok = false;
+      break;
+    }
+    inBody = true;
+    if (head.size() > end + 4) ok = body((const uint8_t*)head.data() + end + 4, head.size() - end - 4);
+  }
+  close(fd);
+  return ok && inBody;
+}
+
+// Value of "key" in the manifest, searching from offset; enough for what ota_delta writes
+static std::string jsonValue(const std::string& json, const std::string& key, size_t from = 0) {
+  size_t at = json.find("\"" + key + "\"", from);
+  if (at == std::string::npos) return "";
+  at = json.find(':', at);
+  if (at == std::string::npos) return "";
+  at = json.find_first_not_of(" \t\r\n", at + 1);
+  if (at == std::string::npos) return "";
+  if (json[at] == '"') {
+    size_t end = json.find('"', at + 1);
+    return json.substr(at + 1, end - at - 1);
+  }
+  size_t end = json.find_first_of(",}\r\n", at);
+  return json.substr(at, end - at);
+}
+
+// As OtaUpdater::isNewer(): dotted versions compared field by field
+static bool isNewer(const char* version, const char* current) {
+  while (true) {
+    char* versionEnd;
+    char* currentEnd;
+    unsigned long a = strtoul(version, &versionEnd, 10);
+    unsigned long b = strtoul(current, &currentEnd, 10);
+    if (a != b) return a > b;
+    if (*versionEnd != '.' && *currentEnd != '.') return false;
+    version = *versionEnd == '.' ? versionEnd + 1 : versionEnd;
+    current = *currentEnd == '.' ? currentEnd + 1 : currentEnd;
+  }
+}
+
+static std::string resolve(const std::string& manifestUrl, const std::string& url) {
+  if (url.find("://") != std::string::npos) return url;
+  return manifestUrl.substr(0, manifestUrl.rfind('/') + 1) + url;
+}
+
+struct Transfer {
+  size_t bytes = 0;
+  uint64_t us = 0;
+};
+
+struct PatchContext {
+  FILE* old;
+  FILE* out;
+  Sha256 sha;
+};
+
+static bool applyDelta(const Options& opt, const std::string& url, const std::vector<uint8_t>& oldDigest,
+                       Transfer& transfer, uint8_t digest[32]) {
+  PatchContext context;
+  context.old = fopen(opt.imagePath.c_str(), "rb");
+  context.out = fopen(opt.outPath.c_str(), "wb");
+  if (!context.old || !context.out) {
+    fprintf(stderr, "can't open %s or %s\n", opt.imagePath.c_str(), opt.outPath.c_str());
+    return false;
+  }
+  static std::vector<uint8_t> expected;
+  expected = oldDigest;
+  DeltaPatch patch(
+      [](void* c, uint32_t offset, uint8_t* data, size_t n) {
+        FILE* old = ((PatchContext*)c)->old;
+        return fseek(old, offset, SEEK_SET) == 0 && fread(data, 1, n, old) == n;
+      },
+      [](void* c, const uint8_t* data, size_t n) {
+        PatchContext* context = (PatchContext*)c;
+        context->sha.update(data, n);
+        return fwrite(data, 1, n, context->out) == n;
+      },
+      [](void* c, const DeltaHeader& header) { return memcmp(header.oldSha256, expected.data(), 32) == 0; },
+      &context);
+
+  uint64_t startUs = nowUs();
+  bool ok = httpGet(url, [&](const uint8_t* data, size_t n) {
+    transfer.bytes += n;
+    return patch.feed(data, n);
+  });
+  transfer.us = nowUs() - startUs;
+  fclose(context.old);
+  fclose(context.out);
+  if (!ok || !patch.done()) {
+    fprintf(stderr, "delta failed: %s\n", patch.error() ? patch.error() : "transfer ended early");
+    return false;
+  }
+  context.sha.finish(digest);
+  return true;
+}
+
+static bool downloadFull(const Options& opt, const std::string& url, Transfer& transfer, uint8_t digest[32]) {
+  FILE* out = fopen(opt.outPath.c_str(), "wb");
+  if (!out) return false;
+  Sha256 sha;
+  uint64_t startUs = nowUs();
+  bool ok = httpGet(url, [&](const uint8_t* data, size_t n) {
+    transfer.bytes += n;
+    sha.update(data, n);
+    return fwrite(data, 1, n, out) == n;
+  });
+  transfer.us = nowUs() - startUs;
+  fclose(out);
+  sha.finish(digest);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::string manifest;
+  if (!httpGet(opt.manifestUrl, [&](const uint8_t* data, size_t n) {
+        manifest.append((const char*)data, n);
+        return true;
+      })) {
+    return 1;
+  }
+  std::string signature;
+  httpGet(opt.manifestUrl + ".sig", [&](const uint8_t* data, size_t n) {
+    signature.append((const char*)data, n);
+    return true;
+  });
+  std::vector<uint8_t> publicKey(ota_signing_key, ota_signing_key + ota_signing_key_len);
+  if (!opt.publicKeyPath.empty()) {
+    publicKey.clear();
+    FILE* f = fopen(opt.publicKeyPath.c_str(), "rb");
+    int c;
+    while (f && (c = fgetc(f)) != EOF) publicKey.push_back(c);
+    if (f) fclose(f);
+  }
+  if (!verifyManifest(publicKey.data(), publicKey.size(), manifest, signature)) {
+    fprintf(stderr, "manifest signature missing or doesn't verify\n");
+    return 1;
+  }
+  std::string version = jsonValue(manifest, "version");
+  std::string sha = jsonValue(manifest, "sha256");
+  size_t size = strtoul(jsonValue(manifest, "size").c_str(), nullptr, 10);
+  if (version.empty() || sha.size() != 64) {
+    fprintf(stderr, "manifest has no version or sha256\n");
+    return 1;
+  }
+  if (!isNewer(version.c_str(), opt.version.c_str())) {
+    printf("running %s, manifest has %s: nothing newer\n", opt.version.c_str(), version.c_str());
+    return 0;
+  }
+
+  // The running image's digest, as the device computes it over its own partition
+  std::vector<uint8_t> image;
+  {
+    FILE* f = fopen(opt.imagePath.c_str(), "rb");
+    if (!f) {
+      fprintf(stderr, "can't read %s\n", opt.imagePath.c_str());
+      return 1;
+    }
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) image.insert(image.end(), buffer, buffer + n);
+    fclose(f);
+  }
+  std::vector<uint8_t> oldDigest(32);
+  Sha256 oldSha;
+  oldSha.update(image.data(), image.size());
+  oldSha.finish(oldDigest.data());
+
+  uint8_t digest[32];
+  Transfer transfer;
+  bool updated = false;
+  size_t deltaAt = manifest.find("\"from\": \"" + opt.version + "\"");
+  if (!opt.full && deltaAt != std::string::npos) {
+    std::string url = resolve(opt.manifestUrl, jsonValue(manifest, "url", deltaAt));
+    updated = applyDelta(opt, url, oldDigest, transfer, digest) && Sha256::hex(digest) == sha;
+    printf("delta %s -> %s: %zu B in %.0f ms, %s\n", opt.version.c_str(), version.c_str(), transfer.bytes,
+           transfer.us / 1000.0, updated ? "verified" : "failed");
+  }
+  if (!updated) {
+    transfer = Transfer();
+    size_t urlAt = manifest.find("\"url\"");  // The image's, before the deltas
+    updated = downloadFull(opt, resolve(opt.manifestUrl, jsonValue(manifest, "url", urlAt)), transfer, digest) &&
+              Sha256::hex(digest) == sha;
+    printf("full %s: %zu B in %.0f ms, %s\n", version.c_str(), transfer.bytes, transfer.us / 1000.0,
+           updated ? "verified" : "failed");
+  }
+  if (!updated) return 1;
+  printf("wrote %s (%zu B)\n", opt.outPath.c_str(), size);
+  return 0;
+}
@@ -0,0 +1,348 @@
+// Builds an OTA release directory for the firmware's OtaUpdater: the full image, one delta patch
+// (DeltaPatch.h) from each older image given, manifest.json listing them, and manifest.json.sig,
+// the manifest signed with the release key. Every patch is applied back in memory and checked
+// against the new image before it is written. Any static file server can then serve the
+// directory, e.g. for a bench test:
+//
+//   ./build/ota_delta --new v2.bin --to 1.1.0 --old v1.bin --from 1.0.0 --key ota_signing_key.pem --out release
+//   python3 -m http.server 8000 --directory release
+//   ./build/ota_client --manifest http://127.0.0.1:8000/manifest.json --image v1.bin --version 1.0.0
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "DeltaPatch.h"
+#include "HostSha256.h"
+#include "HostSignature.h"
+#include "HostStats.h"
+
+struct Base {
+  std::string path;
+  std::string version;
+};
+
+struct Options {
+  std::string newPath;
+  std::string newVersion;
+  std::vector<Base> bases;
+  std::string keyPath;
+  std::string outDir;
+};
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s --new IMAGE --to VERSION [--old IMAGE --from VERSION]... --key KEY.pem --out DIR\n"
+          "  writes DIR/firmware-VERSION.bin, DIR/FROM-TO.pgd per --old, DIR/manifest.json and\n"
+          "  DIR/manifest.json.sig, signed with the ECDSA P-256 private key in KEY.pem\n",
+          argv0);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char* value = nullptr;
+    if (arg == "--new" && (value = next())) opt.newPath = value;
+    else if (arg == "--to" && (value = next())) opt.newVersion = value;
+    else if (arg == "--old" && (value = next())) opt.bases.push_back({value, ""});
+    else if (arg == "--from" && (value = next()) && !opt.bases.empty()) opt.bases.back().version = value;
+    else if (arg == "--key" && (value = next())) opt.keyPath = value;
+    else if (arg == "--out" && (value = next())) opt.outDir = value;
+    else return false;
+  }
+  for (const Base& base : opt.bases) {
+    if (base.version.empty()) return false;
+  }
+  return !opt.newPath.empty() && !opt.newVersion.empty() && !opt.keyPath.empty() && !opt.outDir.empty();
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) out.insert(out.end(), buffer, buffer + n);
+  fclose(f);
+  return true;
+}
+
+static bool writeFile(const std::string& path, const void* data, size_t n) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(data, 1, n, f) == n;
+  return fclose(f) == 0 && ok;
+}
+
+static void sha256(const std::vector<uint8_t>& data, uint8_t out[32]) {
+  Sha256 sha;
+  sha.update(data.data(), data.size());
+  sha.finish(out);
+}
+
+// ==========================================
+// Matching, after bsdiff
+// ==========================================
+// Suffix array by prefix doubling; a couple of seconds for a 2 MB image
+static std::vector<int32_t> suffixArray(const std::vector<uint8_t>& s) {
+  int32_t n = (int32_t)s.size();
+  std::vector<int32_t> sa(n), rank(n), next(n);
+  for (int32_t i = 0; i < n; i++) {
+    sa[i] = i;
+    rank[i] = s[i];
+  }
+  for (int32_t k = 1; n > 0; k *= 2) {
+    auto key = [&](int32_t i) { return std::make_pair(rank[i], i + k < n ? rank[i + k] : -1); };
+    std::sort(sa.begin(), sa.end(), [&](int32_t a, int32_t b) { return key(a) < key(b); });
+    next[sa[0]] = 0;
+    for (int32_t i = 1; i < n; i++) next[sa[i]] = next[sa[i - 1]] + (key(sa[i - 1]) < key(sa[i]) ? 1 : 0);
+    rank.swap(next);
+    if (rank[sa[n - 1]] == n - 1) break;
+  }
+  return sa;
+}
+
+static int32_t matchLength(const uint8_t* a, int32_t aLength, const uint8_t* b, int32_t bLength) {
+  int32_t i = 0;
+  while (i < aLength && i < bLength && a[i] == b[i]) i++;
+  return i;
+}
+
+// Longest match of target in old, by binary search over the suffix array
+static int32_t search(const std::vector<int32_t>& sa, const std::vector<uint8_t>& old, const uint8_t* target,
+                      int32_t targetLength, int32_t& pos) {
+  int32_t lo = 0, hi = (int32_t)sa.size() - 1;
+  int32_t oldSize = (int32_t)old.size();
+  while (hi - lo > 1) {
+    int32_t mid = lo + (hi - lo) / 2;
+    int32_t start = sa[mid];
+    int32_t n = std::min(oldSize - start, targetLength);
+    if (memcmp(old.data() + start, target, n) < 0) lo = mid;
+    else hi = mid;
+  }
+  int32_t x = matchLength(old.data() + sa[lo], oldSize - sa[lo], target, targetLength);
+  int32_t y = matchLength(old.data() + sa[hi], oldSize - sa[hi], target, targetLength);
+  pos = x > y ? sa[lo] : sa[hi];
+  return std::max(x, y);
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+// Writes a diff as (unchanged, changed) runs; gaps of unchanged bytes shorter than a run header
+// stay inside the changed run
+static void putDiff(std::vector<uint8_t>& out, const uint8_t* diff, int32_t length) {
+  int32_t i = 0;
+  while (i < length) {
+    int32_t unchanged = 0;
+    while (i + unchanged < length && diff[i + unchanged] == 0) unchanged++;
+    int32_t start = i + unchanged;
+    int32_t end = start;
+    while (end < length) {
+      if (diff[end] != 0) {
+        end++;
+        continue;
+      }
+      int32_t zeros = 0;
+      while (end + zeros < length && diff[end + zeros] == 0) zeros++;
+      if (zeros > 2 || end + zeros == length) break;
+      end += zeros;
+    }
+    putVarint(out, unchanged);
+    putVarint(out, end - start);
+    out.insert(out.end(), diff + start, diff + end);
+    i = end;
+  }
+}
+
+static std::vector<uint8_t> makePatch(const std::vector<uint8_t>& old, const std::vector<uint8_t>& neu) {
+  std::vector<uint8_t> patch(DELTA_HEADER_BYTES);
+  memcpy(patch.data(), DELTA_MAGIC, 4);
+  uint32_t sizes[2] = {(uint32_t)old.size(), (uint32_t)neu.size()};
+  for (int s = 0; s < 2; s++) {
+    for (int b = 0; b < 4; b++) patch[4 + 4 * s + b] = (uint8_t)(sizes[s] >> (8 * b));
+  }
+  sha256(old, patch.data() + 12);
+  sha256(neu, patch.data() + 44);
+
+  std::vector<int32_t> sa = suffixArray(old);
+  int32_t oldSize = (int32_t)old.size(), newSize = (int32_t)neu.size();
+  int32_t scan = 0, len = 0, pos = 0, lastScan = 0, lastPos = 0, lastOffset = 0;
+  std::vector<uint8_t> diff;
+  while (scan < newSize) {
+    int32_t oldScore = 0;
+    for (int32_t scsc = scan += len; scan < newSize; scan++) {
+      len = oldSize > 0 ? search(sa, old, neu.data() + scan, newSize - scan, pos) : 0;
+      for (; scsc < scan + len; scsc++) {
+        if (scsc + lastOffset < oldSize && old[scsc + lastOffset] == neu[scsc]) oldScore++;
+      }
+      if ((len == oldScore && len != 0) || len > oldScore + 8) break;
+      if (scan + lastOffset < oldSize && old[scan + lastOffset] == neu[scan]) oldScore--;
+    }
+    if (len == oldScore && scan != newSize) continue;
+
+    // Extend the previous match forward and this one backward, allowing mismatches
+    int32_t s = 0, best = 0, lengthForward = 0;
+    for (int32_t i = 0; lastScan + i < scan && lastPos + i < oldSize;) {
+      if (old[lastPos + i] == neu[lastScan + i]) s++;
+      i++;
+      if (s * 2 - i > best * 2 - lengthForward) {
+        best = s;
+        lengthForward = i;
+      }
+    }
+    int32_t lengthBack = 0;
+    if (scan < newSize) {
+      s = 0;
+      best = 0;
+      for (int32_t i = 1; scan >= lastScan + i && pos >= i; i++) {
+        if (old[pos - i] == neu[scan - i]) s++;
+        if (s * 2 - i > best * 2 - lengthBack) {
+          best = s;
+          lengthBack = i;
+        }
+      }
+    }
+    if (lastScan + lengthForward > scan - lengthBack) {
+      int32_t overlap = (lastScan + lengthForward) - (scan - lengthBack);
+      s = 0;
+      best = 0;
+      int32_t split = 0;
+      for (int32_t i = 0; i < overlap; i++) {
+        if (neu[lastScan + lengthForward - overlap + i] == old[lastPos + lengthForward - overlap + i]) s++;
+        if (neu[scan - lengthBack + i] == old[pos - lengthBack + i]) s--;
+        if (s > best) {
+          best = s;
+          split = i + 1;
+        }
+      }
+      lengthForward += split - overlap;
+      lengthBack -= split;
+    }
+
+    int32_t extra = (scan - lengthBack) - (lastScan + lengthForward);
+    int64_t seek = (int64_t)(pos - lengthBack) - (lastPos + lengthForward);
+    putVarint(patch, lengthForward);
+    putVarint(patch, extra);
+    putVarint(patch, (uint64_t)((seek << 1) ^ (seek >> 63)));
+    diff.resize(lengthForward);
+    for (int32_t i = 0; i < lengthForward; i++) diff[i] = neu[lastScan + i] - old[lastPos + i];
+    putDiff(patch, diff.data(), lengthForward);
+    patch.insert(patch.end(), neu.begin() + lastScan + lengthForward, neu.begin() + scan - lengthBack);
+
+    lastScan = scan - lengthBack;
+    lastPos = pos - lengthBack;
+    lastOffset = pos - scan;
+  }
+  return patch;
+}
+
+// ==========================================
+// Check by applying, the way the device does
+// ==========================================
+struct ApplyContext {
+  const std::vector<uint8_t>* old;
+  std::vector<uint8_t> out;
+};
+
+static bool applyPatch(const std::vector<uint8_t>& old, const std::vector<uint8_t>& patch, std::vector<uint8_t>& out) {
+  ApplyContext context{&old, {}};
+  DeltaPatch applier(
+      [](void* c, uint32_t offset, uint8_t* data, size_t n) {
+        const std::vector<uint8_t>& image = *((ApplyContext*)c)->old;
+        if (offset + n > image.size()) return false;
+        memcpy(data, image.data() + offset, n);
+        return true;
+      },
+      [](void* c, const uint8_t* data, size_t n) {
+        std::vector<uint8_t>& image = ((ApplyContext*)c)->out;
+        image.insert(image.end(), data, data + n);
+        return true;
+      },
+      nullptr, &context);
+  // Small pieces, like a TCP stream, to exercise every state boundary
+  for (size_t i = 0; i < patch.size(); i += 1371) {
+    if (!applier.feed(patch.data() + i, std::min<size_t>(1371, patch.size() - i))) {
+      fprintf(stderr, "patch check failed: %s\n", applier.error());
+      return false;
+    }
+  }
+  out.swap(context.out);
+  return applier.done();
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::vector<uint8_t> image;
+  if (!readFile(opt.newPath, image)) {
+    fprintf(stderr, "can't read %s\n", opt.newPath.c_str());
+    return 1;
+  }
+  mkdir(opt.outDir.c_str(), 0755);
+  std::string imageName = "firmware-" + opt.newVersion + ".bin";
+  if (!writeFile(opt.outDir + "/" + imageName, image.data(), image.size())) {
+    fprintf(stderr, "can't write to %s\n", opt.outDir.c_str());
+    return 1;
+  }
+  uint8_t digest[32];
+  sha256(image, digest);
+
+  std::string deltas;
+  for (const Base& base : opt.bases) {
+    std::vector<uint8_t> old, check;
+    if (!readFile(base.path, old)) {
+      fprintf(stderr, "can't read %s\n", base.path.c_str());
+      return 1;
+    }
+    uint64_t startUs = nowUs();
+    std::vector<uint8_t> patch = makePatch(old, image);
+    uint64_t builtUs = nowUs() - startUs;
+    if (!applyPatch(old, patch, check) || check != image) {
+      fprintf(stderr, "%s -> %s: patch doesn't reproduce the new image\n", base.version.c_str(),
+              opt.newVersion.c_str());
+      return 1;
+    }
+    std::string patchName = base.version + "-" + opt.newVersion + ".pgd";
+    if (!writeFile(opt.outDir + "/" + patchName, patch.data(), patch.size())) {
+      fprintf(stderr, "can't write %s\n", patchName.c_str());
+      return 1;
+    }
+    printf("%s -> %s: %zu B patch for a %zu B image (%.1f%%), built in %.1f s\n", base.version.c_str(),
+           opt.newVersion.c_str(), patch.size(), image.size(), 100.0 * patch.size() / image.size(), builtUs / 1e6);
+    char entry[256];
+    snprintf(entry, sizeof(entry), "%s\n    {\"from\": \"%s\", \"url\": \"%s\", \"size\": %zu}",
+             deltas.empty() ? "" : ",", base.version.c_str(), patchName.c_str(), patch.size());
+    deltas += entry;
+  }
+
+  char manifest[4096];
+  snprintf(manifest, sizeof(manifest),
+           "{\n  \"version\": \"%s\",\n  \"size\": %zu,\n  \"sha256\": \"%s\",\n  \"url\": \"%s\",\n"
+           "  \"deltas\": [%s\n  ]\n}\n",
+           opt.newVersion.c_str(), image.size(), Sha256::hex(digest).c_str(), imageName.c_str(), deltas.c_str());
+  std::string signature = signManifest(opt.keyPath, manifest) + "\n";
+  if (signature.size() == 1) {
+    fprintf(stderr, "can't sign with %s; it needs an EC P-256 private key in PEM\n", opt.keyPath.c_str());
+    return 1;
+  }
+  if (!writeFile(opt.outDir + "/manifest.json", manifest, strlen(manifest)) ||
+      !writeFile(opt.outDir + "/manifest.json.sig", signature.data(), signature.size())) {
+    fprintf(stderr, "can't write the manifest\n");
+    return 1;
+  }
+  printf("wrote %s/manifest.json for %s (%zu B, sha256 %s)\n", opt.outDir.c_str(), opt.newVersion.c_str(),
+         image.size(), Sha256::hex(digest).c_str());
+  return 0;
+}
@@ -0,0 +1,546 @@
+// Replays QTA sensor exports through the firmware's sampling path on a virtual clock.
+// Each CSV row drives the stand-in ADC, DS18B20 and DHT22 reads; the real SensorManager,
+// Scheduler, CircularBuffer and takeBatch() do the rest. Reports records and bytes produced,
+// CPU time per stage, on-device watering predictions and buffer occupancy over time.
+//
+//   ./build/qta_replay ../../QTA/Sensor_Data_Jun_21_guru1.csv [--offline] [--occupancy-csv occ.csv]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include "Scheduling.h"
+#include "SensorService.h"
+#include "UploadBatch.h"
+#include "RecordCodec.h"
+#if USE_ROLLUPS
+#include "Rollups.h"
+#endif
+#include "HostStats.h"
+
+struct Options {
+  std::vector<std::string> files;
+  unsigned long sampleMs = 1000;                 // Stand-in for the loop() rate, SENSOR_UPDATE_INTERVAL is 0
+  unsigned long recordMs = SENSOR_RECORD_INTERVAL;
+  unsigned long uploadMs = WIFI_UPDATE_INTERVAL;
+  unsigned long maxGapMs = 5 * 60 * 1000;        // Longer gaps between rows are treated as the device being off
+  unsigned long occupancyMs = 60 * 60 * 1000;
+  int plantId = 1;
+  const char* probePlants = nullptr;             // "id,id,..." per soil probe, overrides plantId
+  bool offline = false;
+  bool adaptive = false;                         // Record at the adaptive rate (AdaptiveRate.h), not every recordMs
+  double failRate = 0;                           // Fraction of uploads that fail and return their batch
+  const char* occupancyCsv = nullptr;
+  const char* serial = "null";
+};
+
+// One row of a QTA export. Columns missing from a file, or "null", read as NAN.
+struct TraceRow {
+  float temp1, temp2, light, soil1, soil2, humidity;
+  long long timestampMs;
+};
+
+// CPU time spent in one stage of the pipeline
+struct Stage {
+  const char* name;
+  uint64_t calls = 0;
+  uint64_t ns = 0;
+  uint64_t maxNs = 0;
+
+  explicit Stage(const char* name) : name(name) {}
+
+  template <typename F> void time(F&& f) {
+    uint64_t start = cpuNs();
+    f();
+    uint64_t elapsed = cpuNs() - start;
+    calls++;
+    ns += elapsed;
+    if (elapsed > maxNs) maxNs = elapsed;
+  }
+
+  static uint64_t cpuNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  }
+};
+
+struct OccupancySample {
+  long long epochSec;
+  int count;
+};
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s FILE.csv [FILE.csv ...] [--sample-ms N] [--record-ms N] [--upload-ms N]\n"
+          "          [--max-gap-ms N] [--occupancy-ms N] [--occupancy-csv FILE] [--plant-id N]\n"
+          "          [--probe-plants ID,ID,...] [--offline] [--fail-rate P] [--adaptive]\n"
+          "          [--serial null|stdout|off]\n"
+          "  --probe-plants plant per soil probe, -1 for unused (default: every probe in --plant-id)\n"
+          "  --offline     never upload, so the buffer fills and overwrites\n"
+          "  --fail-rate   fraction of uploads that fail and put their batch back\n"
+          "  --adaptive    record at the adaptive rate around --record-ms instead of every --record-ms\n"
+          "  --serial      where firmware logging goes; null formats it and discards it (default)\n",
+          argv0);
+}
+
+static bool parseOptions(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char* value = nullptr;
+    if (arg == "--sample-ms" && (value = next())) opt.sampleMs = strtoul(value, nullptr, 10);
+    else if (arg == "--record-ms" && (value = next())) opt.recordMs = strtoul(value, nullptr, 10);
+    else if (arg == "--upload-ms" && (value = next())) opt.uploadMs = strtoul(value, nullptr, 10);
+    else if (arg == "--max-gap-ms" && (value = next())) opt.maxGapMs = strtoul(value, nullptr, 10);
+    else if (arg == "--occupancy-ms" && (value = next())) opt.occupancyMs = strtoul(value, nullptr, 10);
+    else if (arg == "--occupancy-csv" && (value = next())) opt.occupancyCsv = value;
+    else if (arg == "--plant-id" && (value = next())) opt.plantId = atoi(value);
+    else if (arg == "--probe-plants" && (value = next())) opt.probePlants = value;
+    else if (arg == "--fail-rate" && (value = next())) opt.failRate = atof(value);
+    else if (arg == "--serial" && (value = next())) opt.serial = value;
+    else if (arg == "--offline") opt.offline = true;
+    else if (arg == "--adaptive") opt.adaptive = true;
+    else if (arg.compare(0, 2, "--") != 0) opt.files.push_back(arg);
+    else return false;
+  }
+  return !opt.files.empty() && opt.sampleMs > 0 && opt.recordMs > 0 && opt.uploadMs > 0 && opt.occupancyMs > 0;
+}
+
+static float parseField(const std::string& field) {
+  if (field.empty() || field == "null") return NAN;
+  char* end = nullptr;
+  float value = strtof(field.c_str(), &end);
+  return end == field.c_str() ? NAN : value;
+}
+
+// Appends the rows of one export, matching columns by header name
+static bool loadTrace(const std::string& path, std::vector<TraceRow>& rows) {
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) {
+    perror(path.c_str());
+    return false;
+  }
+
+  static const char* columns[] = {"Temp Sensor 1", "Temp Sensor 2", "Light Percentage", "Soil Moisture 1",
+                                  "Soil Moisture 2", "Humidity", "Timestamp"};
+  const int numColumns = sizeof(columns) / sizeof(columns[0]);
+  int indexOf[numColumns];
+
+  char line[512];
+  auto split = [](const char* s) {
+    std::vector<std::string> fields(1);
+    for (; *s && *s != '\r' && *s != '\n'; s++) {
+      if (*s == ',') fields.emplace_back();
+      else fields.back() += *s;
+    }
+    return fields;
+  };
+
+  if (!fgets(line, sizeof(line), f)) {
+    fclose(f);
+    return false;
+  }
+  std::vector<std::string> header = split(line);
+  for (int c = 0; c < numColumns; c++) {
+    indexOf[c] = -1;
+    for (size_t h = 0; h < header.size(); h++) {
+      if (header[h] == columns[c]) indexOf[c] = (int)h;
+    }
+  }
+  if (indexOf[numColumns - 1] < 0) {
+    fprintf(stderr, "%s: no Timestamp column\n", path.c_str());
+    fclose(f);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), f)) {
+    std::vector<std::string> fields = split(line);
+    float values[numColumns - 1];
+    for (int c = 0; c < numColumns - 1; c++) {
+      values[c] = indexOf[c] >= 0 && indexOf[c] < (int)fields.size() ? parseField(fields[indexOf[c]]) : NAN;
+    }
+    if (indexOf[numColumns - 1] >= (int)fields.size()) continue;
+    long long timestampMs = atoll(fields[indexOf[numColumns - 1]].c_str());
+    if (timestampMs <= 0) continue;
+    rows.push_back({values[0], values[1], values[2], values[3], values[4], values[5], timestampMs});
+  }
+  fclose(f);
+  return true;
+}
+
+// Inverse of the conversions in SensorManager::updateSensorData(). A missing analog channel
+// reads as 0%, which is what a floating pin looks like to the firmware.
+static int percentToRaw(float percent, bool inverted) {
+  if (isnan(percent)) return inverted ? (int)ANALOG_MAX : 0;
+  float fraction = percent / 100.0f;
+  if (inverted) fraction = 1 - fraction;
+  int raw = (int)lroundf(fraction * (float)ANALOG_MAX);
+  return raw < 0 ? 0 : raw > (int)ANALOG_MAX ? (int)ANALOG_MAX : raw;
+}
+
+static void applyRow(const TraceRow& row) {
+  host::ds18b20TempC = isnan(row.temp1) ? DEVICE_DISCONNECTED_C : row.temp1;
+  host::dhtTemperature = row.temp2;
+  host::dhtHumidity = row.humidity;
+  host::analogValues[SOIL_PIN1 & 63] = percentToRaw(row.soil1, true);
+  host::analogValues[SOIL_PIN2 & 63] = percentToRaw(row.soil2, true);
+  host::analogValues[LIGHT_PIN & 63] = percentToRaw(row.light, false);
+}
+
+// Average cost of one walk of the exported decision tree over a sweep of plausible inputs
+static double treeInferenceNs() {
+  const int iterations = 1000000;
+  volatile float sink = 0;
+  float features[WATERING_MODEL_FEATURES];
+  uint64_t start = Stage::cpuNs();
+  for (int i = 0; i < iterations; i++) {
+    features[WATERING_FEATURE_EXT_TEMP] = 15 + (i % 200) * 0.1f;
+    features[WATERING_FEATURE_HUMIDITY] = 30 + (i % 500) * 0.1f;
+    features[WATERING_FEATURE_LIGHT] = (i % 1000) * 0.1f;
+    features[WATERING_FEATURE_SOIL_MOISTURE_1] = 40 + (i % 450) * 0.1f;
+    sink = sink + predictWateringMoisture(features);
+  }
+  return (double)(Stage::cpuNs() - start) / iterations;
+}
+
+// The record just pushed, read back through the buffer's column access
+static SensorData newestRecord() {
+  SensorData record;
+  forEachChannel([&](auto id) { record.set(decltype(id)::value, columnAt(cb, decltype(id)::value, bufferCount(cb) - 1)); });
+  int32_t timestamp = -1;
+  readTimestamps(cb, bufferCount(cb) - 1, &timestamp, 1);
+  record.timestamp = timestamp;
+  readSequences(cb, bufferCount(cb) - 1, &record.sequence, 1);
+  return record;
+}
+
+struct CodecResult {
+  size_t blockBytes = 0;      // Sum of used bytes over all blocks
+  size_t blocks = 0;
+  double encodeNs = 0;        // Per record
+  double decodeNs = 0;
+  float maxError = 0;         // Largest difference from the recorded value
+};
+
+// Streams every recorded SensorData through the SD history's block format
+static CodecResult benchmarkCodec(const std::vector<SensorData>& records, size_t blockSize) {
+  CodecResult result;
+  std::vector<std::vector<uint8_t>> blocks;
+  const int repeats = 20;
+  uint64_t start = Stage::cpuNs();
+  for (int rep = 0; rep < repeats; rep++) {
+    blocks.clear();
+    blocks.emplace_back(blockSize);
+    RecordEncoder encoder(blocks.back().data(), blockSize);
+    for (const SensorData& record : records) {
+      if (!encoder.append(record)) {
+        blocks.back().resize(encoder.size());
+        blocks.emplace_back(blockSize);
+        encoder = RecordEncoder(blocks.back().data(), blockSize);
+        encoder.append(record);
+      }
+    }
+    blocks.back().resize(encoder.size());
+  }
+  result.encodeNs = (double)(Stage::cpuNs() - start) / repeats / records.size();
+
+  start = Stage::cpuNs();
+  for (int rep = 0; rep < repeats; rep++) {
+    size_t i = 0;
+    for (const std::vector<uint8_t>& block : blocks) {
+      RecordDecoder decoder(block.data(), block.size());
+      SensorData record;
+      while (decoder.next(record)) {
+        if (rep == 0) {
+          for (size_t c = 0; c < STORED_CHANNEL_COUNT; c++) {
+            float a = records[i].values[c], b = record.values[c];
+            if (isnan(a) != isnan(b)) result.maxError = INFINITY;
+            else if (!isnan(a)) result.maxError = std::max(result.maxError, fabsf(a - b));
+          }
+          if (records[i].timestamp != record.timestamp) result.maxError = INFINITY;
+        }
+        i++;
+      }
+    }
+  }
+  result.decodeNs = (double)(Stage::cpuNs() - start) / repeats / records.size();
+
+  for (const std::vector<uint8_t>& block : blocks) {
+    result.blockBytes += block.size();
+  }
+  result.blocks = blocks.size();
+  return result;
+}
+
+static void printOccupancy(const std::vector<OccupancySample>& samples, unsigned long intervalMs, FILE* out) {
+  if (samples.empty()) return;
+  // Fold the series into at most 24 rows, keeping the peak of each span
+  const size_t maxRows = 24;
+  size_t span = (samples.size() + maxRows - 1) / maxRows;
+  fprintf(out, "  occupancy    peak per %.1f h of trace (buffer holds %d)\n",
+          span * intervalMs / 3600000.0, BUFFER_SIZE);
+  for (size_t i = 0; i < samples.size(); i += span) {
+    int peak = 0;
+    for (size_t j = i; j < samples.size() && j < i + span; j++) peak = std::max(peak, samples[j].count);
+    time_t t = (time_t)samples[i].epochSec;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char when[20];
+    strftime(when, sizeof(when), "%m-%d %H:%M", &tm);
+    int bar = (int)(40.0 * peak / BUFFER_SIZE + 0.5);
+    fprintf(out, "    %s %4d %.*s\n", when, peak, bar, "########################################");
+  }
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  FILE* serialOut = nullptr;
+  if (strcmp(opt.serial, "stdout") == 0) serialOut = stdout;
+  else if (strcmp(opt.serial, "null") == 0) serialOut = fopen("/dev/null", "w");
+  else if (strcmp(opt.serial, "off") != 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  Serial.setOutput(serialOut);
+
+  std::vector<TraceRow> rows;
+  for (const std::string& file : opt.files) {
+    if (!loadTrace(file, rows)) return 1;
+  }
+  // Later exports repeat earlier ones; keep rows in time order and drop anything replayed already
+  std::vector<TraceRow> trace;
+  for (const TraceRow& row : rows) {
+    if (trace.empty() || row.timestampMs > trace.back().timestampMs) trace.push_back(row);
+  }
+  if (trace.empty()) {
+    fprintf(stderr, "no rows to replay\n");
+    return 1;
+  }
+
+  // Record timestamps come from mktime(localtime) in getUnixTime(); keep them in UTC
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  const long long originMs = trace.front().timestampMs;
+  host::useVirtualClock = true;
+  host::virtualMillis = 0;
+  host::epochAtZero = (time_t)(originMs / 1000);
+  host::timeSynced = true;
+
+  SensorManager sensorManager;
+  Scheduler scheduler;
+  static UploadBatch batch;
+  initCircularBuffer(cb);
+
+  Stage sampleStage("sample"), recordStage("record"), serializeStage("serialize"), schedulerStage("scheduler");
+  uint64_t recordsProduced = 0, recordsOverwritten = 0, recordsUploaded = 0, recordsReturned = 0;
+  uint64_t uploads = 0, failedUploads = 0, payloadBytes = 0;
+  uint64_t predictionUploads = 0, predictionBytes = 0;
+  uint64_t rollupUploads = 0, rollupBytes = 0;
+  uint32_t failRng = 0x9e3779b9;
+
+  std::vector<SensorData> recorded;
+
+  sensorManager.setupBeforeSerial();
+  sensorManager.setupAfterSerial();
+  PlantMap plants;
+  if (opt.probePlants ? !plants.assign(String(opt.probePlants)) : (plants.assignAll(opt.plantId), false)) {
+    fprintf(stderr, "--probe-plants needs %d plant IDs\n", SOIL_PROBE_COUNT);
+    return 2;
+  }
+  plantMap.publish(plants);
+
+  // Set directly: Intervals::set() would write to NVS and count against saveBufferState()
+  intervals.ms[INTERVAL_RECORD] = opt.recordMs;
+  size_t recordTask = 0;
+  scheduler.add([&]() {
+    sampleStage.time([&]() { sensorManager.run(); });
+    if (opt.adaptive && sensorManager.recordDue()) scheduler.trigger(recordTask);
+  }, opt.sampleMs);
+  recordTask = scheduler.add([&]() {
+    if (isFull(cb)) recordsOverwritten++;
+    recordStage.time([&]() { sensorManager.recordToBuffer(); });
+    recordsProduced++;
+    recorded.push_back(newestRecord());
+    if (opt.adaptive) scheduler.setInterval(recordTask, sensorManager.recordInterval());
+  }, opt.recordMs);
+  // Mirrors postSensorData(): one batch per pass, put back on failure
+  scheduler.add([&]() {
+    if (opt.offline) return;
+    #if USE_ROLLUPS
+    // Mirrors postRollups(): the rollups go first, all of them
+    static RollupBatch rollupBatch;
+    while (rollups.take(rollupBatch, plants, "QTAREPLAY") > 0) {
+      rollupUploads += rollupBatch.count;
+      rollupBytes += rollupBatch.payloadLength;
+      rollups.commit(rollupBatch);
+    }
+    #endif
+    if (isEmpty(cb)) return;
+    serializeStage.time([&]() { takeBatch(cb, batch, plants, "QTAREPLAY"); });
+    failRng = failRng * 1664525u + 1013904223u;
+    if ((failRng >> 8) / 16777216.0 < opt.failRate) {
+      failedUploads++;
+      recordsReturned += batch.count;
+      returnBatch(cb, batch);
+      return;
+    }
+    uploads++;
+    recordsUploaded += batch.count;
+    payloadBytes += batch.payloadLength;
+    // A backend that stored the whole batch acknowledges its last sequence
+    ackBatch(cb, batch, batch.records[batch.count - 1].sequence);
+
+    // Mirrors postWateringPrediction(): only changed dry times go out
+    for (int i = 0; i < SOIL_PROBE_COUNT; i++) {
+      char prediction[160];
+      uint32_t version = sensorManager.takePrediction(i, prediction, sizeof(prediction));
+      if (version != 0) {
+        predictionBytes += strlen(prediction);
+        predictionUploads++;
+        sensorManager.predictionUploaded(i, version);
+      }
+    }
+  }, opt.uploadMs);
+
+  std::vector<OccupancySample> occupancy;
+  unsigned long nextOccupancyMs = 0;
+  int intervalPeak = 0;
+  uint64_t gaps = 0;
+  double trackingError = 0, maxTrackingError = 0;  // Trace soil moisture 1 against the newest record
+  uint64_t trackedRows = 0;
+  uint64_t wallStart = nowUs();
+
+  for (size_t i = 0; i < trace.size(); i++) {
+    applyRow(trace[i]);
+    unsigned long rowMs = (unsigned long)(trace[i].timestampMs - originMs);
+    unsigned long endMs = i + 1 < trace.size() ? (unsigned long)(trace[i + 1].timestampMs - originMs) : rowMs + 1;
+    if (endMs - rowMs > opt.maxGapMs) {
+      // Device was off: run through the first sample period only, then jump
+      gaps++;
+      endMs = rowMs + opt.sampleMs;
+    }
+
+    for (host::virtualMillis = std::max(host::virtualMillis, rowMs); host::virtualMillis < endMs;
+         host::virtualMillis += opt.sampleMs) {
+      uint64_t before = sampleStage.ns + recordStage.ns + serializeStage.ns;
+      uint64_t start = Stage::cpuNs();
+      scheduler.run();
+      uint64_t elapsed = Stage::cpuNs() - start;
+      uint64_t inStages = sampleStage.ns + recordStage.ns + serializeStage.ns - before;
+      schedulerStage.calls++;
+      uint64_t own = elapsed > inStages ? elapsed - inStages : 0;
+      schedulerStage.ns += own;
+      if (own > schedulerStage.maxNs) schedulerStage.maxNs = own;
+
+      // Each sample is the peak over its interval, so short-lived backlogs still show up
+      intervalPeak = std::max(intervalPeak, bufferCount(cb));
+      if (host::virtualMillis >= nextOccupancyMs) {
+        occupancy.push_back({(long long)host::epochNow(), intervalPeak});
+        intervalPeak = 0;
+        nextOccupancyMs = host::virtualMillis + opt.occupancyMs;
+      }
+    }
+
+    float newest = recorded.empty() ? NAN : recorded.back().get(CHANNEL_SOIL_MOISTURE_1);
+    if (!isnan(trace[i].soil1) && !isnan(newest)) {
+      double error = fabs(trace[i].soil1 - newest);
+      trackingError += error;
+      maxTrackingError = std::max(maxTrackingError, error);
+      trackedRows++;
+    }
+  }
+  uint64_t wallUs = nowUs() - wallStart;
+
+  double traceHours = (trace.back().timestampMs - originMs) / 3600000.0;
+  int peak = 0;
+  double meanOccupancy = 0;
+  for (const OccupancySample& s : occupancy) {
+    peak = std::max(peak, s.count);
+    meanOccupancy += s.count;
+  }
+  if (!occupancy.empty()) meanOccupancy /= occupancy.size();
+
+  printf("QTA replay: %zu rows, %.1f h of trace (%llu gaps > %lu s skipped), replayed in %.2f s (%.0fx)\n",
+         trace.size(), traceHours, (unsigned long long)gaps, opt.maxGapMs / 1000, wallUs / 1e6,
+         wallUs ? traceHours * 3600e6 / wallUs : 0);
+  printf("  intervals    sample %lu ms, record %lu ms%s, upload %lu ms%s\n", opt.sampleMs, opt.recordMs,
+         opt.adaptive ? " (adaptive)" : "", opt.uploadMs, opt.offline ? " (offline)" : "");
+  printf("  records      %llu produced, %llu uploaded, %llu overwritten, %d still buffered\n",
+         (unsigned long long)recordsProduced, (unsigned long long)recordsUploaded,
+         (unsigned long long)recordsOverwritten, bufferCount(cb));
+  #if USE_ROLLUPS
+  printf("  rollups      %lu overwritten records folded, %lu lost; %d rollups held (%d hourly), "
+         "%llu uploaded (%llu B)\n",
+         (unsigned long)rollups.foldedRecords(), (unsigned long)rollups.lostRecords(), rollups.count(),
+         rollups.coarseCount(), (unsigned long long)rollupUploads, (unsigned long long)rollupBytes);
+  #endif
+  printf("  tracking     soil moisture 1 off the newest record by %.2f %% on average, %.1f %% at most",
+         trackedRows ? trackingError / trackedRows : 0, maxTrackingError);
+  #if USE_ADAPTIVE_SAMPLING
+  if (opt.adaptive) {
+    printf("; %lu changing windows", (unsigned long)sensorManager.getAdaptiveRate().changingWindows());
+  }
+  #endif
+  printf("\n");
+  printf("  uploads      %llu ok, %llu failed (%llu records put back)\n", (unsigned long long)uploads,
+         (unsigned long long)failedUploads, (unsigned long long)recordsReturned);
+  printf("  plants       %d (probe map %s), %d soil probes\n", plants.plantCount, plants.toString().c_str(),
+         SOIL_PROBE_COUNT);
+  printf("  bytes        %llu B JSON payload (%.1f B/record, %.1f B/probe), %zu B per buffered record, "
+         "%zu B buffer in RAM\n",
+         (unsigned long long)payloadBytes, recordsUploaded ? (double)payloadBytes / recordsUploaded : 0,
+         recordsUploaded ? (double)payloadBytes / recordsUploaded / SOIL_PROBE_COUNT : 0,
+         sizeof(CircularBuffer) / BUFFER_SIZE, sizeof(CircularBuffer));
+  unsigned long predictions = 0;
+  for (int i = 0; i < plants.plantCount; i++) {
+    predictions += sensorManager.getPredictor(i).getPredictionCount();
+  }
+  printf("  prediction   %lu dry times computed, %llu uploaded as changes (%llu B), tree %.1f ns/inference\n",
+         predictions, (unsigned long long)predictionUploads,
+         (unsigned long long)predictionBytes, treeInferenceNs());
+  printf("  NVS          %zu B written for the buffer state, %.1f B/record (one save per %d s at most)\n",
+         host::nvsBytesWritten, recordsProduced ? (double)host::nvsBytesWritten / recordsProduced : 0,
+         BUFFER_SAVE_INTERVAL / 1000);
+  if (!recorded.empty()) {
+    size_t rawBytes = sizeof(CircularBuffer) / BUFFER_SIZE;
+    CodecResult sd = benchmarkCodec(recorded, 512);
+    CodecResult nvs = benchmarkCodec(recorded, BUFFER_BLOCK_BYTES);
+    double perRecord = (double)sd.blockBytes / recorded.size();
+    printf("  codec        %.2f B/record in 512 B SD blocks (%.1fx vs %zu B raw), %.2f B/record in %d B NVS blocks\n",
+           perRecord, rawBytes / perRecord, rawBytes, (double)nvs.blockBytes / recorded.size(), BUFFER_BLOCK_BYTES);
+    printf("               encode %.1f ns/record, decode %.1f ns/record, max error %g\n", sd.encodeNs, sd.decodeNs,
+           sd.maxError);
+    double recordsPerBuffer = (double)sizeof(CircularBuffer) / perRecord;
+    printf("               %.0f records (%.1f days at this record interval) fit in the %zu B a raw buffer takes\n",
+           recordsPerBuffer, recordsPerBuffer * opt.recordMs / 86400000.0, sizeof(CircularBuffer));
+  }
+  printf("  CPU          %-10s %10s %12s %10s %10s\n", "stage", "calls", "total ms", "mean us", "max us");
+  for (const Stage* s : {&sampleStage, &recordStage, &serializeStage, &schedulerStage}) {
+    printf("               %-10s %10llu %12.2f %10.3f %10.1f\n", s->name, (unsigned long long)s->calls,
+           s->ns / 1e6, s->calls ? s->ns / 1e3 / s->calls : 0, s->maxNs / 1e3);
+  }
+  printf("  buffer       peak %d, mean of interval peaks %.1f, capacity %d, %zu samples\n", peak, meanOccupancy,
+         BUFFER_SIZE, occupancy.size());
+  printOccupancy(occupancy, opt.occupancyMs, stdout);
+
+  if (opt.occupancyCsv) {
+    FILE* f = fopen(opt.occupancyCsv, "w");
+    if (!f) {
+      perror(opt.occupancyCsv);
+      return 1;
+    }
+    fprintf(f, "time_stamp,buffered\n");
+    for (const OccupancySample& s : occupancy) fprintf(f, "%lld,%d\n", s.epochSec, s.count);
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,193 @@
+// Minimal Arduino core for building firmware sources on the host.
+// Only covers what the portable parts of full_prov use.
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+
+using std::isnan;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+
+// ==========================================
+// Clock
+// ==========================================
+// Tools that replay data at accelerated speed switch to a virtual clock and advance it themselves
+namespace host {
+inline bool useVirtualClock = false;
+inline unsigned long virtualMillis = 0;
+
+inline unsigned long realMillis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace host
+
+inline unsigned long millis() {
+  return host::useVirtualClock ? host::virtualMillis : host::realMillis();
+}
+
+inline void delay(unsigned long ms) {
+  if (host::useVirtualClock) {
+    host::virtualMillis += ms;
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+// ==========================================
+// Wall clock (SNTP)
+// ==========================================
+// configTime() marks the clock as synced. On the virtual clock, wall time is
+// host::epochAtZero plus millis(), so replayed traces keep their original timestamps.
+namespace host {
+inline bool timeSynced = false;
+inline time_t epochAtZero = 0;
+
+inline time_t epochNow() {
+  return useVirtualClock ? epochAtZero + (time_t)(virtualMillis / 1000) : time(nullptr);
+}
+}  // namespace host
+
+inline void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr) {
+  host::timeSynced = true;
+}
+
+inline bool getLocalTime(struct tm* info, uint32_t = 5000) {
+  if (!host::timeSynced) return false;
+  time_t now = host::epochNow();
+  localtime_r(&now, info);
+  return true;
+}
+
+// ==========================================
+// String
+// ==========================================
+class String : public std::string {
+public:
+  String() {}
+  String(const char* s) : std::string(s ? s : "") {}
+  String(const std::string& s) : std::string(s) {}
+  String(char c) : std::string(1, c) {}
+  String(int v) : std::string(std::to_string(v)) {}
+  String(unsigned int v) : std::string(std::to_string(v)) {}
+  String(long v) : std::string(std::to_string(v)) {}
+  String(unsigned long v) : std::string(std::to_string(v)) {}
+  String(double v, unsigned int decimals = 2) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    assign(buf);
+  }
+
+  bool isEmpty() const { return empty(); }
+  unsigned int length() const { return (unsigned int)size(); }
+  bool concat(const String& s) { append(s); return true; }
+  char charAt(unsigned int i) const { return i < size() ? (*this)[i] : 0; }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t pos = find(c, from);
+    return pos == npos ? -1 : (int)pos;
+  }
+  int indexOf(const String& s, unsigned int from = 0) const {
+    size_t pos = find(s, from);
+    return pos == npos ? -1 : (int)pos;
+  }
+  String substring(unsigned int from) const {
+    return from < size() ? String(std::string::substr(from)) : String();
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    return from < size() ? String(std::string::substr(from, to - from)) : String();
+  }
+  long toInt() const { return strtol(c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(c_str(), nullptr); }
+  bool startsWith(const String& s) const { return compare(0, s.size(), s) == 0; }
+  void trim() {
+    size_t b = find_first_not_of(" \t\r\n");
+    size_t e = find_last_not_of(" \t\r\n");
+    if (b == npos) { clear(); return; }
+    assign(std::string::substr(b, e - b + 1));
+  }
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r.append(b); return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r.append(b); return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r.append(b); return r; }
+
+// ==========================================
+// Serial
+// ==========================================
+// Output goes to stdout only when enabled, so tools can run the firmware's logging paths
+// without paying for terminal I/O.
+class HostSerial {
+public:
+  FILE* out = nullptr;
+
+  void begin(unsigned long) {}
+  void setOutput(FILE* f) { out = f; }
+
+  int printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    if (!out) return 0;
+    va_list args;
+    va_start(args, format);
+    int n = vfprintf(out, format, args);
+    va_end(args);
+    return n;
+  }
+
+  void print(const char* s) { if (out) fputs(s, out); }
+  void print(const std::string& s) { print(s.c_str()); }
+  void print(char c) { if (out) fputc(c, out); }
+  void print(int v) { printf("%d", v); }
+  void print(unsigned int v) { printf("%u", v); }
+  void print(long v) { printf("%ld", v); }
+  void print(unsigned long v) { printf("%lu", v); }
+  void print(double v, int decimals = 2) { printf("%.*f", decimals, v); }
+
+  void println() { print("\n"); }
+  template <typename T> void println(const T& v) { print(v); println(); }
+  void println(double v, int decimals) { print(v, decimals); println(); }
+
+  size_t write(uint8_t c) { print((char)c); return 1; }
+};
+
+inline HostSerial Serial;
+
+// ==========================================
+// GPIO / ADC
+// ==========================================
+// Replay tools feed analog values per pin through host::analogValues
+namespace host {
+inline int analogValues[64] = {0};
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+inline uint16_t analogRead(uint8_t pin) { return (uint16_t)host::analogValues[pin & 63]; }
+
+#define A0 36
+#define A1 39
+#define A2 34
+#define A3 35
+#define A4 15
+#define D7 13
+
+#endif  // HOST_ARDUINO_H
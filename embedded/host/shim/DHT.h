@@ -0,0 +1,23 @@
+// Stand-in for the DHT22 driver. Replay tools set host::dhtTemperature and host::dhtHumidity;
+// NAN reads as a failed measurement, like the real library.
+#ifndef HOST_DHT_H
+#define HOST_DHT_H
+
+#include "Arduino.h"
+
+#define DHT22 22
+
+namespace host {
+inline float dhtTemperature = NAN;
+inline float dhtHumidity = NAN;
+}
+
+class DHT {
+public:
+  DHT(uint8_t pin, uint8_t type) {}
+  void begin() {}
+  float readTemperature() { return host::dhtTemperature; }
+  float readHumidity() { return host::dhtHumidity; }
+};
+
+#endif  // HOST_DHT_H
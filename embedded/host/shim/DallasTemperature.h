@@ -0,0 +1,21 @@
+// Stand-in for the DS18B20 driver. Replay tools set host::ds18b20TempC before each read.
+#ifndef HOST_DALLASTEMPERATURE_H
+#define HOST_DALLASTEMPERATURE_H
+
+#include "OneWire.h"
+
+#define DEVICE_DISCONNECTED_C -127
+
+namespace host {
+inline float ds18b20TempC = DEVICE_DISCONNECTED_C;
+}
+
+class DallasTemperature {
+public:
+  explicit DallasTemperature(OneWire*) {}
+  void begin() {}
+  void requestTemperatures() {}
+  float getTempCByIndex(uint8_t) { return host::ds18b20TempC; }
+};
+
+#endif  // HOST_DALLASTEMPERATURE_H
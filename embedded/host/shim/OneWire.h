@@ -0,0 +1,13 @@
+// Stand-in for the OneWire bus; the DallasTemperature stand-in doesn't use it
+#ifndef HOST_ONEWIRE_H
+#define HOST_ONEWIRE_H
+
+#include "Arduino.h"
+
+class OneWire {
+public:
+  explicit OneWire(uint8_t pin) : pin(pin) {}
+  uint8_t pin;
+};
+
+#endif  // HOST_ONEWIRE_H
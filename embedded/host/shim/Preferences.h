@@ -0,0 +1,106 @@
+// In-memory stand-in for the ESP32 Preferences (NVS) library
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+namespace host {
+typedef std::map<std::string, std::vector<uint8_t>> NvsNamespace;
+
+inline std::map<std::string, NvsNamespace>& nvs() {
+  static std::map<std::string, NvsNamespace> storage;
+  return storage;
+}
+
+// Bytes written through putBytes/put*; lets tools report NVS write volume
+inline size_t nvsBytesWritten = 0;
+}  // namespace host
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false, const char* = nullptr) {
+    ns = &host::nvs()[name];
+    this->readOnly = readOnly;
+    return true;
+  }
+
+  void end() { ns = nullptr; }
+
+  bool clear() {
+    if (!writable()) return false;
+    ns->clear();
+    return true;
+  }
+
+  bool remove(const char* key) {
+    if (!writable()) return false;
+    return ns->erase(key) > 0;
+  }
+
+  bool isKey(const char* key) { return ns && ns->count(key) > 0; }
+
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    if (!writable()) return 0;
+    const uint8_t* p = (const uint8_t*)value;
+    (*ns)[key].assign(p, p + len);
+    host::nvsBytesWritten += len;
+    return len;
+  }
+
+  size_t getBytesLength(const char* key) {
+    if (!ns) return 0;
+    auto it = ns->find(key);
+    return it == ns->end() ? 0 : it->second.size();
+  }
+
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!ns) return 0;
+    auto it = ns->find(key);
+    if (it == ns->end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+
+  size_t putString(const char* key, const char* value) { return putBytes(key, value, strlen(value) + 1); }
+  size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+
+  String getString(const char* key, const String& defaultValue = String()) {
+    if (!ns) return defaultValue;
+    auto it = ns->find(key);
+    return it == ns->end() ? defaultValue : String((const char*)it->second.data());
+  }
+
+  size_t getString(const char* key, char* value, size_t maxLen) {
+    String s = getString(key);
+    if (s.length() + 1 > maxLen) return 0;
+    memcpy(value, s.c_str(), s.length() + 1);
+    return s.length() + 1;
+  }
+
+  size_t putInt(const char* key, int32_t value) { return putScalar(key, value); }
+  int32_t getInt(const char* key, int32_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  size_t putUInt(const char* key, uint32_t value) { return putScalar(key, value); }
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  size_t putULong(const char* key, uint32_t value) { return putScalar(key, value); }
+  uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return getScalar(key, defaultValue); }
+  size_t putBool(const char* key, bool value) { return putScalar(key, (uint8_t)value); }
+  bool getBool(const char* key, bool defaultValue = false) { return getScalar(key, (uint8_t)defaultValue) != 0; }
+
+private:
+  host::NvsNamespace* ns = nullptr;
+  bool readOnly = false;
+
+  bool writable() const { return ns && !readOnly; }
+
+  template <typename T> size_t putScalar(const char* key, T value) { return putBytes(key, &value, sizeof(value)); }
+
+  template <typename T> T getScalar(const char* key, T defaultValue) {
+    T value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+  }
+};
+
+#endif  // HOST_PREFERENCES_H